@@ -138,6 +138,8 @@ dctool_errmsg (dc_status_t status)
 		return "Data format error";
 	case DC_STATUS_CANCELLED:
 		return "Cancelled";
+	case DC_STATUS_WOULDBLOCK:
+		return "Operation would block";
 	default:
 		return "Unknown error";
 	}
@@ -218,6 +220,7 @@ dctool_event_cb (dc_device_t *device, dc_event_type_t event, const void *data, v
 	const dc_event_devinfo_t *devinfo = (const dc_event_devinfo_t *) data;
 	const dc_event_clock_t *clock = (const dc_event_clock_t *) data;
 	const dc_event_vendor_t *vendor = (const dc_event_vendor_t *) data;
+	const dc_event_stats_t *stats = (const dc_event_stats_t *) data;
 
 	switch (event) {
 	case DC_EVENT_WAITING:
@@ -244,6 +247,11 @@ dctool_event_cb (dc_device_t *device, dc_event_type_t event, const void *data, v
 			message ("%02X", vendor->data[i]);
 		message ("\n");
 		break;
+	case DC_EVENT_STATS:
+		message ("Event: blocksize=%u, bytes=%u, elapsed=%u ms, throughput=%u B/s, errors=%u\n",
+			stats->blocksize, stats->nbytes, stats->elapsed,
+			stats->throughput, stats->nerrors);
+		break;
 	default:
 		break;
 	}
@@ -62,6 +62,7 @@ static const dctool_command_t *g_commands[] = {
 	&dctool_list,
 	&dctool_scan,
 	&dctool_download,
+	&dctool_fleet,
 	&dctool_dump,
 	&dctool_parse,
 	&dctool_read,
@@ -47,6 +47,7 @@ extern const dctool_command_t dctool_version;
 extern const dctool_command_t dctool_list;
 extern const dctool_command_t dctool_scan;
 extern const dctool_command_t dctool_download;
+extern const dctool_command_t dctool_fleet;
 extern const dctool_command_t dctool_dump;
 extern const dctool_command_t dctool_parse;
 extern const dctool_command_t dctool_read;
@@ -70,7 +70,7 @@ dump (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transpo
 
 	// Register the event handler.
 	message ("Registering the event handler.\n");
-	int events = DC_EVENT_WAITING | DC_EVENT_PROGRESS | DC_EVENT_DEVINFO | DC_EVENT_CLOCK | DC_EVENT_VENDOR;
+	int events = DC_EVENT_WAITING | DC_EVENT_PROGRESS | DC_EVENT_DEVINFO | DC_EVENT_CLOCK | DC_EVENT_VENDOR | DC_EVENT_STATS;
 	rc = dc_device_set_events (device, events, dctool_event_cb, NULL);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR ("Error registering the event handler.");
@@ -0,0 +1,490 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#endif
+
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/descriptor.h>
+#include <libdivecomputer/device.h>
+#include <libdivecomputer/parser.h>
+
+#include "dctool.h"
+#include "common.h"
+#include "output.h"
+#include "fleet.h"
+#include "utils.h"
+
+typedef struct fleet_options_t {
+	const char *outdir;
+	const char *cachedir;
+	const char *format;
+	dctool_units_t units;
+	unsigned int limit;
+} fleet_options_t;
+
+typedef struct fleet_data_t {
+	const fleet_options_t *options;
+	dctool_fleet_device_t *device;
+	dc_device_t *handle;
+	dc_event_devinfo_t devinfo;
+	unsigned int have_devinfo;
+	dc_buffer_t *fingerprint;
+	dctool_output_t *output;
+} fleet_data_t;
+
+static void
+fleet_filename (char *filename, size_t size, const char *directory, fleet_data_t *data, const char *suffix)
+{
+	dc_family_t family = dc_device_get_type (data->handle);
+
+	if (data->have_devinfo) {
+		snprintf (filename, size, "%s/%s-%08X%s",
+			directory, dctool_family_name (family), data->devinfo.serial, suffix);
+	} else {
+		snprintf (filename, size, "%s/%s-device%u%s",
+			directory, dctool_family_name (family), data->device->index, suffix);
+	}
+}
+
+static dctool_output_t *
+fleet_output_new (fleet_data_t *data)
+{
+	const fleet_options_t *options = data->options;
+	char filename[1024] = {0};
+
+	// The output is created on the first dive, once the serial number of
+	// the device is known.
+	if (strcasecmp (options->format, "raw") == 0) {
+		fleet_filename (filename, sizeof (filename), options->outdir, data, "-%n.bin");
+		return dctool_raw_output_new (filename);
+	} else {
+		fleet_filename (filename, sizeof (filename), options->outdir, data, ".xml");
+		return dctool_xml_output_new (filename, options->units);
+	}
+}
+
+static int
+fleet_dive_cb (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
+{
+	fleet_data_t *fleetdata = (fleet_data_t *) userdata;
+	dctool_fleet_device_t *device = fleetdata->device;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_parser_t *parser = NULL;
+
+	device->ndives++;
+	device->nbytes += size;
+
+	// Keep a copy of the most recent fingerprint.
+	if (device->ndives == 1) {
+		dc_buffer_t *fp = dc_buffer_new (fsize);
+		dc_buffer_append (fp, fingerprint, fsize);
+		fleetdata->fingerprint = fp;
+	}
+
+	if (fleetdata->output == NULL) {
+		fleetdata->output = fleet_output_new (fleetdata);
+		if (fleetdata->output == NULL) {
+			ERROR ("Failed to create the output.");
+			return 0;
+		}
+	}
+
+	rc = dc_parser_new (&parser, fleetdata->handle, data, size);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error creating the parser.");
+		goto cleanup;
+	}
+
+	rc = dctool_output_write (fleetdata->output, parser, data, size, fingerprint, fsize);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error parsing the dive data.");
+		goto cleanup;
+	}
+
+cleanup:
+	dc_parser_destroy (parser);
+
+	if (fleetdata->options->limit > 0 && device->ndives >= fleetdata->options->limit) {
+		return 0;
+	}
+
+	return 1;
+}
+
+static void
+fleet_event_cb (dc_device_t *device, dc_event_type_t event, const void *data, void *userdata)
+{
+	const dc_event_devinfo_t *devinfo = (const dc_event_devinfo_t *) data;
+
+	fleet_data_t *fleetdata = (fleet_data_t *) userdata;
+
+	if (event != DC_EVENT_DEVINFO)
+		return;
+
+	fleetdata->devinfo = *devinfo;
+	fleetdata->have_devinfo = 1;
+
+	message ("Device %u: model=%u, firmware=%u, serial=%u\n",
+		fleetdata->device->index, devinfo->model, devinfo->firmware, devinfo->serial);
+
+	// Load the fingerprint from the per-device cache.
+	if (fleetdata->options->cachedir) {
+		char filename[1024] = {0};
+		fleet_filename (filename, sizeof (filename), fleetdata->options->cachedir, fleetdata, ".bin");
+
+		dc_buffer_t *fingerprint = dctool_file_read (filename);
+		dc_device_set_fingerprint (device,
+			dc_buffer_get_data (fingerprint),
+			dc_buffer_get_size (fingerprint));
+		dc_buffer_free (fingerprint);
+	}
+}
+
+static unsigned long long
+fleet_median (const unsigned int histogram[])
+{
+	unsigned long long total = 0;
+	for (unsigned int i = 0; i < DC_IOSTREAM_NBUCKETS; ++i)
+		total += histogram[i];
+
+	unsigned long long count = 0;
+	for (unsigned int i = 0; i < DC_IOSTREAM_NBUCKETS; ++i) {
+		count += histogram[i];
+		if (count * 2 >= total && total)
+			return 1ULL << i;
+	}
+
+	return 0;
+}
+
+static void
+fleet_iostats (dctool_fleet_device_t *device, dc_iostream_t *iostream)
+{
+	dc_iostream_stats_t stats;
+
+	if (dc_iostream_get_stats (iostream, &stats) != DC_STATUS_SUCCESS)
+		return;
+
+	message ("Device %u: %s I/O: in=%llu, out=%llu, reads=%u, writes=%u, calls=%u, timeouts=%u, purges=%u, retransmits=%u, latency=~%llu us, read=~%llu us\n",
+		device->index,
+		dc_descriptor_get_product (device->descriptor),
+		stats.nbytes_in, stats.nbytes_out,
+		stats.nreads, stats.nwrites, stats.ncalls,
+		stats.ntimeouts, stats.npurges, stats.nretransmits,
+		fleet_median (stats.latency), fleet_median (stats.read));
+}
+
+static dc_status_t
+fleet_download (dc_context_t *context, dctool_fleet_device_t *device, void *userdata)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_iostream_t *iostream = NULL;
+
+	fleet_data_t fleetdata = {0};
+	fleetdata.options = (const fleet_options_t *) userdata;
+	fleetdata.device = device;
+
+	message ("Device %u: %s %s (%s%s%s)\n", device->index,
+		dc_descriptor_get_vendor (device->descriptor),
+		dc_descriptor_get_product (device->descriptor),
+		dctool_transport_name (device->transport),
+		device->name ? ", " : "",
+		device->name ? device->name : "");
+
+	rc = dctool_fleet_iostream_open (&iostream, context, device);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error opening the I/O stream.");
+		goto cleanup;
+	}
+
+	rc = dc_device_open (&fleetdata.handle, context, device->descriptor, iostream);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error opening the device.");
+		goto cleanup;
+	}
+
+	rc = dc_device_set_events (fleetdata.handle, DC_EVENT_DEVINFO, fleet_event_cb, &fleetdata);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error registering the event handler.");
+		goto cleanup;
+	}
+
+	rc = dc_device_set_cancel (fleetdata.handle, dctool_cancel_cb, NULL);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error registering the cancellation handler.");
+		goto cleanup;
+	}
+
+	rc = dc_device_foreach (fleetdata.handle, fleet_dive_cb, &fleetdata);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error downloading the dives.");
+		goto cleanup;
+	}
+
+	// Store the fingerprint data.
+	if (fleetdata.options->cachedir && fleetdata.fingerprint && fleetdata.have_devinfo) {
+		char filename[1024] = {0};
+		fleet_filename (filename, sizeof (filename), fleetdata.options->cachedir, &fleetdata, ".bin");
+		dctool_file_write (filename, fleetdata.fingerprint);
+	}
+
+cleanup:
+	dctool_output_free (fleetdata.output);
+	dc_buffer_free (fleetdata.fingerprint);
+	dc_device_close (fleetdata.handle);
+	if (iostream)
+		fleet_iostats (device, iostream);
+	dc_iostream_close (iostream);
+	return rc;
+}
+
+static int
+dctool_fleet_run_command (int argc, char *argv[], dc_context_t *context, dc_descriptor_t *descriptor)
+{
+	int exitcode = EXIT_SUCCESS;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dctool_fleet_t *fleet = NULL;
+
+	// Default option values.
+	unsigned int help = 0;
+	unsigned int transports = 0;
+	unsigned int nworkers = 0;
+	fleet_options_t options = {0};
+	options.outdir = ".";
+	options.format = "xml";
+	options.units = DCTOOL_UNITS_METRIC;
+
+	// Parse the command-line options.
+	int opt = 0;
+	const char *optstring = "ht:j:o:c:f:u:l:";
+#ifdef HAVE_GETOPT_LONG
+	struct option longoptions[] = {
+		{"help",        no_argument,       0, 'h'},
+		{"transport",   required_argument, 0, 't'},
+		{"jobs",        required_argument, 0, 'j'},
+		{"output",      required_argument, 0, 'o'},
+		{"cache",       required_argument, 0, 'c'},
+		{"format",      required_argument, 0, 'f'},
+		{"units",       required_argument, 0, 'u'},
+		{"limit",       required_argument, 0, 'l'},
+		{0,             0,                 0,  0 }
+	};
+	while ((opt = getopt_long (argc, argv, optstring, longoptions, NULL)) != -1) {
+#else
+	while ((opt = getopt (argc, argv, optstring)) != -1) {
+#endif
+		switch (opt) {
+		case 'h':
+			help = 1;
+			break;
+		case 't':
+			transports |= dctool_transport_type (optarg);
+			break;
+		case 'j':
+			nworkers = strtoul (optarg, NULL, 0);
+			break;
+		case 'o':
+			options.outdir = optarg;
+			break;
+		case 'c':
+			options.cachedir = optarg;
+			break;
+		case 'f':
+			options.format = optarg;
+			break;
+		case 'u':
+			if (strcmp (optarg, "metric") == 0)
+				options.units = DCTOOL_UNITS_METRIC;
+			if (strcmp (optarg, "imperial") == 0)
+				options.units = DCTOOL_UNITS_IMPERIAL;
+			break;
+		case 'l':
+			options.limit = strtoul (optarg, NULL, 0);
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	// Show help message.
+	if (help) {
+		dctool_command_showhelp (&dctool_fleet);
+		return EXIT_SUCCESS;
+	}
+
+	if (strcasecmp (options.format, "raw") != 0 && strcasecmp (options.format, "xml") != 0) {
+		message ("Unknown output format: %s\n", options.format);
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	// Serial devices can't be identified, and require a descriptor.
+	if (transports == 0) {
+		transports = DC_TRANSPORT_USB | DC_TRANSPORT_USBHID;
+		if (descriptor && argc)
+			transports |= dctool_transport_default (descriptor);
+	}
+
+	fleet = dctool_fleet_new (context);
+	if (fleet == NULL) {
+		message ("Failed to create the fleet.\n");
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	// Add the usb devices.
+	status = dctool_fleet_scan (fleet, descriptor, transports);
+	if (status != DC_STATUS_SUCCESS) {
+		message ("ERROR: %s\n", dctool_errmsg (status));
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	// Add the named devices, or all matching serial ports.
+	const dc_transport_t named[] = {DC_TRANSPORT_SERIAL, DC_TRANSPORT_IRDA, DC_TRANSPORT_BLUETOOTH};
+	for (unsigned int i = 0; i < sizeof (named) / sizeof (named[0]); ++i) {
+		if ((transports & named[i]) == 0)
+			continue;
+
+		if (descriptor == NULL) {
+			message ("A device descriptor is required for the %s transport.\n",
+				dctool_transport_name (named[i]));
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+
+		if (argc == 0) {
+			status = dctool_fleet_add (fleet, descriptor, named[i], NULL);
+		}
+		for (int j = 0; j < argc && status == DC_STATUS_SUCCESS; ++j) {
+			status = dctool_fleet_add (fleet, descriptor, named[i], argv[j]);
+		}
+		if (status != DC_STATUS_SUCCESS) {
+			message ("ERROR: %s\n", dctool_errmsg (status));
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	}
+
+	unsigned int count = dctool_fleet_count (fleet);
+	if (count == 0) {
+		message ("No supported devices found.\n");
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	message ("Downloading %u devices.\n", count);
+
+	// Download all devices concurrently.
+	unsigned long long elapsed = 0;
+	status = dctool_fleet_run (fleet, nworkers, fleet_download, &options, &elapsed);
+	if (status != DC_STATUS_SUCCESS) {
+		message ("ERROR: %s\n", dctool_errmsg (status));
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	// Report the results.
+	unsigned int ndives = 0, nfailed = 0;
+	unsigned long long nbytes = 0;
+	for (unsigned int i = 0; i < count; ++i) {
+		const dctool_fleet_device_t *device = dctool_fleet_get (fleet, i);
+		unsigned long long throughput = device->elapsed ? device->nbytes * 1000 / device->elapsed : 0;
+
+		message ("Device %u: %s %s: %s, dives=%u, bytes=%llu, elapsed=%llu ms, throughput=%llu B/s\n",
+			device->index,
+			dc_descriptor_get_vendor (device->descriptor),
+			dc_descriptor_get_product (device->descriptor),
+			dctool_errmsg (device->status),
+			device->ndives, device->nbytes, device->elapsed, throughput);
+
+		ndives += device->ndives;
+		nbytes += device->nbytes;
+		if (device->status != DC_STATUS_SUCCESS)
+			nfailed++;
+	}
+
+	message ("Total: devices=%u, failed=%u, dives=%u, bytes=%llu, elapsed=%llu ms, throughput=%llu B/s\n",
+		count, nfailed, ndives, nbytes, elapsed,
+		elapsed ? nbytes * 1000 / elapsed : 0);
+
+	if (nfailed)
+		exitcode = EXIT_FAILURE;
+
+cleanup:
+	dctool_fleet_free (fleet);
+	return exitcode;
+}
+
+const dctool_command_t dctool_fleet = {
+	dctool_fleet_run_command,
+	DCTOOL_CONFIG_NONE,
+	"fleet",
+	"Download the dives of many devices concurrently",
+	"Usage:\n"
+	"   dctool fleet [options] [<devname>...]\n"
+	"\n"
+	"Options:\n"
+#ifdef HAVE_GETOPT_LONG
+	"   -h, --help                 Show help message\n"
+	"   -t, --transport <name>     Transport type (can be repeated)\n"
+	"   -j, --jobs <number>        Maximum number of concurrent downloads\n"
+	"   -o, --output <directory>   Output directory\n"
+	"   -c, --cache <directory>    Cache directory\n"
+	"   -f, --format <format>      Output format\n"
+	"   -u, --units <units>        Set units (metric or imperial)\n"
+	"   -l, --limit <number>       Maximum number of dives per device\n"
+#else
+	"   -h                 Show help message\n"
+	"   -t <transport>     Transport type (can be repeated)\n"
+	"   -j <number>        Maximum number of concurrent downloads\n"
+	"   -o <directory>     Output directory\n"
+	"   -c <directory>     Cache directory\n"
+	"   -f <format>        Output format\n"
+	"   -u <units>         Set units (metric or imperial)\n"
+	"   -l <limit>         Maximum number of dives per device\n"
+#endif
+	"\n"
+	"All connected usb and usbhid devices are detected automatically. If a\n"
+	"device is selected with the global options, only matching devices are\n"
+	"downloaded. Serial, irda and bluetooth devices require a selected device,\n"
+	"and are downloaded from the given device names, or from all matching\n"
+	"serial ports.\n"
+	"\n"
+	"The dives of each device are written to a separate file in the output\n"
+	"directory, named after the family and the serial number of the device.\n"
+	"The fingerprint of each device is cached in the same way.\n"
+};
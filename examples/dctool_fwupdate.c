@@ -44,7 +44,7 @@
 #include "utils.h"
 
 static dc_status_t
-fwupdate (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname, const char *hexfile)
+fwupdate (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t transport, const char *devname, const char *hexfile, unsigned int fast)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	dc_iostream_t *iostream = NULL;
@@ -94,7 +94,7 @@ fwupdate (dc_context_t *context, dc_descriptor_t *descriptor, dc_transport_t tra
 		rc = hw_ostc_device_fwupdate (device, hexfile);
 		break;
 	case DC_FAMILY_HW_OSTC3:
-		rc = hw_ostc3_device_fwupdate (device, hexfile);
+		rc = hw_ostc3_device_fwupdate2 (device, hexfile, fast ? HW_OSTC3_FWUPDATE_FAST : 0);
 		break;
 	case DC_FAMILY_DIVESYSTEM_IDIVE:
 		rc = divesystem_idive_device_fwupdate (device, hexfile);
@@ -123,16 +123,18 @@ dctool_fwupdate_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 
 	// Default option values.
 	unsigned int help = 0;
+	unsigned int fast = 0;
 	const char *filename = NULL;
 
 	// Parse the command-line options.
 	int opt = 0;
-	const char *optstring = "ht:f:";
+	const char *optstring = "ht:f:q";
 #ifdef HAVE_GETOPT_LONG
 	struct option options[] = {
 		{"help",        no_argument,       0, 'h'},
 		{"transport",   required_argument, 0, 't'},
 		{"firmware",    required_argument, 0, 'f'},
+		{"quick",       no_argument,       0, 'q'},
 		{0,             0,                 0,  0 }
 	};
 	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
@@ -146,6 +148,9 @@ dctool_fwupdate_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 		case 't':
 			transport = dctool_transport_type (optarg);
 			break;
+		case 'q':
+			fast = 1;
+			break;
 		case 'h':
 			help = 1;
 			break;
@@ -178,7 +183,7 @@ dctool_fwupdate_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 	}
 
 	// Update the firmware.
-	status = fwupdate (context, descriptor, transport, argv[0], filename);
+	status = fwupdate (context, descriptor, transport, argv[0], filename, fast);
 	if (status != DC_STATUS_SUCCESS) {
 		message ("ERROR: %s\n", dctool_errmsg (status));
 		exitcode = EXIT_FAILURE;
@@ -202,9 +207,11 @@ const dctool_command_t dctool_fwupdate = {
 	"   -h, --help                  Show help message\n"
 	"   -t, --transport <name>      Transport type\n"
 	"   -f, --firmware <filename>   Firmware filename\n"
+	"   -q, --quick                 Skip the read-back verification\n"
 #else
 	"   -h              Show help message\n"
 	"   -t <transport>  Transport type\n"
 	"   -f <filename>   Firmware filename\n"
+	"   -q              Skip the read-back verification\n"
 #endif
 };
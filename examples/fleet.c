@@ -0,0 +1,498 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <pthread.h>
+#endif
+
+#include <libdivecomputer/iterator.h>
+#include <libdivecomputer/serial.h>
+#include <libdivecomputer/usb.h>
+#include <libdivecomputer/usbhid.h>
+
+#include "fleet.h"
+#include "common.h"
+#include "utils.h"
+
+typedef struct dctool_fleet_claim_t {
+	dc_transport_t transport;
+	unsigned int vid, pid;
+	dc_descriptor_t *descriptor;
+} dctool_fleet_claim_t;
+
+struct dctool_fleet_t {
+	dc_context_t *context;
+	/* Devices. */
+	dctool_fleet_device_t *devices;
+	unsigned int ndevices;
+	/* Descriptors owned by the fleet. */
+	dc_descriptor_t **descriptors;
+	unsigned int ndescriptors;
+	/* Usb vendor and product ids claimed by a descriptor. */
+	dctool_fleet_claim_t *claims;
+	unsigned int nclaims;
+	/* Work queue. */
+	dctool_fleet_func_t func;
+	void *userdata;
+	unsigned int next;
+#ifdef _WIN32
+	SRWLOCK lock;
+#else
+	pthread_mutex_t lock;
+#endif
+};
+
+static unsigned long long
+dctool_fleet_now (void)
+{
+#ifdef _WIN32
+	return GetTickCount64 ();
+#else
+	struct timeval now;
+	gettimeofday (&now, NULL);
+	return (unsigned long long) now.tv_sec * 1000 + now.tv_usec / 1000;
+#endif
+}
+
+static void
+dctool_fleet_lock (dctool_fleet_t *fleet)
+{
+#ifdef _WIN32
+	AcquireSRWLockExclusive (&fleet->lock);
+#else
+	pthread_mutex_lock (&fleet->lock);
+#endif
+}
+
+static void
+dctool_fleet_unlock (dctool_fleet_t *fleet)
+{
+#ifdef _WIN32
+	ReleaseSRWLockExclusive (&fleet->lock);
+#else
+	pthread_mutex_unlock (&fleet->lock);
+#endif
+}
+
+dctool_fleet_t *
+dctool_fleet_new (dc_context_t *context)
+{
+	dctool_fleet_t *fleet = (dctool_fleet_t *) malloc (sizeof (dctool_fleet_t));
+	if (fleet == NULL)
+		return NULL;
+
+	memset (fleet, 0, sizeof (dctool_fleet_t));
+	fleet->context = context;
+#ifdef _WIN32
+	InitializeSRWLock (&fleet->lock);
+#else
+	pthread_mutex_init (&fleet->lock, NULL);
+#endif
+
+	return fleet;
+}
+
+void
+dctool_fleet_free (dctool_fleet_t *fleet)
+{
+	if (fleet == NULL)
+		return;
+
+	for (unsigned int i = 0; i < fleet->ndevices; ++i) {
+		dctool_fleet_device_t *device = &fleet->devices[i];
+		if (device->transport == DC_TRANSPORT_USB) {
+			dc_usb_device_free (device->handle);
+		} else if (device->transport == DC_TRANSPORT_USBHID) {
+			dc_usbhid_device_free (device->handle);
+		}
+		free (device->name);
+	}
+
+	for (unsigned int i = 0; i < fleet->ndescriptors; ++i) {
+		dc_descriptor_free (fleet->descriptors[i]);
+	}
+
+#ifndef _WIN32
+	pthread_mutex_destroy (&fleet->lock);
+#endif
+	free (fleet->claims);
+	free (fleet->descriptors);
+	free (fleet->devices);
+	free (fleet);
+}
+
+static dctool_fleet_device_t *
+dctool_fleet_append (dctool_fleet_t *fleet, dc_descriptor_t *descriptor, dc_transport_t transport)
+{
+	dctool_fleet_device_t *devices = (dctool_fleet_device_t *) realloc (fleet->devices, (fleet->ndevices + 1) * sizeof (dctool_fleet_device_t));
+	if (devices == NULL)
+		return NULL;
+
+	fleet->devices = devices;
+
+	dctool_fleet_device_t *device = &devices[fleet->ndevices];
+	memset (device, 0, sizeof (dctool_fleet_device_t));
+	device->index = fleet->ndevices;
+	device->descriptor = descriptor;
+	device->transport = transport;
+	device->status = DC_STATUS_SUCCESS;
+
+	fleet->ndevices++;
+
+	return device;
+}
+
+/*
+ * Several descriptors can match the same usb vendor and product id. The
+ * first descriptor is used for all devices with that id.
+ */
+static int
+dctool_fleet_claim (dctool_fleet_t *fleet, dc_descriptor_t *descriptor, dc_transport_t transport, unsigned int vid, unsigned int pid)
+{
+	for (unsigned int i = 0; i < fleet->nclaims; ++i) {
+		const dctool_fleet_claim_t *claim = &fleet->claims[i];
+		if (claim->transport == transport && claim->vid == vid && claim->pid == pid)
+			return claim->descriptor == descriptor;
+	}
+
+	dctool_fleet_claim_t *claims = (dctool_fleet_claim_t *) realloc (fleet->claims, (fleet->nclaims + 1) * sizeof (dctool_fleet_claim_t));
+	if (claims == NULL)
+		return 0;
+
+	fleet->claims = claims;
+	fleet->claims[fleet->nclaims].transport = transport;
+	fleet->claims[fleet->nclaims].vid = vid;
+	fleet->claims[fleet->nclaims].pid = pid;
+	fleet->claims[fleet->nclaims].descriptor = descriptor;
+	fleet->nclaims++;
+
+	return 1;
+}
+
+static void
+dctool_fleet_unclaim (dctool_fleet_t *fleet, dc_descriptor_t *descriptor)
+{
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < fleet->nclaims; ++i) {
+		if (fleet->claims[i].descriptor != descriptor) {
+			fleet->claims[n++] = fleet->claims[i];
+		}
+	}
+
+	fleet->nclaims = n;
+}
+
+static dc_status_t
+dctool_fleet_scan_descriptor (dctool_fleet_t *fleet, dc_descriptor_t *descriptor, dc_transport_t transport, unsigned int *count)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_iterator_t *iterator = NULL;
+
+	if (transport == DC_TRANSPORT_USB) {
+		status = dc_usb_iterator_new (&iterator, fleet->context, descriptor);
+	} else {
+		status = dc_usbhid_iterator_new (&iterator, fleet->context, descriptor);
+	}
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	void *handle = NULL;
+	while ((status = dc_iterator_next (iterator, &handle)) == DC_STATUS_SUCCESS) {
+		unsigned int vid = 0, pid = 0;
+		if (transport == DC_TRANSPORT_USB) {
+			vid = dc_usb_device_get_vid (handle);
+			pid = dc_usb_device_get_pid (handle);
+		} else {
+			vid = dc_usbhid_device_get_vid (handle);
+			pid = dc_usbhid_device_get_pid (handle);
+		}
+
+		dctool_fleet_device_t *device = NULL;
+		if (dctool_fleet_claim (fleet, descriptor, transport, vid, pid)) {
+			device = dctool_fleet_append (fleet, descriptor, transport);
+		}
+
+		if (device == NULL) {
+			if (transport == DC_TRANSPORT_USB) {
+				dc_usb_device_free (handle);
+			} else {
+				dc_usbhid_device_free (handle);
+			}
+			continue;
+		}
+
+		device->handle = handle;
+		(*count)++;
+	}
+
+	dc_iterator_free (iterator);
+
+	if (status != DC_STATUS_DONE)
+		return status;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dctool_fleet_scan (dctool_fleet_t *fleet, dc_descriptor_t *descriptor, unsigned int transports)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	const dc_transport_t list[] = {DC_TRANSPORT_USB, DC_TRANSPORT_USBHID};
+	for (unsigned int i = 0; i < sizeof (list) / sizeof (list[0]); ++i) {
+		dc_transport_t transport = list[i];
+		if ((transports & transport) == 0 ||
+			(dc_context_get_transports (fleet->context) & transport) == 0)
+			continue;
+
+		if (descriptor) {
+			if ((dc_descriptor_get_transports (descriptor) & transport) == 0)
+				continue;
+
+			unsigned int count = 0;
+			status = dctool_fleet_scan_descriptor (fleet, descriptor, transport, &count);
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+
+			continue;
+		}
+
+		// Try all known descriptors.
+		dc_iterator_t *iterator = NULL;
+		status = dc_descriptor_iterator_new (&iterator, fleet->context);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		dc_descriptor_t *current = NULL;
+		while ((status = dc_iterator_next (iterator, &current)) == DC_STATUS_SUCCESS) {
+			// The fleet owns the descriptor before any device or claim
+			// can refer to it.
+			dc_descriptor_t **descriptors = (dc_descriptor_t **) realloc (fleet->descriptors, (fleet->ndescriptors + 1) * sizeof (dc_descriptor_t *));
+			if (descriptors == NULL) {
+				dc_descriptor_free (current);
+				status = DC_STATUS_NOMEMORY;
+				break;
+			}
+
+			fleet->descriptors = descriptors;
+			fleet->descriptors[fleet->ndescriptors++] = current;
+
+			unsigned int count = 0;
+			if (dc_descriptor_get_transports (current) & transport) {
+				status = dctool_fleet_scan_descriptor (fleet, current, transport, &count);
+				if (status != DC_STATUS_SUCCESS)
+					break;
+			}
+
+			// Keep the descriptor only if it's used by a device.
+			if (count == 0) {
+				dctool_fleet_unclaim (fleet, current);
+				fleet->ndescriptors--;
+				dc_descriptor_free (current);
+			}
+		}
+
+		dc_iterator_free (iterator);
+
+		if (status != DC_STATUS_DONE)
+			return status;
+
+		status = DC_STATUS_SUCCESS;
+	}
+
+	return status;
+}
+
+dc_status_t
+dctool_fleet_add (dctool_fleet_t *fleet, dc_descriptor_t *descriptor, dc_transport_t transport, const char *name)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (name) {
+		dctool_fleet_device_t *device = dctool_fleet_append (fleet, descriptor, transport);
+		if (device == NULL)
+			return DC_STATUS_NOMEMORY;
+
+		device->name = strdup (name);
+		if (device->name == NULL)
+			return DC_STATUS_NOMEMORY;
+
+		return DC_STATUS_SUCCESS;
+	}
+
+	if (transport != DC_TRANSPORT_SERIAL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_iterator_t *iterator = NULL;
+	status = dc_serial_iterator_new (&iterator, fleet->context, descriptor);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	dc_serial_device_t *port = NULL;
+	while ((status = dc_iterator_next (iterator, &port)) == DC_STATUS_SUCCESS) {
+		status = dctool_fleet_add (fleet, descriptor, transport, dc_serial_device_get_name (port));
+		dc_serial_device_free (port);
+		if (status != DC_STATUS_SUCCESS)
+			break;
+	}
+
+	dc_iterator_free (iterator);
+
+	if (status != DC_STATUS_DONE)
+		return status;
+
+	return DC_STATUS_SUCCESS;
+}
+
+unsigned int
+dctool_fleet_count (dctool_fleet_t *fleet)
+{
+	return fleet->ndevices;
+}
+
+dctool_fleet_device_t *
+dctool_fleet_get (dctool_fleet_t *fleet, unsigned int index)
+{
+	if (index >= fleet->ndevices)
+		return NULL;
+
+	return &fleet->devices[index];
+}
+
+dc_status_t
+dctool_fleet_iostream_open (dc_iostream_t **iostream, dc_context_t *context, dctool_fleet_device_t *device)
+{
+	switch (device->transport) {
+	case DC_TRANSPORT_USB:
+		if (device->handle)
+			return dc_usb_open (iostream, context, device->handle);
+		break;
+	case DC_TRANSPORT_USBHID:
+		if (device->handle)
+			return dc_usbhid_open (iostream, context, device->handle);
+		break;
+	default:
+		break;
+	}
+
+	return dctool_iostream_open (iostream, context, device->descriptor, device->transport, device->name);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+dctool_fleet_worker (LPVOID userdata)
+#else
+static void *
+dctool_fleet_worker (void *userdata)
+#endif
+{
+	dctool_fleet_t *fleet = (dctool_fleet_t *) userdata;
+
+	while (1) {
+		dctool_fleet_lock (fleet);
+		unsigned int index = fleet->next;
+		if (index < fleet->ndevices)
+			fleet->next++;
+		dctool_fleet_unlock (fleet);
+
+		if (index >= fleet->ndevices)
+			break;
+
+		dctool_fleet_device_t *device = &fleet->devices[index];
+
+		unsigned long long start = dctool_fleet_now ();
+		device->status = fleet->func (fleet->context, device, fleet->userdata);
+		device->elapsed = dctool_fleet_now () - start;
+	}
+
+	return 0;
+}
+
+dc_status_t
+dctool_fleet_run (dctool_fleet_t *fleet, unsigned int nworkers, dctool_fleet_func_t func, void *userdata, unsigned long long *elapsed)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (nworkers == 0 || nworkers > fleet->ndevices)
+		nworkers = fleet->ndevices;
+
+	fleet->func = func;
+	fleet->userdata = userdata;
+	fleet->next = 0;
+
+	unsigned long long start = dctool_fleet_now ();
+
+#ifdef _WIN32
+	HANDLE *threads = (HANDLE *) malloc (nworkers * sizeof (HANDLE));
+#else
+	pthread_t *threads = (pthread_t *) malloc (nworkers * sizeof (pthread_t));
+#endif
+	if (threads == NULL && nworkers) {
+		ERROR ("Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	unsigned int nthreads = 0;
+	for (unsigned int i = 0; i < nworkers; ++i) {
+#ifdef _WIN32
+		threads[i] = CreateThread (NULL, 0, dctool_fleet_worker, fleet, 0, NULL);
+		if (threads[i] == NULL)
+			break;
+#else
+		if (pthread_create (&threads[i], NULL, dctool_fleet_worker, fleet) != 0)
+			break;
+#endif
+		nthreads++;
+	}
+
+	// Process the remaining devices on the current thread if no worker
+	// could be started at all.
+	if (nthreads == 0 && nworkers) {
+		WARNING ("Failed to create the worker threads.");
+		dctool_fleet_worker (fleet);
+	}
+
+	for (unsigned int i = 0; i < nthreads; ++i) {
+#ifdef _WIN32
+		WaitForSingleObject (threads[i], INFINITE);
+		CloseHandle (threads[i]);
+#else
+		pthread_join (threads[i], NULL);
+#endif
+	}
+
+	free (threads);
+
+	if (elapsed)
+		*elapsed = dctool_fleet_now () - start;
+
+	return status;
+}
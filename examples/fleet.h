@@ -0,0 +1,95 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DCTOOL_FLEET_H
+#define DCTOOL_FLEET_H
+
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/descriptor.h>
+#include <libdivecomputer/iostream.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct dctool_fleet_t dctool_fleet_t;
+
+typedef struct dctool_fleet_device_t {
+	unsigned int index;
+	dc_descriptor_t *descriptor;
+	dc_transport_t transport;
+	char *name;
+	void *handle;
+	/* Results, filled in by the worker. */
+	dc_status_t status;
+	unsigned int ndives;
+	unsigned long long nbytes;
+	unsigned long long elapsed;
+} dctool_fleet_device_t;
+
+typedef dc_status_t (*dctool_fleet_func_t) (dc_context_t *context, dctool_fleet_device_t *device, void *userdata);
+
+dctool_fleet_t *
+dctool_fleet_new (dc_context_t *context);
+
+void
+dctool_fleet_free (dctool_fleet_t *fleet);
+
+/*
+ * Add all connected usb and usbhid devices, matching either the given
+ * descriptor, or any known descriptor if no descriptor is given.
+ */
+dc_status_t
+dctool_fleet_scan (dctool_fleet_t *fleet, dc_descriptor_t *descriptor, unsigned int transports);
+
+/*
+ * Add a device by name. If no name is given, all serial ports matching the
+ * descriptor are added.
+ */
+dc_status_t
+dctool_fleet_add (dctool_fleet_t *fleet, dc_descriptor_t *descriptor, dc_transport_t transport, const char *name);
+
+unsigned int
+dctool_fleet_count (dctool_fleet_t *fleet);
+
+dctool_fleet_device_t *
+dctool_fleet_get (dctool_fleet_t *fleet, unsigned int index);
+
+dc_status_t
+dctool_fleet_iostream_open (dc_iostream_t **iostream, dc_context_t *context, dctool_fleet_device_t *device);
+
+/*
+ * Process all devices with a pool of worker threads. The function returns
+ * once all devices are finished, and the wall clock time is returned in
+ * milliseconds.
+ *
+ * All workers share the context, and the usb and usbhid devices also share
+ * the libusb session. The transfer state of each usb and usbhid device is
+ * protected by its own mutex, because the libusb callbacks can run on any
+ * worker thread.
+ */
+dc_status_t
+dctool_fleet_run (dctool_fleet_t *fleet, unsigned int nworkers, dctool_fleet_func_t func, void *userdata, unsigned long long *elapsed);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DCTOOL_FLEET_H */
@@ -22,6 +22,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
 
 #include <libdivecomputer/units.h>
 
@@ -31,10 +33,14 @@
 static dc_status_t dctool_xml_output_write (dctool_output_t *output, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
 static dc_status_t dctool_xml_output_free (dctool_output_t *output);
 
+#define BUFSIZE 65536
+
 typedef struct dctool_xml_output_t {
 	dctool_output_t base;
 	FILE *ostream;
 	dctool_units_t units;
+	size_t length;
+	char buffer[BUFSIZE];
 } dctool_xml_output_t;
 
 static const dctool_output_vtable_t xml_vtable = {
@@ -44,11 +50,156 @@ static const dctool_output_vtable_t xml_vtable = {
 };
 
 typedef struct sample_data_t {
-	FILE *ostream;
+	dctool_xml_output_t *output;
 	dctool_units_t units;
 	unsigned int nsamples;
 } sample_data_t;
 
+/*
+ * The output is collected in a large buffer, which is written to the
+ * file in a single call once it is full. The numbers are formatted
+ * manually, because the printf family of functions is too slow for the
+ * large number of samples.
+ */
+
+static void
+xml_flush (dctool_xml_output_t *output)
+{
+	if (output->length) {
+		fwrite (output->buffer, 1, output->length, output->ostream);
+		output->length = 0;
+	}
+}
+
+static char *
+xml_reserve (dctool_xml_output_t *output, size_t size)
+{
+	if (output->length + size > sizeof (output->buffer))
+		xml_flush (output);
+
+	return output->buffer + output->length;
+}
+
+static void
+xml_write (dctool_xml_output_t *output, const char *data, size_t size)
+{
+	if (size > sizeof (output->buffer)) {
+		xml_flush (output);
+		fwrite (data, 1, size, output->ostream);
+		return;
+	}
+
+	memcpy (xml_reserve (output, size), data, size);
+	output->length += size;
+}
+
+static void
+xml_puts (dctool_xml_output_t *output, const char *str)
+{
+	xml_write (output, str, strlen (str));
+}
+
+static void
+xml_printf (dctool_xml_output_t *output, const char *format, ...)
+{
+	va_list ap;
+
+	size_t available = sizeof (output->buffer) - output->length;
+
+	va_start (ap, format);
+	int n = vsnprintf (output->buffer + output->length, available, format, ap);
+	va_end (ap);
+
+	if (n >= 0 && (size_t) n >= available && (size_t) n < sizeof (output->buffer)) {
+		// Retry with an empty buffer.
+		xml_flush (output);
+
+		va_start (ap, format);
+		n = vsnprintf (output->buffer, sizeof (output->buffer), format, ap);
+		va_end (ap);
+	}
+
+	if (n < 0 || (size_t) n >= sizeof (output->buffer) - output->length) {
+		// Write directly to the file.
+		xml_flush (output);
+
+		va_start (ap, format);
+		vfprintf (output->ostream, format, ap);
+		va_end (ap);
+		return;
+	}
+
+	output->length += n;
+}
+
+static void
+xml_uint (dctool_xml_output_t *output, unsigned int value, unsigned int width)
+{
+	char digits[16];
+	unsigned int n = 0;
+
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value || n < width);
+
+	char *p = xml_reserve (output, n);
+	for (unsigned int i = 0; i < n; ++i) {
+		p[i] = digits[n - 1 - i];
+	}
+	output->length += n;
+}
+
+static void
+xml_fixed (dctool_xml_output_t *output, double value, unsigned int decimals)
+{
+	static const unsigned int scale[] = {1, 10, 100, 1000};
+
+	// Fall back to printf for values which don't fit, or are not finite.
+	// Values close to a halfway case are also left to printf, because the
+	// scaling can introduce a rounding error.
+	double scaled = fabs (value) * scale[decimals];
+	if (!(scaled < 4294967295.0) || fabs (scaled - floor (scaled) - 0.5) < 1e-6) {
+		xml_printf (output, "%.*f", decimals, value);
+		return;
+	}
+
+	unsigned int number = (unsigned int) rint (scaled);
+
+	if (signbit (value)) {
+		xml_write (output, "-", 1);
+	}
+
+	xml_uint (output, number / scale[decimals], 1);
+	if (decimals) {
+		xml_write (output, ".", 1);
+		xml_uint (output, number % scale[decimals], decimals);
+	}
+}
+
+static void
+xml_hex (dctool_xml_output_t *output, const unsigned char data[], unsigned int size)
+{
+	static const char hex[] = "0123456789ABCDEF";
+
+	while (size) {
+		unsigned int n = size;
+		if (n > sizeof (output->buffer) / 2) {
+			n = sizeof (output->buffer) / 2;
+		}
+
+		char *p = xml_reserve (output, n * 2);
+		for (unsigned int i = 0; i < n; ++i) {
+			p[i * 2 + 0] = hex[(data[i] >> 4) & 0x0F];
+			p[i * 2 + 1] = hex[data[i] & 0x0F];
+		}
+		output->length += n * 2;
+
+		data += n;
+		size -= n;
+	}
+}
+
 static double
 convert_depth (double value, dctool_units_t units)
 {
@@ -103,6 +254,7 @@ sample_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata
 		"ndl", "safety", "deco", "deep"};
 
 	sample_data_t *sampledata = (sample_data_t *) userdata;
+	dctool_xml_output_t *output = sampledata->output;
 
 	unsigned int seconds = 0, milliseconds = 0;
 
@@ -111,73 +263,112 @@ sample_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata
 		seconds = value->time / 1000;
 		milliseconds = value->time % 1000;
 		if (sampledata->nsamples++)
-			fprintf (sampledata->ostream, "</sample>\n");
-		fprintf (sampledata->ostream, "<sample>\n");
+			xml_puts (output, "</sample>\n");
+		xml_puts (output, "<sample>\n   <time>");
+		xml_uint (output, seconds / 60, 2);
+		xml_puts (output, ":");
+		xml_uint (output, seconds % 60, 2);
 		if (milliseconds) {
-			fprintf (sampledata->ostream, "   <time>%02u:%02u.%03u</time>\n", seconds / 60, seconds % 60, milliseconds);
-		} else {
-			fprintf (sampledata->ostream, "   <time>%02u:%02u</time>\n", seconds / 60, seconds % 60);
+			xml_puts (output, ".");
+			xml_uint (output, milliseconds, 3);
 		}
+		xml_puts (output, "</time>\n");
 		break;
 	case DC_SAMPLE_DEPTH:
-		fprintf (sampledata->ostream, "   <depth>%.2f</depth>\n",
-			convert_depth(value->depth, sampledata->units));
+		xml_puts (output, "   <depth>");
+		xml_fixed (output, convert_depth(value->depth, sampledata->units), 2);
+		xml_puts (output, "</depth>\n");
 		break;
 	case DC_SAMPLE_PRESSURE:
-		fprintf (sampledata->ostream, "   <pressure tank=\"%u\">%.2f</pressure>\n",
-			value->pressure.tank,
-			convert_pressure(value->pressure.value, sampledata->units));
+		xml_puts (output, "   <pressure tank=\"");
+		xml_uint (output, value->pressure.tank, 1);
+		xml_puts (output, "\">");
+		xml_fixed (output, convert_pressure(value->pressure.value, sampledata->units), 2);
+		xml_puts (output, "</pressure>\n");
 		break;
 	case DC_SAMPLE_TEMPERATURE:
-		fprintf (sampledata->ostream, "   <temperature>%.2f</temperature>\n",
-			convert_temperature(value->temperature, sampledata->units));
+		xml_puts (output, "   <temperature>");
+		xml_fixed (output, convert_temperature(value->temperature, sampledata->units), 2);
+		xml_puts (output, "</temperature>\n");
 		break;
 	case DC_SAMPLE_EVENT:
 		if (value->event.type != SAMPLE_EVENT_GASCHANGE && value->event.type != SAMPLE_EVENT_GASCHANGE2) {
-			fprintf (sampledata->ostream, "   <event type=\"%u\" time=\"%u\" flags=\"%u\" value=\"%u\">%s</event>\n",
-				value->event.type, value->event.time, value->event.flags, value->event.value, events[value->event.type]);
+			xml_puts (output, "   <event type=\"");
+			xml_uint (output, value->event.type, 1);
+			xml_puts (output, "\" time=\"");
+			xml_uint (output, value->event.time, 1);
+			xml_puts (output, "\" flags=\"");
+			xml_uint (output, value->event.flags, 1);
+			xml_puts (output, "\" value=\"");
+			xml_uint (output, value->event.value, 1);
+			xml_puts (output, "\">");
+			xml_puts (output, events[value->event.type]);
+			xml_puts (output, "</event>\n");
 		}
 		break;
 	case DC_SAMPLE_RBT:
-		fprintf (sampledata->ostream, "   <rbt>%u</rbt>\n", value->rbt);
+		xml_puts (output, "   <rbt>");
+		xml_uint (output, value->rbt, 1);
+		xml_puts (output, "</rbt>\n");
 		break;
 	case DC_SAMPLE_HEARTBEAT:
-		fprintf (sampledata->ostream, "   <heartbeat>%u</heartbeat>\n", value->heartbeat);
+		xml_puts (output, "   <heartbeat>");
+		xml_uint (output, value->heartbeat, 1);
+		xml_puts (output, "</heartbeat>\n");
 		break;
 	case DC_SAMPLE_BEARING:
-		fprintf (sampledata->ostream, "   <bearing>%u</bearing>\n", value->bearing);
+		xml_puts (output, "   <bearing>");
+		xml_uint (output, value->bearing, 1);
+		xml_puts (output, "</bearing>\n");
 		break;
 	case DC_SAMPLE_VENDOR:
-		fprintf (sampledata->ostream, "   <vendor type=\"%u\" size=\"%u\">", value->vendor.type, value->vendor.size);
-		for (unsigned int i = 0; i < value->vendor.size; ++i)
-			fprintf (sampledata->ostream, "%02X", ((const unsigned char *) value->vendor.data)[i]);
-		fprintf (sampledata->ostream, "</vendor>\n");
+		xml_puts (output, "   <vendor type=\"");
+		xml_uint (output, value->vendor.type, 1);
+		xml_puts (output, "\" size=\"");
+		xml_uint (output, value->vendor.size, 1);
+		xml_puts (output, "\">");
+		xml_hex (output, (const unsigned char *) value->vendor.data, value->vendor.size);
+		xml_puts (output, "</vendor>\n");
 		break;
 	case DC_SAMPLE_SETPOINT:
-		fprintf (sampledata->ostream, "   <setpoint>%.2f</setpoint>\n", value->setpoint);
+		xml_puts (output, "   <setpoint>");
+		xml_fixed (output, value->setpoint, 2);
+		xml_puts (output, "</setpoint>\n");
 		break;
 	case DC_SAMPLE_PPO2:
 		if (value->ppo2.sensor != DC_SENSOR_NONE) {
-			fprintf (sampledata->ostream, "   <ppo2 sensor=\"%u\">%.2f</ppo2>\n", value->ppo2.sensor, value->ppo2.value);
+			xml_puts (output, "   <ppo2 sensor=\"");
+			xml_uint (output, value->ppo2.sensor, 1);
+			xml_puts (output, "\">");
 		} else {
-			fprintf (sampledata->ostream, "   <ppo2>%.2f</ppo2>\n", value->ppo2.value);
+			xml_puts (output, "   <ppo2>");
 		}
+		xml_fixed (output, value->ppo2.value, 2);
+		xml_puts (output, "</ppo2>\n");
 		break;
 	case DC_SAMPLE_CNS:
-		fprintf (sampledata->ostream, "   <cns>%.1f</cns>\n", value->cns * 100.0);
+		xml_puts (output, "   <cns>");
+		xml_fixed (output, value->cns * 100.0, 1);
+		xml_puts (output, "</cns>\n");
 		break;
 	case DC_SAMPLE_DECO:
-		fprintf (sampledata->ostream, "   <deco time=\"%u\" depth=\"%.2f\">%s</deco>\n",
-			value->deco.time,
-			convert_depth(value->deco.depth, sampledata->units),
-			decostop[value->deco.type]);
+		xml_puts (output, "   <deco time=\"");
+		xml_uint (output, value->deco.time, 1);
+		xml_puts (output, "\" depth=\"");
+		xml_fixed (output, convert_depth(value->deco.depth, sampledata->units), 2);
+		xml_puts (output, "\">");
+		xml_puts (output, decostop[value->deco.type]);
+		xml_puts (output, "</deco>\n");
 		if (value->deco.tts) {
-			fprintf (sampledata->ostream, "   <tts>%u</tts>\n",
-				value->deco.tts);
+			xml_puts (output, "   <tts>");
+			xml_uint (output, value->deco.tts, 1);
+			xml_puts (output, "</tts>\n");
 		}
 		break;
 	case DC_SAMPLE_GASMIX:
-		fprintf (sampledata->ostream, "   <gasmix>%u</gasmix>\n", value->gasmix);
+		xml_puts (output, "   <gasmix>");
+		xml_uint (output, value->gasmix, 1);
+		xml_puts (output, "</gasmix>\n");
 		break;
 	default:
 		break;
@@ -205,8 +396,9 @@ dctool_xml_output_new (const char *filename, dctool_units_t units)
 	}
 
 	output->units = units;
+	output->length = 0;
 
-	fprintf (output->ostream, "<device>\n");
+	xml_puts (output, "<device>\n");
 
 	return (dctool_output_t *) output;
 
@@ -225,16 +417,15 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	// Initialize the sample data.
 	sample_data_t sampledata = {0};
 	sampledata.nsamples = 0;
-	sampledata.ostream = output->ostream;
+	sampledata.output = output;
 	sampledata.units = output->units;
 
-	fprintf (output->ostream, "<dive>\n<number>%u</number>\n<size>%u</size>\n", abstract->number, size);
+	xml_printf (output, "<dive>\n<number>%u</number>\n<size>%u</size>\n", abstract->number, size);
 
 	if (fingerprint) {
-		fprintf (output->ostream, "<fingerprint>");
-		for (unsigned int i = 0; i < fsize; ++i)
-			fprintf (output->ostream, "%02X", fingerprint[i]);
-		fprintf (output->ostream, "</fingerprint>\n");
+		xml_puts (output, "<fingerprint>");
+		xml_hex (output, fingerprint, fsize);
+		xml_puts (output, "</fingerprint>\n");
 	}
 
 	// Parse the datetime.
@@ -247,11 +438,11 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	}
 
 	if (dt.timezone == DC_TIMEZONE_NONE) {
-		fprintf (output->ostream, "<datetime>%04i-%02i-%02i %02i:%02i:%02i</datetime>\n",
+		xml_printf (output, "<datetime>%04i-%02i-%02i %02i:%02i:%02i</datetime>\n",
 			dt.year, dt.month, dt.day,
 			dt.hour, dt.minute, dt.second);
 	} else {
-		fprintf (output->ostream, "<datetime>%04i-%02i-%02i %02i:%02i:%02i %+03i:%02i</datetime>\n",
+		xml_printf (output, "<datetime>%04i-%02i-%02i %02i:%02i:%02i %+03i:%02i</datetime>\n",
 			dt.year, dt.month, dt.day,
 			dt.hour, dt.minute, dt.second,
 			dt.timezone / 3600, (abs(dt.timezone) % 3600) / 60);
@@ -266,7 +457,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 		goto cleanup;
 	}
 
-	fprintf (output->ostream, "<divetime>%02u:%02u</divetime>\n",
+	xml_printf (output, "<divetime>%02u:%02u</divetime>\n",
 		divetime / 60, divetime % 60);
 
 	// Parse the maxdepth.
@@ -278,7 +469,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 		goto cleanup;
 	}
 
-	fprintf (output->ostream, "<maxdepth>%.2f</maxdepth>\n",
+	xml_printf (output, "<maxdepth>%.2f</maxdepth>\n",
 		convert_depth(maxdepth, output->units));
 
 	// Parse the avgdepth.
@@ -291,7 +482,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	}
 
 	if (status != DC_STATUS_UNSUPPORTED) {
-		fprintf (output->ostream, "<avgdepth>%.2f</avgdepth>\n",
+		xml_printf (output, "<avgdepth>%.2f</avgdepth>\n",
 			convert_depth(avgdepth, output->units));
 	}
 
@@ -311,7 +502,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 		}
 
 		if (status != DC_STATUS_UNSUPPORTED) {
-			fprintf (output->ostream, "<temperature type=\"%s\">%.1f</temperature>\n",
+			xml_printf (output, "<temperature type=\"%s\">%.1f</temperature>\n",
 				names[i],
 				convert_temperature(temperature, output->units));
 		}
@@ -334,7 +525,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 			goto cleanup;
 		}
 
-		fprintf (output->ostream,
+		xml_printf (output,
 			"<gasmix>\n"
 			"   <he>%.1f</he>\n"
 			"   <o2>%.1f</o2>\n"
@@ -344,11 +535,11 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 			gasmix.nitrogen * 100.0);
 		if (gasmix.usage) {
 			const char *usage[] = {"none", "oxygen", "diluent", "sidemount"};
-			fprintf (output->ostream,
+			xml_printf (output,
 				"   <usage>%s</usage>\n",
 				usage[gasmix.usage]);
 		}
-		fprintf (output->ostream,
+		xml_printf (output,
 			"</gasmix>\n");
 
 	}
@@ -372,20 +563,20 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 			goto cleanup;
 		}
 
-		fprintf (output->ostream, "<tank>\n");
+		xml_printf (output, "<tank>\n");
 		if (tank.gasmix != DC_GASMIX_UNKNOWN) {
-			fprintf (output->ostream,
+			xml_printf (output,
 				"   <gasmix>%u</gasmix>\n",
 				tank.gasmix);
 		}
 		if (tank.usage) {
 			const char *usage[] = {"none", "oxygen", "diluent", "sidemount"};
-			fprintf (output->ostream,
+			xml_printf (output,
 				"   <usage>%s</usage>\n",
 				usage[tank.usage]);
 		}
 		if (tank.type != DC_TANKVOLUME_NONE) {
-			fprintf (output->ostream,
+			xml_printf (output,
 				"   <type>%s</type>\n"
 				"   <volume>%.1f</volume>\n"
 				"   <workpressure>%.2f</workpressure>\n",
@@ -393,7 +584,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 				convert_volume(tank.volume, output->units),
 				convert_pressure(tank.workpressure, output->units));
 		}
-		fprintf (output->ostream,
+		xml_printf (output,
 			"   <beginpressure>%.2f</beginpressure>\n"
 			"   <endpressure>%.2f</endpressure>\n"
 			"</tank>\n",
@@ -412,7 +603,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 
 	if (status != DC_STATUS_UNSUPPORTED) {
 		const char *names[] = {"freedive", "gauge", "oc", "ccr", "scr"};
-		fprintf (output->ostream, "<divemode>%s</divemode>\n",
+		xml_printf (output, "<divemode>%s</divemode>\n",
 			names[divemode]);
 	}
 
@@ -427,15 +618,15 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 
 	if (status != DC_STATUS_UNSUPPORTED) {
 		const char *names[] = {"none", "buhlmann", "vpm", "rgbm", "dciem"};
-		fprintf (output->ostream, "<decomodel>%s</decomodel>\n",
+		xml_printf (output, "<decomodel>%s</decomodel>\n",
 			names[decomodel.type]);
 		if (decomodel.type == DC_DECOMODEL_BUHLMANN &&
 			(decomodel.params.gf.low != 0 || decomodel.params.gf.high != 0)) {
-			fprintf (output->ostream, "<gf>%u/%u</gf>\n",
+			xml_printf (output, "<gf>%u/%u</gf>\n",
 				decomodel.params.gf.low, decomodel.params.gf.high);
 		}
 		if (decomodel.conservatism) {
-			fprintf (output->ostream, "<conservatism>%d</conservatism>\n",
+			xml_printf (output, "<conservatism>%d</conservatism>\n",
 				decomodel.conservatism);
 		}
 	}
@@ -452,10 +643,10 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	if (status != DC_STATUS_UNSUPPORTED) {
 		const char *names[] = {"fresh", "salt"};
 		if (salinity.density) {
-			fprintf (output->ostream, "<salinity density=\"%.1f\">%s</salinity>\n",
+			xml_printf (output, "<salinity density=\"%.1f\">%s</salinity>\n",
 				salinity.density, names[salinity.type]);
 		} else {
-			fprintf (output->ostream, "<salinity>%s</salinity>\n",
+			xml_printf (output, "<salinity>%s</salinity>\n",
 				names[salinity.type]);
 		}
 	}
@@ -470,7 +661,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	}
 
 	if (status != DC_STATUS_UNSUPPORTED) {
-		fprintf (output->ostream, "<atmospheric>%.5f</atmospheric>\n",
+		xml_printf (output, "<atmospheric>%.5f</atmospheric>\n",
 			convert_pressure(atmospheric, output->units));
 	}
 
@@ -484,7 +675,7 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	}
 
 	if (status != DC_STATUS_UNSUPPORTED) {
-		fprintf (output->ostream,
+		xml_printf (output,
 			"<location>\n"
 			"   <latitude>%.6f<latitude>\n"
 			"   <longitude>%.6f</longitude>\n"
@@ -506,8 +697,8 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 cleanup:
 
 	if (sampledata.nsamples)
-		fprintf (output->ostream, "</sample>\n");
-	fprintf (output->ostream, "</dive>\n");
+		xml_puts (output, "</sample>\n");
+	xml_puts (output, "</dive>\n");
 
 	return status;
 }
@@ -517,7 +708,8 @@ dctool_xml_output_free (dctool_output_t *abstract)
 {
 	dctool_xml_output_t *output = (dctool_xml_output_t *) abstract;
 
-	fprintf (output->ostream, "</device>\n");
+	xml_puts (output, "</device>\n");
+	xml_flush (output);
 
 	fclose (output->ostream);
 
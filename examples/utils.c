@@ -35,15 +35,41 @@ static unsigned char g_lastchar = '\n';
 #ifdef _WIN32
 	#include <windows.h>
 	static LARGE_INTEGER g_timestamp, g_frequency;
+	static SRWLOCK g_lock = SRWLOCK_INIT;
 #else
 	#include <sys/time.h>
+	#include <pthread.h>
 	static struct timeval g_timestamp;
+	static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
 #endif
 
+static void
+message_lock (void)
+{
+#ifdef _WIN32
+	AcquireSRWLockExclusive (&g_lock);
+#else
+	pthread_mutex_lock (&g_lock);
+#endif
+}
+
+static void
+message_unlock (void)
+{
+#ifdef _WIN32
+	ReleaseSRWLockExclusive (&g_lock);
+#else
+	pthread_mutex_unlock (&g_lock);
+#endif
+}
+
 int message (const char* fmt, ...)
 {
 	va_list ap;
 
+	// Messages can be written from several download threads.
+	message_lock ();
+
 	if (g_logfile) {
 		if (g_lastchar == '\n') {
 #ifdef _WIN32
@@ -76,6 +102,8 @@ int message (const char* fmt, ...)
 	int rc = vfprintf (stderr, fmt, ap);
 	va_end (ap);
 
+	message_unlock ();
+
 	return rc;
 }
 
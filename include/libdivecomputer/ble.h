@@ -60,6 +60,25 @@ extern "C" {
 #define DC_IOCTL_BLE_CHARACTERISTIC_READ  DC_IOCTL_IOR('b', 3, DC_IOCTL_SIZE_VARIABLE)
 #define DC_IOCTL_BLE_CHARACTERISTIC_WRITE DC_IOCTL_IOW('b', 3, DC_IOCTL_SIZE_VARIABLE)
 
+/**
+ * Get/set the ATT MTU of the connection.
+ *
+ * The data format is an unsigned int. The maximum size of a single write
+ * or notification is the ATT MTU minus the 3 byte ATT header. Setting the
+ * MTU requests an MTU exchange with the remote device. Because the
+ * negotiated MTU can be smaller than requested, the actual value should
+ * be retrieved again afterwards.
+ */
+#define DC_IOCTL_BLE_GET_MTU DC_IOCTL_IOR('b', 4, sizeof(unsigned int))
+#define DC_IOCTL_BLE_SET_MTU DC_IOCTL_IOW('b', 4, sizeof(unsigned int))
+
+/**
+ * The ATT header size, and the default and maximum ATT MTU.
+ */
+#define DC_BLE_ATT_HEADER 3
+#define DC_BLE_MTU_DEFAULT 23
+#define DC_BLE_MTU_MAX 517
+
 /**
  * The minimum number of bytes (including the terminating null byte) for
  * formatting a bluetooth UUID as a string.
@@ -38,7 +38,8 @@ typedef enum dc_status_t {
 	DC_STATUS_TIMEOUT = -7,
 	DC_STATUS_PROTOCOL = -8,
 	DC_STATUS_DATAFORMAT = -9,
-	DC_STATUS_CANCELLED = -10
+	DC_STATUS_CANCELLED = -10,
+	DC_STATUS_WOULDBLOCK = -11
 } dc_status_t;
 
 typedef enum dc_transport_t {
@@ -61,6 +61,49 @@ typedef struct dc_custom_cbs_t {
 dc_status_t
 dc_custom_open (dc_iostream_t **iostream, dc_context_t *context, dc_transport_t transport, const dc_custom_cbs_t *callbacks, void *userdata);
 
+/**
+ * A memory buffer for the vectored I/O callbacks.
+ */
+typedef struct dc_custom_iovec_t {
+	void *data;
+	size_t size;
+} dc_custom_iovec_t;
+
+/**
+ * Optional vectored I/O callbacks.
+ *
+ * The readv callback works like the read callback, but scatters the data
+ * over several buffers. Only the first buffer needs to be filled. The
+ * remaining buffers are filled with whatever data is already available,
+ * and the callback should return as soon as the first buffer is full. The
+ * total number of bytes is returned in the actual parameter.
+ *
+ * The writev callback writes the buffers in order. For packet oriented
+ * transports, each buffer must be sent as a separate packet.
+ */
+typedef struct dc_custom_vcbs_t {
+	dc_status_t (*readv) (void *userdata, const dc_custom_iovec_t iov[], size_t count, size_t *actual);
+	dc_status_t (*writev) (void *userdata, const dc_custom_iovec_t iov[], size_t count, size_t *actual);
+} dc_custom_vcbs_t;
+
+/**
+ * Set the vectored I/O callbacks of a custom I/O stream.
+ *
+ * With a readv callback, reads on a stream oriented transport also fetch
+ * the data that is already available into an internal read-ahead buffer,
+ * such that subsequent small reads don't need a callback. With a writev
+ * callback, writes are queued internally, and all queued writes are passed
+ * to a single writev call before any other operation on the I/O stream.
+ * Errors from the queued writes are therefore reported by that operation.
+ *
+ * @param[in]   iostream   A valid custom I/O stream.
+ * @param[in]   callbacks  The vectored callback functions to call.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_custom_set_vectored (dc_iostream_t *iostream, const dc_custom_vcbs_t *callbacks);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
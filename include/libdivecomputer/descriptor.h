@@ -124,6 +124,54 @@ dc_descriptor_get_transports (const dc_descriptor_t *descriptor);
 int
 dc_descriptor_filter (const dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata);
 
+/**
+ * Find the supported dive computer with a family type and model number.
+ *
+ * If several dive computers share the same model number, the first one
+ * reported by the descriptor iterator is returned.
+ *
+ * @param[out] descriptor  A location to store the device descriptor.
+ * @param[in]  family      The family type of the dive computer.
+ * @param[in]  model       The model number of the dive computer.
+ * @returns #DC_STATUS_SUCCESS on success, #DC_STATUS_UNSUPPORTED if there
+ * is no match, or another #dc_status_t code on failure.
+ */
+dc_status_t
+dc_descriptor_lookup_by_model (dc_descriptor_t **descriptor, dc_family_t family, unsigned int model);
+
+/**
+ * Find the first supported dive computer matching a usb device.
+ *
+ * The result is identical to the first descriptor for which
+ * #dc_descriptor_filter returns a match.
+ *
+ * @param[out] descriptor  A location to store the device descriptor.
+ * @param[in]  transport   The transport type (DC_TRANSPORT_USB or
+ *                         DC_TRANSPORT_USBHID).
+ * @param[in]  vid         The USB vendor id.
+ * @param[in]  pid         The USB product id.
+ * @returns #DC_STATUS_SUCCESS on success, #DC_STATUS_UNSUPPORTED if there
+ * is no match, or another #dc_status_t code on failure.
+ */
+dc_status_t
+dc_descriptor_lookup_by_usb (dc_descriptor_t **descriptor, dc_transport_t transport, unsigned int vid, unsigned int pid);
+
+/**
+ * Find the first supported dive computer matching a device name.
+ *
+ * The result is identical to the first descriptor for which
+ * #dc_descriptor_filter returns a match. The names are looked up in an
+ * index on their first character, which also makes a miss cheap.
+ *
+ * @param[out] descriptor  A location to store the device descriptor.
+ * @param[in]  transport   The transport type of the I/O device.
+ * @param[in]  name        The serial, IrDA or bluetooth device name.
+ * @returns #DC_STATUS_SUCCESS on success, #DC_STATUS_UNSUPPORTED if there
+ * is no match, or another #dc_status_t code on failure.
+ */
+dc_status_t
+dc_descriptor_lookup_by_name (dc_descriptor_t **descriptor, dc_transport_t transport, const char *name);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
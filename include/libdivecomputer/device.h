@@ -38,7 +38,8 @@ typedef enum dc_event_type_t {
 	DC_EVENT_PROGRESS = (1 << 1),
 	DC_EVENT_DEVINFO = (1 << 2),
 	DC_EVENT_CLOCK = (1 << 3),
-	DC_EVENT_VENDOR = (1 << 4)
+	DC_EVENT_VENDOR = (1 << 4),
+	DC_EVENT_STATS = (1 << 5)
 } dc_event_type_t;
 
 typedef struct dc_device_t dc_device_t;
@@ -64,6 +65,14 @@ typedef struct dc_event_vendor_t {
 	unsigned int size;
 } dc_event_vendor_t;
 
+typedef struct dc_event_stats_t {
+	unsigned int blocksize;  /* Current block size (bytes) */
+	unsigned int nbytes;     /* Number of bytes transferred */
+	unsigned int elapsed;    /* Elapsed time (milliseconds) */
+	unsigned int throughput; /* Throughput (bytes per second) */
+	unsigned int nerrors;    /* Number of failed blocks */
+} dc_event_stats_t;
+
 typedef int (*dc_cancel_callback_t) (void *userdata);
 
 typedef void (*dc_event_callback_t) (dc_device_t *device, dc_event_type_t event, const void *data, void *userdata);
@@ -97,6 +106,12 @@ dc_device_dump (dc_device_t *device, dc_buffer_t *buffer);
 dc_status_t
 dc_device_foreach (dc_device_t *device, dc_dive_callback_t callback, void *userdata);
 
+dc_status_t
+dc_device_foreach_step (dc_device_t *device, dc_dive_callback_t callback, void *userdata);
+
+dc_status_t
+dc_device_get_pollfd (dc_device_t *device, dc_pollfd_t *pollfd);
+
 dc_status_t
 dc_device_timesync (dc_device_t *device, const dc_datetime_t *datetime);
 
@@ -33,6 +33,9 @@ extern "C" {
 #define HW_OSTC3_DISPLAY_SIZE    16
 #define HW_OSTC3_CUSTOMTEXT_SIZE 60
 
+/* Firmware update flags. */
+#define HW_OSTC3_FWUPDATE_FAST   0x01
+
 dc_status_t
 hw_ostc3_device_version (dc_device_t *device, unsigned char data[], unsigned int size);
 
@@ -57,6 +60,16 @@ hw_ostc3_device_config_reset (dc_device_t *abstract);
 dc_status_t
 hw_ostc3_device_fwupdate (dc_device_t *abstract, const char *filename);
 
+/*
+ * Update the firmware. With the HW_OSTC3_FWUPDATE_FAST flag, the display
+ * updates are throttled and the read-back verification of the uploaded
+ * firmware is skipped. The checksum of the image is still validated by
+ * the bootloader before reprogramming. The flag has no effect on the
+ * hwOS 4 firmware, which doesn't use a read-back verification.
+ */
+dc_status_t
+hw_ostc3_device_fwupdate2 (dc_device_t *abstract, const char *filename, unsigned int flags);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -83,6 +83,50 @@ typedef enum dc_line_t {
 	DC_LINE_RNG = 0x08, /**< Ring indicator */
 } dc_line_t;
 
+/**
+ * The poll events.
+ *
+ * The values are identical to the POSIX POLLIN and POLLOUT constants.
+ */
+typedef enum dc_pollevent_t {
+	DC_POLL_IN = 0x01,  /**< Wait for input */
+	DC_POLL_OUT = 0x04, /**< Wait for output */
+} dc_pollevent_t;
+
+/**
+ * A file descriptor to wait on.
+ */
+typedef struct dc_pollfd_t {
+	int fd;            /**< File descriptor */
+	unsigned int events; /**< Bitmap with the #dc_pollevent_t events */
+} dc_pollfd_t;
+
+/**
+ * The number of buckets in the latency histograms.
+ *
+ * Bucket n counts the durations between 2^n and 2^(n+1) microseconds. The
+ * first bucket also counts the shorter durations, and the last bucket all
+ * the longer durations.
+ */
+#define DC_IOSTREAM_NBUCKETS 24
+
+/**
+ * The I/O statistics.
+ */
+typedef struct dc_iostream_stats_t {
+	unsigned long long nbytes_in;  /**< Number of bytes received */
+	unsigned long long nbytes_out; /**< Number of bytes sent */
+	unsigned int nreads;           /**< Number of read operations */
+	unsigned int nwrites;          /**< Number of write operations */
+	unsigned int ncalls;           /**< Number of calls into the transport */
+	unsigned int ntimeouts;        /**< Number of timeouts */
+	unsigned int npurges;          /**< Number of purge operations */
+	unsigned int nretransmits;     /**< Number of repeated writes */
+	unsigned int latency[DC_IOSTREAM_NBUCKETS]; /**< Request to response latency */
+	unsigned int read[DC_IOSTREAM_NBUCKETS];    /**< Read duration */
+	unsigned int write[DC_IOSTREAM_NBUCKETS];   /**< Write duration */
+} dc_iostream_stats_t;
+
 /**
  * Get the transport type.
  *
@@ -225,6 +269,54 @@ dc_iostream_configure (dc_iostream_t *iostream, unsigned int baudrate, unsigned
 dc_status_t
 dc_iostream_poll (dc_iostream_t *iostream, int timeout);
 
+/**
+ * Get the file descriptors of the I/O stream.
+ *
+ * The file descriptors can be added to an external event loop (e.g.
+ * poll, epoll or kqueue), to wait for activity on many I/O streams from
+ * a single thread. Once one of them becomes ready, the I/O stream must
+ * be read (typically in non-blocking mode) to process the activity.
+ *
+ * Some transports use more than one file descriptor, and the set may
+ * change over time (e.g. libusb based transports). The set should
+ * therefore be queried again after each event. A file descriptor waits
+ * for output only while a non-blocking write has data left to send.
+ *
+ * @param[in]  iostream  A valid I/O stream.
+ * @param[out] pollfd    The array to store the file descriptors.
+ * @param[in]  size      The number of elements in the array.
+ * @param[out] actual    An (optional) location to store the number of
+ *                       file descriptors.
+ * @returns #DC_STATUS_SUCCESS on success, #DC_STATUS_UNSUPPORTED if the
+ * I/O stream has no file descriptors, #DC_STATUS_NOMEMORY if the array
+ * is too small, or another #dc_status_t code on failure.
+ */
+dc_status_t
+dc_iostream_get_pollfd (dc_iostream_t *iostream, dc_pollfd_t pollfd[], size_t size, size_t *actual);
+
+/**
+ * Enable or disable the non-blocking mode.
+ *
+ * In non-blocking mode, a read operation returns immediately with the
+ * bytes that are already available, and a write operation only sends
+ * the bytes that fit in the output buffer. The number of bytes actually
+ * transferred is returned, and #DC_STATUS_WOULDBLOCK if no bytes could
+ * be transferred at all. In combination with #dc_iostream_get_pollfd,
+ * this allows an external event loop to drive the I/O stream. Partial
+ * writes are supported by the serial, irda and bluetooth transports.
+ * On the other transports, a write always sends all data.
+ *
+ * The non-blocking mode requires support for querying the number of
+ * available bytes.
+ *
+ * @param[in]  iostream  A valid I/O stream.
+ * @param[in]  value     Non-zero to enable the non-blocking mode.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_iostream_set_nonblocking (dc_iostream_t *iostream, unsigned int value);
+
 /**
  * Read data from the I/O stream.
  *
@@ -300,6 +392,23 @@ dc_iostream_purge (dc_iostream_t *iostream, dc_direction_t direction);
 dc_status_t
 dc_iostream_sleep (dc_iostream_t *iostream, unsigned int milliseconds);
 
+/**
+ * Get the I/O statistics.
+ *
+ * The statistics are collected for all operations since the I/O stream
+ * was opened. The latency is the time between the end of a write and the
+ * end of the first read returning data after it. A write is counted as a
+ * retransmit if it repeats the previous write after a timeout or an
+ * error.
+ *
+ * @param[in]   iostream  A valid I/O stream.
+ * @param[out]  stats     A location to store the statistics.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_iostream_get_stats (dc_iostream_t *iostream, dc_iostream_stats_t *stats);
+
 /**
  * Close the I/O stream and free all resources.
  *
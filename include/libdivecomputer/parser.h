@@ -284,10 +284,56 @@ typedef union dc_sample_value_t {
 	unsigned int gasmix; /* Gas mix index */
 } dc_sample_value_t;
 
+/*
+ * Fixed-point sample value
+ *
+ * Same as the dc_sample_value_t structure, but with all floating point
+ * values replaced with integers in a fixed unit. All other fields are
+ * identical.
+ */
+typedef union dc_sample_fixed_t {
+	unsigned int time; /* Milliseconds */
+	int depth; /* Millimeter */
+	struct {
+		unsigned int tank;
+		int value; /* Millibar */
+	} pressure;
+	int temperature; /* Millikelvin */
+	struct {
+		unsigned int type;
+		unsigned int time;
+		unsigned int flags;
+		unsigned int value;
+	} event;
+	unsigned int rbt;
+	unsigned int heartbeat;
+	unsigned int bearing;
+	struct {
+		unsigned int type;
+		unsigned int size;
+		const void *data;
+	} vendor;
+	unsigned int setpoint; /* Millibar */
+	struct {
+		unsigned int sensor;
+		unsigned int value; /* Millibar */
+	} ppo2;
+	unsigned int cns; /* Per mille */
+	struct {
+		unsigned int type;
+		unsigned int time;
+		int depth; /* Millimeter */
+		unsigned int tts;
+	} deco;
+	unsigned int gasmix; /* Gas mix index */
+} dc_sample_fixed_t;
+
 typedef struct dc_parser_t dc_parser_t;
 
 typedef void (*dc_sample_callback_t) (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata);
 
+typedef void (*dc_sample_fixed_callback_t) (dc_sample_type_t type, const dc_sample_fixed_t *value, void *userdata);
+
 dc_status_t
 dc_parser_new (dc_parser_t **parser, dc_device_t *device, const unsigned char data[], size_t size);
 
@@ -315,6 +361,9 @@ dc_parser_get_field (dc_parser_t *parser, dc_field_type_t type, unsigned int fla
 dc_status_t
 dc_parser_samples_foreach (dc_parser_t *parser, dc_sample_callback_t callback, void *userdata);
 
+dc_status_t
+dc_parser_samples_foreach_fixed (dc_parser_t *parser, dc_sample_fixed_callback_t callback, void *userdata);
+
 dc_status_t
 dc_parser_destroy (dc_parser_t *parser);
 
@@ -47,6 +47,19 @@ extern "C" {
 #define DC_IOCTL_USB_CONTROL_READ  DC_IOCTL_IOR('u', 0, DC_IOCTL_SIZE_VARIABLE)
 #define DC_IOCTL_USB_CONTROL_WRITE DC_IOCTL_IOW('u', 0, DC_IOCTL_SIZE_VARIABLE)
 
+/**
+ * Configure the queue of asynchronous bulk-IN transfers.
+ *
+ * The parameters for the queue are specified in the #dc_usb_queue_t
+ * data structure. With a non-zero number of transfers, the bulk-IN
+ * transfers are submitted in advance and kept pending all the time.
+ * Each read returns the data from at most one completed transfer, so a
+ * short transfer still ends the read. A zero number of transfers
+ * disables the queue and restores the synchronous transfers. Any
+ * queued data that was not read yet is discarded.
+ */
+#define DC_IOCTL_USB_SET_QUEUE DC_IOCTL_IOW('u', 1, sizeof(dc_usb_queue_t))
+
 /**
  * USB control transfer.
  */
@@ -58,6 +71,14 @@ typedef struct dc_usb_control_t {
 	unsigned short wLength;
 } dc_usb_control_t;
 
+/**
+ * Queue of asynchronous bulk-IN transfers.
+ */
+typedef struct dc_usb_queue_t {
+	unsigned int count; /* Number of outstanding transfers. */
+	unsigned int size;  /* Size of each transfer (bytes). */
+} dc_usb_queue_t;
+
 /**
  * Endpoint direction bits of the USB control transfer.
  */
@@ -60,6 +60,23 @@ NOTE:   String length must be evenly divisible by 16byte (str_len % 16 == 0)
 #include <string.h> // CBC mode, for memset
 #include "aes.h"
 
+// Hardware acceleration. The x86 instructions are detected at runtime, the
+// ARMv8 instructions only when enabled at compile time.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+  #define AESNI 1
+  #define AESNI_TARGET __attribute__((target("aes,sse2")))
+  #include <cpuid.h>
+  #include <wmmintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  #define AESNI 1
+  #define AESNI_TARGET
+  #include <intrin.h>
+  #include <wmmintrin.h>
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+  #define AESARM 1
+  #include <arm_neon.h>
+#endif
+
 
 /*****************************************************************************/
 /* Defines:                                                                  */
@@ -611,3 +628,422 @@ void AES128_CBC_decrypt_buffer(uint8_t* output, uint8_t* input, uint32_t length,
 #endif // #if defined(CBC) && CBC
 
 
+
+/*****************************************************************************/
+/* Multi-block functions:                                                    */
+/*****************************************************************************/
+
+// The number of blocks processed in parallel by the hardware implementations.
+#define NBLOCKS 4
+
+static void XorBlock(uint8_t* output, const uint8_t* a, const uint8_t* b, uint32_t length)
+{
+  uint32_t i;
+  for (i = 0; i < length; ++i)
+  {
+    output[i] = a[i] ^ b[i];
+  }
+}
+
+static void IncrementCounter(uint8_t* counter)
+{
+  int i;
+  for (i = KEYLEN - 1; i >= 0; --i)
+  {
+    if (++counter[i] != 0)
+      break;
+  }
+}
+
+#if defined(AESNI) && AESNI
+
+static int AesniSupported(void)
+{
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 25)) != 0;
+#else
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return 0;
+  return (ecx & bit_AES) != 0;
+#endif
+}
+
+AESNI_TARGET
+static void AesniLoadKey(const AES128_ctx_t* ctx, __m128i rk[Nr + 1])
+{
+  uint8_t round;
+  for (round = 0; round <= Nr; ++round)
+  {
+    rk[round] = _mm_loadu_si128((const __m128i*)(ctx->RoundKey + round * KEYLEN));
+  }
+}
+
+// Encrypt NBLOCKS blocks in parallel, to hide the latency of the instructions.
+AESNI_TARGET
+static void AesniEncrypt(const __m128i rk[Nr + 1], __m128i b[NBLOCKS])
+{
+  uint8_t round, i;
+  for (i = 0; i < NBLOCKS; ++i)
+  {
+    b[i] = _mm_xor_si128(b[i], rk[0]);
+  }
+  for (round = 1; round < Nr; ++round)
+  {
+    for (i = 0; i < NBLOCKS; ++i)
+    {
+      b[i] = _mm_aesenc_si128(b[i], rk[round]);
+    }
+  }
+  for (i = 0; i < NBLOCKS; ++i)
+  {
+    b[i] = _mm_aesenclast_si128(b[i], rk[Nr]);
+  }
+}
+
+#if defined(CFB) && CFB
+AESNI_TARGET
+static uint32_t AesniCFBDecrypt(const AES128_ctx_t* ctx, uint8_t* output, const uint8_t* input, uint32_t length, uint8_t* iv)
+{
+  __m128i rk[Nr + 1], b[NBLOCKS], c[NBLOCKS];
+  __m128i prev = _mm_loadu_si128((const __m128i*)iv);
+  uint32_t offset = 0;
+  uint8_t i;
+
+  AesniLoadKey(ctx, rk);
+
+  for (offset = 0; offset + NBLOCKS * KEYLEN <= length; offset += NBLOCKS * KEYLEN)
+  {
+    for (i = 0; i < NBLOCKS; ++i)
+    {
+      c[i] = _mm_loadu_si128((const __m128i*)(input + offset + i * KEYLEN));
+      b[i] = i ? c[i - 1] : prev;
+    }
+    AesniEncrypt(rk, b);
+    for (i = 0; i < NBLOCKS; ++i)
+    {
+      _mm_storeu_si128((__m128i*)(output + offset + i * KEYLEN), _mm_xor_si128(b[i], c[i]));
+    }
+    prev = c[NBLOCKS - 1];
+  }
+
+  _mm_storeu_si128((__m128i*)iv, prev);
+
+  return offset;
+}
+#endif
+
+#if defined(CTR) && CTR
+AESNI_TARGET
+static uint32_t AesniCTRXcrypt(const AES128_ctx_t* ctx, uint8_t* output, const uint8_t* input, uint32_t length, uint8_t* counter)
+{
+  __m128i rk[Nr + 1], b[NBLOCKS];
+  uint32_t offset = 0;
+  uint8_t i;
+
+  AesniLoadKey(ctx, rk);
+
+  for (offset = 0; offset + NBLOCKS * KEYLEN <= length; offset += NBLOCKS * KEYLEN)
+  {
+    for (i = 0; i < NBLOCKS; ++i)
+    {
+      b[i] = _mm_loadu_si128((const __m128i*)counter);
+      IncrementCounter(counter);
+    }
+    AesniEncrypt(rk, b);
+    for (i = 0; i < NBLOCKS; ++i)
+    {
+      __m128i data = _mm_loadu_si128((const __m128i*)(input + offset + i * KEYLEN));
+      _mm_storeu_si128((__m128i*)(output + offset + i * KEYLEN), _mm_xor_si128(b[i], data));
+    }
+  }
+
+  return offset;
+}
+#endif
+
+#endif // #if defined(AESNI) && AESNI
+
+#if defined(AESARM) && AESARM
+
+static void ArmEncrypt(const AES128_ctx_t* ctx, uint8x16_t b[NBLOCKS])
+{
+  uint8_t round, i;
+  for (round = 0; round < Nr - 1; ++round)
+  {
+    uint8x16_t rk = vld1q_u8(ctx->RoundKey + round * KEYLEN);
+    for (i = 0; i < NBLOCKS; ++i)
+    {
+      b[i] = vaesmcq_u8(vaeseq_u8(b[i], rk));
+    }
+  }
+  uint8x16_t rk9 = vld1q_u8(ctx->RoundKey + (Nr - 1) * KEYLEN);
+  uint8x16_t rk10 = vld1q_u8(ctx->RoundKey + Nr * KEYLEN);
+  for (i = 0; i < NBLOCKS; ++i)
+  {
+    b[i] = veorq_u8(vaeseq_u8(b[i], rk9), rk10);
+  }
+}
+
+#if defined(CFB) && CFB
+static uint32_t ArmCFBDecrypt(const AES128_ctx_t* ctx, uint8_t* output, const uint8_t* input, uint32_t length, uint8_t* iv)
+{
+  uint8x16_t b[NBLOCKS], c[NBLOCKS];
+  uint8x16_t prev = vld1q_u8(iv);
+  uint32_t offset = 0;
+  uint8_t i;
+
+  for (offset = 0; offset + NBLOCKS * KEYLEN <= length; offset += NBLOCKS * KEYLEN)
+  {
+    for (i = 0; i < NBLOCKS; ++i)
+    {
+      c[i] = vld1q_u8(input + offset + i * KEYLEN);
+      b[i] = i ? c[i - 1] : prev;
+    }
+    ArmEncrypt(ctx, b);
+    for (i = 0; i < NBLOCKS; ++i)
+    {
+      vst1q_u8(output + offset + i * KEYLEN, veorq_u8(b[i], c[i]));
+    }
+    prev = c[NBLOCKS - 1];
+  }
+
+  vst1q_u8(iv, prev);
+
+  return offset;
+}
+#endif
+
+#if defined(CTR) && CTR
+static uint32_t ArmCTRXcrypt(const AES128_ctx_t* ctx, uint8_t* output, const uint8_t* input, uint32_t length, uint8_t* counter)
+{
+  uint8x16_t b[NBLOCKS];
+  uint32_t offset = 0;
+  uint8_t i;
+
+  for (offset = 0; offset + NBLOCKS * KEYLEN <= length; offset += NBLOCKS * KEYLEN)
+  {
+    for (i = 0; i < NBLOCKS; ++i)
+    {
+      b[i] = vld1q_u8(counter);
+      IncrementCounter(counter);
+    }
+    ArmEncrypt(ctx, b);
+    for (i = 0; i < NBLOCKS; ++i)
+    {
+      vst1q_u8(output + offset + i * KEYLEN, veorq_u8(b[i], vld1q_u8(input + offset + i * KEYLEN)));
+    }
+  }
+
+  return offset;
+}
+#endif
+
+#endif // #if defined(AESARM) && AESARM
+
+void AES128_init(AES128_ctx_t* ctx, const uint8_t* key)
+{
+  aes_state_t state;
+  state.Key = key;
+  KeyExpansion(&state);
+  memcpy(ctx->RoundKey, state.RoundKey, sizeof(ctx->RoundKey));
+}
+
+static void LoadKey(aes_state_t *state, const AES128_ctx_t* ctx)
+{
+  memcpy(state->RoundKey, ctx->RoundKey, sizeof(state->RoundKey));
+}
+
+static void EncryptBlock(aes_state_t *state, const uint8_t* input, uint8_t* output)
+{
+  memmove(output, input, KEYLEN);
+  state->state = (state_t*)output;
+  Cipher(state);
+}
+
+void AES128_encrypt(const AES128_ctx_t* ctx, const uint8_t* input, uint8_t* output)
+{
+  aes_state_t state;
+  LoadKey(&state, ctx);
+  EncryptBlock(&state, input, output);
+}
+
+
+#if (defined(AESNI) && AESNI) || (defined(AESARM) && AESARM)
+
+#if defined(CFB) && CFB
+static uint32_t HwCFBDecrypt(const AES128_ctx_t* ctx, uint8_t* output, const uint8_t* input, uint32_t length, uint8_t* iv)
+{
+#if defined(AESNI) && AESNI
+  return AesniCFBDecrypt(ctx, output, input, length, iv);
+#else
+  return ArmCFBDecrypt(ctx, output, input, length, iv);
+#endif
+}
+#endif
+
+#if defined(CTR) && CTR
+static uint32_t HwCTRXcrypt(const AES128_ctx_t* ctx, uint8_t* output, const uint8_t* input, uint32_t length, uint8_t* counter)
+{
+#if defined(AESNI) && AESNI
+  return AesniCTRXcrypt(ctx, output, input, length, counter);
+#else
+  return ArmCTRXcrypt(ctx, output, input, length, counter);
+#endif
+}
+#endif
+
+// Known-answer test of the hardware implementation, with the AES-128 vectors
+// of NIST SP 800-38A (F.3.14 CFB128 and F.5.1 CTR). The four blocks are
+// exactly one parallel batch.
+static const uint8_t KatKey[KEYLEN] = {
+  0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+
+static const uint8_t KatPlaintext[NBLOCKS * KEYLEN] = {
+  0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+  0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+  0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+  0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10 };
+
+#if defined(CFB) && CFB
+static const uint8_t KatCFBIv[KEYLEN] = {
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+
+static const uint8_t KatCFBCiphertext[NBLOCKS * KEYLEN] = {
+  0x3b, 0x3f, 0xd9, 0x2e, 0xb7, 0x2d, 0xad, 0x20, 0x33, 0x34, 0x49, 0xf8, 0xe8, 0x3c, 0xfb, 0x4a,
+  0xc8, 0xa6, 0x45, 0x37, 0xa0, 0xb3, 0xa9, 0x3f, 0xcd, 0xe3, 0xcd, 0xad, 0x9f, 0x1c, 0xe5, 0x8b,
+  0x26, 0x75, 0x1f, 0x67, 0xa3, 0xcb, 0xb1, 0x40, 0xb1, 0x80, 0x8c, 0xf1, 0x87, 0xa4, 0xf4, 0xdf,
+  0xc0, 0x4b, 0x05, 0x35, 0x7c, 0x5d, 0x1c, 0x0e, 0xea, 0xc4, 0xc6, 0x6f, 0x9f, 0xf7, 0xf2, 0xe6 };
+#endif
+
+#if defined(CTR) && CTR
+static const uint8_t KatCTRCounter[KEYLEN] = {
+  0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff };
+
+static const uint8_t KatCTRCiphertext[NBLOCKS * KEYLEN] = {
+  0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+  0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+  0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+  0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee };
+#endif
+
+static int HwSelfTest(void)
+{
+  AES128_ctx_t ctx;
+  uint8_t iv[KEYLEN], output[NBLOCKS * KEYLEN];
+
+  AES128_init(&ctx, KatKey);
+
+#if defined(CFB) && CFB
+  memcpy(iv, KatCFBIv, KEYLEN);
+  if (HwCFBDecrypt(&ctx, output, KatCFBCiphertext, sizeof(output), iv) != sizeof(output) ||
+      memcmp(output, KatPlaintext, sizeof(output)) != 0 ||
+      memcmp(iv, KatCFBCiphertext + sizeof(output) - KEYLEN, KEYLEN) != 0)
+    return 0;
+#endif
+
+#if defined(CTR) && CTR
+  memcpy(iv, KatCTRCounter, KEYLEN);
+  if (HwCTRXcrypt(&ctx, output, KatPlaintext, sizeof(output), iv) != sizeof(output) ||
+      memcmp(output, KatCTRCiphertext, sizeof(output)) != 0)
+    return 0;
+#endif
+
+  return 1;
+}
+
+// The hardware implementation is used only if the instructions are available,
+// and the self-test passes. The result is determined once. Concurrent first
+// calls may both run the test, but they store the same result.
+static int HwSupported(void)
+{
+  static volatile int supported = -1;
+
+  if (supported < 0)
+  {
+#if defined(AESNI) && AESNI
+    supported = AesniSupported() && HwSelfTest();
+#else
+    supported = HwSelfTest();
+#endif
+  }
+
+  return supported;
+}
+
+#endif
+
+
+#if defined(CFB) && CFB
+
+void AES128_CFB_encrypt_buffer(const AES128_ctx_t* ctx, uint8_t* output, const uint8_t* input, uint32_t length, const uint8_t* iv)
+{
+  aes_state_t state;
+  uint8_t keystream[KEYLEN];
+  uint32_t offset, n;
+
+  // Every block depends on the previous ciphertext, so there is nothing to
+  // process in parallel.
+  LoadKey(&state, ctx);
+  EncryptBlock(&state, iv, keystream);
+  for (offset = 0; offset < length; offset += KEYLEN)
+  {
+    n = length - offset < KEYLEN ? length - offset : KEYLEN;
+    XorBlock(output + offset, input + offset, keystream, n);
+    if (n == KEYLEN)
+      EncryptBlock(&state, output + offset, keystream);
+  }
+}
+
+void AES128_CFB_decrypt_buffer(const AES128_ctx_t* ctx, uint8_t* output, const uint8_t* input, uint32_t length, const uint8_t* iv)
+{
+  aes_state_t state;
+  uint8_t prev[KEYLEN], keystream[KEYLEN];
+  uint32_t offset = 0, n;
+
+  memcpy(prev, iv, KEYLEN);
+
+#if (defined(AESNI) && AESNI) || (defined(AESARM) && AESARM)
+  if (HwSupported())
+    offset = HwCFBDecrypt(ctx, output, input, length, prev);
+#endif
+
+  LoadKey(&state, ctx);
+  for (; offset < length; offset += KEYLEN)
+  {
+    n = length - offset < KEYLEN ? length - offset : KEYLEN;
+    EncryptBlock(&state, prev, keystream);
+    memcpy(prev, input + offset, n);
+    XorBlock(output + offset, input + offset, keystream, n);
+  }
+}
+
+#endif // #if defined(CFB) && CFB
+
+
+#if defined(CTR) && CTR
+
+void AES128_CTR_xcrypt_buffer(const AES128_ctx_t* ctx, uint8_t* output, const uint8_t* input, uint32_t length, uint8_t* counter)
+{
+  aes_state_t state;
+  uint8_t keystream[KEYLEN];
+  uint32_t offset = 0, n;
+
+#if (defined(AESNI) && AESNI) || (defined(AESARM) && AESARM)
+  if (HwSupported())
+    offset = HwCTRXcrypt(ctx, output, input, length, counter);
+#endif
+
+  LoadKey(&state, ctx);
+  for (; offset < length; offset += KEYLEN)
+  {
+    n = length - offset < KEYLEN ? length - offset : KEYLEN;
+    EncryptBlock(&state, counter, keystream);
+    IncrementCounter(counter);
+    XorBlock(output + offset, input + offset, keystream, n);
+  }
+}
+
+#endif // #if defined(CTR) && CTR
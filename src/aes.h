@@ -49,6 +49,15 @@ typedef unsigned int  uint32_t;
   #define ECB 1
 #endif
 
+// CFB and CTR enable the multi-block stream modes, which use a pre-expanded key.
+#ifndef CFB
+  #define CFB 1
+#endif
+
+#ifndef CTR
+  #define CTR 1
+#endif
+
 
 
 #if defined(ECB) && ECB
@@ -67,5 +76,35 @@ void AES128_CBC_decrypt_buffer(uint8_t* output, uint8_t* input, uint32_t length,
 #endif // #if defined(CBC) && CBC
 
 
+// The expanded key, such that many blocks can be processed without repeating
+// the key expansion. The block functions below use the AES-NI or ARMv8 crypto
+// instructions when available, and fall back to the portable implementation.
+typedef struct AES128_ctx_t
+{
+  uint8_t RoundKey[176];
+} AES128_ctx_t;
+
+void AES128_init(AES128_ctx_t* ctx, const uint8_t* key);
+void AES128_encrypt(const AES128_ctx_t* ctx, const uint8_t* input, uint8_t* output);
+
+
+// The stream modes accept any length, and the output may be identical to the input.
+
+#if defined(CFB) && CFB
+
+void AES128_CFB_encrypt_buffer(const AES128_ctx_t* ctx, uint8_t* output, const uint8_t* input, uint32_t length, const uint8_t* iv);
+void AES128_CFB_decrypt_buffer(const AES128_ctx_t* ctx, uint8_t* output, const uint8_t* input, uint32_t length, const uint8_t* iv);
+
+#endif // #if defined(CFB) && CFB
+
+
+#if defined(CTR) && CTR
+
+// The 128 bit big endian counter block is incremented for every block.
+void AES128_CTR_xcrypt_buffer(const AES128_ctx_t* ctx, uint8_t* output, const uint8_t* input, uint32_t length, uint8_t* counter);
+
+#endif // #if defined(CTR) && CTR
+
+
 
 #endif //_AES_H_
@@ -46,6 +46,9 @@
 #define SZ_MEMORY1 (29 * 64 * 1024) // Cobalt 1
 #define SZ_MEMORY2 (41 * 64 * 1024) // Cobalt 2
 #define SZ_VERSION 14
+#define SZ_PACKET  (8 * 1024)
+
+#define NTRANSFERS 4
 
 typedef struct atomics_cobalt_device_t {
 	dc_device_t base;
@@ -66,6 +69,7 @@ static const dc_device_vtable_t atomics_cobalt_device_vtable = {
 	NULL, /* write */
 	NULL, /* dump */
 	atomics_cobalt_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -99,6 +103,15 @@ atomics_cobalt_device_open (dc_device_t **out, dc_context_t *context, dc_iostrea
 		goto error_free;
 	}
 
+	// Keep several bulk transfers pending, to receive the dive data
+	// without gaps between the transfers.
+	dc_usb_queue_t queue = {NTRANSFERS, SZ_PACKET};
+	status = dc_iostream_ioctl (device->iostream, DC_IOCTL_USB_SET_QUEUE, &queue, sizeof(queue));
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_UNSUPPORTED) {
+		ERROR (context, "Failed to set up the transfer queue.");
+		goto error_free;
+	}
+
 	status = atomics_cobalt_device_version ((dc_device_t *) device, device->version, sizeof (device->version));
 	if (status != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to identify the dive computer.");
@@ -248,7 +261,7 @@ atomics_cobalt_read_dive (dc_device_t *abstract, dc_buffer_t *buffer, int init,
 	while (1) {
 		// Receive the answer from the dive computer.
 		size_t length = 0;
-		unsigned char packet[8 * 1024] = {0};
+		unsigned char packet[SZ_PACKET] = {0};
 		status = dc_iostream_read (device->iostream, packet, sizeof(packet), &length);
 		if (status != DC_STATUS_SUCCESS && status != DC_STATUS_TIMEOUT) {
 			ERROR (abstract->context, "Failed to receive the answer.");
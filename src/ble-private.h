@@ -0,0 +1,53 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_BLE_PRIVATE_H
+#define DC_BLE_PRIVATE_H
+
+#include <libdivecomputer/common.h>
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/iostream.h>
+#include <libdivecomputer/ble.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Enlarge the packet sizes to the payload size of the ATT MTU.
+ *
+ * The MTU exchange is requested first, and if the base I/O stream reports
+ * the resulting ATT MTU, the non-zero packet sizes are increased to the
+ * maximum payload size. They are never decreased. For other transports, or
+ * if the MTU is unknown, the packet sizes are left unchanged.
+ *
+ * @param[in]     iostream  A valid I/O stream.
+ * @param[in]     context   A valid context.
+ * @param[in,out] isize     The input packet size in bytes.
+ * @param[in,out] osize     The output packet size in bytes.
+ */
+void
+dc_ble_packetsize (dc_iostream_t *iostream, dc_context_t *context, size_t *isize, size_t *osize);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_BLE_PRIVATE_H */
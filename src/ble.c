@@ -27,6 +27,8 @@
 
 #include <libdivecomputer/ble.h>
 
+#include "ble-private.h"
+#include "context-private.h"
 #include "platform.h"
 
 char *
@@ -95,3 +97,29 @@ dc_ble_str2uuid (const char *str, dc_ble_uuid_t uuid)
 
 	return 1;
 }
+
+void
+dc_ble_packetsize (dc_iostream_t *iostream, dc_context_t *context, size_t *isize, size_t *osize)
+{
+	if (dc_iostream_get_transport (iostream) != DC_TRANSPORT_BLE)
+		return;
+
+	// Request the largest MTU. Hosts which don't support the MTU
+	// requests simply keep the default packet sizes.
+	unsigned int mtu = DC_BLE_MTU_MAX;
+	dc_iostream_ioctl (iostream, DC_IOCTL_BLE_SET_MTU, &mtu, sizeof(mtu));
+
+	mtu = 0;
+	dc_status_t status = dc_iostream_ioctl (iostream, DC_IOCTL_BLE_GET_MTU, &mtu, sizeof(mtu));
+	if (status != DC_STATUS_SUCCESS || mtu <= DC_BLE_ATT_HEADER)
+		return;
+
+	size_t payload = mtu - DC_BLE_ATT_HEADER;
+
+	INFO (context, "BLE MTU: mtu=%u, payload=" DC_PRINTF_SIZE, mtu, payload);
+
+	if (*isize && *isize < payload)
+		*isize = payload;
+	if (*osize && *osize < payload)
+		*osize = payload;
+}
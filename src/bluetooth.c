@@ -62,6 +62,7 @@
 
 #define MAX_DEVICES 255
 #define MAX_PERIODS 8
+#define MAX_RESOLVERS 4
 
 #define ISINSTANCE(device) dc_iostream_isinstance((device), &dc_bluetooth_vtable)
 
@@ -71,6 +72,37 @@ struct dc_bluetooth_device_t {
 };
 
 #ifdef BLUETOOTH
+#ifdef HAVE_BLUEZ
+typedef struct dc_bluetooth_result_t {
+	dc_bluetooth_address_t address;
+	int valid;
+	int match;
+	char name[HCI_MAX_NAME_LENGTH];
+} dc_bluetooth_result_t;
+
+/*
+ * The state shared by the iterator and the resolver threads. The iterator
+ * doesn't wait for the resolvers when it's freed, and the last one to
+ * finish frees the state. Once cancelled, the resolvers no longer touch
+ * the context and the descriptor, because those are owned by the caller.
+ */
+typedef struct dc_bluetooth_resolver_t {
+	dc_mutex_t mutex;
+	dc_signal_t *signal;
+	size_t refcount;
+	int cancel;
+	dc_context_t *context;
+	dc_descriptor_t *descriptor;
+	int dev;
+	inquiry_info *devices;
+	dc_bluetooth_result_t *results;
+	size_t count;
+	size_t next;
+	size_t ncompleted;
+	size_t *completed;
+} dc_bluetooth_resolver_t;
+#endif
+
 static dc_status_t dc_bluetooth_iterator_next (dc_iterator_t *iterator, void *item);
 static dc_status_t dc_bluetooth_iterator_free (dc_iterator_t *iterator);
 
@@ -80,9 +112,7 @@ typedef struct dc_bluetooth_iterator_t {
 #ifdef _WIN32
 	HANDLE hLookup;
 #else
-	int fd;
-	inquiry_info *devices;
-	size_t count;
+	dc_bluetooth_resolver_t *resolver;
 	size_t current;
 #endif
 } dc_bluetooth_iterator_t;
@@ -103,6 +133,7 @@ static const dc_iostream_vtable_t dc_bluetooth_vtable = {
 	dc_socket_get_available, /* get_available */
 	NULL, /* configure */
 	dc_socket_poll, /* poll */
+	dc_socket_get_pollfd, /* get_pollfd */
 	dc_socket_read, /* read */
 	dc_socket_write, /* write */
 	dc_socket_ioctl, /* ioctl */
@@ -219,6 +250,116 @@ error:
 
 	return status;
 }
+
+static void
+dc_bluetooth_resolver_release (dc_bluetooth_resolver_t *resolver)
+{
+	dc_mutex_lock (&resolver->mutex);
+	size_t refcount = --resolver->refcount;
+	dc_mutex_unlock (&resolver->mutex);
+
+	if (refcount)
+		return;
+
+	dc_signal_free (resolver->signal);
+	dc_mutex_destroy (&resolver->mutex);
+	free (resolver->completed);
+	free (resolver->results);
+	bt_free (resolver->devices);
+	free (resolver);
+}
+
+static void
+dc_bluetooth_resolver (void *userdata)
+{
+	dc_bluetooth_resolver_t *resolver = (dc_bluetooth_resolver_t *) userdata;
+
+	// Each resolver needs its own socket, because the replies to the
+	// requests can't be matched when sharing a socket between threads.
+	int fd = hci_open_dev (resolver->dev);
+	if (fd < 0) {
+		s_errcode_t errcode = S_ERRNO;
+		dc_mutex_lock (&resolver->mutex);
+		if (!resolver->cancel)
+			SYSERROR (resolver->context, errcode);
+		dc_mutex_unlock (&resolver->mutex);
+	}
+
+	while (1) {
+		// The context is only used while holding the lock, to ensure the
+		// iterator hasn't been freed in the meantime.
+		dc_mutex_lock (&resolver->mutex);
+		size_t i = resolver->next;
+		int cancel = resolver->cancel;
+		int cached = 0;
+		if (!cancel && i < resolver->count) {
+			dc_bluetooth_result_t *result = &resolver->results[i];
+			result->address = dc_address_get (&resolver->devices[i].bdaddr);
+			cached = dc_context_cache_get_name (resolver->context, DC_TRANSPORT_BLUETOOTH,
+				result->address, result->name, sizeof(result->name)) == DC_STATUS_SUCCESS;
+			resolver->next++;
+		}
+		dc_mutex_unlock (&resolver->mutex);
+
+		if (cancel || i >= resolver->count)
+			break;
+
+		inquiry_info *dev = &resolver->devices[i];
+		dc_bluetooth_result_t *result = &resolver->results[i];
+
+		// Get the user friendly name. The page scan parameters from the
+		// inquiry avoid a slow full page scan.
+		int resolved = 0;
+		if (cached) {
+			result->valid = 1;
+		} else if (fd >= 0 && hci_read_remote_name_with_clock_offset (fd, &dev->bdaddr,
+			dev->pscan_rep_mode, dev->clock_offset | 0x8000,
+			sizeof(result->name), result->name, 0) >= 0) {
+			// Null terminate the string.
+			result->name[sizeof(result->name) - 1] = '\0';
+			result->valid = 1;
+			resolved = 1;
+		}
+
+		// Hand the result to the iterator.
+		unsigned int port = 0;
+		int lookup = 0;
+		dc_mutex_lock (&resolver->mutex);
+		cancel = resolver->cancel;
+		if (!cancel) {
+			if (resolved)
+				dc_context_cache_set_name (resolver->context, DC_TRANSPORT_BLUETOOTH, result->address, result->name);
+			result->match = dc_descriptor_filter (resolver->descriptor, DC_TRANSPORT_BLUETOOTH,
+				result->valid ? result->name : NULL);
+			lookup = resolver->descriptor && result->match &&
+				dc_context_cache_get_port (resolver->context, DC_TRANSPORT_BLUETOOTH, result->address, &port) != DC_STATUS_SUCCESS;
+			resolver->completed[resolver->ncompleted++] = i;
+		}
+		dc_mutex_unlock (&resolver->mutex);
+
+		if (cancel)
+			break;
+
+		dc_signal_set (resolver->signal);
+
+		// Look up the serial port service of a matching device in
+		// advance, to avoid the delay when opening the connection. The
+		// lookup can outlive the iterator, so it doesn't log anything.
+		uint8_t channel = 0;
+		if (lookup && dc_bluetooth_sdp (&channel, NULL, &dev->bdaddr) == DC_STATUS_SUCCESS) {
+			dc_mutex_lock (&resolver->mutex);
+			if (!resolver->cancel)
+				dc_context_cache_set_port (resolver->context, DC_TRANSPORT_BLUETOOTH, result->address, channel);
+			dc_mutex_unlock (&resolver->mutex);
+		}
+	}
+
+	if (fd >= 0) {
+		hci_close_dev (fd);
+	}
+
+	dc_bluetooth_resolver_release (resolver);
+}
 #endif
 #endif
 
@@ -347,15 +488,6 @@ dc_bluetooth_iterator_new (dc_iterator_t **out, dc_context_t *context, dc_descri
 		goto error_socket_exit;
 	}
 
-	// Open a socket to the bluetooth adapter.
-	int fd = hci_open_dev (dev);
-	if (fd < 0) {
-		s_errcode_t errcode = S_ERRNO;
-		SYSERROR (context, errcode);
-		status = dc_socket_syserror(errcode);
-		goto error_socket_exit;
-	}
-
 	// Perform the bluetooth device discovery. The inquiry lasts for at
 	// most MAX_PERIODS * 1.28 seconds, and at most MAX_DEVICES devices
 	// will be returned.
@@ -365,23 +497,87 @@ dc_bluetooth_iterator_new (dc_iterator_t **out, dc_context_t *context, dc_descri
 		s_errcode_t errcode = S_ERRNO;
 		SYSERROR (context, errcode);
 		status = dc_socket_syserror(errcode);
-		goto error_close;
+		goto error_socket_exit;
 	}
 
-	iterator->fd = fd;
-	iterator->devices = devices;
-	iterator->count = ndevices;
+	dc_bluetooth_resolver_t *resolver = (dc_bluetooth_resolver_t *) calloc (1, sizeof (dc_bluetooth_resolver_t));
+	if (resolver == NULL) {
+		SYSERROR (context, S_ENOMEM);
+		status = DC_STATUS_NOMEMORY;
+		goto error_devices_free;
+	}
+
+	resolver->refcount = 1;
+	resolver->cancel = 0;
+	resolver->context = context;
+	resolver->descriptor = descriptor;
+	resolver->dev = dev;
+	resolver->devices = devices;
+	resolver->count = ndevices;
+	resolver->next = 0;
+	resolver->ncompleted = 0;
+	resolver->results = (dc_bluetooth_result_t *) calloc (ndevices ? ndevices : 1, sizeof (dc_bluetooth_result_t));
+	resolver->completed = (size_t *) malloc ((ndevices ? ndevices : 1) * sizeof (size_t));
+	if (resolver->results == NULL || resolver->completed == NULL) {
+		SYSERROR (context, S_ENOMEM);
+		status = DC_STATUS_NOMEMORY;
+		goto error_results_free;
+	}
+
+	dc_mutex_init (&resolver->mutex);
+	if (dc_signal_new (&resolver->signal) != 0) {
+		ERROR (context, "Failed to create the signal.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_mutex_destroy;
+	}
+
+	iterator->resolver = resolver;
 	iterator->current = 0;
 #endif
 	iterator->descriptor = descriptor;
 
+#ifndef _WIN32
+	// Resolve the names of the discovered devices concurrently. The
+	// devices are returned by the iterator as soon as they are resolved.
+	// The resolver threads are detached, and each one holds a reference
+	// to the shared state.
+	size_t nthreads = ndevices < MAX_RESOLVERS ? ndevices : MAX_RESOLVERS;
+	for (size_t i = 0; i < nthreads; ++i) {
+		dc_mutex_lock (&resolver->mutex);
+		resolver->refcount++;
+		dc_mutex_unlock (&resolver->mutex);
+
+		dc_thread_t *thread = NULL;
+		if (dc_thread_new (&thread, dc_bluetooth_resolver, resolver) != 0) {
+			dc_mutex_lock (&resolver->mutex);
+			resolver->refcount--;
+			dc_mutex_unlock (&resolver->mutex);
+			if (i)
+				break;
+			ERROR (context, "Failed to create the resolver thread.");
+			status = DC_STATUS_NOMEMORY;
+			goto error_signal_free;
+		}
+
+		dc_thread_detach (thread);
+	}
+#endif
+
 	*out = (dc_iterator_t *) iterator;
 
 	return DC_STATUS_SUCCESS;
 
 #ifndef _WIN32
-error_close:
-	hci_close_dev(fd);
+error_signal_free:
+	dc_signal_free (resolver->signal);
+error_mutex_destroy:
+	dc_mutex_destroy (&resolver->mutex);
+error_results_free:
+	free (resolver->completed);
+	free (resolver->results);
+	free (resolver);
+error_devices_free:
+	bt_free (devices);
 #endif
 error_socket_exit:
 	dc_socket_exit (context);
@@ -434,28 +630,36 @@ dc_bluetooth_iterator_next (dc_iterator_t *abstract, void *out)
 		dc_bluetooth_address_t address = sa->btAddr;
 		const char *name = (char *) pwsaResults->lpszServiceInstanceName;
 #else
-	while (iterator->current < iterator->count) {
-		inquiry_info *dev = &iterator->devices[iterator->current++];
-
-		dc_bluetooth_address_t address = dc_address_get (&dev->bdaddr);
-
-		// Get the user friendly name.
-		char buf[HCI_MAX_NAME_LENGTH], *name = buf;
-		int rc = hci_read_remote_name (iterator->fd, &dev->bdaddr, sizeof(buf), buf, 0);
-		if (rc < 0) {
-			name = NULL;
+	dc_bluetooth_resolver_t *resolver = iterator->resolver;
+	while (iterator->current < resolver->count) {
+		dc_mutex_lock (&resolver->mutex);
+		size_t ncompleted = resolver->ncompleted;
+		dc_mutex_unlock (&resolver->mutex);
+
+		// Wait for the next resolved device.
+		if (iterator->current >= ncompleted) {
+			dc_signal_wait (resolver->signal);
+			continue;
 		}
 
-		// Null terminate the string.
-		buf[sizeof(buf) - 1] = '\0';
+		const dc_bluetooth_result_t *result = &resolver->results[resolver->completed[iterator->current++]];
+
+		dc_bluetooth_address_t address = result->address;
+		const char *name = result->valid ? result->name : NULL;
 #endif
 
 		INFO (abstract->context, "Discover: address=" DC_ADDRESS_FORMAT ", name=%s",
 			address, name ? name : "");
 
+#ifdef _WIN32
 		if (!dc_descriptor_filter (iterator->descriptor, DC_TRANSPORT_BLUETOOTH, name)) {
 			continue;
 		}
+#else
+		if (!result->match) {
+			continue;
+		}
+#endif
 
 		device = (dc_bluetooth_device_t *) malloc (sizeof(dc_bluetooth_device_t));
 		if (device == NULL) {
@@ -489,8 +693,13 @@ dc_bluetooth_iterator_free (dc_iterator_t *abstract)
 		WSALookupServiceEnd (iterator->hLookup);
 	}
 #else
-	bt_free(iterator->devices);
-	hci_close_dev(iterator->fd);
+	// Stop the resolver threads, without waiting for a request that is
+	// still in progress. The last thread frees the shared state.
+	dc_mutex_lock (&iterator->resolver->mutex);
+	iterator->resolver->cancel = 1;
+	dc_mutex_unlock (&iterator->resolver->mutex);
+
+	dc_bluetooth_resolver_release (iterator->resolver);
 #endif
 	dc_socket_exit (abstract->context);
 
@@ -541,10 +750,18 @@ dc_bluetooth_open (dc_iostream_t **out, dc_context_t *context, dc_bluetooth_addr
 	struct sockaddr_rc sa;
 	sa.rc_family = AF_BLUETOOTH;
 	dc_address_set (&sa.rc_bdaddr, address);
+	unsigned int cached = 0;
 	if (port == 0) {
-		status = dc_bluetooth_sdp (&sa.rc_channel, context, &sa.rc_bdaddr);
-		if (status != DC_STATUS_SUCCESS) {
-			goto error_close;
+		// Use the result of a recent service lookup if available.
+		if (dc_context_cache_get_port (context, DC_TRANSPORT_BLUETOOTH, address, &cached) == DC_STATUS_SUCCESS) {
+			INFO (context, "SDP: channel=%u (cached)", cached);
+			sa.rc_channel = cached;
+		} else {
+			status = dc_bluetooth_sdp (&sa.rc_channel, context, &sa.rc_bdaddr);
+			if (status != DC_STATUS_SUCCESS) {
+				goto error_close;
+			}
+			dc_context_cache_set_port (context, DC_TRANSPORT_BLUETOOTH, address, sa.rc_channel);
 		}
 	} else {
 		sa.rc_channel = port;
@@ -553,6 +770,12 @@ dc_bluetooth_open (dc_iostream_t **out, dc_context_t *context, dc_bluetooth_addr
 
 	status = dc_socket_connect (&device->base, (struct sockaddr *) &sa, sizeof (sa));
 	if (status != DC_STATUS_SUCCESS) {
+#ifndef _WIN32
+		// Don't reuse a cached port that no longer works.
+		if (cached) {
+			dc_context_cache_set_port (context, DC_TRANSPORT_BLUETOOTH, address, 0);
+		}
+#endif
 		goto error_close;
 	}
 
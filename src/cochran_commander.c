@@ -29,6 +29,8 @@
 #include "array.h"
 #include "ringbuffer.h"
 #include "rbstream.h"
+#include "transaction.h"
+#include "timer.h"
 
 #define MAXRETRIES 2
 
@@ -94,6 +96,7 @@ typedef struct cochran_device_layout_t {
 typedef struct cochran_commander_device_t {
 	dc_device_t base;
 	dc_iostream_t *iostream;
+	dc_transaction_t transaction;
 	const cochran_device_layout_t *layout;
 	unsigned char id[67];
 	unsigned char fingerprint[6];
@@ -112,6 +115,7 @@ static const dc_device_vtable_t cochran_commander_device_vtable = {
 	NULL, /* write */
 	cochran_commander_device_dump, /* dump */
 	cochran_commander_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -537,33 +541,121 @@ cochran_commander_read (cochran_commander_device_t *device, dc_event_progress_t
 }
 
 
+typedef struct cochran_commander_transfer_t {
+	dc_event_progress_t *progress;
+	unsigned int saved;
+	unsigned int address;
+	unsigned char *data;
+	unsigned int size;
+} cochran_commander_transfer_t;
+
 static dc_status_t
-cochran_commander_read_retry (cochran_commander_device_t *device, dc_event_progress_t *progress, unsigned int address, unsigned char data[], unsigned int size)
+cochran_commander_read_attempt (dc_transaction_t *transaction, unsigned int attempt, void *userdata)
 {
-	// Save the state of the progress events.
-	unsigned int saved = 0;
-	if (progress) {
-		saved = progress->current;
+	cochran_commander_transfer_t *transfer = (cochran_commander_transfer_t *) userdata;
+	cochran_commander_device_t *device = (cochran_commander_device_t *) transaction->device;
+
+	// Restore the state of the progress events.
+	if (attempt && transfer->progress) {
+		transfer->progress->current = transfer->saved;
 	}
 
-	unsigned int nretries = 0;
+	return cochran_commander_read (device, transfer->progress, transfer->address, transfer->data, transfer->size);
+}
+
+static unsigned int
+cochran_commander_chunksize (const cochran_device_layout_t *layout, unsigned int seconds)
+{
+	// The amount of data transferred in the given number of seconds (at
+	// about ten bits per byte), rounded down to a multiple of 512 bytes.
+	unsigned int chunksize = layout->baudrate / 10 * seconds;
+
+	return chunksize - chunksize % 512;
+}
+
+static void
+cochran_commander_stats (cochran_commander_device_t *device, dc_timer_t *timer, dc_usecs_t begin, unsigned int blocksize, unsigned int nbytes, unsigned int nerrors)
+{
+	dc_event_stats_t stats;
+	dc_usecs_t now = begin;
+
+	if (timer)
+		dc_timer_now (timer, &now);
+
+	dc_usecs_t elapsed = now - begin;
+
+	stats.blocksize = blocksize;
+	stats.nbytes = nbytes;
+	stats.elapsed = elapsed / 1000;
+	stats.throughput = elapsed ? (unsigned int) (nbytes * 1000000ULL / elapsed) : 0;
+	stats.nerrors = nerrors;
+	device_event_emit ((dc_device_t *) device, DC_EVENT_STATS, &stats);
+}
+
+static dc_status_t
+cochran_commander_read_retry (cochran_commander_device_t *device, dc_event_progress_t *progress, unsigned int address, unsigned char data[], unsigned int size)
+{
+	dc_device_t *abstract = (dc_device_t *) device;
 	dc_status_t rc = DC_STATUS_SUCCESS;
-	while ((rc = cochran_commander_read (device, progress, address, data, size)) != DC_STATUS_SUCCESS) {
-		// Automatically discard a corrupted packet,
-		// and request a new one.
-		if (rc != DC_STATUS_PROTOCOL && rc != DC_STATUS_TIMEOUT)
-			return rc;
 
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
-			return rc;
+	// The protocol has no checksums, so only incomplete transfers can be
+	// detected. Large regions are read in chunks, such that a failure
+	// only needs to re-request the failed chunk instead of the entire
+	// region. But every chunk also repeats the wakeup sequence, which
+	// takes more than half a second. The chunks start at about forty
+	// seconds worth of data, where that overhead is small. A chunk that
+	// needed a retry halves the size, down to about five seconds, to
+	// limit the cost of the next failure. A chunk that succeeds at the
+	// first attempt doubles it again.
+	unsigned int minchunk = cochran_commander_chunksize (device->layout, 5);
+	unsigned int maxchunk = cochran_commander_chunksize (device->layout, 40);
+	unsigned int chunksize = maxchunk;
+	unsigned int nretries = device->transaction.nretries;
+
+	dc_timer_t *timer = NULL;
+	dc_usecs_t begin = 0;
+	if (dc_timer_new (&timer) == DC_STATUS_SUCCESS) {
+		dc_timer_now (timer, &begin);
+	}
+
+	unsigned int nbytes = 0;
+	while (nbytes < size) {
+		unsigned int len = size - nbytes;
+		if (len > chunksize)
+			len = chunksize;
 
-		// Restore the state of the progress events.
+		// Save the state of the progress events.
+		cochran_commander_transfer_t transfer = {progress, 0, address + nbytes, data + nbytes, len};
 		if (progress) {
-			progress->current = saved;
+			transfer.saved = progress->current;
+		}
+
+		unsigned int before = device->transaction.nretries;
+		rc = dc_transaction_run (&device->transaction, cochran_commander_read_attempt, &transfer);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to read chunk at address 0x%06x (%u of %u bytes done).", address + nbytes, nbytes, size);
+			goto error;
+		}
+
+		nbytes += len;
+
+		// Report the effective throughput, including the retries.
+		cochran_commander_stats (device, timer, begin, len, nbytes, device->transaction.nretries - nretries);
+
+		// Adapt the chunk size.
+		if (device->transaction.nretries != before) {
+			chunksize /= 2;
+			if (chunksize < minchunk)
+				chunksize = minchunk;
+		} else if (chunksize < maxchunk) {
+			chunksize *= 2;
+			if (chunksize > maxchunk)
+				chunksize = maxchunk;
 		}
 	}
 
+error:
+	dc_timer_free (timer);
 	return rc;
 }
 
@@ -732,6 +824,9 @@ cochran_commander_device_open (dc_device_t **out, dc_context_t *context, dc_iost
 	device->iostream = iostream;
 	cochran_commander_device_set_fingerprint((dc_device_t *) device, NULL, 0);
 
+	// Retry failed reads immediately.
+	dc_transaction_init (&device->transaction, (dc_device_t *) device, device->iostream, MAXRETRIES, 0, 0);
+
 	status = cochran_commander_serial_setup(device);
 	if (status != DC_STATUS_SUCCESS) {
 		goto error_free;
@@ -67,6 +67,25 @@ dc_context_syserror (dc_context_t *context, dc_loglevel_t loglevel, const char *
 dc_status_t
 dc_context_hexdump (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *prefix, const unsigned char data[], unsigned int size);
 
+/*
+ * The discovery cache remembers the name and port of a device address for
+ * a limited time (see dc_context_set_cache_ttl), to avoid repeating slow
+ * lookups. The get functions return DC_STATUS_UNSUPPORTED if there is no
+ * valid entry. Setting a zero port number invalidates the cached port.
+ */
+
+dc_status_t
+dc_context_cache_get_name (dc_context_t *context, dc_transport_t transport, unsigned long long address, char *name, size_t size);
+
+dc_status_t
+dc_context_cache_set_name (dc_context_t *context, dc_transport_t transport, unsigned long long address, const char *name);
+
+dc_status_t
+dc_context_cache_get_port (dc_context_t *context, dc_transport_t transport, unsigned long long address, unsigned int *port);
+
+dc_status_t
+dc_context_cache_set_port (dc_context_t *context, dc_transport_t transport, unsigned long long address, unsigned int port);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
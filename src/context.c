@@ -38,13 +38,34 @@
 #include "platform.h"
 #include "timer.h"
 
+#define CACHE_TTL 300
+
+#define MSGSIZE (16384 + 32)
+
+typedef struct dc_context_cache_t {
+	dc_transport_t transport;
+	unsigned long long address;
+	dc_usecs_t name_expires;
+	dc_usecs_t port_expires;
+	unsigned int port;
+	char name[248];
+} dc_context_cache_t;
+
 struct dc_context_t {
 	dc_loglevel_t loglevel;
 	dc_logfunc_t logfunc;
 	void *userdata;
-#ifdef ENABLE_LOGGING
-	char msg[16384 + 32];
+	// The discovery cache is shared by all threads using the context.
+	dc_mutex_t cache_mutex;
+	dc_context_cache_t *cache;
+	size_t cache_count;
+	size_t cache_capacity;
+	unsigned int cache_ttl;
 	dc_timer_t *timer;
+#ifdef ENABLE_LOGGING
+	// Protects the log function, which can be changed while other threads
+	// are logging.
+	dc_mutex_t mutex;
 #endif
 };
 
@@ -125,10 +146,17 @@ dc_context_new (dc_context_t **out)
 #endif
 	context->userdata = NULL;
 
-#ifdef ENABLE_LOGGING
-	memset (context->msg, 0, sizeof (context->msg));
+	dc_mutex_init (&context->cache_mutex);
+	context->cache = NULL;
+	context->cache_count = 0;
+	context->cache_capacity = 0;
+	context->cache_ttl = CACHE_TTL;
+
 	context->timer = NULL;
 	dc_timer_new (&context->timer);
+
+#ifdef ENABLE_LOGGING
+	dc_mutex_init (&context->mutex);
 #endif
 
 	*out = context;
@@ -143,8 +171,11 @@ dc_context_free (dc_context_t *context)
 		return DC_STATUS_SUCCESS;
 
 #ifdef ENABLE_LOGGING
-	dc_timer_free (context->timer);
+	dc_mutex_destroy (&context->mutex);
 #endif
+	dc_timer_free (context->timer);
+	dc_mutex_destroy (&context->cache_mutex);
+	free (context->cache);
 	free (context);
 
 	return DC_STATUS_SUCCESS;
@@ -170,18 +201,204 @@ dc_context_set_logfunc (dc_context_t *context, dc_logfunc_t logfunc, void *userd
 		return DC_STATUS_INVALIDARGS;
 
 #ifdef ENABLE_LOGGING
+	dc_mutex_lock (&context->mutex);
 	context->logfunc = logfunc;
 	context->userdata = userdata;
+	dc_mutex_unlock (&context->mutex);
 #endif
 
 	return DC_STATUS_SUCCESS;
 }
 
+dc_status_t
+dc_context_set_cache_ttl (dc_context_t *context, unsigned int seconds)
+{
+	if (context == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_mutex_lock (&context->cache_mutex);
+	context->cache_ttl = seconds;
+	if (seconds == 0) {
+		context->cache_count = 0;
+	}
+	dc_mutex_unlock (&context->cache_mutex);
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * The expiry times are based on the monotonic timer, such that changes to
+ * the system clock don't affect them. Without a timer, the cache is
+ * disabled.
+ */
+static int
+dc_context_cache_enabled (dc_context_t *context)
+{
+	return context->cache_ttl != 0 && context->timer != NULL;
+}
+
+static dc_usecs_t
+dc_context_cache_now (dc_context_t *context)
+{
+	dc_usecs_t now = 0;
+	dc_timer_now (context->timer, &now);
+	return now;
+}
+
+static dc_usecs_t
+dc_context_cache_expires (dc_context_t *context)
+{
+	return dc_context_cache_now (context) + (dc_usecs_t) context->cache_ttl * 1000000;
+}
+
+/*
+ * Find the cache entry for an address, and optionally create a new one.
+ * Expired entries are removed while searching. The cache mutex must be
+ * locked by the caller.
+ */
+static dc_context_cache_t *
+dc_context_cache_find (dc_context_t *context, dc_transport_t transport, unsigned long long address, int create)
+{
+	dc_usecs_t now = dc_context_cache_now (context);
+
+	size_t i = 0;
+	while (i < context->cache_count) {
+		dc_context_cache_t *entry = context->cache + i;
+		if (entry->name_expires <= now && entry->port_expires <= now) {
+			context->cache[i] = context->cache[--context->cache_count];
+			continue;
+		}
+
+		if (entry->transport == transport && entry->address == address)
+			return entry;
+
+		i++;
+	}
+
+	if (!create || !dc_context_cache_enabled (context))
+		return NULL;
+
+	if (context->cache_count == context->cache_capacity) {
+		size_t capacity = context->cache_capacity ? context->cache_capacity * 2 : 16;
+		dc_context_cache_t *cache = (dc_context_cache_t *) realloc (context->cache, capacity * sizeof (dc_context_cache_t));
+		if (cache == NULL)
+			return NULL;
+
+		context->cache = cache;
+		context->cache_capacity = capacity;
+	}
+
+	dc_context_cache_t *entry = context->cache + context->cache_count++;
+	memset (entry, 0, sizeof (dc_context_cache_t));
+	entry->transport = transport;
+	entry->address = address;
+
+	return entry;
+}
+
+dc_status_t
+dc_context_cache_get_name (dc_context_t *context, dc_transport_t transport, unsigned long long address, char *name, size_t size)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (context == NULL || name == NULL || size == 0)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_mutex_lock (&context->cache_mutex);
+
+	dc_context_cache_t *entry = dc_context_cache_find (context, transport, address, 0);
+	if (entry == NULL || entry->name_expires <= dc_context_cache_now (context)) {
+		status = DC_STATUS_UNSUPPORTED;
+	} else {
+		strncpy (name, entry->name, size - 1);
+		name[size - 1] = '\0';
+	}
+
+	dc_mutex_unlock (&context->cache_mutex);
+
+	return status;
+}
+
+dc_status_t
+dc_context_cache_set_name (dc_context_t *context, dc_transport_t transport, unsigned long long address, const char *name)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (context == NULL || name == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_mutex_lock (&context->cache_mutex);
+
+	dc_context_cache_t *entry = dc_context_cache_find (context, transport, address, 1);
+	if (entry == NULL) {
+		if (dc_context_cache_enabled (context))
+			status = DC_STATUS_NOMEMORY;
+	} else {
+		strncpy (entry->name, name, sizeof (entry->name) - 1);
+		entry->name[sizeof (entry->name) - 1] = '\0';
+		entry->name_expires = dc_context_cache_expires (context);
+	}
+
+	dc_mutex_unlock (&context->cache_mutex);
+
+	return status;
+}
+
+dc_status_t
+dc_context_cache_get_port (dc_context_t *context, dc_transport_t transport, unsigned long long address, unsigned int *port)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (context == NULL || port == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_mutex_lock (&context->cache_mutex);
+
+	dc_context_cache_t *entry = dc_context_cache_find (context, transport, address, 0);
+	if (entry == NULL || entry->port_expires <= dc_context_cache_now (context)) {
+		status = DC_STATUS_UNSUPPORTED;
+	} else {
+		*port = entry->port;
+	}
+
+	dc_mutex_unlock (&context->cache_mutex);
+
+	return status;
+}
+
+dc_status_t
+dc_context_cache_set_port (dc_context_t *context, dc_transport_t transport, unsigned long long address, unsigned int port)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (context == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_mutex_lock (&context->cache_mutex);
+
+	// A zero port number invalidates the cached port.
+	dc_context_cache_t *entry = dc_context_cache_find (context, transport, address, port != 0);
+	if (entry == NULL) {
+		if (port != 0 && dc_context_cache_enabled (context))
+			status = DC_STATUS_NOMEMORY;
+	} else if (port == 0) {
+		entry->port_expires = 0;
+	} else {
+		entry->port = port;
+		entry->port_expires = dc_context_cache_expires (context);
+	}
+
+	dc_mutex_unlock (&context->cache_mutex);
+
+	return status;
+}
+
 dc_status_t
 dc_context_log (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *format, ...)
 {
 #ifdef ENABLE_LOGGING
 	va_list ap;
+	char msg[MSGSIZE];
 #endif
 
 	if (context == NULL)
@@ -191,14 +408,21 @@ dc_context_log (dc_context_t *context, dc_loglevel_t loglevel, const char *file,
 	if (loglevel > context->loglevel)
 		return DC_STATUS_SUCCESS;
 
-	if (context->logfunc == NULL)
+	// The log function is called without holding the lock, such that it
+	// can't block the other threads.
+	dc_mutex_lock (&context->mutex);
+	dc_logfunc_t logfunc = context->logfunc;
+	void *userdata = context->userdata;
+	dc_mutex_unlock (&context->mutex);
+
+	if (logfunc == NULL)
 		return DC_STATUS_SUCCESS;
 
 	va_start (ap, format);
-	dc_platform_vsnprintf (context->msg, sizeof (context->msg), format, ap);
+	dc_platform_vsnprintf (msg, sizeof (msg), format, ap);
 	va_end (ap);
 
-	context->logfunc (context, loglevel, file, line, function, context->msg, context->userdata);
+	logfunc (context, loglevel, file, line, function, msg, userdata);
 #endif
 
 	return DC_STATUS_SUCCESS;
@@ -249,6 +473,7 @@ dc_context_hexdump (dc_context_t *context, dc_loglevel_t loglevel, const char *f
 {
 #ifdef ENABLE_LOGGING
 	int n;
+	char msg[MSGSIZE];
 #endif
 
 	if (context == NULL || prefix == NULL)
@@ -258,16 +483,21 @@ dc_context_hexdump (dc_context_t *context, dc_loglevel_t loglevel, const char *f
 	if (loglevel > context->loglevel)
 		return DC_STATUS_SUCCESS;
 
-	if (context->logfunc == NULL)
+	dc_mutex_lock (&context->mutex);
+	dc_logfunc_t logfunc = context->logfunc;
+	void *userdata = context->userdata;
+	dc_mutex_unlock (&context->mutex);
+
+	if (logfunc == NULL)
 		return DC_STATUS_SUCCESS;
 
-	n = dc_platform_snprintf (context->msg, sizeof (context->msg), "%s: size=%u, data=", prefix, size);
+	n = dc_platform_snprintf (msg, sizeof (msg), "%s: size=%u, data=", prefix, size);
 
 	if (n >= 0) {
-		n = l_hexdump (context->msg + n, sizeof (context->msg) - n, data, size);
+		n = l_hexdump (msg + n, sizeof (msg) - n, data, size);
 	}
 
-	context->logfunc (context, loglevel, file, line, function, context->msg, context->userdata);
+	logfunc (context, loglevel, file, line, function, msg, userdata);
 #endif
 
 	return DC_STATUS_SUCCESS;
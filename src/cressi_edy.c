@@ -77,6 +77,7 @@ static const dc_device_vtable_t cressi_edy_device_vtable = {
 	NULL, /* write */
 	cressi_edy_device_dump, /* dump */
 	cressi_edy_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	NULL, /* timesync */
 	cressi_edy_device_close /* close */
 };
@@ -417,7 +418,7 @@ cressi_edy_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
 
 	return device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), device->packetsize);
+		dc_buffer_get_size (buffer), device->packetsize, device->packetsize);
 }
 
 
@@ -83,6 +83,7 @@ static const dc_device_vtable_t cressi_goa_device_vtable = {
 	NULL, /* write */
 	NULL, /* dump */
 	cressi_goa_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	cressi_goa_device_timesync, /* timesync */
 	cressi_goa_device_close /* close */
 };
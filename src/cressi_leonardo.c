@@ -65,6 +65,7 @@ static const dc_device_vtable_t cressi_leonardo_device_vtable = {
 	NULL, /* write */
 	cressi_leonardo_device_dump, /* dump */
 	cressi_leonardo_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -20,6 +20,7 @@
  */
 
 #include <stdlib.h> // malloc, free
+#include <string.h> // memcpy
 
 #include <libdivecomputer/custom.h>
 
@@ -27,6 +28,12 @@
 #include "common-private.h"
 #include "context-private.h"
 
+#define ISINSTANCE(device) dc_iostream_isinstance((device), &dc_custom_vtable)
+
+#define RBUF_SIZE 4096
+#define WBUF_SIZE 4096
+#define WBUF_COUNT 16
+
 static dc_status_t dc_custom_set_timeout (dc_iostream_t *abstract, int timeout);
 static dc_status_t dc_custom_set_break (dc_iostream_t *abstract, unsigned int value);
 static dc_status_t dc_custom_set_dtr (dc_iostream_t *abstract, unsigned int value);
@@ -48,7 +55,17 @@ typedef struct dc_custom_t {
 	dc_iostream_t base;
 	/* Internal state. */
 	dc_custom_cbs_t callbacks;
+	dc_custom_vcbs_t vcallbacks;
 	void *userdata;
+	/* Read-ahead buffer (readv only). */
+	unsigned char rbuf[RBUF_SIZE];
+	size_t roffset;
+	size_t ravailable;
+	/* Queued writes (writev only). */
+	unsigned char wbuf[WBUF_SIZE];
+	size_t wsize;
+	dc_custom_iovec_t wiov[WBUF_COUNT];
+	size_t wcount;
 } dc_custom_t;
 
 static const dc_iostream_vtable_t dc_custom_vtable = {
@@ -61,6 +78,7 @@ static const dc_iostream_vtable_t dc_custom_vtable = {
 	dc_custom_get_available, /* get_available */
 	dc_custom_configure, /* configure */
 	dc_custom_poll, /* poll */
+	NULL, /* get_pollfd */
 	dc_custom_read, /* read */
 	dc_custom_write, /* write */
 	dc_custom_ioctl, /* ioctl */
@@ -88,13 +106,74 @@ dc_custom_open (dc_iostream_t **out, dc_context_t *context, dc_transport_t trans
 	}
 
 	custom->callbacks = *callbacks;
+	memset (&custom->vcallbacks, 0, sizeof (custom->vcallbacks));
 	custom->userdata = userdata;
+	custom->roffset = 0;
+	custom->ravailable = 0;
+	custom->wsize = 0;
+	custom->wcount = 0;
 
 	*out = (dc_iostream_t *) custom;
 
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * The read-ahead buffer is only used for stream oriented transports. For
+ * packet oriented transports, the packet boundaries need to be preserved.
+ */
+static int
+dc_custom_isstream (dc_custom_t *custom)
+{
+	dc_transport_t transport = dc_iostream_get_transport ((dc_iostream_t *) custom);
+
+	return transport != DC_TRANSPORT_USB &&
+		transport != DC_TRANSPORT_USBHID &&
+		transport != DC_TRANSPORT_BLE;
+}
+
+/*
+ * Send all queued writes with a single writev call.
+ */
+static dc_status_t
+dc_custom_drain (dc_custom_t *custom)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (custom->wcount == 0)
+		return DC_STATUS_SUCCESS;
+
+	size_t nbytes = 0;
+	status = custom->vcallbacks.writev (custom->userdata, custom->wiov, custom->wcount, &nbytes);
+	if (status == DC_STATUS_SUCCESS && nbytes != custom->wsize) {
+		ERROR (custom->base.context, "Unexpected number of bytes written (" DC_PRINTF_SIZE " " DC_PRINTF_SIZE ").", nbytes, custom->wsize);
+		status = DC_STATUS_IO;
+	}
+
+	custom->wsize = 0;
+	custom->wcount = 0;
+
+	return status;
+}
+
+dc_status_t
+dc_custom_set_vectored (dc_iostream_t *abstract, const dc_custom_vcbs_t *callbacks)
+{
+	dc_custom_t *custom = (dc_custom_t *) abstract;
+
+	if (!ISINSTANCE (abstract) || callbacks == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// Send the queued writes with the old callbacks.
+	dc_status_t status = dc_custom_drain (custom);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	custom->vcallbacks = *callbacks;
+
+	return DC_STATUS_SUCCESS;
+}
+
 static dc_status_t
 dc_custom_set_timeout (dc_iostream_t *abstract, int timeout)
 {
@@ -111,6 +190,10 @@ dc_custom_set_break (dc_iostream_t *abstract, unsigned int value)
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	dc_status_t status = dc_custom_drain (custom);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	if (custom->callbacks.set_break == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -122,6 +205,10 @@ dc_custom_set_dtr (dc_iostream_t *abstract, unsigned int value)
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	dc_status_t status = dc_custom_drain (custom);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	if (custom->callbacks.set_dtr == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -133,6 +220,10 @@ dc_custom_set_rts (dc_iostream_t *abstract, unsigned int value)
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	dc_status_t status = dc_custom_drain (custom);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	if (custom->callbacks.set_rts == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -144,6 +235,10 @@ dc_custom_get_lines (dc_iostream_t *abstract, unsigned int *value)
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	dc_status_t status = dc_custom_drain (custom);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	if (custom->callbacks.get_lines == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -155,6 +250,15 @@ dc_custom_get_available (dc_iostream_t *abstract, size_t *value)
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	if (custom->ravailable) {
+		size_t available = 0;
+		if (custom->callbacks.get_available)
+			custom->callbacks.get_available (custom->userdata, &available);
+		if (value)
+			*value = custom->ravailable + available;
+		return DC_STATUS_SUCCESS;
+	}
+
 	if (custom->callbacks.get_available == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -166,6 +270,10 @@ dc_custom_configure (dc_iostream_t *abstract, unsigned int baudrate, unsigned in
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	dc_status_t status = dc_custom_drain (custom);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	if (custom->callbacks.configure == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -177,6 +285,13 @@ dc_custom_poll (dc_iostream_t *abstract, int timeout)
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	dc_status_t status = dc_custom_drain (custom);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	if (custom->ravailable)
+		return DC_STATUS_SUCCESS;
+
 	if (custom->callbacks.poll == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -188,10 +303,50 @@ dc_custom_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
-	if (custom->callbacks.read == NULL)
-		return DC_STATUS_SUCCESS;
+	dc_status_t status = dc_custom_drain (custom);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	if (custom->vcallbacks.readv == NULL) {
+		if (custom->callbacks.read == NULL)
+			return DC_STATUS_SUCCESS;
+
+		return custom->callbacks.read (custom->userdata, data, size, actual);
+	}
+
+	// Return the buffered data first.
+	size_t nbytes = custom->ravailable < size ? custom->ravailable : size;
+	if (nbytes) {
+		memcpy (data, custom->rbuf + custom->roffset, nbytes);
+		custom->roffset += nbytes;
+		custom->ravailable -= nbytes;
+	}
+
+	// Read the remaining data, and fill the read-ahead buffer with the
+	// data that is already available.
+	if (nbytes < size) {
+		dc_custom_iovec_t iov[2] = {
+			{(unsigned char *) data + nbytes, size - nbytes},
+			{custom->rbuf, sizeof (custom->rbuf)},
+		};
+		size_t count = dc_custom_isstream (custom) ? 2 : 1;
+
+		size_t transferred = 0;
+		status = custom->vcallbacks.readv (custom->userdata, iov, count, &transferred);
+
+		if (transferred > iov[0].size) {
+			custom->roffset = 0;
+			custom->ravailable = transferred - iov[0].size;
+			transferred = iov[0].size;
+		}
+
+		nbytes += transferred;
+	}
+
+	if (actual)
+		*actual = nbytes;
 
-	return custom->callbacks.read (custom->userdata, data, size, actual);
+	return status;
 }
 
 static dc_status_t
@@ -199,10 +354,65 @@ dc_custom_write (dc_iostream_t *abstract, const void *data, size_t size, size_t
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
-	if (custom->callbacks.write == NULL)
-		return DC_STATUS_SUCCESS;
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (custom->vcallbacks.writev == NULL) {
+		if (custom->callbacks.write == NULL)
+			return DC_STATUS_SUCCESS;
+
+		return custom->callbacks.write (custom->userdata, data, size, actual);
+	}
+
+	// Send the queued writes if there is no room left.
+	if (custom->wcount == WBUF_COUNT || custom->wsize + size > sizeof (custom->wbuf)) {
+		status = dc_custom_drain (custom);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+	}
+
+	if (size > sizeof (custom->wbuf)) {
+		// Large writes are passed directly, or sent in chunks
+		// through the queue if there is no plain write callback.
+		if (custom->callbacks.write)
+			return custom->callbacks.write (custom->userdata, data, size, actual);
+
+		const unsigned char *p = (const unsigned char *) data;
+		size_t nbytes = 0;
+		while (nbytes < size) {
+			size_t len = size - nbytes;
+			if (len > sizeof (custom->wbuf))
+				len = sizeof (custom->wbuf);
 
-	return custom->callbacks.write (custom->userdata, data, size, actual);
+			memcpy (custom->wbuf, p + nbytes, len);
+			custom->wiov[0].data = custom->wbuf;
+			custom->wiov[0].size = len;
+			custom->wsize = len;
+			custom->wcount = 1;
+
+			status = dc_custom_drain (custom);
+			if (status != DC_STATUS_SUCCESS)
+				break;
+
+			nbytes += len;
+		}
+
+		if (actual)
+			*actual = nbytes;
+
+		return status;
+	}
+
+	// Queue the data.
+	custom->wiov[custom->wcount].data = custom->wbuf + custom->wsize;
+	custom->wiov[custom->wcount].size = size;
+	memcpy (custom->wbuf + custom->wsize, data, size);
+	custom->wsize += size;
+	custom->wcount++;
+
+	if (actual)
+		*actual = size;
+
+	return DC_STATUS_SUCCESS;
 }
 
 static dc_status_t
@@ -210,6 +420,10 @@ dc_custom_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	dc_status_t status = dc_custom_drain (custom);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	if (custom->callbacks.ioctl == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -221,6 +435,10 @@ dc_custom_flush (dc_iostream_t *abstract)
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	dc_status_t status = dc_custom_drain (custom);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	if (custom->callbacks.flush == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -232,6 +450,17 @@ dc_custom_purge (dc_iostream_t *abstract, dc_direction_t direction)
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	// Discard the queued writes and the buffered data.
+	if (direction & DC_DIRECTION_OUTPUT) {
+		custom->wsize = 0;
+		custom->wcount = 0;
+	}
+
+	if (direction & DC_DIRECTION_INPUT) {
+		custom->roffset = 0;
+		custom->ravailable = 0;
+	}
+
 	if (custom->callbacks.purge == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -243,6 +472,10 @@ dc_custom_sleep (dc_iostream_t *abstract, unsigned int milliseconds)
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
+	dc_status_t status = dc_custom_drain (custom);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
 	if (custom->callbacks.sleep == NULL)
 		return DC_STATUS_SUCCESS;
 
@@ -254,8 +487,13 @@ dc_custom_close (dc_iostream_t *abstract)
 {
 	dc_custom_t *custom = (dc_custom_t *) abstract;
 
-	if (custom->callbacks.close == NULL)
-		return DC_STATUS_SUCCESS;
+	dc_status_t status = dc_custom_drain (custom);
+
+	if (custom->callbacks.close) {
+		dc_status_t rc = custom->callbacks.close (custom->userdata);
+		if (status == DC_STATUS_SUCCESS)
+			status = rc;
+	}
 
-	return custom->callbacks.close (custom->userdata);
+	return status;
 }
@@ -81,6 +81,7 @@ static const dc_device_vtable_t deepblu_cosmiq_device_vtable = {
 	NULL, /* write */
 	NULL, /* dump */
 	deepblu_cosmiq_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	deepblu_cosmiq_device_timesync, /* timesync */
 	NULL, /* close */
 };
@@ -55,6 +55,7 @@ static const dc_parser_vtable_t deepblu_cosmiq_parser_vtable = {
 	deepblu_cosmiq_parser_get_datetime, /* datetime */
 	deepblu_cosmiq_parser_get_field, /* fields */
 	deepblu_cosmiq_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_foreach_fixed */
 	NULL /* destroy */
 };
 
@@ -83,6 +83,7 @@ static const dc_device_vtable_t deepsix_excursion_device_vtable = {
 	NULL, /* write */
 	NULL, /* dump */
 	deepsix_excursion_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	deepsix_excursion_device_timesync, /* timesync */
 	NULL, /* close */
 };
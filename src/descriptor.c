@@ -81,6 +81,24 @@ typedef struct dc_descriptor_iterator_t {
 	size_t current;
 } dc_descriptor_iterator_t;
 
+typedef struct dc_descriptor_usb_t {
+	unsigned int transport;
+	unsigned int vid;
+	unsigned int pid;
+	size_t index;
+} dc_descriptor_usb_t;
+
+typedef struct dc_descriptor_name_t {
+	unsigned int transport;
+	unsigned int first;
+	size_t index;
+} dc_descriptor_name_t;
+
+typedef struct dc_filter_probe_t {
+	unsigned int any;
+	unsigned char first[256 / 8];
+} dc_filter_probe_t;
+
 static const dc_iterator_vtable_t dc_descriptor_iterator_vtable = {
 	sizeof(dc_descriptor_iterator_t),
 	dc_descriptor_iterator_next,
@@ -94,7 +112,7 @@ static const dc_iterator_vtable_t dc_descriptor_iterator_vtable = {
  * actually used to identify individual models, identical values are assigned.
  */
 
-static const dc_descriptor_t g_descriptors[] = {
+static dc_descriptor_t g_descriptors[] = {
 	/* Suunto Solution */
 	{"Suunto", "Solution", DC_FAMILY_SUUNTO_SOLUTION, 0, DC_TRANSPORT_SERIAL, NULL},
 	/* Suunto Eon */
@@ -636,12 +654,60 @@ dc_match_halcyon (const void *key, const void *value)
 	return strncasecmp (str + 4, prefix + 1, 2) == 0;
 }
 
+/*
+ * The name index is built by calling each filter with the probe as the
+ * key. Instead of matching, the filter then reports the first character of
+ * all its name patterns. Patterns that can start with any character are
+ * reported as such.
+ */
+static dc_filter_probe_t g_filter_probe;
+
+static unsigned int
+dc_filter_fold (unsigned char c)
+{
+	if (c >= 'A' && c <= 'Z')
+		c += 'a' - 'A';
+
+	return c;
+}
+
+static void
+dc_filter_probe (const void *values, size_t count, size_t size, dc_match_t match)
+{
+	for (size_t i = 0; i < count; ++i) {
+		const void *value = (const unsigned char *) values + i * size;
+
+		unsigned int c = 0;
+		if (match == dc_match_name || match == dc_match_prefix ||
+			match == dc_match_prefix_with_number || match == dc_match_prefix_with_hex) {
+			c = dc_filter_fold (**(const char * const *) value);
+		} else if (match == dc_match_oceanic) {
+			c = dc_filter_fold ((*(const unsigned int *) value >> 8) & 0xFF);
+		} else if (match == dc_match_cressi) {
+			char prefix[16] = {0};
+			dc_platform_snprintf (prefix, sizeof (prefix), "%x_", *(const unsigned int *) value);
+			c = dc_filter_fold (prefix[0]);
+		}
+
+		if (c == 0) {
+			g_filter_probe.any = 1;
+		} else {
+			g_filter_probe.first[c / 8] |= 1 << (c % 8);
+		}
+	}
+}
+
 static int
 dc_filter_internal (const void *key, const void *values, size_t count, size_t size, dc_match_t match)
 {
 	if (key == NULL)
 		return 1;
 
+	if (key == &g_filter_probe) {
+		dc_filter_probe (values, count, size, match);
+		return count == 0;
+	}
+
 	for (size_t i = 0; i < count; ++i) {
 		if (match (key, (const unsigned char *) values + i * size)) {
 			return 1;
@@ -651,6 +717,29 @@ dc_filter_internal (const void *key, const void *values, size_t count, size_t si
 	return count == 0;
 }
 
+/*
+ * The usb tables are shared with the descriptor index, which needs the list
+ * of all known VID/PID pairs.
+ */
+
+static const dc_usbhid_desc_t g_usbhid_uwatec[] = {
+	{0x2e6c, 0x3201}, // G2, G2 TEK
+	{0x2e6c, 0x3211}, // G2 Console
+	{0x2e6c, 0x4201}, // G2 HUD
+	{0xc251, 0x2006}, // Aladin Square
+};
+
+static const dc_usbhid_desc_t g_usbhid_suunto[] = {
+	{0x1493, 0x0030}, // Eon Steel
+	{0x1493, 0x0033}, // Eon Core
+	{0x1493, 0x0035}, // D5
+	{0x1493, 0x0036}, // EON Steel Black
+};
+
+static const dc_usb_desc_t g_usb_atomic[] = {
+	{0x0471, 0x0888}, // Atomic Aquatics Cobalt
+};
+
 static int
 dc_filter_uwatec (const dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
@@ -663,12 +752,6 @@ dc_filter_uwatec (const dc_descriptor_t *descriptor, dc_transport_t transport, c
 		"UWATEC Galileo",
 		"UWATEC Galileo Sol",
 	};
-	static const dc_usbhid_desc_t usbhid[] = {
-		{0x2e6c, 0x3201}, // G2, G2 TEK
-		{0x2e6c, 0x3211}, // G2 Console
-		{0x2e6c, 0x4201}, // G2 HUD
-		{0xc251, 0x2006}, // Aladin Square
-	};
 	static const char * const bluetooth[] = {
 		"G2",
 		"Aladin",
@@ -684,7 +767,7 @@ dc_filter_uwatec (const dc_descriptor_t *descriptor, dc_transport_t transport, c
 	if (transport == DC_TRANSPORT_IRDA) {
 		return DC_FILTER_INTERNAL (userdata, irda, 0, dc_match_name);
 	} else if (transport == DC_TRANSPORT_USBHID) {
-		return DC_FILTER_INTERNAL (userdata, usbhid, 0, dc_match_usbhid);
+		return DC_FILTER_INTERNAL (userdata, g_usbhid_uwatec, 0, dc_match_usbhid);
 	} else if (transport == DC_TRANSPORT_BLE) {
 		return DC_FILTER_INTERNAL (userdata, bluetooth, 0, dc_match_name);
 	}
@@ -695,12 +778,6 @@ dc_filter_uwatec (const dc_descriptor_t *descriptor, dc_transport_t transport, c
 static int
 dc_filter_suunto (const dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
-	static const dc_usbhid_desc_t usbhid[] = {
-		{0x1493, 0x0030}, // Eon Steel
-		{0x1493, 0x0033}, // Eon Core
-		{0x1493, 0x0035}, // D5
-		{0x1493, 0x0036}, // EON Steel Black
-	};
 	static const char * const bluetooth[] = {
 		"EON Steel",
 		"EON Core",
@@ -709,7 +786,7 @@ dc_filter_suunto (const dc_descriptor_t *descriptor, dc_transport_t transport, c
 	};
 
 	if (transport == DC_TRANSPORT_USBHID) {
-		return DC_FILTER_INTERNAL (userdata, usbhid, 0, dc_match_usbhid);
+		return DC_FILTER_INTERNAL (userdata, g_usbhid_suunto, 0, dc_match_usbhid);
 	} else if (transport == DC_TRANSPORT_BLE) {
 		return DC_FILTER_INTERNAL (userdata, bluetooth, 0, dc_match_prefix);
 	}
@@ -857,12 +934,8 @@ dc_filter_mclean(const dc_descriptor_t *descriptor, dc_transport_t transport, co
 static int
 dc_filter_atomic (const dc_descriptor_t *descriptor, dc_transport_t transport, const void *userdata)
 {
-	static const dc_usb_desc_t usb[] = {
-		{0x0471, 0x0888}, // Atomic Aquatics Cobalt
-	};
-
 	if (transport == DC_TRANSPORT_USB) {
-		return DC_FILTER_INTERNAL (userdata, usb, 0, dc_match_usb);
+		return DC_FILTER_INTERNAL (userdata, g_usb_atomic, 0, dc_match_usb);
 	}
 
 	return 1;
@@ -1012,13 +1085,12 @@ dc_descriptor_iterator_next (dc_iterator_t *abstract, void *out)
 		return DC_STATUS_DONE;
 
 	/*
-	 * The explicit cast from a const to a non-const pointer is safe here. The
-	 * public interface doesn't support write access, and therefore descriptor
-	 * objects are always read-only. However, the cast allows to return a direct
-	 * reference to the entries in the table, avoiding the overhead of
-	 * allocating (and freeing) memory for a deep copy.
+	 * The public interface doesn't support write access, and therefore
+	 * descriptor objects are always read-only. Returning a direct reference
+	 * to the entries in the table avoids the overhead of allocating (and
+	 * freeing) memory for a deep copy.
 	 */
-	*item = (dc_descriptor_t *) &g_descriptors[iterator->current++];
+	*item = &g_descriptors[iterator->current++];
 
 	return DC_STATUS_SUCCESS;
 }
@@ -1088,3 +1160,330 @@ dc_descriptor_filter (const dc_descriptor_t *descriptor, dc_transport_t transpor
 
 	return descriptor->filter (descriptor, transport, userdata);
 }
+
+/*
+ * The descriptor index is built once, on first use. It maps the (family,
+ * model) pairs and the usb VID/PID pairs directly to the first matching
+ * entry in the descriptor table. Device names can't be enumerated in
+ * advance, because most filters match on a prefix or a pattern. Instead,
+ * the name index is sorted on the transport and the first character of the
+ * name, and lists the candidate entries for each character. The candidates
+ * are then checked with the filter. Entries that can match a name starting
+ * with any character are listed under NAME_ANY. The index values are stored
+ * with an offset of one, such that zero marks an empty slot.
+ */
+
+#define INDEX_MODEL_SIZE 1024
+#define INDEX_USB_SIZE   64
+#define INDEX_NAME_SIZE  1024
+
+#define NAME_ANY 256
+
+static dc_mutex_t g_index_mutex = DC_MUTEX_INIT;
+static unsigned int g_index_ready = 0;
+static size_t g_index_model[INDEX_MODEL_SIZE];
+static dc_descriptor_usb_t g_index_usb[INDEX_USB_SIZE];
+static size_t g_index_usb_any[2];
+static dc_descriptor_name_t g_index_name[INDEX_NAME_SIZE];
+static size_t g_index_name_count = 0;
+static unsigned int g_index_name_overflow = 0;
+
+static unsigned int
+dc_descriptor_hash (unsigned int hash, unsigned int value)
+{
+	/* FNV-1a hash, one byte at a time. */
+	for (unsigned int i = 0; i < 4; ++i) {
+		hash ^= (value >> (i * 8)) & 0xFF;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static size_t
+dc_descriptor_find (dc_transport_t transport, const void *userdata)
+{
+	for (size_t i = 0; i < C_ARRAY_SIZE (g_descriptors); ++i) {
+		if (dc_descriptor_filter (&g_descriptors[i], transport, userdata))
+			return i + 1;
+	}
+
+	return 0;
+}
+
+static void
+dc_descriptor_index_usb (dc_transport_t transport, unsigned int vid, unsigned int pid)
+{
+	dc_usb_desc_t usb = {vid, pid};
+	dc_usbhid_desc_t usbhid = {vid, pid};
+
+	size_t index = dc_descriptor_find (transport,
+		transport == DC_TRANSPORT_USB ? (const void *) &usb : (const void *) &usbhid);
+	if (index == 0)
+		return;
+
+	unsigned int hash = dc_descriptor_hash (dc_descriptor_hash (dc_descriptor_hash (2166136261u, transport), vid), pid);
+	for (unsigned int i = 0; i < INDEX_USB_SIZE; ++i) {
+		dc_descriptor_usb_t *entry = &g_index_usb[(hash + i) % INDEX_USB_SIZE];
+		if (entry->index == 0) {
+			entry->transport = transport;
+			entry->vid = vid;
+			entry->pid = pid;
+			entry->index = index;
+			return;
+		}
+
+		if (entry->transport == transport && entry->vid == vid && entry->pid == pid)
+			return;
+	}
+}
+
+static int
+dc_descriptor_name_cmp (const void *a, const void *b)
+{
+	const dc_descriptor_name_t *x = (const dc_descriptor_name_t *) a;
+	const dc_descriptor_name_t *y = (const dc_descriptor_name_t *) b;
+
+	if (x->transport != y->transport)
+		return x->transport < y->transport ? -1 : 1;
+	if (x->first != y->first)
+		return x->first < y->first ? -1 : 1;
+	if (x->index != y->index)
+		return x->index < y->index ? -1 : 1;
+
+	return 0;
+}
+
+static void
+dc_descriptor_index_name (dc_transport_t transport, unsigned int first, size_t index)
+{
+	if (g_index_name_count == INDEX_NAME_SIZE) {
+		g_index_name_overflow = 1;
+		return;
+	}
+
+	dc_descriptor_name_t *entry = &g_index_name[g_index_name_count++];
+	entry->transport = transport;
+	entry->first = first;
+	entry->index = index;
+}
+
+static void
+dc_descriptor_index_names (void)
+{
+	const dc_transport_t transports[] = {
+		DC_TRANSPORT_SERIAL,
+		DC_TRANSPORT_IRDA,
+		DC_TRANSPORT_BLUETOOTH,
+		DC_TRANSPORT_BLE,
+	};
+
+	for (size_t t = 0; t < C_ARRAY_SIZE (transports); ++t) {
+		dc_transport_t transport = transports[t];
+
+		for (size_t i = 0; i < C_ARRAY_SIZE (g_descriptors); ++i) {
+			const dc_descriptor_t *descriptor = &g_descriptors[i];
+			if ((descriptor->transports & transport) == 0)
+				continue;
+
+			memset (&g_filter_probe, 0, sizeof (g_filter_probe));
+			int all = descriptor->filter == NULL ||
+				descriptor->filter (descriptor, transport, &g_filter_probe);
+
+			if (all || g_filter_probe.any) {
+				dc_descriptor_index_name (transport, NAME_ANY, i + 1);
+				// The entries after one that matches all names are
+				// never returned.
+				if (all)
+					break;
+				continue;
+			}
+
+			for (unsigned int c = 0; c < NAME_ANY; ++c) {
+				if (g_filter_probe.first[c / 8] & (1 << (c % 8)))
+					dc_descriptor_index_name (transport, c, i + 1);
+			}
+		}
+	}
+
+	qsort (g_index_name, g_index_name_count, sizeof (dc_descriptor_name_t), dc_descriptor_name_cmp);
+}
+
+static void
+dc_descriptor_index_build (void)
+{
+	for (size_t i = 0; i < C_ARRAY_SIZE (g_descriptors); ++i) {
+		const dc_descriptor_t *descriptor = &g_descriptors[i];
+
+		unsigned int hash = dc_descriptor_hash (dc_descriptor_hash (2166136261u, descriptor->type), descriptor->model);
+		for (unsigned int j = 0; j < INDEX_MODEL_SIZE; ++j) {
+			size_t *slot = &g_index_model[(hash + j) % INDEX_MODEL_SIZE];
+			if (*slot == 0) {
+				*slot = i + 1;
+				break;
+			}
+
+			// Keep the first entry for duplicate model numbers.
+			const dc_descriptor_t *entry = &g_descriptors[*slot - 1];
+			if (entry->type == descriptor->type && entry->model == descriptor->model)
+				break;
+		}
+	}
+
+	for (size_t i = 0; i < C_ARRAY_SIZE (g_usbhid_uwatec); ++i)
+		dc_descriptor_index_usb (DC_TRANSPORT_USBHID, g_usbhid_uwatec[i].vid, g_usbhid_uwatec[i].pid);
+	for (size_t i = 0; i < C_ARRAY_SIZE (g_usbhid_suunto); ++i)
+		dc_descriptor_index_usb (DC_TRANSPORT_USBHID, g_usbhid_suunto[i].vid, g_usbhid_suunto[i].pid);
+	for (size_t i = 0; i < C_ARRAY_SIZE (g_usb_atomic); ++i)
+		dc_descriptor_index_usb (DC_TRANSPORT_USB, g_usb_atomic[i].vid, g_usb_atomic[i].pid);
+
+	// Descriptors without a VID/PID filter match any usb device.
+	const dc_usb_desc_t usb = {0, 0};
+	const dc_usbhid_desc_t usbhid = {0, 0};
+	g_index_usb_any[0] = dc_descriptor_find (DC_TRANSPORT_USB, &usb);
+	g_index_usb_any[1] = dc_descriptor_find (DC_TRANSPORT_USBHID, &usbhid);
+
+	dc_descriptor_index_names ();
+}
+
+static void
+dc_descriptor_index_init (void)
+{
+	dc_mutex_lock (&g_index_mutex);
+	if (!g_index_ready) {
+		dc_descriptor_index_build ();
+		g_index_ready = 1;
+	}
+	dc_mutex_unlock (&g_index_mutex);
+}
+
+dc_status_t
+dc_descriptor_lookup_by_model (dc_descriptor_t **out, dc_family_t family, unsigned int model)
+{
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_descriptor_index_init ();
+
+	unsigned int hash = dc_descriptor_hash (dc_descriptor_hash (2166136261u, family), model);
+	for (unsigned int i = 0; i < INDEX_MODEL_SIZE; ++i) {
+		size_t slot = g_index_model[(hash + i) % INDEX_MODEL_SIZE];
+		if (slot == 0)
+			break;
+
+		dc_descriptor_t *descriptor = &g_descriptors[slot - 1];
+		if (descriptor->type == family && descriptor->model == model) {
+			*out = descriptor;
+			return DC_STATUS_SUCCESS;
+		}
+	}
+
+	return DC_STATUS_UNSUPPORTED;
+}
+
+dc_status_t
+dc_descriptor_lookup_by_usb (dc_descriptor_t **out, dc_transport_t transport, unsigned int vid, unsigned int pid)
+{
+	if (out == NULL || (transport != DC_TRANSPORT_USB && transport != DC_TRANSPORT_USBHID))
+		return DC_STATUS_INVALIDARGS;
+
+	dc_descriptor_index_init ();
+
+	size_t index = g_index_usb_any[transport == DC_TRANSPORT_USBHID];
+
+	unsigned int hash = dc_descriptor_hash (dc_descriptor_hash (dc_descriptor_hash (2166136261u, transport), vid), pid);
+	for (unsigned int i = 0; i < INDEX_USB_SIZE; ++i) {
+		const dc_descriptor_usb_t *entry = &g_index_usb[(hash + i) % INDEX_USB_SIZE];
+		if (entry->index == 0)
+			break;
+
+		if (entry->transport == transport && entry->vid == vid && entry->pid == pid) {
+			if (index == 0 || entry->index < index)
+				index = entry->index;
+			break;
+		}
+	}
+
+	if (index == 0)
+		return DC_STATUS_UNSUPPORTED;
+
+	*out = &g_descriptors[index - 1];
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Find the range of candidates in the name index, with a binary search.
+ */
+static const dc_descriptor_name_t *
+dc_descriptor_index_range (dc_transport_t transport, unsigned int first, size_t *count)
+{
+	const dc_descriptor_name_t key = {transport, first, 0};
+
+	size_t lo = 0, hi = g_index_name_count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (dc_descriptor_name_cmp (&g_index_name[mid], &key) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	size_t n = 0;
+	while (lo + n < g_index_name_count &&
+		g_index_name[lo + n].transport == transport &&
+		g_index_name[lo + n].first == first) {
+		n++;
+	}
+
+	*count = n;
+
+	return g_index_name + lo;
+}
+
+dc_status_t
+dc_descriptor_lookup_by_name (dc_descriptor_t **out, dc_transport_t transport, const char *name)
+{
+	if (out == NULL || name == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (transport != DC_TRANSPORT_SERIAL && transport != DC_TRANSPORT_IRDA &&
+		transport != DC_TRANSPORT_BLUETOOTH && transport != DC_TRANSPORT_BLE)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_descriptor_index_init ();
+
+	size_t index = 0;
+	if (g_index_name_overflow) {
+		index = dc_descriptor_find (transport, name);
+	} else {
+		// Check the candidates for the first character, and those for any
+		// character, in the order of the descriptor table.
+		size_t na = 0, nb = 0;
+		const dc_descriptor_name_t *a = dc_descriptor_index_range (transport, dc_filter_fold (name[0]), &na);
+		const dc_descriptor_name_t *b = dc_descriptor_index_range (transport, NAME_ANY, &nb);
+
+		size_t i = 0, j = 0;
+		while (i < na || j < nb) {
+			size_t candidate = 0;
+			if (j == nb || (i < na && a[i].index < b[j].index)) {
+				candidate = a[i++].index;
+			} else {
+				candidate = b[j++].index;
+			}
+
+			if (dc_descriptor_filter (&g_descriptors[candidate - 1], transport, name)) {
+				index = candidate;
+				break;
+			}
+		}
+	}
+
+	if (index == 0)
+		return DC_STATUS_UNSUPPORTED;
+
+	*out = &g_descriptors[index - 1];
+
+	return DC_STATUS_SUCCESS;
+}
@@ -37,8 +37,10 @@ extern "C" {
 
 struct dc_device_t;
 struct dc_device_vtable_t;
+struct dc_device_step_t;
 
 typedef struct dc_device_vtable_t dc_device_vtable_t;
+typedef struct dc_device_step_t dc_device_step_t;
 
 struct dc_device_t {
 	const dc_device_vtable_t *vtable;
@@ -54,6 +56,8 @@ struct dc_device_t {
 	// Cached events for the parsers.
 	dc_event_devinfo_t devinfo;
 	dc_event_clock_t clock;
+	// Resumable download support.
+	dc_device_step_t *step;
 };
 
 struct dc_device_vtable_t {
@@ -71,6 +75,8 @@ struct dc_device_vtable_t {
 
 	dc_status_t (*foreach) (dc_device_t *device, dc_dive_callback_t callback, void *userdata);
 
+	dc_status_t (*foreach_step) (dc_device_t *device, dc_dive_callback_t callback, void *userdata);
+
 	dc_status_t (*timesync) (dc_device_t *device, const dc_datetime_t *datetime);
 
 	dc_status_t (*close) (dc_device_t *device);
@@ -92,7 +98,7 @@ int
 device_is_cancelled (dc_device_t *device);
 
 dc_status_t
-device_dump_read (dc_device_t *device, unsigned int address, unsigned char data[], unsigned int size, unsigned int blocksize);
+device_dump_read (dc_device_t *device, unsigned int address, unsigned char data[], unsigned int size, unsigned int minsize, unsigned int maxsize);
 
 #ifdef __cplusplus
 }
@@ -70,6 +70,11 @@
 
 #include "device-private.h"
 #include "context-private.h"
+#include "timer.h"
+#include "platform.h"
+
+#define MINBLOCKS 16
+#define MAXBLOCKS 256
 
 dc_device_t *
 dc_device_allocate (dc_context_t *context, const dc_device_vtable_t *vtable)
@@ -100,6 +105,8 @@ dc_device_allocate (dc_context_t *context, const dc_device_vtable_t *vtable)
 	memset (&device->devinfo, 0, sizeof (device->devinfo));
 	memset (&device->clock, 0, sizeof (device->clock));
 
+	device->step = NULL;
+
 	return device;
 }
 
@@ -367,8 +374,27 @@ dc_device_dump (dc_device_t *device, dc_buffer_t *buffer)
 }
 
 
+static void
+device_dump_stats (dc_device_t *device, dc_timer_t *timer, dc_usecs_t begin, unsigned int blocksize, unsigned int nbytes, unsigned int nerrors)
+{
+	dc_event_stats_t stats;
+	dc_usecs_t now = begin;
+
+	if (timer)
+		dc_timer_now (timer, &now);
+
+	dc_usecs_t elapsed = now - begin;
+
+	stats.blocksize = blocksize;
+	stats.nbytes = nbytes;
+	stats.elapsed = elapsed / 1000;
+	stats.throughput = elapsed ? (unsigned int) (nbytes * 1000000ULL / elapsed) : 0;
+	stats.nerrors = nerrors;
+	device_event_emit (device, DC_EVENT_STATS, &stats);
+}
+
 dc_status_t
-device_dump_read (dc_device_t *device, unsigned int address, unsigned char data[], unsigned int size, unsigned int blocksize)
+device_dump_read (dc_device_t *device, unsigned int address, unsigned char data[], unsigned int size, unsigned int minsize, unsigned int maxsize)
 {
 	if (device == NULL)
 		return DC_STATUS_UNSUPPORTED;
@@ -376,11 +402,35 @@ device_dump_read (dc_device_t *device, unsigned int address, unsigned char data[
 	if (device->vtable->read == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
+	if (minsize == 0 || maxsize < minsize)
+		return DC_STATUS_INVALIDARGS;
+
+	// Without a timer, the statistics are reported without timing
+	// information.
+	dc_timer_t *timer = NULL;
+	dc_timer_new (&timer);
+
+	dc_usecs_t begin = 0;
+	if (timer)
+		dc_timer_now (timer, &begin);
+
 	// Enable progress notifications.
 	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
 	progress.maximum = size;
 	device_event_emit (device, DC_EVENT_PROGRESS, &progress);
 
+	// The maximum block size is the largest request the backend sends
+	// as a single packet, so the block size always ends up on the wire.
+	// The transfer starts at the maximum, and the block size is reduced
+	// after a failed block. Once enough blocks succeeded in a row, it
+	// is increased again. Every failure at the same block size doubles
+	// the number of blocks needed, to avoid oscillating on a marginal
+	// link.
+	dc_status_t status = DC_STATUS_SUCCESS;
+	unsigned int blocksize = maxsize;
+	unsigned int threshold = MINBLOCKS;
+	unsigned int nblocks = 0;
+	unsigned int nerrors = 0;
 	unsigned int nbytes = 0;
 	while (nbytes < size) {
 		// Calculate the packet size.
@@ -389,18 +439,49 @@ device_dump_read (dc_device_t *device, unsigned int address, unsigned char data[
 			len = blocksize;
 
 		// Read the packet.
-		dc_status_t rc = device->vtable->read (device, address + nbytes, data + nbytes, len);
-		if (rc != DC_STATUS_SUCCESS)
-			return rc;
+		status = device->vtable->read (device, address + nbytes, data + nbytes, len);
+		if (status != DC_STATUS_SUCCESS) {
+			if ((status != DC_STATUS_TIMEOUT && status != DC_STATUS_PROTOCOL) ||
+				blocksize == minsize || device_is_cancelled (device))
+				break;
+
+			// Retry the same block with a smaller block size.
+			blocksize /= 2;
+			if (blocksize < minsize)
+				blocksize = minsize;
+			if (threshold < MAXBLOCKS)
+				threshold *= 2;
+			nblocks = 0;
+			nerrors++;
+			WARNING (device->context, "Read failed, reducing the block size to %u bytes.", blocksize);
+			device_dump_stats (device, timer, begin, blocksize, nbytes, nerrors);
+			status = DC_STATUS_SUCCESS;
+			continue;
+		}
 
 		// Update and emit a progress event.
 		progress.current += len;
 		device_event_emit (device, DC_EVENT_PROGRESS, &progress);
 
 		nbytes += len;
+
+		// Increase the block size again after a run of successful blocks.
+		if (blocksize < maxsize && ++nblocks >= threshold) {
+			blocksize *= 2;
+			if (blocksize > maxsize)
+				blocksize = maxsize;
+			nblocks = 0;
+			device_dump_stats (device, timer, begin, blocksize, nbytes, nerrors);
+		}
 	}
 
-	return DC_STATUS_SUCCESS;
+	if (status == DC_STATUS_SUCCESS) {
+		device_dump_stats (device, timer, begin, blocksize, nbytes, nerrors);
+	}
+
+	dc_timer_free (timer);
+
+	return status;
 }
 
 
@@ -416,6 +497,264 @@ dc_device_foreach (dc_device_t *device, dc_dive_callback_t callback, void *userd
 	return device->vtable->foreach (device, callback, userdata);
 }
 
+/*
+ * Resumable downloads.
+ *
+ * Backends with a native implementation keep their own download state,
+ * and each step performs only a small part of the download. The
+ * wakeup signal is set as long as more steps are needed.
+ *
+ * For all other backends, the regular foreach function runs on a helper
+ * thread, and each dive is handed over to the thread calling
+ * dc_device_foreach_step(). The helper thread waits until the dive
+ * callback has been called, such that the return value can be passed
+ * back, and only a single dive is buffered.
+ */
+struct dc_device_step_t {
+	dc_device_t *device;
+	dc_thread_t *thread;
+	dc_signal_t *ready;
+	dc_signal_t *resume;
+	dc_mutex_t mutex;
+	// Shared state, protected by the mutex.
+	dc_buffer_t *data;
+	dc_buffer_t *fingerprint;
+	unsigned int available;
+	unsigned int finished;
+	unsigned int abort;
+	int result;
+	dc_status_t status;
+};
+
+static int
+dc_device_step_dive (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
+{
+	dc_device_step_t *step = (dc_device_step_t *) userdata;
+
+	dc_mutex_lock (&step->mutex);
+	if (step->abort) {
+		dc_mutex_unlock (&step->mutex);
+		return 0;
+	}
+	dc_buffer_clear (step->data);
+	dc_buffer_clear (step->fingerprint);
+	if (!dc_buffer_append (step->data, data, size) ||
+		!dc_buffer_append (step->fingerprint, fingerprint, fsize)) {
+		ERROR (step->device->context, "Insufficient buffer space available.");
+		step->status = DC_STATUS_NOMEMORY;
+		dc_mutex_unlock (&step->mutex);
+		return 0;
+	}
+	step->available = 1;
+	dc_mutex_unlock (&step->mutex);
+
+	// Wait until the dive has been consumed.
+	dc_signal_set (step->ready);
+	dc_signal_wait (step->resume);
+
+	dc_mutex_lock (&step->mutex);
+	int result = step->result && !step->abort;
+	dc_mutex_unlock (&step->mutex);
+
+	return result;
+}
+
+static void
+dc_device_step_main (void *userdata)
+{
+	dc_device_step_t *step = (dc_device_step_t *) userdata;
+
+	dc_status_t status = step->device->vtable->foreach (step->device, dc_device_step_dive, step);
+
+	dc_mutex_lock (&step->mutex);
+	if (step->status == DC_STATUS_SUCCESS)
+		step->status = status;
+	step->finished = 1;
+	dc_mutex_unlock (&step->mutex);
+
+	dc_signal_set (step->ready);
+}
+
+static void
+dc_device_step_free (dc_device_step_t *step)
+{
+	if (step == NULL)
+		return;
+
+	dc_mutex_destroy (&step->mutex);
+	dc_signal_free (step->resume);
+	dc_signal_free (step->ready);
+	dc_buffer_free (step->fingerprint);
+	dc_buffer_free (step->data);
+	free (step);
+}
+
+static dc_status_t
+dc_device_step_new (dc_device_step_t **out, dc_device_t *device, unsigned int native)
+{
+	dc_device_step_t *step = (dc_device_step_t *) malloc (sizeof (dc_device_step_t));
+	if (step == NULL) {
+		ERROR (device->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	step->device = device;
+	step->thread = NULL;
+	step->ready = NULL;
+	step->resume = NULL;
+	step->data = dc_buffer_new (0);
+	step->fingerprint = dc_buffer_new (0);
+	step->available = 0;
+	step->finished = 0;
+	step->abort = 0;
+	step->result = 1;
+	step->status = DC_STATUS_SUCCESS;
+	dc_mutex_init (&step->mutex);
+
+	if (step->data == NULL || step->fingerprint == NULL ||
+		dc_signal_new (&step->ready) != 0 ||
+		dc_signal_new (&step->resume) != 0) {
+		ERROR (device->context, "Failed to allocate memory.");
+		dc_device_step_free (step);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	// The helper thread can access the state through the device.
+	*out = step;
+
+	if (native)
+		return DC_STATUS_SUCCESS;
+
+	if (dc_thread_new (&step->thread, dc_device_step_main, step) != 0) {
+		ERROR (device->context, "Failed to create the download thread.");
+		dc_device_step_free (step);
+		*out = NULL;
+		return DC_STATUS_IO;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_device_step_finish (dc_device_step_t *step)
+{
+	if (step->thread)
+		dc_thread_join (step->thread);
+
+	dc_status_t status = step->status;
+
+	dc_device_step_free (step);
+
+	return status;
+}
+
+static void
+dc_device_step_abort (dc_device_step_t *step)
+{
+	dc_mutex_lock (&step->mutex);
+	step->abort = 1;
+	dc_mutex_unlock (&step->mutex);
+
+	dc_signal_set (step->resume);
+
+	dc_device_step_finish (step);
+}
+
+dc_status_t
+dc_device_foreach_step (dc_device_t *device, dc_dive_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (device->vtable->foreach_step) {
+		if (device->step == NULL) {
+			status = dc_device_step_new (&device->step, device, 1);
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+		}
+
+		dc_signal_clear (device->step->ready);
+
+		status = device->vtable->foreach_step (device, callback, userdata);
+		if (status == DC_STATUS_WOULDBLOCK) {
+			dc_signal_set (device->step->ready);
+			return status;
+		}
+
+		dc_device_step_free (device->step);
+		device->step = NULL;
+
+		return status;
+	}
+
+	if (device->vtable->foreach == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	dc_device_step_t *step = device->step;
+	if (step == NULL) {
+		status = dc_device_step_new (&device->step, device, 0);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		return DC_STATUS_WOULDBLOCK;
+	}
+
+	dc_signal_clear (step->ready);
+
+	dc_mutex_lock (&step->mutex);
+	unsigned int available = step->available;
+	unsigned int finished = step->finished;
+	step->available = 0;
+	dc_mutex_unlock (&step->mutex);
+
+	if (available) {
+		// The helper thread is waiting, so the buffers can be accessed
+		// without holding the lock.
+		int result = 1;
+		if (callback) {
+			result = callback (
+				dc_buffer_get_data (step->data), dc_buffer_get_size (step->data),
+				dc_buffer_get_data (step->fingerprint), dc_buffer_get_size (step->fingerprint),
+				userdata);
+		}
+
+		dc_mutex_lock (&step->mutex);
+		step->result = result;
+		dc_mutex_unlock (&step->mutex);
+
+		dc_signal_set (step->resume);
+
+		return DC_STATUS_WOULDBLOCK;
+	}
+
+	if (!finished)
+		return DC_STATUS_WOULDBLOCK;
+
+	device->step = NULL;
+
+	return dc_device_step_finish (step);
+}
+
+dc_status_t
+dc_device_get_pollfd (dc_device_t *device, dc_pollfd_t *pollfd)
+{
+	if (device == NULL || device->step == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	int fd = dc_signal_get_fd (device->step->ready);
+	if (fd < 0)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (pollfd) {
+		pollfd->fd = fd;
+		pollfd->events = DC_POLL_IN;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
 
 dc_status_t
 dc_device_timesync (dc_device_t *device, const dc_datetime_t *datetime)
@@ -441,6 +780,12 @@ dc_device_close (dc_device_t *device)
 	if (device == NULL)
 		return DC_STATUS_SUCCESS;
 
+	// Stop an unfinished download.
+	if (device->step) {
+		dc_device_step_abort (device->step);
+		device->step = NULL;
+	}
+
 	// Disable the cancellation callback.
 	device->cancel_callback = NULL;
 	device->cancel_userdata = NULL;
@@ -476,6 +821,9 @@ device_event_emit (dc_device_t *device, dc_event_type_t event, const void *data)
 	case DC_EVENT_CLOCK:
 		assert (data != NULL);
 		break;
+	case DC_EVENT_STATS:
+		assert (data != NULL);
+		break;
 	default:
 		break;
 	}
@@ -513,6 +861,14 @@ device_is_cancelled (dc_device_t *device)
 	if (device == NULL)
 		return 0;
 
+	if (device->step) {
+		dc_mutex_lock (&device->step->mutex);
+		unsigned int aborted = device->step->abort;
+		dc_mutex_unlock (&device->step->mutex);
+		if (aborted)
+			return 1;
+	}
+
 	if (device->cancel_callback == NULL)
 		return 0;
 
@@ -86,6 +86,7 @@ static const dc_device_vtable_t divesoft_freedom_device_vtable = {
 	NULL, /* write */
 	NULL, /* dump */
 	divesoft_freedom_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	NULL, /* timesync */
 	divesoft_freedom_device_close, /* close */
 };
@@ -270,6 +270,7 @@ static const dc_parser_vtable_t divesoft_freedom_parser_vtable = {
 	divesoft_freedom_parser_get_datetime, /* datetime */
 	divesoft_freedom_parser_get_field, /* fields */
 	divesoft_freedom_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_foreach_fixed */
 	NULL /* destroy */
 };
 
@@ -21,7 +21,6 @@
 
 #include <string.h> // memcmp, memcpy
 #include <stdlib.h> // malloc, free
-#include <stdio.h>
 
 #include "divesystem_idive.h"
 #include "context-private.h"
@@ -30,6 +29,7 @@
 #include "checksum.h"
 #include "array.h"
 #include "packet.h"
+#include "transaction.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &divesystem_idive_device_vtable)
 
@@ -96,6 +96,7 @@ typedef struct divesystem_idive_signature_t {
 typedef struct divesystem_idive_device_t {
 	dc_device_t base;
 	dc_iostream_t *iostream;
+	dc_transaction_t transaction;
 	unsigned char fingerprint[4];
 	unsigned int model;
 } divesystem_idive_device_t;
@@ -113,6 +114,7 @@ static const dc_device_vtable_t divesystem_idive_device_vtable = {
 	NULL, /* write */
 	NULL, /* dump */
 	divesystem_idive_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	divesystem_idive_device_timesync, /* timesync */
 	divesystem_idive_device_close /* close */
 };
@@ -195,6 +197,9 @@ divesystem_idive_device_open (dc_device_t **out, dc_context_t *context, dc_iostr
 		goto error_free_iostream;
 	}
 
+	// Retry failed transfers, with a short delay.
+	dc_transaction_init (&device->transaction, (dc_device_t *) device, device->iostream, MAXRETRIES, 100, 0);
+
 	// Make sure everything is in a sane state.
 	dc_iostream_sleep (device->iostream, 300);
 	dc_iostream_purge (device->iostream, DC_DIRECTION_ALL);
@@ -399,33 +404,41 @@ error:
 }
 
 
+typedef struct divesystem_idive_transfer_t {
+	const unsigned char *command;
+	unsigned int csize;
+	unsigned char *answer;
+	unsigned int asize;
+	unsigned int errcode;
+} divesystem_idive_transfer_t;
+
 static dc_status_t
-divesystem_idive_transfer (divesystem_idive_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize, unsigned int *errorcode)
+divesystem_idive_transfer_attempt (dc_transaction_t *transaction, unsigned int attempt, void *userdata)
 {
-	dc_status_t status = DC_STATUS_SUCCESS;
-	unsigned int errcode = 0;
+	divesystem_idive_transfer_t *transfer = (divesystem_idive_transfer_t *) userdata;
+	divesystem_idive_device_t *device = (divesystem_idive_device_t *) transaction->device;
 
-	unsigned int nretries = 0;
-	while ((status = divesystem_idive_packet (device, command, csize, answer, asize, &errcode)) != DC_STATUS_SUCCESS) {
-		// Automatically discard a corrupted packet,
-		// and request a new one.
-		if (status != DC_STATUS_PROTOCOL && status != DC_STATUS_TIMEOUT)
-			break;
+	transfer->errcode = 0;
 
+	dc_status_t status = divesystem_idive_packet (device, transfer->command, transfer->csize, transfer->answer, transfer->asize, &transfer->errcode);
+	if (status != DC_STATUS_SUCCESS) {
 		// Abort if the device reports a fatal error.
-		if (errcode && errcode != ERR_BUSY)
-			break;
+		if (transfer->errcode && transfer->errcode != ERR_BUSY)
+			dc_transaction_abort (transaction);
+	}
 
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
-			break;
+	return status;
+}
 
-		// Delay the next attempt.
-		dc_iostream_sleep (device->iostream, 100);
-	}
+static dc_status_t
+divesystem_idive_transfer (divesystem_idive_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize, unsigned int *errorcode)
+{
+	divesystem_idive_transfer_t transfer = {command, csize, answer, asize, 0};
+
+	dc_status_t status = dc_transaction_run (&device->transaction, divesystem_idive_transfer_attempt, &transfer);
 
 	if (errorcode) {
-		*errorcode = errcode;
+		*errorcode = transfer.errcode;
 	}
 
 	return status;
@@ -707,43 +720,21 @@ static dc_status_t
 divesystem_idive_firmware_readfile (dc_buffer_t *buffer, dc_context_t *context, const char *filename)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
-	dc_buffer_t *tmp = NULL;
-	FILE *fp = NULL;
+	dc_filemap_t *filemap = NULL;
 
 	if (!dc_buffer_clear (buffer)) {
 		ERROR (context, "Invalid arguments.");
 		return DC_STATUS_INVALIDARGS;
 	}
 
-	// Allocate a temporary buffer.
-	tmp = dc_buffer_new (0x20000);
-	if (tmp == NULL) {
-		ERROR (context, "Failed to allocate memory.");
-		status = DC_STATUS_NOMEMORY;
-		goto error_exit;
-	}
-
 	// Open the file.
-	fp = fopen (filename, "rb");
-	if (fp == NULL) {
+	if (dc_filemap_open (&filemap, filename) != 0) {
 		ERROR (context, "Failed to open the file.");
-		status = DC_STATUS_IO;
-		goto error_free;
-	}
-
-	// Read the entire file into the buffer.
-	size_t n = 0;
-	unsigned char block[4096] = {0};
-	while ((n = fread (block, 1, sizeof (block), fp)) > 0) {
-		if (!dc_buffer_append (tmp, block, n)) {
-			ERROR (context, "Insufficient buffer space available.");
-			status = DC_STATUS_NOMEMORY;
-			goto error_close;
-		}
+		return DC_STATUS_IO;
 	}
 
 	// Resize the output buffer.
-	size_t nbytes = dc_buffer_get_size (tmp);
+	size_t nbytes = dc_filemap_get_size (filemap);
 	if (!dc_buffer_resize (buffer, nbytes / 2)) {
 		ERROR (context, "Insufficient buffer space available.");
 		status = DC_STATUS_NOMEMORY;
@@ -752,7 +743,7 @@ divesystem_idive_firmware_readfile (dc_buffer_t *buffer, dc_context_t *context,
 
 	// Convert to binary data.
 	int rc = array_convert_hex2bin (
-		dc_buffer_get_data (tmp), dc_buffer_get_size (tmp),
+		dc_filemap_get_data (filemap), nbytes,
 		dc_buffer_get_data (buffer), dc_buffer_get_size (buffer));
 	if (rc != 0) {
 		ERROR (context, "Unexpected data format.");
@@ -761,10 +752,7 @@ divesystem_idive_firmware_readfile (dc_buffer_t *buffer, dc_context_t *context,
 	}
 
 error_close:
-	fclose (fp);
-error_free:
-	dc_buffer_free (tmp);
-error_exit:
+	dc_filemap_close (filemap);
 	return status;
 }
 
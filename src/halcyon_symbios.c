@@ -84,6 +84,7 @@ static const dc_device_vtable_t halcyon_symbios_device_vtable = {
 	NULL, /* write */
 	NULL, /* dump */
 	halcyon_symbios_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	halcyon_symbios_device_timesync, /* timesync */
 	NULL, /* close */
 };
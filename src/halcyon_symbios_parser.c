@@ -124,6 +124,7 @@ static const dc_parser_vtable_t halcyon_symbios_parser_vtable = {
 	halcyon_symbios_parser_get_datetime, /* datetime */
 	halcyon_symbios_parser_get_field, /* fields */
 	halcyon_symbios_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_foreach_fixed */
 	NULL /* destroy */
 };
 
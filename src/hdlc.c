@@ -23,6 +23,7 @@
 
 #include "hdlc.h"
 
+#include "ble-private.h"
 #include "iostream-private.h"
 #include "common-private.h"
 #include "context-private.h"
@@ -38,6 +39,7 @@ static dc_status_t dc_hdlc_set_rts (dc_iostream_t *abstract, unsigned int value)
 static dc_status_t dc_hdlc_get_lines (dc_iostream_t *abstract, unsigned int *value);
 static dc_status_t dc_hdlc_configure (dc_iostream_t *abstract, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol);
 static dc_status_t dc_hdlc_poll (dc_iostream_t *abstract, int timeout);
+static dc_status_t dc_hdlc_get_pollfd (dc_iostream_t *abstract, dc_pollfd_t pollfd[], size_t size, size_t *actual);
 static dc_status_t dc_hdlc_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual);
 static dc_status_t dc_hdlc_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *actual);
 static dc_status_t dc_hdlc_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size);
@@ -71,6 +73,7 @@ static const dc_iostream_vtable_t dc_hdlc_vtable = {
 	NULL, /* get_available */
 	dc_hdlc_configure, /* configure */
 	dc_hdlc_poll, /* poll */
+	dc_hdlc_get_pollfd, /* get_pollfd */
 	dc_hdlc_read, /* read */
 	dc_hdlc_write, /* write */
 	dc_hdlc_ioctl, /* ioctl */
@@ -94,6 +97,9 @@ dc_hdlc_open (dc_iostream_t **out, dc_context_t *context, dc_iostream_t *base, s
 
 	dc_transport_t transport = dc_iostream_get_transport (base);
 
+	// Use the full payload size of the BLE connection.
+	dc_ble_packetsize (base, context, &isize, &osize);
+
 	// Allocate memory.
 	hdlc = (dc_hdlc_t *) dc_iostream_allocate (NULL, &dc_hdlc_vtable, transport);
 	if (hdlc == NULL) {
@@ -198,6 +204,14 @@ dc_hdlc_poll (dc_iostream_t *abstract, int timeout)
 	return dc_iostream_poll (hdlc->iostream, timeout);
 }
 
+static dc_status_t
+dc_hdlc_get_pollfd (dc_iostream_t *abstract, dc_pollfd_t pollfd[], size_t size, size_t *actual)
+{
+	dc_hdlc_t *hdlc = (dc_hdlc_t *) abstract;
+
+	return dc_iostream_get_pollfd (hdlc->iostream, pollfd, size, actual);
+}
+
 static dc_status_t
 dc_hdlc_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual)
 {
@@ -22,7 +22,6 @@
 
 #include <string.h> // memcmp, memcpy
 #include <stdlib.h> // malloc, free
-#include <stdio.h>  // FILE, fopen
 
 #include "hw_ostc3.h"
 #include "context-private.h"
@@ -31,6 +30,7 @@
 #include "aes.h"
 #include "platform.h"
 #include "packet.h"
+#include "timer.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &hw_ostc3_device_vtable)
 
@@ -90,6 +90,8 @@
 #define NODELAY 0
 #define TIMEOUT 400
 
+#define DISPLAY_INTERVAL 250000 // 250 ms
+
 #define HDR_COMPACT_LENGTH   0 // 3 bytes
 #define HDR_COMPACT_SUMMARY  3 // 10 bytes
 #define HDR_COMPACT_NUMBER  13 // 2 bytes
@@ -110,6 +112,26 @@ typedef enum hw_ostc3_state_t {
 	REBOOTING,
 } hw_ostc3_state_t;
 
+typedef struct hw_ostc3_logbook_t {
+	unsigned int size;
+	unsigned int profile;
+	unsigned int fingerprint;
+	unsigned int number;
+	unsigned int version;
+} hw_ostc3_logbook_t;
+
+typedef struct hw_ostc3_download_t {
+	unsigned int active;
+	dc_event_progress_t progress;
+	unsigned char *header;
+	unsigned char *profile;
+	const hw_ostc3_logbook_t *logbook;
+	unsigned int compact;
+	unsigned int ndives;
+	unsigned int current;
+	unsigned char dive[RB_LOGBOOK_COUNT];
+} hw_ostc3_download_t;
+
 typedef struct hw_ostc3_device_t {
 	dc_device_t base;
 	dc_iostream_t *iostream;
@@ -120,16 +142,9 @@ typedef struct hw_ostc3_device_t {
 	unsigned int firmware;
 	unsigned char fingerprint[5];
 	hw_ostc3_state_t state;
+	hw_ostc3_download_t download;
 } hw_ostc3_device_t;
 
-typedef struct hw_ostc3_logbook_t {
-	unsigned int size;
-	unsigned int profile;
-	unsigned int fingerprint;
-	unsigned int number;
-	unsigned int version;
-} hw_ostc3_logbook_t;
-
 typedef struct hw_ostc3_firmware_t {
 	unsigned char data[SZ_FIRMWARE];
 	unsigned int checksum;
@@ -150,9 +165,12 @@ static dc_status_t hw_ostc3_device_read (dc_device_t *abstract, unsigned int add
 static dc_status_t hw_ostc3_device_write (dc_device_t *abstract, unsigned int address, const unsigned char data[], unsigned int size);
 static dc_status_t hw_ostc3_device_dump (dc_device_t *abstract, dc_buffer_t *buffer);
 static dc_status_t hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
+static dc_status_t hw_ostc3_device_foreach_step (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
 static dc_status_t hw_ostc3_device_timesync (dc_device_t *abstract, const dc_datetime_t *datetime);
 static dc_status_t hw_ostc3_device_close (dc_device_t *abstract);
 
+static void hw_ostc3_download_reset (hw_ostc3_download_t *download);
+
 static const dc_device_vtable_t hw_ostc3_device_vtable = {
 	sizeof(hw_ostc3_device_t),
 	DC_FAMILY_HW_OSTC3,
@@ -161,6 +179,7 @@ static const dc_device_vtable_t hw_ostc3_device_vtable = {
 	hw_ostc3_device_write, /* write */
 	hw_ostc3_device_dump, /* dump */
 	hw_ostc3_device_foreach, /* foreach */
+	hw_ostc3_device_foreach_step, /* foreach_step */
 	hw_ostc3_device_timesync, /* timesync */
 	hw_ostc3_device_close /* close */
 };
@@ -434,6 +453,7 @@ hw_ostc3_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_t *i
 	device->serial = 0;
 	device->firmware = 0;
 	memset (device->fingerprint, 0, sizeof (device->fingerprint));
+	memset (&device->download, 0, sizeof (device->download));
 
 	// Create the packet stream.
 	if (transport == DC_TRANSPORT_BLE) {
@@ -653,6 +673,9 @@ hw_ostc3_device_close (dc_device_t *abstract)
 	hw_ostc3_device_t *device = (hw_ostc3_device_t*) abstract;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 
+	// Discard an unfinished resumable download.
+	hw_ostc3_download_reset (&device->download);
+
 	// Send the exit command
 	if (device->state == DOWNLOAD || device->state == SERVICE) {
 		rc = hw_ostc3_transfer (device, NULL, EXIT, NULL, 0, NULL, 0, NULL, NODELAY);
@@ -741,15 +764,52 @@ hw_ostc3_device_hardware (dc_device_t *abstract, unsigned char data[], unsigned
 }
 
 
+static void
+hw_ostc3_download_reset (hw_ostc3_download_t *download)
+{
+	free (download->profile);
+	free (download->header);
+
+	download->active = 0;
+	download->header = NULL;
+	download->profile = NULL;
+	download->logbook = NULL;
+	download->compact = 0;
+	download->ndives = 0;
+	download->current = 0;
+}
+
+
+static unsigned int
+hw_ostc3_download_length (hw_ostc3_download_t *download, unsigned int idx)
+{
+	const hw_ostc3_logbook_t *logbook = download->logbook;
+	unsigned int offset = idx * logbook->size;
+
+	// Calculate the profile length.
+	unsigned int length = RB_LOGBOOK_SIZE_FULL + array_uint24_le (download->header + offset + logbook->profile) - 3;
+	if (!download->compact) {
+		// Workaround for a bug in older firmware versions.
+		unsigned int firmware = array_uint16_be (download->header + offset + HDR_FULL_FIRMWARE);
+		if (firmware < OSTC3FW(0,93))
+			length -= 3;
+	}
+
+	return length;
+}
+
+
 static dc_status_t
-hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+hw_ostc3_download_start (hw_ostc3_device_t *device)
 {
-	hw_ostc3_device_t *device = (hw_ostc3_device_t *) abstract;
+	dc_device_t *abstract = (dc_device_t *) device;
+	hw_ostc3_download_t *download = &device->download;
+	dc_event_progress_t *progress = &download->progress;
 
 	// Enable progress notifications.
-	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
-	progress.maximum = SZ_MEMORY;
-	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+	progress->current = 0;
+	progress->maximum = SZ_MEMORY;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
 
 	dc_status_t rc = hw_ostc3_device_init (device, DOWNLOAD);
 	if (rc != DC_STATUS_SUCCESS)
@@ -763,36 +823,38 @@ hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, voi
 	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
 
 	// Allocate memory.
-	unsigned char *header = (unsigned char *) malloc (RB_LOGBOOK_SIZE_FULL * RB_LOGBOOK_COUNT);
-	if (header == NULL) {
+	download->header = (unsigned char *) malloc (RB_LOGBOOK_SIZE_FULL * RB_LOGBOOK_COUNT);
+	if (download->header == NULL) {
 		ERROR (abstract->context, "Failed to allocate memory.");
 		return DC_STATUS_NOMEMORY;
 	}
 
+	unsigned char *header = download->header;
+
 	// Download the compact logbook headers. If the firmware doesn't support
 	// compact headers yet, fallback to downloading the full logbook headers.
 	// This is slower, but also works for older firmware versions.
-	unsigned int compact = 1;
-	rc = hw_ostc3_transfer (device, &progress, COMPACT,
+	download->compact = 1;
+	rc = hw_ostc3_transfer (device, progress, COMPACT,
               NULL, 0, header, RB_LOGBOOK_SIZE_COMPACT * RB_LOGBOOK_COUNT, NULL, NODELAY);
 	if (rc == DC_STATUS_UNSUPPORTED) {
-		compact = 0;
-		rc = hw_ostc3_transfer (device, &progress, HEADER,
+		download->compact = 0;
+		rc = hw_ostc3_transfer (device, progress, HEADER,
 		          NULL, 0, header, RB_LOGBOOK_SIZE_FULL * RB_LOGBOOK_COUNT, NULL, NODELAY);
 	}
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR (abstract->context, "Failed to read the header.");
-		free (header);
 		return rc;
 	}
 
 	// Get the correct logbook layout.
 	const hw_ostc3_logbook_t *logbook = NULL;
-	if (compact) {
+	if (download->compact) {
 		logbook = &hw_ostc3_logbook_compact;
 	} else {
 		logbook = &hw_ostc3_logbook_full;
 	}
+	download->logbook = logbook;
 
 	// Locate the most recent dive.
 	// The device maintains an internal counter which is incremented for every
@@ -819,7 +881,6 @@ hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, voi
 	unsigned int ndives = 0;
 	unsigned int size = 0;
 	unsigned int maxsize = 0;
-	unsigned char dive[RB_LOGBOOK_COUNT] = {0};
 	for (unsigned int i = 0; i < RB_LOGBOOK_COUNT; ++i) {
 		unsigned int idx = (latest + RB_LOGBOOK_COUNT - i) % RB_LOGBOOK_COUNT;
 		unsigned int offset = idx * logbook->size;
@@ -831,16 +892,9 @@ hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, voi
 		}
 
 		// Calculate the profile length.
-		unsigned int length = RB_LOGBOOK_SIZE_FULL + array_uint24_le (header + offset + logbook->profile) - 3;
-		if (!compact) {
-			// Workaround for a bug in older firmware versions.
-			unsigned int firmware = array_uint16_be (header + offset + HDR_FULL_FIRMWARE);
-			if (firmware < OSTC3FW(0,93))
-				length -= 3;
-		}
+		unsigned int length = hw_ostc3_download_length (download, idx);
 		if (length < RB_LOGBOOK_SIZE_FULL) {
 			ERROR (abstract->context, "Invalid profile length (%u bytes).", length);
-			free (header);
 			return DC_STATUS_DATAFORMAT;
 		}
 
@@ -851,96 +905,138 @@ hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, voi
 		if (length > maxsize)
 			maxsize = length;
 		size += length;
-		dive[ndives] = idx;
+		download->dive[ndives] = idx;
 		ndives++;
 	}
 
 	// Update and emit a progress event.
-	progress.maximum = (logbook->size * RB_LOGBOOK_COUNT) + size + ndives;
-	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+	progress->maximum = (logbook->size * RB_LOGBOOK_COUNT) + size + ndives;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
+
+	download->ndives = ndives;
+	download->current = 0;
 
 	// Finish immediately if there are no dives available.
-	if (ndives == 0) {
-		free (header);
+	if (ndives == 0)
 		return DC_STATUS_SUCCESS;
-	}
 
 	// Allocate enough memory for the largest dive.
-	unsigned char *profile = (unsigned char *) malloc (maxsize);
-	if (profile == NULL) {
+	download->profile = (unsigned char *) malloc (maxsize);
+	if (download->profile == NULL) {
 		ERROR (abstract->context, "Failed to allocate memory.");
-		free (header);
 		return DC_STATUS_NOMEMORY;
 	}
 
-	// Download the dives.
-	for (unsigned int i = 0; i < ndives; ++i) {
-		unsigned int idx = dive[i];
-		unsigned int offset = idx * logbook->size;
+	return DC_STATUS_SUCCESS;
+}
 
-		// Calculate the profile length.
-		unsigned int length = RB_LOGBOOK_SIZE_FULL + array_uint24_le (header + offset + logbook->profile) - 3;
-		if (!compact) {
-			// Workaround for a bug in older firmware versions.
-			unsigned int firmware = array_uint16_be (header + offset + HDR_FULL_FIRMWARE);
-			if (firmware < OSTC3FW(0,93))
-				length -= 3;
-		}
 
-		// Download the dive.
-		unsigned char number[1] = {idx};
-		rc = hw_ostc3_transfer (device, &progress, DIVE,
-			number, sizeof (number), profile, length, &length, NODELAY);
-		if (rc != DC_STATUS_SUCCESS) {
-			ERROR (abstract->context, "Failed to read the dive.");
-			free (profile);
-			free (header);
-			return rc;
-		}
+static dc_status_t
+hw_ostc3_download_dive (hw_ostc3_device_t *device, dc_dive_callback_t callback, void *userdata)
+{
+	dc_device_t *abstract = (dc_device_t *) device;
+	hw_ostc3_download_t *download = &device->download;
+	const hw_ostc3_logbook_t *logbook = download->logbook;
+	unsigned char *header = download->header;
+	unsigned char *profile = download->profile;
 
-		// Verify the header in the logbook and profile are identical.
-		if (memcmp (profile + HDR_FULL_VERSION, header + offset + logbook->version, 1) != 0 ||
-			compact ?
-			memcmp (profile + HDR_FULL_SUMMARY, header + offset + HDR_COMPACT_SUMMARY, 10) != 0 ||
-			memcmp (profile + HDR_FULL_NUMBER, header + offset + HDR_COMPACT_NUMBER, 2) != 0 :
-			memcmp (profile + HDR_FULL_SUMMARY, header + offset + HDR_FULL_SUMMARY, RB_LOGBOOK_SIZE_FULL - HDR_FULL_SUMMARY) != 0) {
-			ERROR (abstract->context, "Unexpected profile header.");
-			free (profile);
-			free (header);
-			return DC_STATUS_DATAFORMAT;
-		}
+	unsigned int idx = download->dive[download->current++];
+	unsigned int offset = idx * logbook->size;
 
-		// Detect invalid profile data.
-		unsigned int delta = ISHWOS4(device->hardware) ? 3 : 0;
-		if (length < RB_LOGBOOK_SIZE_FULL + 2 ||
-			profile[length - 2] != 0xFD || profile[length - 1] != 0xFD) {
-			// A valid profile should have at least a correct 2 byte
-			// end-of-profile marker.
-			WARNING (abstract->context, "Invalid profile end marker detected!");
-			length = RB_LOGBOOK_SIZE_FULL;
-		} else if (length == RB_LOGBOOK_SIZE_FULL + 2) {
-			// A profile containing only the 2 byte end-of-profile
-			// marker is considered a valid empty profile.
-		} else if (length < RB_LOGBOOK_SIZE_FULL + 5 ||
-			array_uint24_le (profile + RB_LOGBOOK_SIZE_FULL) + delta != array_uint24_le (profile + HDR_FULL_LENGTH)) {
-			// If there is more data available, then there should be a
-			// valid profile header containing a length matching the
-			// length in the dive header.
-			WARNING (abstract->context, "Invalid profile header detected.");
-			length = RB_LOGBOOK_SIZE_FULL;
-		}
+	// Calculate the profile length.
+	unsigned int length = hw_ostc3_download_length (download, idx);
 
-		if (callback && !callback (profile, length, profile + HDR_FULL_SUMMARY, sizeof (device->fingerprint), userdata))
-			break;
+	// Download the dive.
+	unsigned char number[1] = {idx};
+	dc_status_t rc = hw_ostc3_transfer (device, &download->progress, DIVE,
+		number, sizeof (number), profile, length, &length, NODELAY);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to read the dive.");
+		return rc;
+	}
+
+	// Verify the header in the logbook and profile are identical.
+	if (memcmp (profile + HDR_FULL_VERSION, header + offset + logbook->version, 1) != 0 ||
+		download->compact ?
+		memcmp (profile + HDR_FULL_SUMMARY, header + offset + HDR_COMPACT_SUMMARY, 10) != 0 ||
+		memcmp (profile + HDR_FULL_NUMBER, header + offset + HDR_COMPACT_NUMBER, 2) != 0 :
+		memcmp (profile + HDR_FULL_SUMMARY, header + offset + HDR_FULL_SUMMARY, RB_LOGBOOK_SIZE_FULL - HDR_FULL_SUMMARY) != 0) {
+		ERROR (abstract->context, "Unexpected profile header.");
+		return DC_STATUS_DATAFORMAT;
 	}
 
-	free (profile);
-	free (header);
+	// Detect invalid profile data.
+	unsigned int delta = ISHWOS4(device->hardware) ? 3 : 0;
+	if (length < RB_LOGBOOK_SIZE_FULL + 2 ||
+		profile[length - 2] != 0xFD || profile[length - 1] != 0xFD) {
+		// A valid profile should have at least a correct 2 byte
+		// end-of-profile marker.
+		WARNING (abstract->context, "Invalid profile end marker detected!");
+		length = RB_LOGBOOK_SIZE_FULL;
+	} else if (length == RB_LOGBOOK_SIZE_FULL + 2) {
+		// A profile containing only the 2 byte end-of-profile
+		// marker is considered a valid empty profile.
+	} else if (length < RB_LOGBOOK_SIZE_FULL + 5 ||
+		array_uint24_le (profile + RB_LOGBOOK_SIZE_FULL) + delta != array_uint24_le (profile + HDR_FULL_LENGTH)) {
+		// If there is more data available, then there should be a
+		// valid profile header containing a length matching the
+		// length in the dive header.
+		WARNING (abstract->context, "Invalid profile header detected.");
+		length = RB_LOGBOOK_SIZE_FULL;
+	}
+
+	if (callback && !callback (profile, length, profile + HDR_FULL_SUMMARY, sizeof (device->fingerprint), userdata))
+		download->current = download->ndives;
 
 	return DC_STATUS_SUCCESS;
 }
 
 
+/*
+ * Resumable download. The first step downloads the logbook headers, and
+ * every next step downloads a single dive. DC_STATUS_WOULDBLOCK is
+ * returned as long as there are more dives to download.
+ */
+static dc_status_t
+hw_ostc3_device_foreach_step (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	hw_ostc3_device_t *device = (hw_ostc3_device_t *) abstract;
+	hw_ostc3_download_t *download = &device->download;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	if (!download->active) {
+		download->active = 1;
+		rc = hw_ostc3_download_start (device);
+	} else {
+		rc = hw_ostc3_download_dive (device, callback, userdata);
+	}
+
+	if (rc != DC_STATUS_SUCCESS || download->current >= download->ndives) {
+		hw_ostc3_download_reset (download);
+		return rc;
+	}
+
+	return DC_STATUS_WOULDBLOCK;
+}
+
+
+static dc_status_t
+hw_ostc3_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	hw_ostc3_device_t *device = (hw_ostc3_device_t *) abstract;
+
+	// Discard an unfinished resumable download.
+	hw_ostc3_download_reset (&device->download);
+
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	do {
+		rc = hw_ostc3_device_foreach_step (abstract, callback, userdata);
+	} while (rc == DC_STATUS_WOULDBLOCK);
+
+	return rc;
+}
+
+
 static dc_status_t
 hw_ostc3_device_timesync (dc_device_t *abstract, const dc_datetime_t *datetime)
 {
@@ -1105,45 +1201,46 @@ hw_ostc3_firmware_checksum (const unsigned char data[], unsigned int size)
 }
 
 static dc_status_t
-hw_ostc3_firmware_readline (FILE *fp, dc_context_t *context, unsigned int addr, unsigned char data[], unsigned int size)
+hw_ostc3_firmware_readline (dc_filemap_t *filemap, size_t *offset, dc_context_t *context, unsigned int addr, unsigned char data[], unsigned int size)
 {
-	unsigned char ascii[39];
+	const unsigned char *ascii = dc_filemap_get_data (filemap);
+	size_t length = dc_filemap_get_size (filemap);
 	unsigned char faddr_byte[3];
 	unsigned int faddr = 0;
-	size_t n = 0;
 
 	if (size > 16) {
 		ERROR (context, "Invalid arguments.");
 		return DC_STATUS_INVALIDARGS;
 	}
 
-	// Read the start code.
+	// Find the start code.
 	while (1) {
-		n = fread (ascii, 1, 1, fp);
-		if (n != 1) {
+		if (*offset >= length) {
 			ERROR (context, "Failed to read the start code.");
 			return DC_STATUS_IO;
 		}
 
-		if (ascii[0] == ':')
+		unsigned char c = ascii[(*offset)++];
+		if (c == ':')
 			break;
 
 		// Ignore CR and LF characters.
-		if (ascii[0] != '\n' && ascii[0] != '\r') {
-			ERROR (context, "Unexpected character (0x%02x).", ascii[0]);
+		if (c != '\n' && c != '\r') {
+			ERROR (context, "Unexpected character (0x%02x).", c);
 			return DC_STATUS_DATAFORMAT;
 		}
 	}
 
-	// Read the payload.
-	n = fread (ascii + 1, 1, 6 + size * 2, fp);
-	if (n != 6 + size * 2) {
+	// Check the payload.
+	if (length - *offset < 6 + size * 2) {
 		ERROR (context, "Failed to read the data.");
 		return DC_STATUS_IO;
 	}
+	ascii += *offset;
+	*offset += 6 + size * 2;
 
 	// Convert the address to binary representation.
-	if (array_convert_hex2bin(ascii + 1, 6, faddr_byte, sizeof(faddr_byte)) != 0) {
+	if (array_convert_hex2bin(ascii, 6, faddr_byte, sizeof(faddr_byte)) != 0) {
 		ERROR (context, "Invalid hexadecimal character.");
 		return DC_STATUS_DATAFORMAT;
 	}
@@ -1156,7 +1253,7 @@ hw_ostc3_firmware_readline (FILE *fp, dc_context_t *context, unsigned int addr,
 	}
 
 	// Convert the payload to binary representation.
-	if (array_convert_hex2bin (ascii + 1 + 6, size * 2, data, size) != 0) {
+	if (array_convert_hex2bin (ascii + 6, size * 2, data, size) != 0) {
 		ERROR (context, "Invalid hexadecimal character.");
 		return DC_STATUS_DATAFORMAT;
 	}
@@ -1169,10 +1266,9 @@ static dc_status_t
 hw_ostc3_firmware_readfile3 (hw_ostc3_firmware_t *firmware, dc_context_t *context, const char *filename)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
-	FILE *fp = NULL;
+	dc_filemap_t *filemap = NULL;
+	size_t offset = 0;
 	unsigned char iv[16] = {0};
-	unsigned char tmpbuf[16] = {0};
-	unsigned char encrypted[16] = {0};
 	unsigned int bytes = 0, addr = 0;
 	unsigned char checksum[4];
 
@@ -1185,48 +1281,42 @@ hw_ostc3_firmware_readfile3 (hw_ostc3_firmware_t *firmware, dc_context_t *contex
 	memset (firmware->data, 0xFF, sizeof (firmware->data));
 	firmware->checksum = 0;
 
-	fp = fopen (filename, "rb");
-	if (fp == NULL) {
+	if (dc_filemap_open (&filemap, filename) != 0) {
 		ERROR (context, "Failed to open the file.");
 		return DC_STATUS_IO;
 	}
 
-	rc = hw_ostc3_firmware_readline (fp, context, 0, iv, sizeof(iv));
+	rc = hw_ostc3_firmware_readline (filemap, &offset, context, 0, iv, sizeof(iv));
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to parse header.");
-		fclose (fp);
+		dc_filemap_close (filemap);
 		return rc;
 	}
 	bytes += 16;
 
-	// Load the iv for AES-FCB-mode
-	AES128_ECB_encrypt (iv, ostc3_key, tmpbuf);
-
 	for (addr = 0; addr < SZ_FIRMWARE; addr += 16, bytes += 16) {
-		rc = hw_ostc3_firmware_readline (fp, context, bytes, encrypted, sizeof(encrypted));
+		rc = hw_ostc3_firmware_readline (filemap, &offset, context, bytes, firmware->data + addr, 16);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (context, "Failed to parse file data.");
-			fclose (fp);
+			dc_filemap_close (filemap);
 			return rc;
 		}
-
-		// Decrypt AES-FCB data
-		for (unsigned int i = 0; i < 16; i++)
-			firmware->data[addr + i] = encrypted[i] ^ tmpbuf[i];
-
-		// Run the next round of encryption
-		AES128_ECB_encrypt (encrypted, ostc3_key, tmpbuf);
 	}
 
+	// Decrypt the AES-CFB data in place.
+	AES128_ctx_t aes;
+	AES128_init (&aes, ostc3_key);
+	AES128_CFB_decrypt_buffer (&aes, firmware->data, firmware->data, SZ_FIRMWARE, iv);
+
 	// This file format contains a tail with the checksum in
-	rc = hw_ostc3_firmware_readline (fp, context, bytes, checksum, sizeof(checksum));
+	rc = hw_ostc3_firmware_readline (filemap, &offset, context, bytes, checksum, sizeof(checksum));
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to parse file tail.");
-		fclose (fp);
+		dc_filemap_close (filemap);
 		return rc;
 	}
 
-	fclose (fp);
+	dc_filemap_close (filemap);
 
 	unsigned int csum1 = array_uint32_le (checksum);
 	unsigned int csum2 = hw_ostc3_firmware_checksum (firmware->data, sizeof(firmware->data));
@@ -1243,7 +1333,7 @@ hw_ostc3_firmware_readfile3 (hw_ostc3_firmware_t *firmware, dc_context_t *contex
 static dc_status_t
 hw_ostc3_firmware_readfile4 (dc_buffer_t *buffer, dc_context_t *context, const char *filename)
 {
-	FILE *fp = NULL;
+	dc_filemap_t *filemap = NULL;
 
 	if (buffer == NULL) {
 		ERROR (context, "Invalid arguments.");
@@ -1251,25 +1341,20 @@ hw_ostc3_firmware_readfile4 (dc_buffer_t *buffer, dc_context_t *context, const c
 	}
 
 	// Open the file.
-	fp = fopen (filename, "rb");
-	if (fp == NULL) {
+	if (dc_filemap_open (&filemap, filename) != 0) {
 		ERROR (context, "Failed to open the file.");
 		return DC_STATUS_IO;
 	}
 
-	// Read the entire file into the buffer.
-	size_t n = 0;
-	unsigned char block[1024] = {0};
-	while ((n = fread (block, 1, sizeof (block), fp)) > 0) {
-		if (!dc_buffer_append (buffer, block, n)) {
-			ERROR (context, "Insufficient buffer space available.");
-			fclose (fp);
-			return DC_STATUS_NOMEMORY;
-		}
+	// Copy the entire file into the buffer.
+	if (!dc_buffer_append (buffer, dc_filemap_get_data (filemap), dc_filemap_get_size (filemap))) {
+		ERROR (context, "Insufficient buffer space available.");
+		dc_filemap_close (filemap);
+		return DC_STATUS_NOMEMORY;
 	}
 
 	// Close the file.
-	fclose (fp);
+	dc_filemap_close (filemap);
 
 	// Verify the minimum size.
 	size_t size = dc_buffer_get_size (buffer);
@@ -1407,31 +1492,57 @@ hw_ostc3_firmware_upgrade (dc_device_t *abstract, unsigned int checksum)
 }
 
 
+static void
+hw_ostc3_firmware_display (dc_device_t *abstract, dc_timer_t *timer, dc_usecs_t *last, const char *text)
+{
+	// Without a timer, every update is sent.
+	if (timer) {
+		dc_usecs_t now = 0;
+		dc_timer_now (timer, &now);
+		if (*last && now - *last < DISPLAY_INTERVAL)
+			return;
+		*last = now ? now : 1;
+	}
+
+	hw_ostc3_device_display (abstract, text);
+}
+
 static dc_status_t
-hw_ostc3_device_fwupdate3 (dc_device_t *abstract, const char *filename)
+hw_ostc3_device_fwupdate3 (dc_device_t *abstract, const char *filename, unsigned int flags)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	hw_ostc3_device_t *device = (hw_ostc3_device_t *) abstract;
 	dc_context_t *context = (abstract ? abstract->context : NULL);
+	hw_ostc3_firmware_t *firmware = NULL;
+	dc_timer_t *timer = NULL;
+	dc_usecs_t last = 0;
+
+	// In fast mode, the display updates are throttled and the read-back
+	// verification is skipped. The bootloader still validates the
+	// checksum of the uploaded image before reprogramming.
+	unsigned int fast = (flags & HW_OSTC3_FWUPDATE_FAST) != 0;
+	if (fast) {
+		dc_timer_new (&timer);
+	}
 
 	// Enable progress notifications.
 	// load, erase, upload FZ, verify FZ, reprogram
 	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
-	progress.maximum = 3 + SZ_FIRMWARE * 2 / SZ_FIRMWARE_BLOCK;
+	progress.maximum = 3 + SZ_FIRMWARE * (fast ? 1 : 2) / SZ_FIRMWARE_BLOCK;
 	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
 	// Allocate memory for the firmware data.
-	hw_ostc3_firmware_t *firmware = (hw_ostc3_firmware_t *) malloc (sizeof (hw_ostc3_firmware_t));
+	firmware = (hw_ostc3_firmware_t *) malloc (sizeof (hw_ostc3_firmware_t));
 	if (firmware == NULL) {
 		ERROR (context, "Failed to allocate memory.");
-		return DC_STATUS_NOMEMORY;
+		rc = DC_STATUS_NOMEMORY;
+		goto error;
 	}
 
 	// Read the hex file.
 	rc = hw_ostc3_firmware_readfile3 (firmware, context, filename);
 	if (rc != DC_STATUS_SUCCESS) {
-		free (firmware);
-		return rc;
+		goto error;
 	}
 
 	// Device open and firmware loaded
@@ -1443,8 +1554,7 @@ hw_ostc3_device_fwupdate3 (dc_device_t *abstract, const char *filename)
 	rc = hw_ostc3_firmware_erase (device, FIRMWARE_AREA, SZ_FIRMWARE);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to erase old firmware");
-		free (firmware);
-		return rc;
+		goto error;
 	}
 
 	// Memory erased
@@ -1456,22 +1566,23 @@ hw_ostc3_device_fwupdate3 (dc_device_t *abstract, const char *filename)
 	for (unsigned int len = 0; len < SZ_FIRMWARE; len += SZ_FIRMWARE_BLOCK) {
 		char status[SZ_DISPLAY + 1]; // Status message on the display
 		dc_platform_snprintf (status, sizeof(status), " Uploading %2d%%", (100 * len) / SZ_FIRMWARE);
-		hw_ostc3_device_display (abstract, status);
+		hw_ostc3_firmware_display (abstract, timer, &last, status);
 
 		rc = hw_ostc3_firmware_block_write (device, FIRMWARE_AREA + len, firmware->data + len, SZ_FIRMWARE_BLOCK);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (context, "Failed to write block to device");
-			free(firmware);
-			return rc;
+			goto error;
 		}
 		// One block uploaded
 		progress.current++;
 		device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 	}
 
-	hw_ostc3_device_display (abstract, " Verifying...");
+	if (!fast) {
+		hw_ostc3_device_display (abstract, " Verifying...");
+	}
 
-	for (unsigned int len = 0; len < SZ_FIRMWARE; len += SZ_FIRMWARE_BLOCK) {
+	for (unsigned int len = 0; !fast && len < SZ_FIRMWARE; len += SZ_FIRMWARE_BLOCK) {
 		unsigned char block[SZ_FIRMWARE_BLOCK];
 		char status[SZ_DISPLAY + 1]; // Status message on the display
 		dc_platform_snprintf (status, sizeof(status), " Verifying %2d%%", (100 * len) / SZ_FIRMWARE);
@@ -1480,14 +1591,13 @@ hw_ostc3_device_fwupdate3 (dc_device_t *abstract, const char *filename)
 		rc = hw_ostc3_firmware_block_read (device, FIRMWARE_AREA + len, block, sizeof (block));
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (context, "Failed to read block.");
-			free (firmware);
-			return rc;
+			goto error;
 		}
 		if (memcmp (firmware->data + len, block, sizeof (block)) != 0) {
 			ERROR (context, "Failed verify.");
 			hw_ostc3_device_display (abstract, " Verify FAILED");
-			free (firmware);
-			return DC_STATUS_PROTOCOL;
+			rc = DC_STATUS_PROTOCOL;
+			goto error;
 		}
 		// One block verified
 		progress.current++;
@@ -1499,18 +1609,17 @@ hw_ostc3_device_fwupdate3 (dc_device_t *abstract, const char *filename)
 	rc = hw_ostc3_firmware_upgrade (abstract, firmware->checksum);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to start programing");
-		free (firmware);
-		return rc;
+		goto error;
 	}
 
 	// Programing done!
 	progress.current++;
 	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
+error:
+	dc_timer_free (timer);
 	free (firmware);
-
-	// Finished!
-	return DC_STATUS_SUCCESS;
+	return rc;
 }
 
 static dc_status_t
@@ -1609,6 +1718,12 @@ error:
 
 dc_status_t
 hw_ostc3_device_fwupdate (dc_device_t *abstract, const char *filename)
+{
+	return hw_ostc3_device_fwupdate2 (abstract, filename, 0);
+}
+
+dc_status_t
+hw_ostc3_device_fwupdate2 (dc_device_t *abstract, const char *filename, unsigned int flags)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	hw_ostc3_device_t *device = (hw_ostc3_device_t *) abstract;
@@ -1625,7 +1740,7 @@ hw_ostc3_device_fwupdate (dc_device_t *abstract, const char *filename)
 	if (ISHWOS4(device->hardware)) {
 		return hw_ostc3_device_fwupdate4 (abstract, filename);
 	} else {
-		return hw_ostc3_device_fwupdate3 (abstract, filename);
+		return hw_ostc3_device_fwupdate3 (abstract, filename, flags);
 	}
 }
 
@@ -150,8 +150,9 @@ typedef struct hw_ostc_parser_t {
 static dc_status_t hw_ostc_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t hw_ostc_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t hw_ostc_parser_samples_foreach_fixed (dc_parser_t *abstract, dc_sample_fixed_callback_t callback, void *userdata);
 
-static dc_status_t hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t callback, void *userdata);
+static dc_status_t hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, const dc_sample_sink_t *sink);
 
 static const dc_parser_vtable_t hw_ostc_parser_vtable = {
 	sizeof(hw_ostc_parser_t),
@@ -162,6 +163,7 @@ static const dc_parser_vtable_t hw_ostc_parser_vtable = {
 	hw_ostc_parser_get_datetime, /* datetime */
 	hw_ostc_parser_get_field, /* fields */
 	hw_ostc_parser_samples_foreach, /* samples_foreach */
+	hw_ostc_parser_samples_foreach_fixed, /* samples_foreach_fixed */
 	NULL /* destroy */
 };
 
@@ -530,7 +532,8 @@ hw_ostc_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned
 
 	// Cache the profile data.
 	if (parser->cached < PROFILE) {
-		rc = hw_ostc_parser_internal_foreach (parser, NULL, NULL);
+		dc_sample_sink_t none = {NULL, NULL, NULL};
+		rc = hw_ostc_parser_internal_foreach (parser, &none);
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 	}
@@ -726,7 +729,7 @@ hw_ostc_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned
 
 
 static dc_status_t
-hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t callback, void *userdata)
+hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, const dc_sample_sink_t *sink)
 {
 	dc_parser_t *abstract = (dc_parser_t *) parser;
 	const unsigned char *data = abstract->data;
@@ -854,38 +857,48 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 		offset += 5 + 3 * nconfig;
 	while (offset + 3 <= size) {
 		dc_sample_value_t sample = {0};
+		dc_sample_fixed_t fixed = {0};
 
 		nsamples++;
 
 		// Time (seconds).
 		time += samplerate;
-		sample.time = time * 1000;
-		if (callback) callback (DC_SAMPLE_TIME, &sample, userdata);
+		sample.time = fixed.time = time * 1000;
+		dc_sample_sink_emit (sink, DC_SAMPLE_TIME, &sample, &fixed);
 
 		// Initial gas mix.
 		if (time == samplerate && parser->initial != UNDEFINED) {
 			unsigned int idx = hw_ostc_find_gasmix_fixed (parser, parser->initial);
 			parser->gasmix[idx].active = 1;
-			sample.gasmix = idx;
-			if (callback) callback (DC_SAMPLE_GASMIX, &sample, userdata);
+			sample.gasmix = fixed.gasmix = idx;
+			dc_sample_sink_emit (sink, DC_SAMPLE_GASMIX, &sample, &fixed);
 		}
 
 		// Initial setpoint (mbar).
 		if (time == samplerate && parser->initial_setpoint != UNDEFINED) {
-			sample.setpoint = parser->initial_setpoint / 100.0;
-			if (callback) callback (DC_SAMPLE_SETPOINT, &sample, userdata);
+			if (sink->fixed)
+				fixed.setpoint = parser->initial_setpoint * 10;
+			else
+				sample.setpoint = parser->initial_setpoint / 100.0;
+			dc_sample_sink_emit (sink, DC_SAMPLE_SETPOINT, &sample, &fixed);
 		}
 
 		// Initial CNS (%).
 		if (time == samplerate && parser->initial_cns != UNDEFINED) {
-			sample.cns = parser->initial_cns / 100.0;
-			if (callback) callback (DC_SAMPLE_CNS, &sample, userdata);
+			if (sink->fixed)
+				fixed.cns = parser->initial_cns * 10;
+			else
+				sample.cns = parser->initial_cns / 100.0;
+			dc_sample_sink_emit (sink, DC_SAMPLE_CNS, &sample, &fixed);
 		}
 
 		// Depth (1/100 m).
 		unsigned int depth = array_uint16_le (data + offset);
-		sample.depth = depth / 100.0;
-		if (callback) callback (DC_SAMPLE_DEPTH, &sample, userdata);
+		if (sink->fixed)
+			fixed.depth = depth * 10;
+		else
+			sample.depth = depth / 100.0;
+		dc_sample_sink_emit (sink, DC_SAMPLE_DEPTH, &sample, &fixed);
 		offset += 2;
 
 		// Extended sample info.
@@ -943,8 +956,13 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 		case 7: // Low Battery
 			break;
 		}
-		if (sample.event.type && callback)
-			callback (DC_SAMPLE_EVENT, &sample, userdata);
+		if (sample.event.type) {
+			fixed.event.type = sample.event.type;
+			fixed.event.time = 0;
+			fixed.event.flags = 0;
+			fixed.event.value = 0;
+			dc_sample_sink_emit (sink, DC_SAMPLE_EVENT, &sample, &fixed);
+		}
 
 		// Manual Gas Set & Change
 		if (events & 0x10) {
@@ -970,8 +988,8 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 				parser->ngasmixes = idx + 1;
 			}
 
-			sample.gasmix = idx;
-			if (callback) callback (DC_SAMPLE_GASMIX, &sample, userdata);
+			sample.gasmix = fixed.gasmix = idx;
+			dc_sample_sink_emit (sink, DC_SAMPLE_GASMIX, &sample, &fixed);
 			offset += 2;
 			length -= 2;
 		}
@@ -993,8 +1011,8 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 			}
 			unsigned int idx = hw_ostc_find_gasmix_fixed (parser, id);
 			parser->gasmix[idx].active = 1;
-			sample.gasmix = idx;
-			if (callback) callback (DC_SAMPLE_GASMIX, &sample, userdata);
+			sample.gasmix = fixed.gasmix = idx;
+			dc_sample_sink_emit (sink, DC_SAMPLE_GASMIX, &sample, &fixed);
 			tank = id - 1;
 			offset++;
 			length--;
@@ -1007,8 +1025,11 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 					ERROR (abstract->context, "Buffer overflow detected!");
 					return DC_STATUS_DATAFORMAT;
 				}
-				sample.setpoint = data[offset] / 100.0;
-				if (callback) callback (DC_SAMPLE_SETPOINT, &sample, userdata);
+				if (sink->fixed)
+					fixed.setpoint = data[offset] * 10;
+				else
+					sample.setpoint = data[offset] / 100.0;
+				dc_sample_sink_emit (sink, DC_SAMPLE_SETPOINT, &sample, &fixed);
 				offset++;
 				length--;
 			}
@@ -1038,8 +1059,8 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 					parser->ngasmixes = idx + 1;
 				}
 
-				sample.gasmix = idx;
-				if (callback) callback (DC_SAMPLE_GASMIX, &sample, userdata);
+				sample.gasmix = fixed.gasmix = idx;
+				dc_sample_sink_emit (sink, DC_SAMPLE_GASMIX, &sample, &fixed);
 				offset += 2;
 				length -= 2;
 			}
@@ -1055,8 +1076,8 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 				unsigned int heading = value & 0x1FF;
 
 				if ((value & OSTC4_COMPASS_CLEARED) == 0) {
-					sample.bearing = heading;
-					if (callback) callback (DC_SAMPLE_BEARING, &sample, userdata);
+					sample.bearing = fixed.bearing = heading;
+					dc_sample_sink_emit (sink, DC_SAMPLE_BEARING, &sample, &fixed);
 				}
 
 				offset += 2;
@@ -1128,8 +1149,11 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 				switch (info[i].type) {
 				case TEMPERATURE:
 					value = array_uint16_le (data + offset);
-					sample.temperature = value / 10.0;
-					if (callback) callback (DC_SAMPLE_TEMPERATURE, &sample, userdata);
+					if (sink->fixed)
+						fixed.temperature = value * 100 + 273150;
+					else
+						sample.temperature = value / 10.0;
+					dc_sample_sink_emit (sink, DC_SAMPLE_TEMPERATURE, &sample, &fixed);
 					break;
 				case DECO:
 					// Due to a firmware bug, the deco/ndl info is incorrect for
@@ -1137,15 +1161,17 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 					if (ISHWOS4(parser->hwos, parser->model) && firmware < OSTC4FW(1,0,8,0))
 						break;
 					if (data[offset]) {
-						sample.deco.type = DC_DECO_DECOSTOP;
-						sample.deco.depth = data[offset];
+						sample.deco.type = fixed.deco.type = DC_DECO_DECOSTOP;
 					} else {
-						sample.deco.type = DC_DECO_NDL;
-						sample.deco.depth = 0.0;
+						sample.deco.type = fixed.deco.type = DC_DECO_NDL;
 					}
-					sample.deco.time = data[offset + 1] * 60;
-					sample.deco.tts = 0;
-					if (callback) callback (DC_SAMPLE_DECO, &sample, userdata);
+					if (sink->fixed)
+						fixed.deco.depth = data[offset] * 1000;
+					else
+						sample.deco.depth = data[offset];
+					sample.deco.time = fixed.deco.time = data[offset + 1] * 60;
+					sample.deco.tts = fixed.deco.tts = 0;
+					dc_sample_sink_emit (sink, DC_SAMPLE_DECO, &sample, &fixed);
 					break;
 				case PPO2:
 					for (unsigned int j = 0; j < 3; ++j) {
@@ -1159,31 +1185,42 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 					}
 					if (count) {
 						for (unsigned int j = 0; j < 3; ++j) {
-							sample.ppo2.sensor = j;
-							sample.ppo2.value = ppo2[j] / 100.0;
-							if (callback) callback (DC_SAMPLE_PPO2, &sample, userdata);
+							sample.ppo2.sensor = fixed.ppo2.sensor = j;
+							if (sink->fixed)
+								fixed.ppo2.value = ppo2[j] * 10;
+							else
+								sample.ppo2.value = ppo2[j] / 100.0;
+							dc_sample_sink_emit (sink, DC_SAMPLE_PPO2, &sample, &fixed);
 						}
 					}
 					break;
 				case CNS:
 					if (info[i].size == 2)
-						sample.cns = array_uint16_le (data + offset) / 100.0;
+						value = array_uint16_le (data + offset);
+					else
+						value = data[offset];
+					if (sink->fixed)
+						fixed.cns = value * 10;
 					else
-						sample.cns = data[offset] / 100.0;
-					if (callback) callback (DC_SAMPLE_CNS, &sample, userdata);
+						sample.cns = value / 100.0;
+					dc_sample_sink_emit (sink, DC_SAMPLE_CNS, &sample, &fixed);
 					break;
 				case TANK:
 					value = array_uint16_le (data + offset);
 					if (value != 0) {
-						sample.pressure.tank = tank;
-						sample.pressure.value = value;
+						sample.pressure.tank = fixed.pressure.tank = tank;
 						// The hwOS Sport firmware used a resolution of
 						// 0.1 bar between versions 10.40 and 10.50.
+						unsigned int resolution = 1;
 						if (ISHWOS3(parser->hwos, parser->model) &&
 							(firmware >= OSTC3FW(10,40) && firmware <= OSTC3FW(10,50))) {
-							sample.pressure.value /= 10.0;
+							resolution = 10;
 						}
-						if (callback) callback (DC_SAMPLE_PRESSURE, &sample, userdata);
+						if (sink->fixed)
+							fixed.pressure.value = value * 1000 / resolution;
+						else
+							sample.pressure.value = (double) value / resolution;
+						dc_sample_sink_emit (sink, DC_SAMPLE_PRESSURE, &sample, &fixed);
 					}
 					break;
 				default: // Not yet used.
@@ -1202,8 +1239,11 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 					ERROR (abstract->context, "Buffer overflow detected!");
 					return DC_STATUS_DATAFORMAT;
 				}
-				sample.setpoint = data[offset] / 100.0;
-				if (callback) callback (DC_SAMPLE_SETPOINT, &sample, userdata);
+				if (sink->fixed)
+					fixed.setpoint = data[offset] * 10;
+				else
+					sample.setpoint = data[offset] / 100.0;
+				dc_sample_sink_emit (sink, DC_SAMPLE_SETPOINT, &sample, &fixed);
 				offset++;
 				length--;
 			}
@@ -1233,8 +1273,8 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 					parser->ngasmixes = idx + 1;
 				}
 
-				sample.gasmix = idx;
-				if (callback) callback (DC_SAMPLE_GASMIX, &sample, userdata);
+				sample.gasmix = fixed.gasmix = idx;
+				dc_sample_sink_emit (sink, DC_SAMPLE_GASMIX, &sample, &fixed);
 				offset += 2;
 				length -= 2;
 			}
@@ -1281,7 +1321,7 @@ hw_ostc_parser_internal_foreach (hw_ostc_parser_t *parser, dc_sample_callback_t
 }
 
 static dc_status_t
-hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+hw_ostc_parser_samples (dc_parser_t *abstract, const dc_sample_sink_t *sink)
 {
 	hw_ostc_parser_t *parser = (hw_ostc_parser_t *) abstract;
 
@@ -1292,10 +1332,27 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 
 	// Cache the profile data.
 	if (parser->cached < PROFILE) {
-		rc = hw_ostc_parser_internal_foreach (parser, NULL, NULL);
+		dc_sample_sink_t none = {NULL, NULL, NULL};
+		rc = hw_ostc_parser_internal_foreach (parser, &none);
 		if (rc != DC_STATUS_SUCCESS)
 			return rc;
 	}
 
-	return hw_ostc_parser_internal_foreach (parser, callback, userdata);
+	return hw_ostc_parser_internal_foreach (parser, sink);
+}
+
+static dc_status_t
+hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+{
+	dc_sample_sink_t sink = {callback, NULL, userdata};
+
+	return hw_ostc_parser_samples (abstract, &sink);
+}
+
+static dc_status_t
+hw_ostc_parser_samples_foreach_fixed (dc_parser_t *abstract, dc_sample_fixed_callback_t callback, void *userdata)
+{
+	dc_sample_sink_t sink = {NULL, callback, userdata};
+
+	return hw_ostc_parser_samples (abstract, &sink);
 }
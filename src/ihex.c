@@ -22,16 +22,19 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
-#include <stdio.h>
 
 #include "ihex.h"
 #include "context-private.h"
 #include "checksum.h"
 #include "array.h"
+#include "platform.h"
 
 struct dc_ihex_file_t {
 	dc_context_t *context;
-	FILE *fp;
+	dc_filemap_t *filemap;
+	const unsigned char *data;
+	size_t size;
+	size_t offset;
 };
 
 dc_status_t
@@ -52,13 +55,17 @@ dc_ihex_file_open (dc_ihex_file_t **result, dc_context_t *context, const char *f
 
 	file->context = context;
 
-	file->fp = fopen (filename, "rb");
-	if (file->fp == NULL) {
+	// The records are parsed directly from the file contents.
+	if (dc_filemap_open (&file->filemap, filename) != 0) {
 		ERROR (context, "Failed to open the file.");
 		free (file);
 		return DC_STATUS_IO;
 	}
 
+	file->data = dc_filemap_get_data (file->filemap);
+	file->size = dc_filemap_get_size (file->filemap);
+	file->offset = 0;
+
 	*result = file;
 
 	return DC_STATUS_SUCCESS;
@@ -67,42 +74,35 @@ dc_ihex_file_open (dc_ihex_file_t **result, dc_context_t *context, const char *f
 dc_status_t
 dc_ihex_file_read (dc_ihex_file_t *file, dc_ihex_entry_t *entry)
 {
-	unsigned char ascii[9 + 2 * 255 + 2] = {0};
 	unsigned char data[4 + 255 + 1] = {0};
 	unsigned int type, length, address;
 	unsigned char csum_a, csum_b;
-	size_t n;
+	const unsigned char *ascii = NULL;
 
 	if (file == NULL || entry == NULL) {
 		ERROR (file ? file->context : NULL, "Invalid arguments.");
 		return DC_STATUS_INVALIDARGS;
 	}
 
-	/* Read the start code. */
+	/* Find the start code. */
 	while (1) {
-		n = fread (ascii, 1, 1, file->fp);
-		if (n != 1) {
-			if (feof (file->fp)) {
-				return DC_STATUS_DONE;
-			} else {
-				ERROR (file->context, "Failed to read the start code.");
-				return DC_STATUS_IO;
-			}
-		}
+		if (file->offset >= file->size)
+			return DC_STATUS_DONE;
 
-		if (ascii[0] == ':')
+		unsigned char c = file->data[file->offset++];
+		if (c == ':')
 			break;
 
 		/* Ignore CR and LF characters. */
-		if (ascii[0] != '\n' && ascii[0] != '\r') {
-			ERROR (file->context, "Unexpected character (0x%02x).", ascii[0]);
+		if (c != '\n' && c != '\r') {
+			ERROR (file->context, "Unexpected character (0x%02x).", c);
 			return DC_STATUS_DATAFORMAT;
 		}
 	}
 
-	/* Read the record length, address and type. */
-	n = fread (ascii + 1, 1, 8, file->fp);
-	if (n != 8) {
+	/* Check the record length, address and type. */
+	ascii = file->data + file->offset - 1;
+	if (file->size - file->offset < 8) {
 		ERROR (file->context, "Failed to read the header.");
 		return DC_STATUS_IO;
 	}
@@ -116,12 +116,12 @@ dc_ihex_file_read (dc_ihex_file_t *file, dc_ihex_entry_t *entry)
 	/* Get the record length. */
 	length = data[0];
 
-	/* Read the record payload. */
-	n = fread (ascii + 9, 1, 2 * length + 2, file->fp);
-	if (n != 2 * length + 2) {
+	/* Check the record payload. */
+	if (file->size - file->offset - 8 < 2 * length + 2) {
 		ERROR (file->context, "Failed to read the data.");
 		return DC_STATUS_IO;
 	}
+	file->offset += 8 + 2 * length + 2;
 
 	/* Convert to binary representation. */
 	if (array_convert_hex2bin (ascii + 9, 2 * length + 2, data + 4, length + 1) != 0) {
@@ -189,7 +189,7 @@ dc_ihex_file_reset (dc_ihex_file_t *file)
 		return DC_STATUS_INVALIDARGS;
 	}
 
-	rewind (file->fp);
+	file->offset = 0;
 
 	return DC_STATUS_SUCCESS;
 }
@@ -198,7 +198,7 @@ dc_status_t
 dc_ihex_file_close (dc_ihex_file_t *file)
 {
 	if (file) {
-		fclose (file->fp);
+		dc_filemap_close (file->filemap);
 		free (file);
 	}
 
@@ -26,6 +26,8 @@
 #include <libdivecomputer/context.h>
 #include <libdivecomputer/iostream.h>
 
+#include "timer.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -36,6 +38,16 @@ struct dc_iostream_t {
 	const dc_iostream_vtable_t *vtable;
 	dc_context_t *context;
 	dc_transport_t transport;
+	unsigned int nonblocking;
+	unsigned int blocked;
+	/* Statistics. */
+	dc_iostream_stats_t stats;
+	dc_timer_t *timer;
+	dc_usecs_t request;
+	unsigned int pending;
+	unsigned int failed;
+	unsigned int hash;
+	size_t lastsize;
 };
 
 struct dc_iostream_vtable_t {
@@ -57,6 +69,8 @@ struct dc_iostream_vtable_t {
 
 	dc_status_t (*poll) (dc_iostream_t *iostream, int timeout);
 
+	dc_status_t (*get_pollfd) (dc_iostream_t *iostream, dc_pollfd_t pollfd[], size_t size, size_t *actual);
+
 	dc_status_t (*read) (dc_iostream_t *iostream, void *data, size_t size, size_t *actual);
 
 	dc_status_t (*write) (dc_iostream_t *iostream, const void *data, size_t size, size_t *actual);
@@ -81,6 +95,13 @@ dc_iostream_deallocate (dc_iostream_t *iostream);
 int
 dc_iostream_isinstance (dc_iostream_t *iostream, const dc_iostream_vtable_t *vtable);
 
+/*
+ * Get the current time of the I/O stream clock, in microseconds. Zero is
+ * returned if no clock is available.
+ */
+dc_usecs_t
+dc_iostream_now (dc_iostream_t *iostream);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
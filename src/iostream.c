@@ -21,6 +21,7 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include <libdivecomputer/ioctl.h>
@@ -28,6 +29,7 @@
 #include "iostream-private.h"
 #include "context-private.h"
 #include "platform.h"
+#include "array.h"
 
 dc_iostream_t *
 dc_iostream_allocate (dc_context_t *context, const dc_iostream_vtable_t *vtable, dc_transport_t transport)
@@ -48,6 +50,19 @@ dc_iostream_allocate (dc_context_t *context, const dc_iostream_vtable_t *vtable,
 	iostream->vtable = vtable;
 	iostream->context = context;
 	iostream->transport = transport;
+	iostream->nonblocking = 0;
+	iostream->blocked = 0;
+
+	// Initialize the statistics. Without a timer, only the durations are
+	// missing.
+	memset (&iostream->stats, 0, sizeof (iostream->stats));
+	iostream->timer = NULL;
+	iostream->request = 0;
+	iostream->pending = 0;
+	iostream->failed = 0;
+	iostream->hash = 0;
+	iostream->lastsize = 0;
+	dc_timer_new (&iostream->timer);
 
 	return iostream;
 }
@@ -55,6 +70,10 @@ dc_iostream_allocate (dc_context_t *context, const dc_iostream_vtable_t *vtable,
 void
 dc_iostream_deallocate (dc_iostream_t *iostream)
 {
+	if (iostream == NULL)
+		return;
+
+	dc_timer_free (iostream->timer);
 	free (iostream);
 }
 
@@ -67,6 +86,52 @@ dc_iostream_isinstance (dc_iostream_t *iostream, const dc_iostream_vtable_t *vta
 	return iostream->vtable == vtable;
 }
 
+dc_usecs_t
+dc_iostream_now (dc_iostream_t *iostream)
+{
+	dc_usecs_t now = 0;
+
+	if (iostream->timer)
+		dc_timer_now (iostream->timer, &now);
+
+	return now;
+}
+
+static void
+dc_iostream_histogram (unsigned int histogram[], dc_usecs_t duration)
+{
+	unsigned int n = 0;
+	while (duration > 1 && n < DC_IOSTREAM_NBUCKETS - 1) {
+		duration >>= 1;
+		n++;
+	}
+
+	histogram[n]++;
+}
+
+static dc_status_t
+dc_iostream_count (dc_iostream_t *iostream, dc_status_t status)
+{
+	iostream->stats.ncalls++;
+
+	if (status == DC_STATUS_TIMEOUT)
+		iostream->stats.ntimeouts++;
+
+	return status;
+}
+
+static unsigned int
+dc_iostream_hash (const unsigned char data[], size_t size)
+{
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= data[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
 dc_transport_t
 dc_iostream_get_transport (dc_iostream_t *iostream)
 {
@@ -84,7 +149,7 @@ dc_iostream_set_timeout (dc_iostream_t *iostream, int timeout)
 
 	INFO (iostream->context, "Timeout: value=%i", timeout);
 
-	return iostream->vtable->set_timeout (iostream, timeout);
+	return dc_iostream_count (iostream, iostream->vtable->set_timeout (iostream, timeout));
 }
 
 dc_status_t
@@ -95,7 +160,7 @@ dc_iostream_set_break (dc_iostream_t *iostream, unsigned int value)
 
 	INFO (iostream->context, "Break: value=%i", value);
 
-	return iostream->vtable->set_break (iostream, value);
+	return dc_iostream_count (iostream, iostream->vtable->set_break (iostream, value));
 }
 
 dc_status_t
@@ -106,7 +171,7 @@ dc_iostream_set_dtr (dc_iostream_t *iostream, unsigned int value)
 
 	INFO (iostream->context, "DTR: value=%i", value);
 
-	return iostream->vtable->set_dtr (iostream, value);
+	return dc_iostream_count (iostream, iostream->vtable->set_dtr (iostream, value));
 }
 
 dc_status_t
@@ -117,7 +182,7 @@ dc_iostream_set_rts (dc_iostream_t *iostream, unsigned int value)
 
 	INFO (iostream->context, "RTS: value=%i", value);
 
-	return iostream->vtable->set_rts (iostream, value);
+	return dc_iostream_count (iostream, iostream->vtable->set_rts (iostream, value));
 }
 
 dc_status_t
@@ -130,7 +195,7 @@ dc_iostream_get_lines (dc_iostream_t *iostream, unsigned int *value)
 		goto out;
 	}
 
-	status = iostream->vtable->get_lines (iostream, &lines);
+	status = dc_iostream_count (iostream, iostream->vtable->get_lines (iostream, &lines));
 
 	INFO (iostream->context, "Lines: value=%u", lines);
 
@@ -151,7 +216,7 @@ dc_iostream_get_available (dc_iostream_t *iostream, size_t *value)
 		goto out;
 	}
 
-	status = iostream->vtable->get_available (iostream, &available);
+	status = dc_iostream_count (iostream, iostream->vtable->get_available (iostream, &available));
 
 	INFO (iostream->context, "Available: value=" DC_PRINTF_SIZE, available);
 
@@ -171,7 +236,7 @@ dc_iostream_configure (dc_iostream_t *iostream, unsigned int baudrate, unsigned
 	INFO (iostream->context, "Configure: baudrate=%i, databits=%i, parity=%i, stopbits=%i, flowcontrol=%i",
 		baudrate, databits, parity, stopbits, flowcontrol);
 
-	return iostream->vtable->configure (iostream, baudrate, databits, parity, stopbits, flowcontrol);
+	return dc_iostream_count (iostream, iostream->vtable->configure (iostream, baudrate, databits, parity, stopbits, flowcontrol));
 }
 
 dc_status_t
@@ -182,7 +247,59 @@ dc_iostream_poll (dc_iostream_t *iostream, int timeout)
 
 	INFO (iostream->context, "Poll: value=%i", timeout);
 
-	return iostream->vtable->poll (iostream, timeout);
+	dc_status_t status = dc_iostream_count (iostream, iostream->vtable->poll (iostream, timeout));
+	if (status != DC_STATUS_SUCCESS)
+		iostream->failed = 1;
+
+	return status;
+}
+
+dc_status_t
+dc_iostream_get_pollfd (dc_iostream_t *iostream, dc_pollfd_t pollfd[], size_t size, size_t *actual)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	size_t count = 0;
+
+	if (iostream == NULL || iostream->vtable->get_pollfd == NULL) {
+		status = DC_STATUS_UNSUPPORTED;
+		goto out;
+	}
+
+	status = iostream->vtable->get_pollfd (iostream, pollfd, size, &count);
+
+	INFO (iostream->context, "Pollfd: count=" DC_PRINTF_SIZE, count);
+
+out:
+	if (actual)
+		*actual = count;
+
+	return status;
+}
+
+dc_status_t
+dc_iostream_set_nonblocking (dc_iostream_t *iostream, unsigned int value)
+{
+	if (iostream == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	INFO (iostream->context, "Nonblocking: value=%i", value ? 1 : 0);
+
+	if (value) {
+		// The number of available bytes is required to read without
+		// blocking.
+		if (iostream->vtable->get_available == NULL)
+			return DC_STATUS_UNSUPPORTED;
+
+		size_t available = 0;
+		dc_status_t status = iostream->vtable->get_available (iostream, &available);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+	}
+
+	iostream->nonblocking = value ? 1 : 0;
+	iostream->blocked = 0;
+
+	return DC_STATUS_SUCCESS;
 }
 
 dc_status_t
@@ -195,7 +312,36 @@ dc_iostream_read (dc_iostream_t *iostream, void *data, size_t size, size_t *actu
 		goto out;
 	}
 
-	status = iostream->vtable->read (iostream, data, size, &nbytes);
+	if (iostream->nonblocking) {
+		size_t available = 0;
+		status = dc_iostream_count (iostream, iostream->vtable->get_available (iostream, &available));
+		if (status != DC_STATUS_SUCCESS)
+			goto out;
+
+		if (available == 0) {
+			status = DC_STATUS_WOULDBLOCK;
+			goto out;
+		}
+
+		if (size > available)
+			size = available;
+	}
+
+	dc_usecs_t begin = dc_iostream_now (iostream);
+
+	status = dc_iostream_count (iostream, iostream->vtable->read (iostream, data, size, &nbytes));
+
+	dc_usecs_t end = dc_iostream_now (iostream);
+
+	iostream->stats.nreads++;
+	iostream->stats.nbytes_in += nbytes;
+	dc_iostream_histogram (iostream->stats.read, end - begin);
+	if (nbytes && iostream->pending) {
+		dc_iostream_histogram (iostream->stats.latency, end - iostream->request);
+		iostream->pending = 0;
+	}
+	if (status != DC_STATUS_SUCCESS)
+		iostream->failed = 1;
 
 	HEXDUMP (iostream->context, DC_LOGLEVEL_INFO, "Read", (unsigned char *) data, nbytes);
 
@@ -216,7 +362,32 @@ dc_iostream_write (dc_iostream_t *iostream, const void *data, size_t size, size_
 		goto out;
 	}
 
-	status = iostream->vtable->write (iostream, data, size, &nbytes);
+	// A write repeating the previous write after a failure is most
+	// likely a retransmit by the backend.
+	unsigned int hash = dc_iostream_hash ((const unsigned char *) data, size);
+	if (iostream->failed && iostream->lastsize == size && iostream->hash == hash)
+		iostream->stats.nretransmits++;
+	iostream->failed = 0;
+	iostream->hash = hash;
+	iostream->lastsize = size;
+
+	dc_usecs_t begin = dc_iostream_now (iostream);
+
+	status = dc_iostream_count (iostream, iostream->vtable->write (iostream, data, size, &nbytes));
+
+	dc_usecs_t end = dc_iostream_now (iostream);
+
+	iostream->stats.nwrites++;
+	iostream->stats.nbytes_out += nbytes;
+	dc_iostream_histogram (iostream->stats.write, end - begin);
+	iostream->request = end;
+	iostream->pending = 1;
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_WOULDBLOCK)
+		iostream->failed = 1;
+
+	// Remember whether the data was only partially written, to wait for
+	// the stream to become writable again.
+	iostream->blocked = iostream->nonblocking && nbytes < size;
 
 	HEXDUMP (iostream->context, DC_LOGLEVEL_INFO, "Write", (const unsigned char *) data, nbytes);
 
@@ -252,7 +423,7 @@ dc_iostream_ioctl (dc_iostream_t *iostream, unsigned int request, void *data, si
 		HEXDUMP (iostream->context, DC_LOGLEVEL_INFO, "Ioctl write", (unsigned char *) data, size);
 	}
 
-	status = iostream->vtable->ioctl (iostream, request, data, size);
+	status = dc_iostream_count (iostream, iostream->vtable->ioctl (iostream, request, data, size));
 
 	if (DC_IOCTL_DIR(request) & DC_IOCTL_DIR_READ) {
 		HEXDUMP (iostream->context, DC_LOGLEVEL_INFO, "Ioctl read", (unsigned char *) data, size);
@@ -269,7 +440,7 @@ dc_iostream_flush (dc_iostream_t *iostream)
 
 	INFO (iostream->context, "Flush: none");
 
-	return iostream->vtable->flush (iostream);
+	return dc_iostream_count (iostream, iostream->vtable->flush (iostream));
 }
 
 dc_status_t
@@ -280,7 +451,13 @@ dc_iostream_purge (dc_iostream_t *iostream, dc_direction_t direction)
 
 	INFO (iostream->context, "Purge: direction=%u", direction);
 
-	return iostream->vtable->purge (iostream, direction);
+	iostream->stats.npurges++;
+
+	dc_status_t status = dc_iostream_count (iostream, iostream->vtable->purge (iostream, direction));
+	if (status != DC_STATUS_SUCCESS)
+		iostream->failed = 1;
+
+	return status;
 }
 
 dc_status_t
@@ -294,6 +471,17 @@ dc_iostream_sleep (dc_iostream_t *iostream, unsigned int milliseconds)
 	return iostream->vtable->sleep (iostream, milliseconds);
 }
 
+dc_status_t
+dc_iostream_get_stats (dc_iostream_t *iostream, dc_iostream_stats_t *stats)
+{
+	if (iostream == NULL || stats == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	*stats = iostream->stats;
+
+	return DC_STATUS_SUCCESS;
+}
+
 dc_status_t
 dc_iostream_close (dc_iostream_t *iostream)
 {
@@ -96,6 +96,7 @@ static const dc_iostream_vtable_t dc_irda_vtable = {
 	dc_socket_get_available, /* get_available */
 	NULL, /* configure */
 	dc_socket_poll, /* poll */
+	dc_socket_get_pollfd, /* get_pollfd */
 	dc_socket_read, /* read */
 	dc_socket_write, /* write */
 	dc_socket_ioctl, /* ioctl */
@@ -100,6 +100,7 @@ static const dc_device_vtable_t liquivision_lynx_device_vtable = {
 	NULL, /* write */
 	liquivision_lynx_device_dump, /* dump */
 	liquivision_lynx_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	NULL, /* timesync */
 	liquivision_lynx_device_close /* close */
 };
@@ -387,7 +388,7 @@ liquivision_lynx_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 
 	// Download the memory dump.
 	return device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), SEGMENTSIZE);
+		dc_buffer_get_size (buffer), SEGMENTSIZE, SEGMENTSIZE);
 }
 
 static dc_status_t
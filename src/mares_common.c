@@ -25,6 +25,7 @@
 
 #include "context-private.h"
 #include "mares_common.h"
+#include "rbstream.h"
 #include "checksum.h"
 #include "array.h"
 
@@ -203,38 +204,45 @@ mares_common_device_read (dc_device_t *abstract, unsigned int address, unsigned
 }
 
 
-dc_status_t
-mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *layout, const unsigned char fingerprint[], const unsigned char data[], dc_dive_callback_t callback, void *userdata)
+/*
+ * The profile ringbuffer is processed from a linear buffer, with the
+ * newest dive at the end. For a memory dump, the buffer is filled
+ * completely in advance. When streaming, the buffer is filled backwards
+ * on demand, such that no more data is downloaded than necessary.
+ */
+typedef struct mares_common_stream_t {
+	dc_device_t *device;
+	dc_rbstream_t *rbstream;
+	dc_event_progress_t *progress;
+	unsigned int available;
+	unsigned char *freedives;
+} mares_common_stream_t;
+
+static dc_status_t
+mares_common_stream_fill (mares_common_stream_t *stream, unsigned char buffer[], unsigned int offset)
 {
-	assert (layout != NULL);
+	if (stream == NULL || offset >= stream->available)
+		return DC_STATUS_SUCCESS;
+
+	dc_status_t rc = dc_rbstream_read (stream->rbstream, stream->progress, buffer + offset, stream->available - offset);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	stream->available = offset;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+mares_common_extract (dc_context_t *context, const mares_common_layout_t *layout, unsigned int model, const unsigned char fingerprint[], unsigned char buffer[], const unsigned char freedives[], mares_common_stream_t *stream, dc_dive_callback_t callback, void *userdata)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
 
 	// Get the freedive mode for this model.
-	unsigned int model = data[1];
 	unsigned int freedive = FREEDIVE;
 	if (model == NEMOWIDE || model == NEMOAIR || model == PUCK || model == PUCKAIR)
 		freedive = GAUGE;
 
-	// Get the end of the profile ring buffer.
-	unsigned int eop = array_uint16_le (data + 0x6B);
-	if (eop < layout->rb_profile_begin || eop >= layout->rb_profile_end) {
-		ERROR (context, "Ringbuffer pointer out of range (0x%04x).", eop);
-		return DC_STATUS_DATAFORMAT;
-	}
-
-	// Make the ringbuffer linear, to avoid having to deal
-	// with the wrap point. The buffer has extra space to
-	// store the profile data for the freedives.
-	unsigned char *buffer = (unsigned char *) malloc (
-		layout->rb_profile_end - layout->rb_profile_begin +
-		layout->rb_freedives_end - layout->rb_freedives_begin);
-	if (buffer == NULL) {
-		ERROR (context, "Failed to allocate memory.");
-		return DC_STATUS_NOMEMORY;
-	}
-
-	memcpy (buffer + 0, data + eop, layout->rb_profile_end - eop);
-	memcpy (buffer + layout->rb_profile_end - eop, data + layout->rb_profile_begin, eop - layout->rb_profile_begin);
-
 	// For a freedive session, the Mares Nemo stores all the freedives of
 	// that session in a single logbook entry, and each sample is actually
 	// a summary for each individual freedive in the session. The profile
@@ -247,6 +255,10 @@ mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *
 	while (offset >= 3) {
 		// Check for the presence of extra header bytes, which can be detected
 		// by means of a three byte marker sequence.
+		rc = mares_common_stream_fill (stream, buffer, offset - 3);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+
 		unsigned int extra = 0;
 		const unsigned char marker[3] = {0xAA, 0xBB, 0xCC};
 		if (memcmp (buffer + offset - 3, marker, sizeof (marker)) == 0) {
@@ -260,6 +272,10 @@ mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *
 		if (offset < extra + 3)
 			break;
 
+		rc = mares_common_stream_fill (stream, buffer, offset - extra - 3);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+
 		// Check the dive mode of the logbook entry. Valid modes are
 		// 0 (air), 1 (EANx), 2 (freedive) or 3 (bottom timer).
 		// If the ringbuffer has never reached the wrap point before,
@@ -299,13 +315,16 @@ mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *
 		// Move to the start of the dive.
 		offset -= nbytes;
 
+		rc = mares_common_stream_fill (stream, buffer, offset);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+
 		// Verify that the length that is stored in the profile data
 		// equals the calculated length. If both values are different,
 		// something is wrong and an error is returned.
 		unsigned int length = array_uint16_le (buffer + offset);
 		if (length != nbytes) {
 			ERROR (context, "Calculated and stored size are not equal (%u %u).", length, nbytes);
-			free (buffer);
 			return DC_STATUS_DATAFORMAT;
 		}
 
@@ -313,6 +332,25 @@ mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *
 		// Since we are processing the entries backwards (newest to oldest),
 		// this entry will always be the first one.
 		if (mode == freedive && nfreedives == 1) {
+			// Download the freedive profile data.
+			unsigned int size = layout->rb_freedives_end - layout->rb_freedives_begin;
+			if (freedives == NULL && stream != NULL && size) {
+				stream->freedives = (unsigned char *) malloc (size);
+				if (stream->freedives == NULL) {
+					ERROR (context, "Failed to allocate memory.");
+					return DC_STATUS_NOMEMORY;
+				}
+
+				rc = dc_device_read (stream->device, layout->rb_freedives_begin, stream->freedives, size);
+				if (rc != DC_STATUS_SUCCESS)
+					return rc;
+
+				stream->progress->current += size;
+				device_event_emit (stream->device, DC_EVENT_PROGRESS, stream->progress);
+
+				freedives = stream->freedives;
+			}
+
 			// Count the number of freedives in the profile data.
 			unsigned int count = 0;
 			unsigned int idx = layout->rb_freedives_begin;
@@ -320,7 +358,7 @@ mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *
 				count != nsamples)
 			{
 				// Each freedive in the session ends with a zero sample.
-				unsigned int sample = array_uint16_le (data + idx);
+				unsigned int sample = array_uint16_le (freedives + idx - layout->rb_freedives_begin);
 				if (sample == 0)
 					count++;
 
@@ -333,30 +371,138 @@ mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *
 			// both values are different, the profile data is incomplete.
 			if (count != nsamples) {
 				ERROR (context, "Unexpected number of freedive sessions (%u %u).", count, nsamples);
-				free (buffer);
 				return DC_STATUS_DATAFORMAT;
 			}
 
 			// Append the profile data to the main logbook entry. The
 			// buffer is guaranteed to have enough space, and the dives
 			// that will be overwritten have already been processed.
-			memcpy (buffer + offset + nbytes, data + layout->rb_freedives_begin, idx - layout->rb_freedives_begin);
-			nbytes += idx - layout->rb_freedives_begin;
+			if (idx > layout->rb_freedives_begin) {
+				memcpy (buffer + offset + nbytes, freedives, idx - layout->rb_freedives_begin);
+				nbytes += idx - layout->rb_freedives_begin;
+			}
 		}
 
 		unsigned int fp_offset = offset + length - extra - FP_OFFSET;
-		if (fingerprint && memcmp (buffer + fp_offset, fingerprint, FP_SIZE) == 0) {
-			free (buffer);
+		if (fingerprint && memcmp (buffer + fp_offset, fingerprint, FP_SIZE) == 0)
 			return DC_STATUS_SUCCESS;
-		}
 
-		if (callback && !callback (buffer + offset, nbytes, buffer + fp_offset, FP_SIZE, userdata)) {
-			free (buffer);
+		if (callback && !callback (buffer + offset, nbytes, buffer + fp_offset, FP_SIZE, userdata))
 			return DC_STATUS_SUCCESS;
-		}
 	}
 
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *layout, const unsigned char fingerprint[], const unsigned char data[], dc_dive_callback_t callback, void *userdata)
+{
+	assert (layout != NULL);
+
+	// Get the end of the profile ring buffer.
+	unsigned int eop = array_uint16_le (data + 0x6B);
+	if (eop < layout->rb_profile_begin || eop >= layout->rb_profile_end) {
+		ERROR (context, "Ringbuffer pointer out of range (0x%04x).", eop);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	// Make the ringbuffer linear, to avoid having to deal
+	// with the wrap point. The buffer has extra space to
+	// store the profile data for the freedives.
+	unsigned char *buffer = (unsigned char *) malloc (
+		layout->rb_profile_end - layout->rb_profile_begin +
+		layout->rb_freedives_end - layout->rb_freedives_begin);
+	if (buffer == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	memcpy (buffer + 0, data + eop, layout->rb_profile_end - eop);
+	memcpy (buffer + layout->rb_profile_end - eop, data + layout->rb_profile_begin, eop - layout->rb_profile_begin);
+
+	dc_status_t rc = mares_common_extract (context, layout, data[1], fingerprint,
+		buffer, data + layout->rb_freedives_begin, NULL, callback, userdata);
+
 	free (buffer);
 
-	return DC_STATUS_SUCCESS;
+	return rc;
+}
+
+
+dc_status_t
+mares_common_device_foreach (dc_device_t *abstract, const mares_common_layout_t *layout, const unsigned char fingerprint[], dc_dive_callback_t callback, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_rbstream_t *rbstream = NULL;
+
+	assert (layout != NULL);
+
+	unsigned int rb_profile_size = layout->rb_profile_end - layout->rb_profile_begin;
+	unsigned int rb_freedives_size = layout->rb_freedives_end - layout->rb_freedives_begin;
+
+	// Allocate memory for the linear profile buffer. The buffer has extra
+	// space to store the profile data for the freedives. Initially, it's
+	// used to store the header.
+	unsigned char *buffer = (unsigned char *) malloc (rb_profile_size + rb_freedives_size);
+	if (buffer == NULL) {
+		ERROR (abstract->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	// Enable progress notifications.
+	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
+	progress.maximum = layout->rb_profile_begin + rb_profile_size + rb_freedives_size;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	// Read the header.
+	status = dc_device_read (abstract, 0, buffer, layout->rb_profile_begin);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to read the header.");
+		goto error_free;
+	}
+
+	unsigned int model = buffer[1];
+
+	// Emit a device info event.
+	dc_event_devinfo_t devinfo;
+	devinfo.model = model;
+	devinfo.firmware = 0;
+	devinfo.serial = array_uint16_be (buffer + 8);
+	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
+
+	// Update and emit a progress event.
+	progress.current += layout->rb_profile_begin;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	// Get the end of the profile ring buffer.
+	unsigned int eop = array_uint16_le (buffer + 0x6B);
+	if (eop < layout->rb_profile_begin || eop >= layout->rb_profile_end) {
+		ERROR (abstract->context, "Ringbuffer pointer out of range (0x%04x).", eop);
+		status = DC_STATUS_DATAFORMAT;
+		goto error_free;
+	}
+
+	// Create the ringbuffer stream.
+	status = dc_rbstream_new (&rbstream, abstract, 1, PACKETSIZE * 4, layout->rb_profile_begin, layout->rb_profile_end, eop, DC_RBSTREAM_BACKWARD);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to create the ringbuffer stream.");
+		goto error_free;
+	}
+
+	// Download and process the dives, newest first, and stop as soon as
+	// the fingerprint is found.
+	mares_common_stream_t stream = {abstract, rbstream, &progress, rb_profile_size, NULL};
+	status = mares_common_extract (abstract->context, layout, model, fingerprint,
+		buffer, NULL, &stream, callback, userdata);
+
+	// Update and emit a progress event.
+	progress.maximum = progress.current;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	free (stream.freedives);
+	dc_rbstream_free (rbstream);
+error_free:
+	free (buffer);
+	return status;
 }
@@ -30,6 +30,7 @@
 #include "context-private.h"
 #include "device-private.h"
 #include "array.h"
+#include "rbstream.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &mares_darwin_device_vtable)
 
@@ -69,6 +70,7 @@ static const dc_device_vtable_t mares_darwin_device_vtable = {
 	NULL, /* write */
 	mares_darwin_device_dump, /* dump */
 	mares_darwin_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -93,9 +95,6 @@ static const mares_darwin_layout_t mares_darwinair_layout = {
 	3       /* samplesize */
 };
 
-static dc_status_t
-mares_darwin_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
-
 dc_status_t
 mares_darwin_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_t *iostream, unsigned int model)
 {
@@ -202,7 +201,7 @@ mares_darwin_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 
 	// Download the memory dump.
 	status = device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), PACKETSIZE);
+		dc_buffer_get_size (buffer), PACKETSIZE / 4, PACKETSIZE);
 	if (status != DC_STATUS_SUCCESS) {
 		return status;
 	}
@@ -222,109 +221,117 @@ mares_darwin_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 static dc_status_t
 mares_darwin_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
+	dc_status_t status = DC_STATUS_SUCCESS;
 	mares_darwin_device_t *device = (mares_darwin_device_t *) abstract;
+	dc_rbstream_t *rbstream = NULL;
 
 	assert (device->layout != NULL);
 
-	dc_buffer_t *buffer = dc_buffer_new (device->layout->memsize);
-	if (buffer == NULL)
-		return DC_STATUS_NOMEMORY;
-
-	dc_status_t rc = mares_darwin_device_dump (abstract, buffer);
-	if (rc != DC_STATUS_SUCCESS) {
-		dc_buffer_free (buffer);
-		return rc;
-	}
-
-	rc = mares_darwin_extract_dives (abstract, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), callback, userdata);
+	const mares_darwin_layout_t *layout = device->layout;
 
-	dc_buffer_free (buffer);
+	unsigned int rb_logbook_end = layout->rb_logbook_offset + layout->rb_logbook_count * layout->rb_logbook_size;
+	unsigned int rb_profile_size = layout->rb_profile_end - layout->rb_profile_begin;
 
-	return rc;
-}
+	// Enable progress notifications.
+	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
+	progress.maximum = rb_logbook_end + rb_profile_size;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
+	// Allocate memory for the header and logbook, and the largest possible dive.
+	unsigned char *logbook = (unsigned char *) malloc (rb_logbook_end);
+	unsigned char *buffer = (unsigned char *) malloc (layout->rb_logbook_size + rb_profile_size);
+	if (logbook == NULL || buffer == NULL) {
+		ERROR (abstract->context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
 
-static dc_status_t
-mares_darwin_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata)
-{
-	mares_darwin_device_t *device = (mares_darwin_device_t *) abstract;
-
-	if (!ISINSTANCE (abstract))
-		return DC_STATUS_INVALIDARGS;
+	// Read the header and the logbook entries.
+	status = dc_device_read (abstract, 0, logbook, rb_logbook_end);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to read the logbook.");
+		goto error_free;
+	}
 
-	assert (device->layout != NULL);
+	// Update and emit a progress event.
+	progress.current += rb_logbook_end;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
-	const mares_darwin_layout_t *layout = device->layout;
+	// Emit a device info event.
+	dc_event_devinfo_t devinfo;
+	devinfo.model = device->model;
+	devinfo.firmware = 0;
+	devinfo.serial = array_uint16_be (logbook + 8);
+	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
 
 	// Get the profile pointer.
-	unsigned int eop = array_uint16_be (data + 0x8A);
+	unsigned int eop = array_uint16_be (logbook + 0x8A);
 	if (eop < layout->rb_profile_begin || eop >= layout->rb_profile_end) {
 		ERROR (abstract->context, "Invalid ringbuffer pointer detected (0x%04x).", eop);
-		return DC_STATUS_DATAFORMAT;
+		status = DC_STATUS_DATAFORMAT;
+		goto error_free;
 	}
 
 	// Get the logbook index.
-	unsigned int last = data[0x8C];
+	unsigned int last = logbook[0x8C];
 	if (last >= layout->rb_logbook_count) {
 		ERROR (abstract->context, "Invalid ringbuffer pointer detected (0x%02x).", last);
-		return DC_STATUS_DATAFORMAT;
+		status = DC_STATUS_DATAFORMAT;
+		goto error_free;
 	}
 
-	// Allocate memory for the largest possible dive.
-	unsigned char *buffer = (unsigned char *) malloc (layout->rb_logbook_size + layout->rb_profile_end - layout->rb_profile_begin);
-	if (buffer == NULL) {
-		ERROR (abstract->context, "Failed to allocate memory.");
-		return DC_STATUS_NOMEMORY;
+	// Create the ringbuffer stream.
+	status = dc_rbstream_new (&rbstream, abstract, 1, PACKETSIZE * 4, layout->rb_profile_begin, layout->rb_profile_end, eop, DC_RBSTREAM_BACKWARD);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to create the ringbuffer stream.");
+		goto error_free;
 	}
 
 	// The logbook ringbuffer can store a fixed amount of entries, but there
 	// is no guarantee that the profile ringbuffer will contain a profile for
 	// each entry. The number of remaining bytes (which is initialized to the
 	// largest possible value) is used to detect the last valid profile.
-	unsigned int remaining = layout->rb_profile_end - layout->rb_profile_begin;
+	unsigned int remaining = rb_profile_size;
 
-	unsigned int current = eop;
 	for (unsigned int i = 0; i < layout->rb_logbook_count; ++i) {
 		// Get the offset to the current logbook entry in the ringbuffer.
 		unsigned int idx = (layout->rb_logbook_count + last - i) % layout->rb_logbook_count;
 		unsigned int offset = layout->rb_logbook_offset + idx * layout->rb_logbook_size;
 
 		// Get the length of the current dive.
-		unsigned int nsamples = array_uint16_be (data + offset + 6);
+		unsigned int nsamples = array_uint16_be (logbook + offset + 6);
 		unsigned int length = nsamples * layout->samplesize;
 		if (nsamples == 0xFFFF || length > remaining)
 			break;
 
+		// Stop before downloading the profile data of a dive that has
+		// already been downloaded.
+		if (memcmp (logbook + offset, device->fingerprint, sizeof (device->fingerprint)) == 0)
+			break;
+
 		// Copy the logbook entry.
-		memcpy (buffer, data + offset, layout->rb_logbook_size);
-
-		// Copy the profile data.
-		if (current < layout->rb_profile_begin + length) {
-			unsigned int a = current - layout->rb_profile_begin;
-			unsigned int b = length - a;
-			memcpy (buffer + layout->rb_logbook_size, data + layout->rb_profile_end - b, b);
-			memcpy (buffer + layout->rb_logbook_size + b, data + layout->rb_profile_begin, a);
-			current = layout->rb_profile_end - b;
-		} else {
-			memcpy (buffer + layout->rb_logbook_size, data + current - length, length);
-			current -= length;
-		}
+		memcpy (buffer, logbook + offset, layout->rb_logbook_size);
 
-		if (memcmp (buffer, device->fingerprint, sizeof (device->fingerprint)) == 0) {
-			free (buffer);
-			return DC_STATUS_SUCCESS;
+		// Read the profile data.
+		status = dc_rbstream_read (rbstream, &progress, buffer + layout->rb_logbook_size, length);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to read the dive.");
+			goto error_free;
 		}
 
-		if (callback && !callback (buffer, layout->rb_logbook_size + length, buffer, 6, userdata)) {
-			free (buffer);
-			return DC_STATUS_SUCCESS;
-		}
+		if (callback && !callback (buffer, layout->rb_logbook_size + length, buffer, 6, userdata))
+			break;
 
 		remaining -= length;
 	}
 
-	free (buffer);
+	// Update and emit a progress event.
+	progress.maximum = progress.current;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
 
-	return DC_STATUS_SUCCESS;
+error_free:
+	dc_rbstream_free (rbstream);
+	free (buffer);
+	free (logbook);
+	return status;
 }
@@ -29,6 +29,7 @@
 #include "rbstream.h"
 #include "platform.h"
 #include "packet.h"
+#include "transaction.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &mares_iconhd_device_vtable)
 
@@ -125,6 +126,7 @@ typedef struct mares_iconhd_model_t {
 typedef struct mares_iconhd_device_t {
 	dc_device_t base;
 	dc_iostream_t *iostream;
+	dc_transaction_t transaction;
 	const mares_iconhd_layout_t *layout;
 	unsigned char fingerprint[10];
 	unsigned int fingerprint_size;
@@ -149,6 +151,7 @@ static const dc_device_vtable_t mares_iconhd_device_vtable = {
 	NULL, /* write */
 	mares_iconhd_device_dump, /* dump */
 	mares_iconhd_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	mares_iconhd_device_timesync, /* timesync */
 	mares_iconhd_device_close /* close */
 };
@@ -410,27 +413,30 @@ mares_iconhd_packet (mares_iconhd_device_t *device,
 	}
 }
 
+typedef struct mares_iconhd_transfer_t {
+	unsigned char cmd;
+	const unsigned char *data;
+	unsigned int size;
+	unsigned char *answer;
+	unsigned int asize;
+	unsigned int *actual;
+} mares_iconhd_transfer_t;
+
 static dc_status_t
-mares_iconhd_transfer (mares_iconhd_device_t *device, unsigned char cmd, const unsigned char data[], unsigned int size, unsigned char answer[], unsigned int asize, unsigned int *actual)
+mares_iconhd_transfer_attempt (dc_transaction_t *transaction, unsigned int attempt, void *userdata)
 {
-	unsigned int nretries = 0;
-	dc_status_t rc = DC_STATUS_SUCCESS;
-	while ((rc = mares_iconhd_packet (device, cmd, data, size, answer, asize, actual)) != DC_STATUS_SUCCESS) {
-		// Automatically discard a corrupted packet,
-		// and request a new one.
-		if (rc != DC_STATUS_PROTOCOL && rc != DC_STATUS_TIMEOUT)
-			return rc;
+	mares_iconhd_transfer_t *transfer = (mares_iconhd_transfer_t *) userdata;
+	mares_iconhd_device_t *device = (mares_iconhd_device_t *) transaction->device;
 
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
-			return rc;
+	return mares_iconhd_packet (device, transfer->cmd, transfer->data, transfer->size, transfer->answer, transfer->asize, transfer->actual);
+}
 
-		// Discard any garbage bytes.
-		dc_iostream_sleep (device->iostream, 1000);
-		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
-	}
+static dc_status_t
+mares_iconhd_transfer (mares_iconhd_device_t *device, unsigned char cmd, const unsigned char data[], unsigned int size, unsigned char answer[], unsigned int asize, unsigned int *actual)
+{
+	mares_iconhd_transfer_t transfer = {cmd, data, size, answer, asize, actual};
 
-	return DC_STATUS_SUCCESS;
+	return dc_transaction_run (&device->transaction, mares_iconhd_transfer_attempt, &transfer);
 }
 
 static dc_status_t
@@ -477,6 +483,19 @@ mares_iconhd_read_object(mares_iconhd_device_t *device, dc_event_progress_t *pro
 		// data packets. The first packet contains only the total size
 		// of the payload.
 		size = array_uint32_le (rsp_init + 4);
+
+		// An object can't be larger than the memory of the device.
+		if (size > device->layout->memsize) {
+			ERROR (abstract->context, "Unexpected object size (%u).", size);
+			return DC_STATUS_PROTOCOL;
+		}
+
+		// Pre-allocate the output buffer for the entire payload, to
+		// avoid re-allocating the buffer for every data packet.
+		if (!dc_buffer_reserve (buffer, dc_buffer_get_size (buffer) + size)) {
+			ERROR (abstract->context, "Insufficient buffer space available.");
+			return DC_STATUS_NOMEMORY;
+		}
 	} else if (rsp_init[0] == 0x42) {
 		// A short (and fixed size) payload is embedded into the first
 		// data packet.
@@ -604,6 +623,11 @@ mares_iconhd_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_
 		goto error_free_iostream;
 	}
 
+	// Retry failed transfers, and discard any garbage bytes. The delay is
+	// already long, so it's not increased on every retry.
+	dc_transaction_init (&device->transaction, (dc_device_t *) device, device->iostream, MAXRETRIES, 1000, DC_DIRECTION_INPUT);
+	dc_transaction_set_maxdelay (&device->transaction, 1000);
+
 	// Clear the DTR line.
 	status = dc_iostream_set_dtr (device->iostream, 0);
 	if (status != DC_STATUS_SUCCESS) {
@@ -799,7 +823,7 @@ mares_iconhd_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 
 	// Download the memory dump.
 	status = device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), device->packetsize);
+		dc_buffer_get_size (buffer), device->packetsize / 16, device->packetsize);
 	if (status != DC_STATUS_SUCCESS) {
 		return status;
 	}
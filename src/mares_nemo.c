@@ -60,6 +60,7 @@ static const dc_device_vtable_t mares_nemo_device_vtable = {
 	NULL, /* write */
 	mares_nemo_device_dump, /* dump */
 	mares_nemo_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	NULL, /* timesync */
 	NULL /* close */
 };
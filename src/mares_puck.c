@@ -55,6 +55,7 @@ static const dc_device_vtable_t mares_puck_device_vtable = {
 	NULL, /* write */
 	mares_puck_device_dump, /* dump */
 	mares_puck_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -205,7 +206,7 @@ mares_puck_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 
 	// Download the memory dump.
 	status = device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), PACKETSIZE);
+		dc_buffer_get_size (buffer), PACKETSIZE / 4, PACKETSIZE);
 	if (status != DC_STATUS_SUCCESS) {
 		return status;
 	}
@@ -229,20 +230,5 @@ mares_puck_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, v
 
 	assert (device->layout != NULL);
 
-	dc_buffer_t *buffer = dc_buffer_new (device->layout->memsize);
-	if (buffer == NULL)
-		return DC_STATUS_NOMEMORY;
-
-	dc_status_t rc = mares_puck_device_dump (abstract, buffer);
-	if (rc != DC_STATUS_SUCCESS) {
-		dc_buffer_free (buffer);
-		return rc;
-	}
-
-	rc = mares_common_extract_dives (abstract->context, device->layout, device->fingerprint,
-		dc_buffer_get_data (buffer), callback, userdata);
-
-	dc_buffer_free (buffer);
-
-	return rc;
+	return mares_common_device_foreach (abstract, device->layout, device->fingerprint, callback, userdata);
 }
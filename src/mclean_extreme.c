@@ -73,6 +73,7 @@ static const dc_device_vtable_t mclean_extreme_device_vtable = {
 	NULL, /* write */
 	NULL, /* dump */
 	mclean_extreme_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	mclean_extreme_device_timesync, /* timesync */
 	mclean_extreme_device_close, /* close */
 };
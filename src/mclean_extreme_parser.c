@@ -71,6 +71,7 @@ static const dc_parser_vtable_t mclean_extreme_parser_vtable = {
 	mclean_extreme_parser_get_datetime, /* datetime */
 	mclean_extreme_parser_get_field, /* fields */
 	mclean_extreme_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_foreach_fixed */
 	NULL /* destroy */
 };
 
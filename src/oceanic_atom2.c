@@ -32,6 +32,7 @@
 #include "ringbuffer.h"
 #include "checksum.h"
 #include "platform.h"
+#include "transaction.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &oceanic_atom2_device_vtable.base)
 
@@ -59,6 +60,7 @@
 typedef struct oceanic_atom2_device_t {
 	oceanic_common_device_t base;
 	dc_iostream_t *iostream;
+	dc_transaction_t transaction;
 	unsigned int handshake_repeat;
 	unsigned int handshake_counter;
 	unsigned int sequence;
@@ -83,6 +85,7 @@ static const oceanic_common_device_vtable_t oceanic_atom2_device_vtable = {
 		oceanic_atom2_device_write, /* write */
 		oceanic_common_device_dump, /* dump */
 		oceanic_common_device_foreach, /* foreach */
+		oceanic_common_device_foreach_step, /* foreach_step */
 		NULL, /* timesync */
 		oceanic_atom2_device_close /* close */
 	},
@@ -584,30 +587,44 @@ oceanic_atom2_ble_read (oceanic_atom2_device_t *device, unsigned char data[], un
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	dc_device_t *abstract = (dc_device_t *) device;
-	unsigned char buf[20];
+	unsigned char buf[MAXPACKET];
 	unsigned char cmd_seq = device->sequence;
 	unsigned char pkt_seq = 0;
 
+	// Some transports deliver several notifications in a single read
+	// (e.g. when the BLE MTU is larger than the packet size). The
+	// receive buffer is therefore large enough to hold multiple
+	// packets, which are processed one after the other.
+	unsigned int offset = 0, available = 0;
+
 	unsigned int nbytes = 0;
 	while (1) {
-		size_t transferred = 0;
-		rc = dc_iostream_read (device->iostream, buf, sizeof(buf), &transferred);
-		if (rc != DC_STATUS_SUCCESS)
-			return rc;
+		if (offset == available) {
+			size_t transferred = 0;
+			rc = dc_iostream_read (device->iostream, buf, sizeof(buf), &transferred);
+			if (rc != DC_STATUS_SUCCESS)
+				return rc;
 
-		if (transferred < 4) {
-			ERROR (abstract->context, "Invalid packet size (" DC_PRINTF_SIZE ").", transferred);
+			offset = 0;
+			available = transferred;
+		}
+
+		const unsigned char *packet = buf + offset;
+		unsigned int remaining = available - offset;
+
+		if (remaining < 4) {
+			ERROR (abstract->context, "Invalid packet size (%u).", remaining);
 			return DC_STATUS_PROTOCOL;
 		}
 
 		// Verify the start byte.
-		if (buf[0] != 0xcd) {
-			ERROR (abstract->context, "Unexpected packet start byte (%02x).", buf[0]);
+		if (packet[0] != 0xcd) {
+			ERROR (abstract->context, "Unexpected packet start byte (%02x).", packet[0]);
 			return DC_STATUS_PROTOCOL;
 		}
 
 		// Verify the status byte.
-		unsigned char status = buf[1];
+		unsigned char status = packet[1];
 		unsigned char expect = 0xc0 | (pkt_seq & 0x1F) | (status & 0x20);
 		if (status != expect) {
 			ERROR (abstract->context, "Unexpected packet status byte (%02x %02x).", status, expect);
@@ -615,14 +632,14 @@ oceanic_atom2_ble_read (oceanic_atom2_device_t *device, unsigned char data[], un
 		}
 
 		// Verify the sequence byte.
-		if (buf[2] != cmd_seq) {
-			ERROR (abstract->context, "Unexpected packet sequence byte (%02x %02x).", buf[2], cmd_seq);
+		if (packet[2] != cmd_seq) {
+			ERROR (abstract->context, "Unexpected packet sequence byte (%02x %02x).", packet[2], cmd_seq);
 			return DC_STATUS_PROTOCOL;
 		}
 
 		// Verify the length byte.
-		unsigned int length = buf[3];
-		if (length + 4 > transferred) {
+		unsigned int length = packet[3];
+		if (length + 4 > remaining) {
 			ERROR (abstract->context, "Invalid packet length (%u).", length);
 			return DC_STATUS_PROTOCOL;
 		}
@@ -635,11 +652,20 @@ oceanic_atom2_ble_read (oceanic_atom2_device_t *device, unsigned char data[], un
 			if (nbytes + n > size) {
 				n = size - nbytes;
 			}
-			memcpy (data + nbytes, buf + 4, n);
+			memcpy (data + nbytes, packet + 4, n);
 		}
 		nbytes += length;
 		pkt_seq++;
 
+		// Only the intermediate packets are guaranteed to be completely
+		// filled, so any padding after the last packet is ignored. A
+		// packet can also be followed by padding up to the end of the
+		// notification. The remainder of the received data is only
+		// processed as another packet if it starts with a start byte.
+		offset += length + 4;
+		if (offset < available && packet[length + 4] != 0xcd)
+			offset = available;
+
 		// Last packet?
 		if ((status & 0x20) == 0)
 			break;
@@ -760,6 +786,29 @@ oceanic_atom2_packet (oceanic_atom2_device_t *device, const unsigned char comman
 }
 
 
+typedef struct oceanic_atom2_transfer_t {
+	oceanic_atom2_device_t *device;
+	const unsigned char *command;
+	unsigned int csize;
+	unsigned char ack;
+	unsigned char *answer;
+	unsigned int asize;
+	unsigned int crc_size;
+} oceanic_atom2_transfer_t;
+
+static dc_status_t
+oceanic_atom2_transfer_attempt (dc_transaction_t *transaction, unsigned int attempt, void *userdata)
+{
+	oceanic_atom2_transfer_t *transfer = (oceanic_atom2_transfer_t *) userdata;
+	oceanic_atom2_device_t *device = transfer->device;
+
+	// Increase the inter packet delay.
+	if (attempt && device->delay < MAXDELAY)
+		device->delay++;
+
+	return oceanic_atom2_packet (device, transfer->command, transfer->csize, transfer->ack, transfer->answer, transfer->asize, transfer->crc_size);
+}
+
 static dc_status_t
 oceanic_atom2_transfer (oceanic_atom2_device_t *device, const unsigned char command[], unsigned int csize, unsigned char ack, unsigned char answer[], unsigned int asize, unsigned int crc_size)
 {
@@ -769,26 +818,9 @@ oceanic_atom2_transfer (oceanic_atom2_device_t *device, const unsigned char comm
 	// a NAK byte, we try to resend the command a number of times before
 	// returning an error.
 
-	unsigned int nretries = 0;
-	dc_status_t rc = DC_STATUS_SUCCESS;
-	while ((rc = oceanic_atom2_packet (device, command, csize, ack, answer, asize, crc_size)) != DC_STATUS_SUCCESS) {
-		if (rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL)
-			return rc;
-
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
-			return rc;
-
-		// Increase the inter packet delay.
-		if (device->delay < MAXDELAY)
-			device->delay++;
+	oceanic_atom2_transfer_t transfer = {device, command, csize, ack, answer, asize, crc_size};
 
-		// Delay the next attempt.
-		dc_iostream_sleep (device->iostream, 100);
-		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
-	}
-
-	return DC_STATUS_SUCCESS;
+	return dc_transaction_run (&device->transaction, oceanic_atom2_transfer_attempt, &transfer);
 }
 
 /*
@@ -857,6 +889,99 @@ oceanic_atom2_ble_handshake(oceanic_atom2_device_t *device)
 	return DC_STATUS_SUCCESS;
 }
 
+static dc_status_t
+oceanic_atom2_read_command (oceanic_atom2_device_t *device, unsigned int bigpage, unsigned char *read_cmd, unsigned int *crc_size)
+{
+	// Pick the correct read command and number of checksum bytes.
+	switch (bigpage) {
+	case 1:
+		*read_cmd = CMD_READ1;
+		*crc_size = 1;
+		break;
+	case 8:
+		*read_cmd = CMD_READ8;
+		*crc_size = device->base.model == PROPLUS4 ? 2 : 1;
+		break;
+	case 16:
+		*read_cmd = CMD_READ16;
+		*crc_size = 2;
+		break;
+	default:
+		return DC_STATUS_INVALIDARGS;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static unsigned int
+oceanic_atom2_bigpage_fallback (unsigned int bigpage)
+{
+	switch (bigpage) {
+	case 16:
+		return 8;
+	case 8:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static dc_status_t
+oceanic_atom2_autotune (oceanic_atom2_device_t *device)
+{
+	dc_device_t *abstract = (dc_device_t *) device;
+
+	// Probe the big page sizes, starting with the largest one. The
+	// first page is read, because it's needed later on anyway. The
+	// result only applies to this connection, because the reliability
+	// depends on the link as well. A timeout or checksum error is
+	// retried first, such that a single transient error doesn't reduce
+	// the page size for the entire session. A rejected command (NAK) is
+	// not retried.
+	unsigned int bigpage = device->bigpage;
+	while (bigpage > 1) {
+		unsigned char read_cmd = 0;
+		unsigned int crc_size = 0;
+		oceanic_atom2_read_command (device, bigpage, &read_cmd, &crc_size);
+
+		unsigned char command[] = {read_cmd, 0x00, 0x00};
+		dc_status_t rc = DC_STATUS_SUCCESS;
+		for (unsigned int attempt = 0; attempt <= MAXRETRIES; ++attempt) {
+			if (attempt) {
+				dc_iostream_sleep (device->iostream, 100);
+				dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
+			}
+
+			rc = oceanic_atom2_packet (device, command, sizeof (command), ACK, device->cache, bigpage * PAGESIZE, crc_size);
+			if (rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL)
+				break;
+		}
+
+		if (rc == DC_STATUS_SUCCESS) {
+			device->cached_page = 0;
+			device->cached_highmem = 0;
+			break;
+		}
+
+		if (rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL && rc != DC_STATUS_UNSUPPORTED)
+			return rc;
+
+		WARNING (abstract->context, "Big page size %u not supported.", bigpage);
+
+		dc_iostream_sleep (device->iostream, 100);
+		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
+
+		bigpage = oceanic_atom2_bigpage_fallback (bigpage);
+	}
+
+	DEBUG (abstract->context, "Using big page size %u.", bigpage);
+
+	device->bigpage = bigpage;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 dc_status_t
 oceanic_atom2_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_t *iostream, unsigned int model)
 {
@@ -906,6 +1031,10 @@ oceanic_atom2_device_open (dc_device_t **out, dc_context_t *context, dc_iostream
 		goto error_free;
 	}
 
+	// Retry failed transfers, and adapt the timeout to the round trip time.
+	dc_transaction_init (&device->transaction, (dc_device_t *) device, device->iostream, MAXRETRIES, 100, DC_DIRECTION_INPUT);
+	dc_transaction_set_adaptive (&device->transaction, 1000, 500);
+
 	// Set the DTR line.
 	status = dc_iostream_set_dtr (device->iostream, 1);
 	if (status != DC_STATUS_SUCCESS) {
@@ -988,6 +1117,14 @@ oceanic_atom2_device_open (dc_device_t **out, dc_context_t *context, dc_iostream
 		device->bigpage = 16;
 	}
 
+	// Find the largest reliable big page size.
+	if (device->bigpage > 1) {
+		status = oceanic_atom2_autotune (device);
+		if (status != DC_STATUS_SUCCESS) {
+			goto error_free;
+		}
+	}
+
 	// Repeat the handshaking every few packets.
 	device->handshake_repeat = dc_iostream_get_transport (device->iostream) == DC_TRANSPORT_BLE &&
 		device->base.model == PROPLUS4;
@@ -1010,6 +1147,9 @@ oceanic_atom2_device_close (dc_device_t *abstract)
 	oceanic_atom2_device_t *device = (oceanic_atom2_device_t*) abstract;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 
+	// Discard an unfinished download.
+	oceanic_common_download_reset (&device->base);
+
 	// Send the quit command.
 	unsigned char command[4] = {CMD_QUIT, 0x05, 0xA5};
 	rc = oceanic_atom2_transfer (device, command, sizeof (command), NAK, NULL, 0, 0);
@@ -1072,22 +1212,9 @@ oceanic_atom2_device_read (dc_device_t *abstract, unsigned int address, unsigned
 	// Pick the correct read command and number of checksum bytes.
 	unsigned char read_cmd = 0x00;
 	unsigned int crc_size = 0;
-	switch (device->bigpage) {
-	case 1:
-		read_cmd = CMD_READ1;
-		crc_size = 1;
-		break;
-	case 8:
-		read_cmd = CMD_READ8;
-		crc_size = device->base.model == PROPLUS4 ? 2 : 1;
-		break;
-	case 16:
-		read_cmd = CMD_READ16;
-		crc_size = 2;
-		break;
-	default:
-		return DC_STATUS_INVALIDARGS;
-	}
+	dc_status_t status = oceanic_atom2_read_command (device, device->bigpage, &read_cmd, &crc_size);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
 
 	// Pick the best pagesize to use.
 	unsigned int pagesize = device->bigpage * PAGESIZE;
@@ -1123,6 +1250,19 @@ oceanic_atom2_device_read (dc_device_t *abstract, unsigned int address, unsigned
 					(number     ) & 0xFF, // low
 				};
 			dc_status_t rc = oceanic_atom2_transfer (device, command, sizeof (command), ACK, device->cache, pagesize, crc_size);
+			if (rc == DC_STATUS_PROTOCOL && !highmem && device->bigpage > 1) {
+				// Fall back to a smaller big page size after
+				// repeated checksum or protocol errors.
+				unsigned int bigpage = oceanic_atom2_bigpage_fallback (device->bigpage);
+				WARNING (abstract->context, "Falling back to big page size %u.", bigpage);
+				device->bigpage = bigpage;
+				device->cached_page = INVALID;
+				device->cached_highmem = INVALID;
+				oceanic_atom2_read_command (device, bigpage, &read_cmd, &crc_size);
+				pagesize = bigpage * PAGESIZE;
+				dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
+				continue;
+			}
 			if (rc != DC_STATUS_SUCCESS)
 				return rc;
 
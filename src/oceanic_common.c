@@ -153,6 +153,7 @@ oceanic_common_device_init (oceanic_common_device_t *device)
 	device->model = 0;
 	device->layout = NULL;
 	device->multipage = 1;
+	memset (&device->download, 0, sizeof (device->download));
 }
 
 
@@ -204,7 +205,7 @@ oceanic_common_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 
 	// Download the memory dump.
 	status = device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), PAGESIZE * device->multipage);
+		dc_buffer_get_size (buffer), PAGESIZE * device->multipage, PAGESIZE * device->multipage);
 	if (status != DC_STATUS_SUCCESS) {
 		return status;
 	}
@@ -443,11 +444,28 @@ oceanic_common_device_logbook (dc_device_t *abstract, dc_event_progress_t *progr
 }
 
 
-dc_status_t
-oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progress, dc_buffer_t *logbook, dc_dive_callback_t callback, void *userdata)
+/*
+ * The profile ringbuffer is downloaded one dive at a time. After
+ * oceanic_common_profile_begin() has located the profiles, every call to
+ * oceanic_common_profile_next() reads a single dive, and returns
+ * DC_STATUS_WOULDBLOCK as long as there are more logbook entries left.
+ */
+static void
+oceanic_common_profile_free (oceanic_common_profile_t *profile)
+{
+	dc_rbstream_free (profile->rbstream);
+	free (profile->profiles);
+
+	profile->rbstream = NULL;
+	profile->profiles = NULL;
+	profile->entry = 0;
+}
+
+
+static dc_status_t
+oceanic_common_profile_begin (dc_device_t *abstract, oceanic_common_profile_t *profile, dc_event_progress_t *progress, dc_buffer_t *logbook)
 {
 	oceanic_common_device_t *device = (oceanic_common_device_t *) abstract;
-	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 
 	assert (device != NULL);
@@ -457,6 +475,16 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 
 	const oceanic_common_layout_t *layout = device->layout;
 
+	profile->logbook = logbook;
+	profile->progress = progress;
+	profile->rbstream = NULL;
+	profile->profiles = NULL;
+	profile->offset = 0;
+	profile->remaining = 0;
+	profile->previous = 0;
+	profile->entry = 0;
+	profile->status = DC_STATUS_SUCCESS;
+
 	// Cache the logbook pointer and size.
 	const unsigned char *logbooks = dc_buffer_get_data (logbook);
 	unsigned int rb_logbook_size = dc_buffer_get_size (logbook);
@@ -495,7 +523,7 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 		{
 			ERROR (abstract->context, "Invalid ringbuffer pointer detected (0x%06x 0x%06x).",
 				rb_entry_begin, rb_entry_end);
-			status = DC_STATUS_DATAFORMAT;
+			profile->status = DC_STATUS_DATAFORMAT;
 			continue;
 		}
 
@@ -541,38 +569,54 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 
 	// Exit if there are no dives.
 	if (rb_profile_size == 0) {
-		return status;
+		return DC_STATUS_SUCCESS;
 	}
 
 	// Create the ringbuffer stream.
-	dc_rbstream_t *rbstream = NULL;
-	rc = dc_rbstream_new (&rbstream, abstract, PAGESIZE, PAGESIZE * device->multipage, layout->rb_profile_begin, layout->rb_profile_end, rb_profile_end, DC_RBSTREAM_BACKWARD);
+	rc = dc_rbstream_new (&profile->rbstream, abstract, PAGESIZE, PAGESIZE * device->multipage, layout->rb_profile_begin, layout->rb_profile_end, rb_profile_end, DC_RBSTREAM_BACKWARD);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR (abstract->context, "Failed to create the ringbuffer stream.");
 		return rc;
 	}
 
 	// Memory buffer for the profile data.
-	unsigned char *profiles = (unsigned char *) malloc (rb_profile_size + rb_logbook_size);
-	if (profiles == NULL) {
+	profile->profiles = (unsigned char *) malloc (rb_profile_size + rb_logbook_size);
+	if (profile->profiles == NULL) {
 		ERROR (abstract->context, "Failed to allocate memory.");
-		dc_rbstream_free (rbstream);
+		oceanic_common_profile_free (profile);
 		return DC_STATUS_NOMEMORY;
 	}
 
 	// Keep track of the current position.
-	unsigned int offset = rb_profile_size + rb_logbook_size;
+	profile->offset = rb_profile_size + rb_logbook_size;
 
 	// Traverse the logbook ringbuffer backwards to retrieve the most recent
 	// dives first. The logbook ringbuffer is linearized at this point, so
 	// we do not have to take into account any memory wrapping near the end
 	// of the memory buffer.
-	remaining = rb_profile_size;
-	previous = rb_profile_end;
-	entry = rb_logbook_size;
-	while (entry) {
+	profile->remaining = rb_profile_size;
+	profile->previous = rb_profile_end;
+	profile->entry = rb_logbook_size;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static dc_status_t
+oceanic_common_profile_next (dc_device_t *abstract, oceanic_common_profile_t *profile, dc_dive_callback_t callback, void *userdata)
+{
+	oceanic_common_device_t *device = (oceanic_common_device_t *) abstract;
+	const oceanic_common_layout_t *layout = device->layout;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	// Cache the logbook pointer.
+	const unsigned char *logbooks = dc_buffer_get_data (profile->logbook);
+
+	unsigned char *profiles = profile->profiles;
+	while (profile->entry) {
 		// Move to the start of the current entry.
-		entry -= layout->rb_logbook_entry_size;
+		profile->entry -= layout->rb_logbook_entry_size;
+		unsigned int entry = profile->entry;
 
 		// Skip uninitialized entries.
 		if (array_isequal (logbooks + entry, layout->rb_logbook_entry_size, 0xFF)) {
@@ -590,7 +634,7 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 		{
 			ERROR (abstract->context, "Invalid ringbuffer pointer detected (0x%06x 0x%06x).",
 				rb_entry_begin, rb_entry_end);
-			status = DC_STATUS_DATAFORMAT;
+			profile->status = DC_STATUS_DATAFORMAT;
 			continue;
 		}
 
@@ -600,42 +644,42 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 		unsigned int rb_entry_size = RB_PROFILE_DISTANCE (rb_entry_begin, rb_entry_end, layout, DC_RINGBUFFER_FULL);
 
 		// Skip gaps between the profiles.
-		unsigned int gap = RB_PROFILE_DISTANCE (rb_entry_end, previous, layout, DC_RINGBUFFER_EMPTY);
+		unsigned int gap = RB_PROFILE_DISTANCE (rb_entry_end, profile->previous, layout, DC_RINGBUFFER_EMPTY);
 		if (gap) {
 			WARNING (abstract->context, "Profiles are not continuous (%u bytes).", gap);
 		}
 
 		// Make sure the profile size is valid.
-		if (rb_entry_size + gap > remaining) {
+		if (rb_entry_size + gap > profile->remaining) {
 			WARNING (abstract->context, "Unexpected profile size.");
 			break;
 		}
 
 		// Move to the start of the current dive.
-		offset -= rb_entry_size + gap;
+		profile->offset -= rb_entry_size + gap;
 
 		// Read the dive.
-		rc = dc_rbstream_read (rbstream, progress, profiles + offset, rb_entry_size + gap);
+		rc = dc_rbstream_read (profile->rbstream, profile->progress, profiles + profile->offset, rb_entry_size + gap);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (abstract->context, "Failed to read the dive.");
-			status = rc;
+			profile->status = rc;
 			break;
 		}
 
-		remaining -= rb_entry_size + gap;
-		previous = rb_entry_begin;
+		profile->remaining -= rb_entry_size + gap;
+		profile->previous = rb_entry_begin;
 
 		// Prepend the logbook entry to the profile data. The memory buffer is
 		// large enough to store this entry.
-		offset -= layout->rb_logbook_entry_size;
-		memcpy (profiles + offset, logbooks + entry, layout->rb_logbook_entry_size);
+		profile->offset -= layout->rb_logbook_entry_size;
+		memcpy (profiles + profile->offset, logbooks + entry, layout->rb_logbook_entry_size);
 
 		// Remove padding from the profile.
 		if (layout->highmem) {
 			// The logbook entry contains the total number of pages containing
 			// profile data, excluding the footer page. Limit the profile size
 			// to this size.
-			unsigned int value = array_uint16_le (profiles + offset + 12);
+			unsigned int value = array_uint16_le (profiles + profile->offset + 12);
 			unsigned int value_hi = value & 0xE000;
 			unsigned int value_lo = value & 0x0FFF;
 			unsigned int npages = ((value_hi >> 1) | value_lo) + 1;
@@ -645,47 +689,68 @@ oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progr
 			}
 		}
 
-		unsigned char *p = profiles + offset;
+		unsigned char *p = profiles + profile->offset;
 		if (callback && !callback (p, rb_entry_size + layout->rb_logbook_entry_size, p, layout->rb_logbook_entry_size, userdata)) {
 			break;
 		}
+
+		if (profile->entry)
+			return DC_STATUS_WOULDBLOCK;
 	}
 
-	dc_rbstream_free (rbstream);
-	free (profiles);
+	profile->entry = 0;
 
-	return status;
+	return profile->status;
 }
 
 
 dc_status_t
-oceanic_common_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+oceanic_common_device_profile (dc_device_t *abstract, dc_event_progress_t *progress, dc_buffer_t *logbook, dc_dive_callback_t callback, void *userdata)
+{
+	oceanic_common_profile_t profile;
+
+	dc_status_t rc = oceanic_common_profile_begin (abstract, &profile, progress, logbook);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	do {
+		rc = oceanic_common_profile_next (abstract, &profile, callback, userdata);
+	} while (rc == DC_STATUS_WOULDBLOCK);
+
+	oceanic_common_profile_free (&profile);
+
+	return rc;
+}
+
+
+void
+oceanic_common_download_reset (oceanic_common_device_t *device)
+{
+	oceanic_common_download_t *download = &device->download;
+
+	oceanic_common_profile_free (&download->profile);
+	dc_buffer_free (download->logbook);
+
+	memset (download, 0, sizeof (*download));
+}
+
+
+static dc_status_t
+oceanic_common_device_logbooks (dc_device_t *abstract, dc_event_progress_t *progress, dc_buffer_t *logbook)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	oceanic_common_device_t *device = (oceanic_common_device_t *) abstract;
 
-	assert (device != NULL);
-	assert (device->layout != NULL);
-
 	const oceanic_common_layout_t *layout = device->layout;
 
-	// For devices without a logbook and profile ringbuffer, downloading dives
-	// isn't possible. This is not considered a fatal error, but handled as if
-	// there are no dives present.
-	if (layout->rb_logbook_begin == layout->rb_logbook_end &&
-		layout->rb_profile_begin == layout->rb_profile_end) {
-		return DC_STATUS_SUCCESS;
-	}
-
 	// Enable progress notifications.
-	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
-	progress.maximum =
+	progress->maximum =
 		(layout->rb_logbook_end - layout->rb_logbook_begin) +
 		(layout->rb_profile_end - layout->rb_profile_begin);
-	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+	device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
 
 	// Read the device info.
-	rc = VTABLE(abstract)->devinfo (abstract, &progress);
+	rc = VTABLE(abstract)->devinfo (abstract, progress);
 	if (rc != DC_STATUS_SUCCESS) {
 		return rc;
 	}
@@ -693,7 +758,7 @@ oceanic_common_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 	// Read the ringbuffer pointers.
 	unsigned int rb_logbook_begin = 0, rb_logbook_end = 0;
 	unsigned int rb_profile_begin = 0, rb_profile_end = 0;
-	rc = VTABLE(abstract)->pointers (abstract, &progress, &rb_logbook_begin, &rb_logbook_end, &rb_profile_begin, &rb_profile_end);
+	rc = VTABLE(abstract)->pointers (abstract, progress, &rb_logbook_begin, &rb_logbook_end, &rb_profile_begin, &rb_profile_end);
 	if (rc != DC_STATUS_SUCCESS) {
 		return rc;
 	}
@@ -701,6 +766,30 @@ oceanic_common_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 	DEBUG (abstract->context, "Logbook: %08x %08x", rb_logbook_begin, rb_logbook_end);
 	DEBUG (abstract->context, "Profile: %08x %08x", rb_profile_begin, rb_profile_end);
 
+	// Download the logbook ringbuffer.
+	return VTABLE(abstract)->logbook (abstract, progress, logbook, rb_logbook_begin, rb_logbook_end);
+}
+
+
+dc_status_t
+oceanic_common_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	oceanic_common_device_t *device = (oceanic_common_device_t *) abstract;
+
+	assert (device != NULL);
+	assert (device->layout != NULL);
+
+	const oceanic_common_layout_t *layout = device->layout;
+
+	// For devices without a logbook and profile ringbuffer, downloading dives
+	// isn't possible. This is not considered a fatal error, but handled as if
+	// there are no dives present.
+	if (layout->rb_logbook_begin == layout->rb_logbook_end &&
+		layout->rb_profile_begin == layout->rb_profile_end) {
+		return DC_STATUS_SUCCESS;
+	}
+
 	// Memory buffer for the logbook data.
 	dc_buffer_t *logbook = dc_buffer_new (0);
 	if (logbook == NULL) {
@@ -708,7 +797,8 @@ oceanic_common_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 	}
 
 	// Download the logbook ringbuffer.
-	rc = VTABLE(abstract)->logbook (abstract, &progress, logbook, rb_logbook_begin, rb_logbook_end);
+	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
+	rc = oceanic_common_device_logbooks (abstract, &progress, logbook);
 	if (rc != DC_STATUS_SUCCESS) {
 		dc_buffer_free (logbook);
 		return rc;
@@ -731,3 +821,62 @@ oceanic_common_device_foreach (dc_device_t *abstract, dc_dive_callback_t callbac
 
 	return DC_STATUS_SUCCESS;
 }
+
+
+/*
+ * The first step downloads the device info, the ringbuffer pointers and
+ * the logbook ringbuffer. Every following step reads and delivers a
+ * single dive from the profile ringbuffer.
+ */
+dc_status_t
+oceanic_common_device_foreach_step (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	oceanic_common_device_t *device = (oceanic_common_device_t *) abstract;
+	oceanic_common_download_t *download = &device->download;
+
+	assert (device != NULL);
+	assert (device->layout != NULL);
+
+	const oceanic_common_layout_t *layout = device->layout;
+
+	if (download->active) {
+		rc = oceanic_common_profile_next (abstract, &download->profile, callback, userdata);
+		if (rc != DC_STATUS_WOULDBLOCK) {
+			oceanic_common_download_reset (device);
+		}
+		return rc;
+	}
+
+	// Devices without a logbook and profile ringbuffer have no dives.
+	if (layout->rb_logbook_begin == layout->rb_logbook_end &&
+		layout->rb_profile_begin == layout->rb_profile_end) {
+		return DC_STATUS_SUCCESS;
+	}
+
+	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
+	download->active = 1;
+	download->progress = progress;
+
+	// Memory buffer for the logbook data.
+	download->logbook = dc_buffer_new (0);
+	if (download->logbook == NULL) {
+		oceanic_common_download_reset (device);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	// Download the logbook ringbuffer.
+	rc = oceanic_common_device_logbooks (abstract, &download->progress, download->logbook);
+	if (rc == DC_STATUS_SUCCESS && dc_buffer_get_size (download->logbook)) {
+		rc = oceanic_common_profile_begin (abstract, &download->profile, &download->progress, download->logbook);
+		if (rc == DC_STATUS_SUCCESS) {
+			rc = download->profile.entry ? DC_STATUS_WOULDBLOCK : download->profile.status;
+		}
+	}
+
+	if (rc != DC_STATUS_WOULDBLOCK) {
+		oceanic_common_download_reset (device);
+	}
+
+	return rc;
+}
@@ -23,6 +23,7 @@
 #define OCEANIC_COMMON_H
 
 #include "device-private.h"
+#include "rbstream.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -163,6 +164,25 @@ typedef struct oceanic_common_layout_t {
 	unsigned int pt_mode_serial;
 } oceanic_common_layout_t;
 
+typedef struct oceanic_common_profile_t {
+	dc_buffer_t *logbook;
+	dc_event_progress_t *progress;
+	dc_rbstream_t *rbstream;
+	unsigned char *profiles;
+	unsigned int offset;
+	unsigned int remaining;
+	unsigned int previous;
+	unsigned int entry;
+	dc_status_t status;
+} oceanic_common_profile_t;
+
+typedef struct oceanic_common_download_t {
+	unsigned int active;
+	dc_event_progress_t progress;
+	dc_buffer_t *logbook;
+	oceanic_common_profile_t profile;
+} oceanic_common_download_t;
+
 typedef struct oceanic_common_device_t {
 	dc_device_t base;
 	unsigned int firmware;
@@ -171,6 +191,7 @@ typedef struct oceanic_common_device_t {
 	unsigned int model;
 	const oceanic_common_layout_t *layout;
 	unsigned int multipage;
+	oceanic_common_download_t download;
 } oceanic_common_device_t;
 
 typedef struct oceanic_common_device_vtable_t {
@@ -217,6 +238,12 @@ oceanic_common_device_dump (dc_device_t *abstract, dc_buffer_t *buffer);
 dc_status_t
 oceanic_common_device_foreach (dc_device_t *device, dc_dive_callback_t callback, void *userdata);
 
+dc_status_t
+oceanic_common_device_foreach_step (dc_device_t *device, dc_dive_callback_t callback, void *userdata);
+
+void
+oceanic_common_download_reset (oceanic_common_device_t *device);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
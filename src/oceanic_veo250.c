@@ -55,6 +55,7 @@ static const oceanic_common_device_vtable_t oceanic_veo250_device_vtable = {
 		NULL, /* write */
 		oceanic_common_device_dump, /* dump */
 		oceanic_common_device_foreach, /* foreach */
+		oceanic_common_device_foreach_step, /* foreach_step */
 		NULL, /* timesync */
 		oceanic_veo250_device_close /* close */
 	},
@@ -348,6 +349,9 @@ oceanic_veo250_device_close (dc_device_t *abstract)
 	oceanic_veo250_device_t *device = (oceanic_veo250_device_t*) abstract;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 
+	// Discard an unfinished download.
+	oceanic_common_download_reset (&device->base);
+
 	// Switch the device back to surface mode.
 	rc = oceanic_veo250_quit (device);
 	if (rc != DC_STATUS_SUCCESS) {
@@ -69,6 +69,7 @@ static const dc_device_vtable_t oceans_s1_device_vtable = {
 	NULL, /* write */
 	NULL, /* dump */
 	oceans_s1_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	oceans_s1_device_timesync, /* timesync */
 	NULL, /* close */
 };
@@ -71,6 +71,7 @@ static const dc_parser_vtable_t oceans_s1_parser_vtable = {
 	oceans_s1_parser_get_datetime, /* datetime */
 	oceans_s1_parser_get_field, /* fields */
 	oceans_s1_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_foreach_fixed */
 	NULL /* destroy */
 };
 
@@ -24,6 +24,7 @@
 
 #include "packet.h"
 
+#include "ble-private.h"
 #include "iostream-private.h"
 #include "common-private.h"
 #include "context-private.h"
@@ -36,6 +37,7 @@ static dc_status_t dc_packet_get_lines (dc_iostream_t *abstract, unsigned int *v
 static dc_status_t dc_packet_get_available (dc_iostream_t *abstract, size_t *value);
 static dc_status_t dc_packet_configure (dc_iostream_t *abstract, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol);
 static dc_status_t dc_packet_poll (dc_iostream_t *abstract, int timeout);
+static dc_status_t dc_packet_get_pollfd (dc_iostream_t *abstract, dc_pollfd_t pollfd[], size_t size, size_t *actual);
 static dc_status_t dc_packet_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual);
 static dc_status_t dc_packet_write (dc_iostream_t *abstract, const void *data, size_t size, size_t *actual);
 static dc_status_t dc_packet_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size);
@@ -66,6 +68,7 @@ static const dc_iostream_vtable_t dc_packet_vtable = {
 	dc_packet_get_available, /* get_available */
 	dc_packet_configure, /* configure */
 	dc_packet_poll, /* poll */
+	dc_packet_get_pollfd, /* get_pollfd */
 	dc_packet_read, /* read */
 	dc_packet_write, /* write */
 	dc_packet_ioctl, /* ioctl */
@@ -93,6 +96,9 @@ dc_packet_open (dc_iostream_t **out, dc_context_t *context, dc_iostream_t *base,
 		goto error_exit;
 	}
 
+	// Use the full payload size of the BLE connection.
+	dc_ble_packetsize (base, context, &isize, &osize);
+
 	// Allocate the read buffer.
 	if (isize) {
 		buffer = (unsigned char *) malloc (isize);
@@ -193,6 +199,14 @@ dc_packet_poll (dc_iostream_t *abstract, int timeout)
 	return dc_iostream_poll (packet->iostream, timeout);
 }
 
+static dc_status_t
+dc_packet_get_pollfd (dc_iostream_t *abstract, dc_pollfd_t pollfd[], size_t size, size_t *actual)
+{
+	dc_packet_t *packet = (dc_packet_t *) abstract;
+
+	return dc_iostream_get_pollfd (packet->iostream, pollfd, size, actual);
+}
+
 static dc_status_t
 dc_packet_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual)
 {
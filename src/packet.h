@@ -37,6 +37,9 @@ extern "C" {
  * underlying packet oriented transport. It changes the packet oriented
  * base transport into a stream oriented transport.
  *
+ * On a BLE transport, the packet sizes are enlarged to the payload size of
+ * the ATT MTU, if the base I/O stream reports it (#DC_IOCTL_BLE_GET_MTU).
+ *
  * @param[out]  iostream    A location to store the packet I/O stream.
  * @param[in]   context     A valid context.
  * @param[in]   base        A valid I/O stream.
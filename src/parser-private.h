@@ -62,6 +62,8 @@ struct dc_parser_vtable_t {
 
 	dc_status_t (*samples_foreach) (dc_parser_t *parser, dc_sample_callback_t callback, void *userdata);
 
+	dc_status_t (*samples_foreach_fixed) (dc_parser_t *parser, dc_sample_fixed_callback_t callback, void *userdata);
+
 	dc_status_t (*destroy) (dc_parser_t *parser);
 };
 
@@ -81,6 +83,21 @@ typedef struct sample_statistics_t {
 
 #define SAMPLE_STATISTICS_INITIALIZER {0, 0.0}
 
+/*
+ * Destination of the samples, for a backend that implements both the
+ * floating point and the fixed-point sample iteration with a single
+ * function. At most one of the two callbacks is set. The backend fills
+ * only the sample value matching the callback, and integer values in both.
+ */
+typedef struct dc_sample_sink_t {
+	dc_sample_callback_t callback;
+	dc_sample_fixed_callback_t fixed;
+	void *userdata;
+} dc_sample_sink_t;
+
+void
+dc_sample_sink_emit (const dc_sample_sink_t *sink, dc_sample_type_t type, const dc_sample_value_t *value, const dc_sample_fixed_t *fixed);
+
 void
 sample_statistics_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata);
 
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <math.h>
 
 #include "suunto_d9.h"
 #include "suunto_eon.h"
@@ -70,6 +71,7 @@
 #include "context-private.h"
 #include "parser-private.h"
 #include "device-private.h"
+#include "platform.h"
 
 #define REACTPROWHITE 0x4354
 
@@ -399,6 +401,93 @@ dc_parser_samples_foreach (dc_parser_t *parser, dc_sample_callback_t callback, v
 }
 
 
+typedef struct dc_parser_fixed_t {
+	dc_sample_fixed_callback_t callback;
+	void *userdata;
+} dc_parser_fixed_t;
+
+static void
+dc_parser_fixed_cb (dc_sample_type_t type, const dc_sample_value_t *value, void *userdata)
+{
+	dc_parser_fixed_t *fixed = (dc_parser_fixed_t *) userdata;
+	dc_sample_fixed_t sample;
+
+	switch (type) {
+	case DC_SAMPLE_DEPTH:
+		sample.depth = rint (value->depth * 1000.0);
+		break;
+	case DC_SAMPLE_PRESSURE:
+		sample.pressure.tank = value->pressure.tank;
+		sample.pressure.value = rint (value->pressure.value * 1000.0);
+		break;
+	case DC_SAMPLE_TEMPERATURE:
+		sample.temperature = rint ((value->temperature + 273.15) * 1000.0);
+		break;
+	case DC_SAMPLE_SETPOINT:
+		sample.setpoint = rint (value->setpoint * 1000.0);
+		break;
+	case DC_SAMPLE_PPO2:
+		sample.ppo2.sensor = value->ppo2.sensor;
+		sample.ppo2.value = rint (value->ppo2.value * 1000.0);
+		break;
+	case DC_SAMPLE_CNS:
+		sample.cns = rint (value->cns * 1000.0);
+		break;
+	case DC_SAMPLE_DECO:
+		sample.deco.type = value->deco.type;
+		sample.deco.time = value->deco.time;
+		sample.deco.depth = rint (value->deco.depth * 1000.0);
+		sample.deco.tts = value->deco.tts;
+		break;
+	case DC_SAMPLE_EVENT:
+		sample.event.type = value->event.type;
+		sample.event.time = value->event.time;
+		sample.event.flags = value->event.flags;
+		sample.event.value = value->event.value;
+		break;
+	case DC_SAMPLE_VENDOR:
+		sample.vendor.type = value->vendor.type;
+		sample.vendor.size = value->vendor.size;
+		sample.vendor.data = value->vendor.data;
+		break;
+	default:
+		// All remaining sample types contain a single integer value.
+		sample.time = value->time;
+		break;
+	}
+
+	fixed->callback (type, &sample, fixed->userdata);
+}
+
+dc_status_t
+dc_parser_samples_foreach_fixed (dc_parser_t *parser, dc_sample_fixed_callback_t callback, void *userdata)
+{
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (parser->vtable->samples_foreach_fixed)
+		return parser->vtable->samples_foreach_fixed (parser, callback, userdata);
+
+	// Convert the floating point samples for the other backends.
+	if (callback == NULL)
+		return dc_parser_samples_foreach (parser, NULL, NULL);
+
+	dc_parser_fixed_t fixed = {callback, userdata};
+
+	return dc_parser_samples_foreach (parser, dc_parser_fixed_cb, &fixed);
+}
+
+
+void
+dc_sample_sink_emit (const dc_sample_sink_t *sink, dc_sample_type_t type, const dc_sample_value_t *value, const dc_sample_fixed_t *fixed)
+{
+	if (sink->fixed)
+		sink->fixed (type, fixed, sink->userdata);
+	else if (sink->callback)
+		sink->callback (type, value, sink->userdata);
+}
+
+
 dc_status_t
 dc_parser_destroy (dc_parser_t *parser)
 {
@@ -79,6 +79,7 @@ typedef struct pelagic_i330r_device_t {
 static dc_status_t pelagic_i330r_device_read (dc_device_t *abstract, unsigned int address, unsigned char data[], unsigned int size);
 static dc_status_t pelagic_i330r_device_devinfo (dc_device_t *abstract, dc_event_progress_t *progress);
 static dc_status_t pelagic_i330r_device_pointers (dc_device_t *abstract, dc_event_progress_t *progress, unsigned int *rb_logbook_begin, unsigned int *rb_logbook_end, unsigned int *rb_profile_begin, unsigned int *rb_profile_end);
+static dc_status_t pelagic_i330r_device_close (dc_device_t *abstract);
 
 static const oceanic_common_device_vtable_t pelagic_i330r_device_vtable = {
 	{
@@ -89,8 +90,9 @@ static const oceanic_common_device_vtable_t pelagic_i330r_device_vtable = {
 		NULL, /* write */
 		oceanic_common_device_dump, /* dump */
 		oceanic_common_device_foreach, /* foreach */
+		oceanic_common_device_foreach_step, /* foreach_step */
 		NULL, /* timesync */
-		NULL /* close */
+		pelagic_i330r_device_close /* close */
 	},
 	pelagic_i330r_device_devinfo,
 	pelagic_i330r_device_pointers,
@@ -560,6 +562,18 @@ error_free:
 	return status;
 }
 
+static dc_status_t
+pelagic_i330r_device_close (dc_device_t *abstract)
+{
+	pelagic_i330r_device_t *device = (pelagic_i330r_device_t *) abstract;
+
+	// Discard an unfinished download.
+	oceanic_common_download_reset (&device->base);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 static dc_status_t
 pelagic_i330r_device_read (dc_device_t *abstract, unsigned int address, unsigned char data[], unsigned int size)
 {
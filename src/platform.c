@@ -26,9 +26,15 @@
 #else
 #include <time.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "platform.h"
 
@@ -52,6 +58,466 @@ dc_platform_sleep (unsigned int milliseconds)
 	return 0;
 }
 
+void
+dc_mutex_init (dc_mutex_t *mutex)
+{
+#ifdef _WIN32
+	*mutex = 0;
+#else
+	pthread_mutex_init (mutex, NULL);
+#endif
+}
+
+void
+dc_mutex_destroy (dc_mutex_t *mutex)
+{
+#ifndef _WIN32
+	pthread_mutex_destroy (mutex);
+#endif
+}
+
+void
+dc_mutex_lock (dc_mutex_t *mutex)
+{
+#ifdef _WIN32
+	while (InterlockedCompareExchange (mutex, 1, 0) == 1) {
+		SleepEx (0, TRUE);
+	}
+#else
+	pthread_mutex_lock (mutex);
+#endif
+}
+
+void
+dc_mutex_unlock (dc_mutex_t *mutex)
+{
+#ifdef _WIN32
+	InterlockedExchange (mutex, 0);
+#else
+	pthread_mutex_unlock (mutex);
+#endif
+}
+
+struct dc_thread_t {
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+};
+
+/*
+ * The start arguments are owned by the new thread, such that a detached
+ * thread doesn't depend on the dc_thread_t structure.
+ */
+typedef struct dc_thread_start_t {
+	dc_thread_func_t function;
+	void *userdata;
+} dc_thread_start_t;
+
+static void
+dc_thread_run (dc_thread_start_t *start)
+{
+	dc_thread_func_t function = start->function;
+	void *userdata = start->userdata;
+
+	free (start);
+
+	function (userdata);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+dc_thread_main (LPVOID arg)
+{
+	dc_thread_run ((dc_thread_start_t *) arg);
+
+	return 0;
+}
+#else
+static void *
+dc_thread_main (void *arg)
+{
+	dc_thread_run ((dc_thread_start_t *) arg);
+
+	return NULL;
+}
+#endif
+
+int
+dc_thread_new (dc_thread_t **out, dc_thread_func_t function, void *userdata)
+{
+	dc_thread_t *thread = (dc_thread_t *) malloc (sizeof (dc_thread_t));
+	if (thread == NULL)
+		return -1;
+
+	dc_thread_start_t *start = (dc_thread_start_t *) malloc (sizeof (dc_thread_start_t));
+	if (start == NULL) {
+		free (thread);
+		return -1;
+	}
+
+	start->function = function;
+	start->userdata = userdata;
+
+#ifdef _WIN32
+	thread->handle = CreateThread (NULL, 0, dc_thread_main, start, 0, NULL);
+	if (thread->handle == NULL) {
+		free (start);
+		free (thread);
+		return -1;
+	}
+#else
+	if (pthread_create (&thread->handle, NULL, dc_thread_main, start) != 0) {
+		free (start);
+		free (thread);
+		return -1;
+	}
+#endif
+
+	*out = thread;
+
+	return 0;
+}
+
+int
+dc_thread_join (dc_thread_t *thread)
+{
+	int rc = 0;
+
+	if (thread == NULL)
+		return 0;
+
+#ifdef _WIN32
+	if (WaitForSingleObject (thread->handle, INFINITE) != WAIT_OBJECT_0)
+		rc = -1;
+	CloseHandle (thread->handle);
+#else
+	if (pthread_join (thread->handle, NULL) != 0)
+		rc = -1;
+#endif
+
+	free (thread);
+
+	return rc;
+}
+
+int
+dc_thread_detach (dc_thread_t *thread)
+{
+	int rc = 0;
+
+	if (thread == NULL)
+		return 0;
+
+#ifdef _WIN32
+	if (!CloseHandle (thread->handle))
+		rc = -1;
+#else
+	if (pthread_detach (thread->handle) != 0)
+		rc = -1;
+#endif
+
+	free (thread);
+
+	return rc;
+}
+
+struct dc_signal_t {
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	int fds[2];
+#endif
+};
+
+int
+dc_signal_new (dc_signal_t **out)
+{
+	dc_signal_t *signal = (dc_signal_t *) malloc (sizeof (dc_signal_t));
+	if (signal == NULL)
+		return -1;
+
+#ifdef _WIN32
+	signal->handle = CreateEvent (NULL, FALSE, FALSE, NULL);
+	if (signal->handle == NULL) {
+		free (signal);
+		return -1;
+	}
+#else
+	if (pipe (signal->fds) != 0) {
+		free (signal);
+		return -1;
+	}
+
+	// Both ends are non-blocking, such that setting a signal never blocks,
+	// and clearing a signal never waits.
+	for (unsigned int i = 0; i < 2; ++i) {
+		int flags = fcntl (signal->fds[i], F_GETFL);
+		if (flags < 0 || fcntl (signal->fds[i], F_SETFL, flags | O_NONBLOCK) != 0 ||
+			fcntl (signal->fds[i], F_SETFD, FD_CLOEXEC) != 0) {
+			close (signal->fds[0]);
+			close (signal->fds[1]);
+			free (signal);
+			return -1;
+		}
+	}
+#endif
+
+	*out = signal;
+
+	return 0;
+}
+
+void
+dc_signal_free (dc_signal_t *signal)
+{
+	if (signal == NULL)
+		return;
+
+#ifdef _WIN32
+	CloseHandle (signal->handle);
+#else
+	close (signal->fds[0]);
+	close (signal->fds[1]);
+#endif
+
+	free (signal);
+}
+
+void
+dc_signal_set (dc_signal_t *signal)
+{
+#ifdef _WIN32
+	SetEvent (signal->handle);
+#else
+	// A full pipe already has the signal set.
+	const unsigned char value = 0;
+	while (write (signal->fds[1], &value, 1) < 0 && errno == EINTR);
+#endif
+}
+
+int
+dc_signal_clear (dc_signal_t *signal)
+{
+#ifdef _WIN32
+	return WaitForSingleObject (signal->handle, 0) == WAIT_OBJECT_0;
+#else
+	unsigned char buffer[32];
+	int set = 0;
+	while (1) {
+		ssize_t n = read (signal->fds[0], buffer, sizeof (buffer));
+		if (n > 0) {
+			set = 1;
+		} else if (n < 0 && errno == EINTR) {
+			continue;
+		} else {
+			break;
+		}
+	}
+
+	return set;
+#endif
+}
+
+void
+dc_signal_wait (dc_signal_t *signal)
+{
+#ifdef _WIN32
+	WaitForSingleObject (signal->handle, INFINITE);
+#else
+	while (!dc_signal_clear (signal)) {
+		fd_set fds;
+		FD_ZERO (&fds);
+		FD_SET (signal->fds[0], &fds);
+		select (signal->fds[0] + 1, &fds, NULL, NULL, NULL);
+	}
+#endif
+}
+
+int
+dc_signal_get_fd (dc_signal_t *signal)
+{
+#ifdef _WIN32
+	return -1;
+#else
+	return signal->fds[0];
+#endif
+}
+
+struct dc_filemap_t {
+	unsigned char *data;
+	size_t size;
+	int mapped;
+#ifdef _WIN32
+	HANDLE mapping;
+#endif
+};
+
+static int
+dc_filemap_read (dc_filemap_t *filemap, const char *filename)
+{
+	unsigned char *data = NULL;
+	size_t size = 0, capacity = 0;
+
+	FILE *fp = fopen (filename, "rb");
+	if (fp == NULL)
+		return -1;
+
+	while (1) {
+		if (size == capacity) {
+			size_t newsize = capacity ? capacity * 2 : 65536;
+			unsigned char *newdata = (unsigned char *) realloc (data, newsize);
+			if (newdata == NULL) {
+				free (data);
+				fclose (fp);
+				return -1;
+			}
+			data = newdata;
+			capacity = newsize;
+		}
+
+		size_t n = fread (data + size, 1, capacity - size, fp);
+		if (n == 0)
+			break;
+
+		size += n;
+	}
+
+	if (ferror (fp)) {
+		free (data);
+		fclose (fp);
+		return -1;
+	}
+
+	fclose (fp);
+
+	filemap->data = data;
+	filemap->size = size;
+	filemap->mapped = 0;
+
+	return 0;
+}
+
+int
+dc_filemap_open (dc_filemap_t **out, const char *filename)
+{
+	dc_filemap_t *filemap = (dc_filemap_t *) malloc (sizeof (dc_filemap_t));
+	if (filemap == NULL)
+		return -1;
+
+	filemap->data = NULL;
+	filemap->size = 0;
+	filemap->mapped = 0;
+
+#ifdef _WIN32
+	filemap->mapping = NULL;
+
+	HANDLE hFile = CreateFileA (filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		free (filemap);
+		return -1;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx (hFile, &size) || size.QuadPart > (LONGLONG) ((size_t) -1)) {
+		CloseHandle (hFile);
+		free (filemap);
+		return -1;
+	}
+
+	// An empty file can't be mapped, and needs no data.
+	if (size.QuadPart > 0) {
+		filemap->mapping = CreateFileMapping (hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (filemap->mapping) {
+			filemap->data = (unsigned char *) MapViewOfFile (filemap->mapping, FILE_MAP_READ, 0, 0, 0);
+			if (filemap->data) {
+				filemap->size = (size_t) size.QuadPart;
+				filemap->mapped = 1;
+			} else {
+				CloseHandle (filemap->mapping);
+				filemap->mapping = NULL;
+			}
+		}
+	}
+
+	CloseHandle (hFile);
+#else
+	int fd = open (filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		free (filemap);
+		return -1;
+	}
+
+	struct stat st;
+	if (fstat (fd, &st) != 0) {
+		close (fd);
+		free (filemap);
+		return -1;
+	}
+
+	// Only regular files can be mapped. An empty file needs no data.
+	if (S_ISREG (st.st_mode) && st.st_size > 0 && (unsigned long long) st.st_size <= (size_t) -1) {
+		void *data = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+#ifdef POSIX_MADV_SEQUENTIAL
+			posix_madvise (data, (size_t) st.st_size, POSIX_MADV_SEQUENTIAL);
+#endif
+			filemap->data = (unsigned char *) data;
+			filemap->size = (size_t) st.st_size;
+			filemap->mapped = 1;
+		}
+	}
+
+	close (fd);
+#endif
+
+	// Fall back to reading the file into memory.
+	if (!filemap->mapped) {
+		if (dc_filemap_read (filemap, filename) != 0) {
+			free (filemap);
+			return -1;
+		}
+	}
+
+	*out = filemap;
+
+	return 0;
+}
+
+void
+dc_filemap_close (dc_filemap_t *filemap)
+{
+	if (filemap == NULL)
+		return;
+
+	if (filemap->mapped) {
+#ifdef _WIN32
+		UnmapViewOfFile (filemap->data);
+		CloseHandle (filemap->mapping);
+#else
+		munmap (filemap->data, filemap->size);
+#endif
+	} else {
+		free (filemap->data);
+	}
+
+	free (filemap);
+}
+
+const unsigned char *
+dc_filemap_get_data (dc_filemap_t *filemap)
+{
+	return filemap->data;
+}
+
+size_t
+dc_filemap_get_size (dc_filemap_t *filemap)
+{
+	return filemap->size;
+}
+
 int
 dc_platform_vsnprintf (char *str, size_t size, const char *format, va_list ap)
 {
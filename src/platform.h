@@ -24,6 +24,9 @@
 
 #include <stddef.h>
 #include <stdarg.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -57,8 +60,63 @@ extern "C" {
 #endif
 #endif
 
+#ifdef _WIN32
+typedef long dc_mutex_t;
+#define DC_MUTEX_INIT 0
+#else
+typedef pthread_mutex_t dc_mutex_t;
+#define DC_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+#endif
+
 int dc_platform_sleep(unsigned int milliseconds);
 
+/*
+ * A minimal mutex for protecting process wide state. It can be initialized
+ * statically with DC_MUTEX_INIT, and doesn't need to be destroyed. A mutex
+ * embedded in a dynamically allocated object is initialized with
+ * dc_mutex_init, and must be destroyed with dc_mutex_destroy.
+ */
+void dc_mutex_init (dc_mutex_t *mutex);
+void dc_mutex_destroy (dc_mutex_t *mutex);
+void dc_mutex_lock (dc_mutex_t *mutex);
+void dc_mutex_unlock (dc_mutex_t *mutex);
+
+/*
+ * A minimal thread, which must be either joined or detached exactly once.
+ */
+typedef struct dc_thread_t dc_thread_t;
+typedef void (*dc_thread_func_t) (void *userdata);
+
+int dc_thread_new (dc_thread_t **thread, dc_thread_func_t function, void *userdata);
+int dc_thread_join (dc_thread_t *thread);
+int dc_thread_detach (dc_thread_t *thread);
+
+/*
+ * A binary wakeup signal between two threads. Setting an already set
+ * signal has no effect, and waiting consumes the signal. On posix systems,
+ * the signal is backed by a pipe, and the file descriptor becomes readable
+ * while the signal is set. Otherwise, the file descriptor is -1.
+ */
+typedef struct dc_signal_t dc_signal_t;
+
+int dc_signal_new (dc_signal_t **signal);
+void dc_signal_free (dc_signal_t *signal);
+void dc_signal_set (dc_signal_t *signal);
+void dc_signal_wait (dc_signal_t *signal);
+int dc_signal_clear (dc_signal_t *signal);
+int dc_signal_get_fd (dc_signal_t *signal);
+
+/*
+ * A read-only view on the contents of a file. Regular files are memory
+ * mapped, and everything else is read into memory.
+ */
+typedef struct dc_filemap_t dc_filemap_t;
+
+int dc_filemap_open (dc_filemap_t **filemap, const char *filename);
+void dc_filemap_close (dc_filemap_t *filemap);
+const unsigned char *dc_filemap_get_data (dc_filemap_t *filemap);
+size_t dc_filemap_get_size (dc_filemap_t *filemap);
+
 /*
  * A wrapper for the vsnprintf function, which will always null terminate the
  * string and returns a negative value if the destination buffer is too small.
@@ -54,6 +54,7 @@ static const dc_device_vtable_t reefnet_sensuspro_device_vtable = {
 	NULL, /* write */
 	reefnet_sensuspro_device_dump, /* dump */
 	reefnet_sensuspro_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -63,6 +63,7 @@ static const dc_device_vtable_t reefnet_sensusultra_device_vtable = {
 	NULL, /* write */
 	reefnet_sensusultra_device_dump, /* dump */
 	reefnet_sensusultra_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -31,6 +31,7 @@
 #include "packet.h"
 #include "checksum.h"
 #include "array.h"
+#include "transaction.h"
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &seac_screen_device_vtable)
 
@@ -92,6 +93,7 @@ typedef struct seac_screen_layout_t {
 typedef struct seac_screen_device_t {
 	dc_device_t base;
 	dc_iostream_t *iostream;
+	dc_transaction_t transaction;
 	const seac_screen_commands_t *cmds;
 	const seac_screen_layout_t *layout;
 	unsigned int fingerprint;
@@ -112,6 +114,7 @@ static const dc_device_vtable_t seac_screen_device_vtable = {
 	NULL, /* write */
 	seac_screen_device_dump, /* dump */
 	seac_screen_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	NULL, /* timesync */
 	seac_screen_device_close, /* close */
 };
@@ -281,27 +284,31 @@ seac_screen_packet (seac_screen_device_t *device, unsigned int cmd, const unsign
 	return status;
 }
 
+typedef struct seac_screen_transfer_t {
+	unsigned int cmd;
+	const unsigned char *data;
+	unsigned int size;
+	unsigned char *answer;
+	unsigned int asize;
+} seac_screen_transfer_t;
+
 static dc_status_t
-seac_screen_transfer (seac_screen_device_t *device, unsigned int cmd, const unsigned char data[], unsigned int size, unsigned char answer[], unsigned int asize)
+seac_screen_transfer_attempt (dc_transaction_t *transaction, unsigned int attempt, void *userdata)
 {
-	unsigned int nretries = 0;
-	dc_status_t rc = DC_STATUS_SUCCESS;
-	while ((rc = seac_screen_packet (device, cmd, data, size, answer, asize)) != DC_STATUS_SUCCESS) {
-		// Automatically discard a corrupted packet,
-		// and request a new one.
-		if (rc != DC_STATUS_PROTOCOL && rc != DC_STATUS_TIMEOUT)
-			return rc;
+	seac_screen_transfer_t *transfer = (seac_screen_transfer_t *) userdata;
+	seac_screen_device_t *device = (seac_screen_device_t *) transaction->device;
 
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
-			return rc;
+	return seac_screen_packet (device, transfer->cmd, transfer->data, transfer->size, transfer->answer, transfer->asize);
+}
 
-		// Discard any garbage bytes.
-		dc_iostream_sleep (device->iostream, 100);
-		dc_iostream_purge (device->iostream, DC_DIRECTION_INPUT);
-	}
+static dc_status_t
+seac_screen_transfer (seac_screen_device_t *device, unsigned int cmd, const unsigned char data[], unsigned int size, unsigned char answer[], unsigned int asize)
+{
+	seac_screen_transfer_t transfer = {cmd, data, size, answer, asize};
 
-	return DC_STATUS_SUCCESS;
+	// The answers range from a few bytes to a full page of memory, so the
+	// adaptive timeout is scaled by the size of the answer.
+	return dc_transaction_run_sized (&device->transaction, asize, seac_screen_transfer_attempt, &transfer);
 }
 
 dc_status_t
@@ -353,6 +360,10 @@ seac_screen_device_open (dc_device_t **out, dc_context_t *context, dc_iostream_t
 		goto error_free_iostream;
 	}
 
+	// Retry failed transfers, and adapt the timeout to the round trip time.
+	dc_transaction_init (&device->transaction, (dc_device_t *) device, device->iostream, MAXRETRIES, 100, DC_DIRECTION_INPUT);
+	dc_transaction_set_adaptive (&device->transaction, timeout, timeout / 2);
+
 	// Make sure everything is in a sane state.
 	dc_iostream_sleep (device->iostream, 100);
 	dc_iostream_purge (device->iostream, DC_DIRECTION_ALL);
@@ -507,7 +518,7 @@ seac_screen_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 	}
 
 	return device_dump_read (abstract, layout->rb_profile_begin, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), SZ_READ);
+		dc_buffer_get_size (buffer), SZ_READ, SZ_READ);
 }
 
 static dc_status_t
@@ -63,6 +63,7 @@ static const dc_parser_vtable_t seac_screen_parser_vtable = {
 	seac_screen_parser_get_datetime, /* datetime */
 	seac_screen_parser_get_field, /* fields */
 	seac_screen_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_foreach_fixed */
 	NULL /* destroy */
 };
 
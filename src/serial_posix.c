@@ -73,6 +73,7 @@ static dc_status_t dc_serial_get_lines (dc_iostream_t *iostream, unsigned int *v
 static dc_status_t dc_serial_get_available (dc_iostream_t *iostream, size_t *value);
 static dc_status_t dc_serial_configure (dc_iostream_t *iostream, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol);
 static dc_status_t dc_serial_poll (dc_iostream_t *iostream, int timeout);
+static dc_status_t dc_serial_get_pollfd (dc_iostream_t *iostream, dc_pollfd_t pollfd[], size_t size, size_t *actual);
 static dc_status_t dc_serial_read (dc_iostream_t *iostream, void *data, size_t size, size_t *actual);
 static dc_status_t dc_serial_write (dc_iostream_t *iostream, const void *data, size_t size, size_t *actual);
 static dc_status_t dc_serial_ioctl (dc_iostream_t *iostream, unsigned int request, void *data, size_t size);
@@ -123,6 +124,7 @@ static const dc_iostream_vtable_t dc_serial_vtable = {
 	dc_serial_get_available, /* get_available */
 	dc_serial_configure, /* configure */
 	dc_serial_poll, /* poll */
+	dc_serial_get_pollfd, /* get_pollfd */
 	dc_serial_read, /* read */
 	dc_serial_write, /* write */
 	dc_serial_ioctl, /* ioctl */
@@ -700,6 +702,25 @@ dc_serial_poll (dc_iostream_t *abstract, int timeout)
 	}
 }
 
+static dc_status_t
+dc_serial_get_pollfd (dc_iostream_t *abstract, dc_pollfd_t pollfd[], size_t size, size_t *actual)
+{
+	dc_serial_t *device = (dc_serial_t *) abstract;
+
+	if (actual)
+		*actual = 1;
+
+	if (size < 1)
+		return DC_STATUS_NOMEMORY;
+
+	pollfd[0].fd = device->fd;
+	pollfd[0].events = DC_POLL_IN;
+	if (abstract->blocked)
+		pollfd[0].events |= DC_POLL_OUT;
+
+	return DC_STATUS_SUCCESS;
+}
+
 static dc_status_t
 dc_serial_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual)
 {
@@ -794,12 +815,17 @@ dc_serial_write (dc_iostream_t *abstract, const void *data, size_t size, size_t
 	dc_serial_t *device = (dc_serial_t *) abstract;
 	size_t nbytes = 0;
 
+	// In non-blocking mode, only the data that fits in the output buffer
+	// is written.
+	struct timeval tv = {0, 0};
+	struct timeval *timeout = abstract->nonblocking ? &tv : NULL;
+
 	while (nbytes < size) {
 		fd_set fds;
 		FD_ZERO (&fds);
 		FD_SET (device->fd, &fds);
 
-		int rc = select (device->fd + 1, NULL, &fds, NULL, NULL);
+		int rc = select (device->fd + 1, NULL, &fds, NULL, timeout);
 		if (rc < 0) {
 			int errcode = errno;
 			if (errcode == EINTR)
@@ -826,6 +852,12 @@ dc_serial_write (dc_iostream_t *abstract, const void *data, size_t size, size_t
 		nbytes += n;
 	}
 
+	if (abstract->nonblocking) {
+		if (nbytes == 0)
+			status = DC_STATUS_WOULDBLOCK;
+		goto out;
+	}
+
 	// Wait until all data has been transmitted.
 #ifdef __ANDROID__
 	/* Android is missing tcdrain, so use ioctl version instead */
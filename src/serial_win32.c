@@ -100,6 +100,7 @@ static const dc_iostream_vtable_t dc_serial_vtable = {
 	dc_serial_get_available, /* get_available */
 	dc_serial_configure, /* configure */
 	dc_serial_poll, /* poll */
+	NULL, /* get_pollfd */
 	dc_serial_read, /* read */
 	dc_serial_write, /* write */
 	dc_serial_ioctl, /* ioctl */
@@ -389,7 +389,7 @@ shearwater_common_transfer (shearwater_common_device_t *device, const unsigned c
 
 
 dc_status_t
-shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buffer, unsigned int address, unsigned int size, unsigned int compression, dc_event_progress_t *progress)
+shearwater_common_download_begin (shearwater_common_device_t *device, shearwater_common_download_t *download, dc_buffer_t *buffer, unsigned int address, unsigned int size, unsigned int compression, dc_event_progress_t *progress)
 {
 	dc_device_t *abstract = (dc_device_t *) device;
 	dc_status_t rc = DC_STATUS_SUCCESS;
@@ -406,8 +406,6 @@ shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buf
 		(size >> 16) & 0xFF,
 		(size >>  8) & 0xFF,
 		(size      ) & 0xFF};
-	unsigned char req_block[] = {0x36, 0x00};
-	unsigned char req_quit[] = {0x37};
 	unsigned char response[SZ_PACKET];
 
 	// Erase the current contents of the buffer.
@@ -416,10 +414,20 @@ shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buf
 		return DC_STATUS_NOMEMORY;
 	}
 
+	download->buffer = buffer;
+	download->progress = progress;
+	download->size = size;
+	download->compression = compression;
+	download->initial = 0;
+	download->current = 0;
+	download->maximum = 3 + size + 1;
+	download->nbytes = 0;
+	download->done = 0;
+	download->block = 1;
+
 	// Enable progress notifications.
-	unsigned int initial = 0, current = 0, maximum = 3 + size + 1;
 	if (progress) {
-		initial = progress->current;
+		download->initial = progress->current;
 		device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
 	}
 
@@ -437,44 +445,57 @@ shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buf
 
 	// Update and emit a progress event.
 	if (progress) {
-		current += 3;
-		progress->current = initial + STEP (current, maximum);
+		download->current += 3;
+		progress->current = download->initial + STEP (download->current, download->maximum);
 		device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
 	}
 
-	unsigned int done = 0;
-	unsigned char block = 1;
-	unsigned int nbytes = 0;
-	while (nbytes < size && !done) {
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+shearwater_common_download_next (shearwater_common_device_t *device, shearwater_common_download_t *download)
+{
+	dc_device_t *abstract = (dc_device_t *) device;
+	dc_event_progress_t *progress = download->progress;
+	dc_buffer_t *buffer = download->buffer;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	unsigned int n = 0;
+
+	unsigned char req_block[] = {0x36, download->block};
+	unsigned char req_quit[] = {0x37};
+	unsigned char response[SZ_PACKET];
+
+	if (download->nbytes < download->size && !download->done) {
 		// Transfer the block request.
-		req_block[1] = block;
 		rc = shearwater_common_transfer (device, req_block, sizeof (req_block), response, sizeof (response), &n);
 		if (rc != DC_STATUS_SUCCESS) {
 			return rc;
 		}
 
 		// Verify the block header.
-		if (n < 2 || response[0] != 0x76 || response[1] != block) {
+		if (n < 2 || response[0] != 0x76 || response[1] != download->block) {
 			ERROR (abstract->context, "Unexpected response packet.");
 			return DC_STATUS_PROTOCOL;
 		}
 
 		// Verify the block length.
 		unsigned int length = n - 2;
-		if (nbytes + length > size) {
+		if (download->nbytes + length > download->size) {
 			ERROR (abstract->context, "Unexpected packet size.");
 			return DC_STATUS_PROTOCOL;
 		}
 
 		// Update and emit a progress event.
 		if (progress) {
-			current += length;
-			progress->current = initial + STEP (current, maximum);
+			download->current += length;
+			progress->current = download->initial + STEP (download->current, download->maximum);
 			device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
 		}
 
-		if (compression) {
-			if (shearwater_common_decompress_lre (response + 2, length, buffer, &done) != 0) {
+		if (download->compression) {
+			if (shearwater_common_decompress_lre (response + 2, length, buffer, &download->done) != 0) {
 				ERROR (abstract->context, "Decompression error (LRE phase).");
 				return DC_STATUS_PROTOCOL;
 			}
@@ -485,11 +506,13 @@ shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buf
 			}
 		}
 
-		nbytes += length;
-		block++;
+		download->nbytes += length;
+		download->block++;
+
+		return DC_STATUS_WOULDBLOCK;
 	}
 
-	if (compression) {
+	if (download->compression) {
 		if (shearwater_common_decompress_xor (dc_buffer_get_data (buffer), dc_buffer_get_size (buffer)) != 0) {
 			ERROR (abstract->context, "Decompression error (XOR phase).");
 			return DC_STATUS_PROTOCOL;
@@ -510,8 +533,8 @@ shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buf
 
 	// Update and emit a progress event.
 	if (progress) {
-		current += 1;
-		progress->current = initial + STEP (current, maximum);
+		download->current += 1;
+		progress->current = download->initial + STEP (download->current, download->maximum);
 		device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
 	}
 
@@ -519,6 +542,24 @@ shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buf
 }
 
 
+dc_status_t
+shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buffer, unsigned int address, unsigned int size, unsigned int compression, dc_event_progress_t *progress)
+{
+	shearwater_common_download_t download;
+
+	dc_status_t rc = shearwater_common_download_begin (device, &download, buffer, address, size, compression, progress);
+	if (rc != DC_STATUS_SUCCESS) {
+		return rc;
+	}
+
+	do {
+		rc = shearwater_common_download_next (device, &download);
+	} while (rc == DC_STATUS_WOULDBLOCK);
+
+	return rc;
+}
+
+
 dc_status_t
 shearwater_common_rdbi (shearwater_common_device_t *device, unsigned int id, unsigned char data[], unsigned int size, unsigned int *actual)
 {
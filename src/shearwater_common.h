@@ -63,6 +63,24 @@ typedef struct shearwater_common_device_t {
 	dc_iostream_t *iostream;
 } shearwater_common_device_t;
 
+/*
+ * State of a resumable memory download. After the init request, every
+ * call to shearwater_common_download_next() transfers a single block,
+ * and returns DC_STATUS_WOULDBLOCK until the download has finished.
+ */
+typedef struct shearwater_common_download_t {
+	dc_buffer_t *buffer;
+	dc_event_progress_t *progress;
+	unsigned int size;
+	unsigned int compression;
+	unsigned int initial;
+	unsigned int current;
+	unsigned int maximum;
+	unsigned int nbytes;
+	unsigned int done;
+	unsigned char block;
+} shearwater_common_download_t;
+
 dc_status_t
 shearwater_common_setup (shearwater_common_device_t *device, dc_context_t *context, dc_iostream_t *iostream);
 
@@ -72,6 +90,12 @@ shearwater_common_transfer (shearwater_common_device_t *device, const unsigned c
 dc_status_t
 shearwater_common_download (shearwater_common_device_t *device, dc_buffer_t *buffer, unsigned int address, unsigned int size, unsigned int compression, dc_event_progress_t *progress);
 
+dc_status_t
+shearwater_common_download_begin (shearwater_common_device_t *device, shearwater_common_download_t *download, dc_buffer_t *buffer, unsigned int address, unsigned int size, unsigned int compression, dc_event_progress_t *progress);
+
+dc_status_t
+shearwater_common_download_next (shearwater_common_device_t *device, shearwater_common_download_t *download);
+
 dc_status_t
 shearwater_common_rdbi (shearwater_common_device_t *device, unsigned int id, unsigned char data[], unsigned int size, unsigned int *actual);
 
@@ -39,13 +39,33 @@
 #define RECORD_SIZE   0x20
 #define RECORD_COUNT  (MANIFEST_SIZE / RECORD_SIZE)
 
+typedef enum shearwater_petrel_phase_t {
+	PHASE_MANIFEST,
+	PHASE_DIVE,
+} shearwater_petrel_phase_t;
+
+typedef struct shearwater_petrel_download_t {
+	unsigned int active;
+	shearwater_petrel_phase_t phase;
+	shearwater_common_download_t transfer;
+	dc_event_progress_t progress;
+	dc_buffer_t *buffer;
+	dc_buffer_t *manifests;
+	unsigned int base_addr;
+	unsigned int current;
+	unsigned int maximum;
+	unsigned int offset;
+} shearwater_petrel_download_t;
+
 typedef struct shearwater_petrel_device_t {
 	shearwater_common_device_t base;
 	unsigned char fingerprint[4];
+	shearwater_petrel_download_t download;
 } shearwater_petrel_device_t;
 
 static dc_status_t shearwater_petrel_device_set_fingerprint (dc_device_t *abstract, const unsigned char data[], unsigned int size);
 static dc_status_t shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
+static dc_status_t shearwater_petrel_device_foreach_step (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
 static dc_status_t shearwater_petrel_device_timesync (dc_device_t *abstract, const dc_datetime_t *datetime);
 static dc_status_t shearwater_petrel_device_close (dc_device_t *abstract);
 
@@ -57,11 +77,14 @@ static const dc_device_vtable_t shearwater_petrel_device_vtable = {
 	NULL, /* write */
 	NULL, /* dump */
 	shearwater_petrel_device_foreach, /* foreach */
+	shearwater_petrel_device_foreach_step, /* foreach_step */
 	shearwater_petrel_device_timesync,
 	shearwater_petrel_device_close /* close */
 };
 
 
+static void shearwater_petrel_download_reset (shearwater_petrel_download_t *download);
+
 static unsigned int
 str2num (unsigned char data[], unsigned int size, unsigned int offset)
 {
@@ -95,6 +118,7 @@ shearwater_petrel_device_open (dc_device_t **out, dc_context_t *context, dc_iost
 
 	// Set the default values.
 	memset (device->fingerprint, 0, sizeof (device->fingerprint));
+	memset (&device->download, 0, sizeof (device->download));
 
 	// Setup the device.
 	status = shearwater_common_setup (&device->base, context, iostream);
@@ -119,6 +143,9 @@ shearwater_petrel_device_close (dc_device_t *abstract)
 	shearwater_common_device_t *device = (shearwater_common_device_t *) abstract;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 
+	// Discard an unfinished resumable download.
+	shearwater_petrel_download_reset (&((shearwater_petrel_device_t *) abstract)->download);
+
 	// Shutdown the device.
 	unsigned char request[] = {0x2E, 0x90, 0x20, 0x00};
 	rc = shearwater_common_transfer (device, request, sizeof (request), NULL, 0, NULL);
@@ -147,16 +174,108 @@ shearwater_petrel_device_set_fingerprint (dc_device_t *abstract, const unsigned
 }
 
 
+static void
+shearwater_petrel_download_reset (shearwater_petrel_download_t *download)
+{
+	dc_buffer_free (download->manifests);
+	dc_buffer_free (download->buffer);
+
+	download->active = 0;
+	download->phase = PHASE_MANIFEST;
+	download->buffer = NULL;
+	download->manifests = NULL;
+	download->base_addr = 0;
+	download->current = 0;
+	download->maximum = 0;
+	download->offset = 0;
+}
+
+
 static dc_status_t
-shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+shearwater_petrel_download_manifest (shearwater_petrel_device_t *device)
 {
-	shearwater_petrel_device_t *device = (shearwater_petrel_device_t *) abstract;
+	dc_device_t *abstract = (dc_device_t *) device;
+	shearwater_petrel_download_t *download = &device->download;
+	dc_event_progress_t *progress = &download->progress;
+
+	// Update the progress state.
+	// Assume the worst case scenario of a full manifest, and adjust the
+	// value with the actual number of dives after the manifest has been
+	// processed.
+	download->maximum += 1 + RECORD_COUNT;
+
+	// Start downloading a manifest.
+	progress->current = NSTEPS * download->current;
+	progress->maximum = NSTEPS * download->maximum;
+	dc_status_t rc = shearwater_common_download_begin (&device->base, &download->transfer,
+		download->buffer, MANIFEST_ADDR, MANIFEST_SIZE, 0, progress);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to download the manifest.");
+		return rc;
+	}
+
+	download->phase = PHASE_MANIFEST;
+
+	return DC_STATUS_WOULDBLOCK;
+}
+
+
+static dc_status_t
+shearwater_petrel_download_dive (shearwater_petrel_device_t *device)
+{
+	dc_device_t *abstract = (dc_device_t *) device;
+	shearwater_petrel_download_t *download = &device->download;
+	dc_event_progress_t *progress = &download->progress;
+
+	// Cache the buffer pointer and size.
+	unsigned char *data = dc_buffer_get_data (download->manifests);
+	unsigned int size = dc_buffer_get_size (download->manifests);
+
+	// skip deleted dives
+	while (download->offset < size && array_uint16_be (data + download->offset) == 0x5A23) {
+		download->offset += RECORD_SIZE;
+	}
+
+	if (download->offset >= size) {
+		// Update and emit a progress event.
+		progress->current = NSTEPS * download->current;
+		progress->maximum = NSTEPS * download->maximum;
+		device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
+		return DC_STATUS_SUCCESS;
+	}
+
+	// Get the address of the dive.
+	unsigned int address = array_uint32_be (data + download->offset + 20);
+
+	// Start downloading the dive.
+	progress->current = NSTEPS * download->current;
+	progress->maximum = NSTEPS * download->maximum;
+	dc_status_t rc = shearwater_common_download_begin (&device->base, &download->transfer,
+		download->buffer, download->base_addr + address, DIVE_SIZE, 1, progress);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to download the dive.");
+		return rc;
+	}
+
+	download->phase = PHASE_DIVE;
+
+	return DC_STATUS_WOULDBLOCK;
+}
+
+
+static dc_status_t
+shearwater_petrel_download_start (shearwater_petrel_device_t *device)
+{
+	dc_device_t *abstract = (dc_device_t *) device;
+	shearwater_petrel_download_t *download = &device->download;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 
 	// Enable progress notifications.
-	unsigned int current = 0, maximum = 0;
 	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
-	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+	download->progress = progress;
+	download->current = 0;
+	download->maximum = 0;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &download->progress);
 
 	// Read the serial number.
 	unsigned char rsp_serial[8] = {0};
@@ -230,129 +349,153 @@ shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t call
 		return DC_STATUS_DATAFORMAT;
 	}
 
+	download->base_addr = base_addr;
+
 	// Allocate memory buffers for the manifests.
-	dc_buffer_t *buffer = dc_buffer_new (MANIFEST_SIZE);
-	dc_buffer_t *manifests = dc_buffer_new (MANIFEST_SIZE);
-	if (buffer == NULL || manifests == NULL) {
+	download->buffer = dc_buffer_new (MANIFEST_SIZE);
+	download->manifests = dc_buffer_new (MANIFEST_SIZE);
+	if (download->buffer == NULL || download->manifests == NULL) {
 		ERROR (abstract->context, "Insufficient buffer space available.");
-		dc_buffer_free (buffer);
-		dc_buffer_free (manifests);
 		return DC_STATUS_NOMEMORY;
 	}
 
-	// Read the manifest pages
-	while (1) {
-		// Update the progress state.
-		// Assume the worst case scenario of a full manifest, and adjust the
-		// value with the actual number of dives after the manifest has been
-		// processed.
-		maximum += 1 + RECORD_COUNT;
-
-		// Download a manifest.
-		progress.current = NSTEPS * current;
-		progress.maximum = NSTEPS * maximum;
-		rc = shearwater_common_download (&device->base, buffer, MANIFEST_ADDR, MANIFEST_SIZE, 0, &progress);
-		if (rc != DC_STATUS_SUCCESS) {
-			ERROR (abstract->context, "Failed to download the manifest.");
-			dc_buffer_free (buffer);
-			dc_buffer_free (manifests);
-			return rc;
-		}
+	// Read the first manifest page.
+	return shearwater_petrel_download_manifest (device);
+}
 
-		HEXDUMP(abstract->context, DC_LOGLEVEL_DEBUG, "Manifest", dc_buffer_get_data (buffer), dc_buffer_get_size (buffer));
-
-		// Cache the buffer pointer and size.
-		unsigned char *data = dc_buffer_get_data (buffer);
-		unsigned int size = dc_buffer_get_size (buffer);
-
-		// Process the records in the manifest.
-		unsigned int count = 0, deleted = 0;
-		unsigned int offset = 0;
-		while (offset < size) {
-			// Check for a valid dive header.
-			unsigned int header = array_uint16_be (data + offset);
-			if (header == 0x5A23) {
-				// this is a deleted dive; keep looking
-				offset += RECORD_SIZE;
-				deleted++;
-				continue;
-			}
-			if (header != 0xA5C4)
-				break;
-
-			// Check the fingerprint data.
-			if (memcmp (data + offset + 4, device->fingerprint, sizeof (device->fingerprint)) == 0)
-				break;
 
-			offset += RECORD_SIZE;
-			count++;
+static dc_status_t
+shearwater_petrel_download_next (shearwater_petrel_device_t *device, dc_dive_callback_t callback, void *userdata)
+{
+	dc_device_t *abstract = (dc_device_t *) device;
+	shearwater_petrel_download_t *download = &device->download;
+
+	dc_status_t rc = shearwater_common_download_next (&device->base, &download->transfer);
+	if (rc == DC_STATUS_WOULDBLOCK) {
+		return rc;
+	} else if (rc != DC_STATUS_SUCCESS) {
+		if (download->phase == PHASE_MANIFEST) {
+			ERROR (abstract->context, "Failed to download the manifest.");
+		} else {
+			ERROR (abstract->context, "Failed to download the dive.");
 		}
+		return rc;
+	}
 
+	if (download->phase == PHASE_DIVE) {
 		// Update the progress state.
-		current += 1;
-		maximum -= RECORD_COUNT - count - deleted;
-
-		// Append the manifest records to the main buffer.
-		if (!dc_buffer_append (manifests, data, count * RECORD_SIZE)) {
-			ERROR (abstract->context, "Insufficient buffer space available.");
-			dc_buffer_free (buffer);
-			dc_buffer_free (manifests);
-			return DC_STATUS_NOMEMORY;
+		download->current += 1;
+
+		unsigned char *buf = dc_buffer_get_data (download->buffer);
+		unsigned int len = dc_buffer_get_size (download->buffer);
+		if (callback && !callback (buf, len, buf + 12, sizeof (device->fingerprint), userdata)) {
+			// Update and emit a progress event.
+			download->progress.current = NSTEPS * download->current;
+			download->progress.maximum = NSTEPS * download->maximum;
+			device_event_emit (abstract, DC_EVENT_PROGRESS, &download->progress);
+			return DC_STATUS_SUCCESS;
 		}
 
-		// Stop downloading manifest if there are no more records.
-		if (count + deleted != RECORD_COUNT)
-			break;
+		download->offset += RECORD_SIZE;
+
+		return shearwater_petrel_download_dive (device);
 	}
 
-	// Update and emit a progress event.
-	progress.current = NSTEPS * current;
-	progress.maximum = NSTEPS * maximum;
-	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+	HEXDUMP(abstract->context, DC_LOGLEVEL_DEBUG, "Manifest", dc_buffer_get_data (download->buffer), dc_buffer_get_size (download->buffer));
 
 	// Cache the buffer pointer and size.
-	unsigned char *data = dc_buffer_get_data (manifests);
-	unsigned int size = dc_buffer_get_size (manifests);
+	unsigned char *data = dc_buffer_get_data (download->buffer);
+	unsigned int size = dc_buffer_get_size (download->buffer);
 
+	// Process the records in the manifest.
+	unsigned int count = 0, deleted = 0;
 	unsigned int offset = 0;
 	while (offset < size) {
-		// skip deleted dives
-		if (array_uint16_be(data + offset) == 0x5A23) {
+		// Check for a valid dive header.
+		unsigned int header = array_uint16_be (data + offset);
+		if (header == 0x5A23) {
+			// this is a deleted dive; keep looking
 			offset += RECORD_SIZE;
+			deleted++;
 			continue;
 		}
-		// Get the address of the dive.
-		unsigned int address = array_uint32_be (data + offset + 20);
-
-		// Download the dive.
-		progress.current = NSTEPS * current;
-		progress.maximum = NSTEPS * maximum;
-		rc = shearwater_common_download (&device->base, buffer, base_addr + address, DIVE_SIZE, 1, &progress);
-		if (rc != DC_STATUS_SUCCESS) {
-			ERROR (abstract->context, "Failed to download the dive.");
-			dc_buffer_free (buffer);
-			dc_buffer_free (manifests);
-			return rc;
-		}
-
-		// Update the progress state.
-		current += 1;
+		if (header != 0xA5C4)
+			break;
 
-		unsigned char *buf = dc_buffer_get_data (buffer);
-		unsigned int len = dc_buffer_get_size (buffer);
-		if (callback && !callback (buf, len, buf + 12, sizeof (device->fingerprint), userdata))
+		// Check the fingerprint data.
+		if (memcmp (data + offset + 4, device->fingerprint, sizeof (device->fingerprint)) == 0)
 			break;
 
 		offset += RECORD_SIZE;
+		count++;
+	}
+
+	// Update the progress state.
+	download->current += 1;
+	download->maximum -= RECORD_COUNT - count - deleted;
+
+	// Append the manifest records to the main buffer.
+	if (!dc_buffer_append (download->manifests, data, count * RECORD_SIZE)) {
+		ERROR (abstract->context, "Insufficient buffer space available.");
+		return DC_STATUS_NOMEMORY;
 	}
 
+	// Continue downloading manifests as long as they are full.
+	if (count + deleted == RECORD_COUNT)
+		return shearwater_petrel_download_manifest (device);
+
 	// Update and emit a progress event.
-	progress.current = NSTEPS * current;
-	progress.maximum = NSTEPS * maximum;
-	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+	download->progress.current = NSTEPS * download->current;
+	download->progress.maximum = NSTEPS * download->maximum;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &download->progress);
+
+	// Start downloading the dives.
+	download->offset = 0;
+
+	return shearwater_petrel_download_dive (device);
+}
+
 
-	dc_buffer_free (manifests);
-	dc_buffer_free (buffer);
+/*
+ * Resumable download. The first step reads the device information and
+ * starts downloading the manifests. Every next step transfers a single
+ * block of a manifest or a dive. DC_STATUS_WOULDBLOCK is returned as
+ * long as the download hasn't finished.
+ */
+static dc_status_t
+shearwater_petrel_device_foreach_step (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	shearwater_petrel_device_t *device = (shearwater_petrel_device_t *) abstract;
+	shearwater_petrel_download_t *download = &device->download;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	if (!download->active) {
+		download->active = 1;
+		rc = shearwater_petrel_download_start (device);
+	} else {
+		rc = shearwater_petrel_download_next (device, callback, userdata);
+	}
+
+	if (rc != DC_STATUS_WOULDBLOCK) {
+		shearwater_petrel_download_reset (download);
+	}
+
+	return rc;
+}
+
+
+static dc_status_t
+shearwater_petrel_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	shearwater_petrel_device_t *device = (shearwater_petrel_device_t *) abstract;
+
+	// Discard an unfinished resumable download.
+	shearwater_petrel_download_reset (&device->download);
+
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	do {
+		rc = shearwater_petrel_device_foreach_step (abstract, callback, userdata);
+	} while (rc == DC_STATUS_WOULDBLOCK);
 
 	return rc;
 }
@@ -36,15 +36,25 @@
 #define RB_PROFILE_BEGIN 0
 #define RB_PROFILE_END   0x1F600
 
+typedef struct shearwater_predator_download_t {
+	unsigned int active;
+	shearwater_common_download_t transfer;
+	dc_event_progress_t progress;
+	dc_buffer_t *buffer;
+} shearwater_predator_download_t;
+
 typedef struct shearwater_predator_device_t {
 	shearwater_common_device_t base;
 	unsigned char fingerprint[4];
+	shearwater_predator_download_t download;
 } shearwater_predator_device_t;
 
 static dc_status_t shearwater_predator_device_set_fingerprint (dc_device_t *abstract, const unsigned char data[], unsigned int size);
 static dc_status_t shearwater_predator_device_dump (dc_device_t *abstract, dc_buffer_t *buffer);
 static dc_status_t shearwater_predator_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
+static dc_status_t shearwater_predator_device_foreach_step (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
 static dc_status_t shearwater_predator_device_timesync (dc_device_t *abstract, const dc_datetime_t *datetime);
+static dc_status_t shearwater_predator_device_close (dc_device_t *abstract);
 
 static const dc_device_vtable_t shearwater_predator_device_vtable = {
 	sizeof(shearwater_predator_device_t),
@@ -54,8 +64,9 @@ static const dc_device_vtable_t shearwater_predator_device_vtable = {
 	NULL, /* write */
 	shearwater_predator_device_dump, /* dump */
 	shearwater_predator_device_foreach, /* foreach */
+	shearwater_predator_device_foreach_step, /* foreach_step */
 	shearwater_predator_device_timesync,
-	NULL /* close */
+	shearwater_predator_device_close /* close */
 };
 
 static dc_status_t
@@ -79,6 +90,7 @@ shearwater_predator_device_open (dc_device_t **out, dc_context_t *context, dc_io
 
 	// Set the default values.
 	memset (device->fingerprint, 0, sizeof (device->fingerprint));
+	memset (&device->download, 0, sizeof (device->download));
 
 	// Setup the device.
 	status = shearwater_common_setup (&device->base, context, iostream);
@@ -113,6 +125,41 @@ shearwater_predator_device_set_fingerprint (dc_device_t *abstract, const unsigne
 }
 
 
+static void
+shearwater_predator_download_reset (shearwater_predator_download_t *download)
+{
+	dc_buffer_free (download->buffer);
+
+	download->active = 0;
+	download->buffer = NULL;
+}
+
+
+static dc_status_t
+shearwater_predator_device_close (dc_device_t *abstract)
+{
+	shearwater_predator_device_t *device = (shearwater_predator_device_t *) abstract;
+
+	// Discard an unfinished resumable download.
+	shearwater_predator_download_reset (&device->download);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+static void
+shearwater_predator_device_devinfo (dc_device_t *abstract, dc_buffer_t *buffer)
+{
+	// Emit a device info event.
+	unsigned char *data = dc_buffer_get_data (buffer);
+	dc_event_devinfo_t devinfo;
+	devinfo.model = data[0x2000D];
+	devinfo.firmware = bcd2dec (data[0x2000A]);
+	devinfo.serial = array_uint32_be (data + 0x20002);
+	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
+}
+
+
 static dc_status_t
 shearwater_predator_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 {
@@ -136,18 +183,67 @@ shearwater_predator_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 		return status;
 	}
 
-	// Emit a device info event.
-	unsigned char *data = dc_buffer_get_data (buffer);
-	dc_event_devinfo_t devinfo;
-	devinfo.model = data[0x2000D];
-	devinfo.firmware = bcd2dec (data[0x2000A]);
-	devinfo.serial = array_uint32_be (data + 0x20002);
-	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
+	shearwater_predator_device_devinfo (abstract, buffer);
 
 	return status;
 }
 
 
+/*
+ * Resumable download. The first step starts the memory dump, and every
+ * next step transfers a single block. Once the dump has finished, all
+ * dives are extracted in the last step.
+ */
+static dc_status_t
+shearwater_predator_device_foreach_step (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	shearwater_predator_device_t *device = (shearwater_predator_device_t *) abstract;
+	shearwater_predator_download_t *download = &device->download;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	if (!download->active) {
+		download->active = 1;
+
+		download->buffer = dc_buffer_new (SZ_MEMORY);
+		if (download->buffer == NULL) {
+			shearwater_predator_download_reset (download);
+			return DC_STATUS_NOMEMORY;
+		}
+
+		// Enable progress notifications.
+		dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
+		download->progress = progress;
+		download->progress.current = 0;
+		download->progress.maximum = NSTEPS;
+
+		// Start the memory dump.
+		rc = shearwater_common_download_begin (&device->base, &download->transfer,
+			download->buffer, 0xDD000000, SZ_MEMORY, 0, &download->progress);
+		if (rc != DC_STATUS_SUCCESS) {
+			shearwater_predator_download_reset (download);
+			return rc;
+		}
+
+		return DC_STATUS_WOULDBLOCK;
+	}
+
+	rc = shearwater_common_download_next (&device->base, &download->transfer);
+	if (rc == DC_STATUS_WOULDBLOCK)
+		return rc;
+
+	if (rc == DC_STATUS_SUCCESS) {
+		shearwater_predator_device_devinfo (abstract, download->buffer);
+
+		rc = shearwater_predator_extract_dives (abstract, dc_buffer_get_data (download->buffer),
+			dc_buffer_get_size (download->buffer), callback, userdata);
+	}
+
+	shearwater_predator_download_reset (download);
+
+	return rc;
+}
+
+
 static dc_status_t
 shearwater_predator_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
 {
@@ -161,6 +161,7 @@ struct shearwater_predator_parser_t {
 	unsigned int hpccr;
 	unsigned int calibrated;
 	double calibration[3];
+	unsigned int calibration_fixed[3];
 	unsigned int divemode;
 	unsigned int units;
 	unsigned int atmospheric;
@@ -170,6 +171,7 @@ struct shearwater_predator_parser_t {
 static dc_status_t shearwater_predator_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t shearwater_predator_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t shearwater_predator_parser_samples_foreach_fixed (dc_parser_t *abstract, dc_sample_fixed_callback_t callback, void *userdata);
 
 static dc_status_t shearwater_predator_parser_cache (shearwater_predator_parser_t *parser);
 
@@ -182,6 +184,7 @@ static const dc_parser_vtable_t shearwater_predator_parser_vtable = {
 	shearwater_predator_parser_get_datetime, /* datetime */
 	shearwater_predator_parser_get_field, /* fields */
 	shearwater_predator_parser_samples_foreach, /* samples_foreach */
+	shearwater_predator_parser_samples_foreach_fixed, /* samples_foreach_fixed */
 	NULL /* destroy */
 };
 
@@ -194,6 +197,7 @@ static const dc_parser_vtable_t shearwater_petrel_parser_vtable = {
 	shearwater_predator_parser_get_datetime, /* datetime */
 	shearwater_predator_parser_get_field, /* fields */
 	shearwater_predator_parser_samples_foreach, /* samples_foreach */
+	shearwater_predator_parser_samples_foreach_fixed, /* samples_foreach_fixed */
 	NULL /* destroy */
 };
 
@@ -283,6 +287,7 @@ shearwater_common_parser_create (dc_parser_t **out, dc_context_t *context, const
 	parser->calibrated = 0;
 	for (unsigned int i = 0; i < 3; ++i) {
 		parser->calibration[i] = 0.0;
+		parser->calibration_fixed[i] = 0;
 	}
 	parser->divemode = M_OC_TEC;
 	parser->units = METRIC;
@@ -661,12 +666,14 @@ shearwater_predator_parser_cache (shearwater_predator_parser_t *parser)
 	for (size_t i = 0; i < 3; ++i) {
 		unsigned int calibration = array_uint16_be(data + base + 1 + i * 2);
 		parser->calibration[i] = calibration / 100000.0;
+		parser->calibration_fixed[i] = calibration * 10; // 1/1000 millibar
 		if (parser->model == PREDATOR) {
 			// The Predator expects the mV output of the cells to be
 			// within 30mV to 70mV in 100% O2 at 1 atmosphere. If the
 			// calibration value is scaled with a factor 2.2, then the
 			// sensors lines up and matches the average.
 			parser->calibration[i] *= 2.2;
+			parser->calibration_fixed[i] = calibration * 22;
 		}
 		if (data[base] & (1 << i)) {
 			if (calibration == 2100) {
@@ -902,7 +909,7 @@ shearwater_predator_parser_get_field (dc_parser_t *abstract, dc_field_type_t typ
 
 
 static dc_status_t
-shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+shearwater_predator_parser_samples (dc_parser_t *abstract, const dc_sample_sink_t *sink)
 {
 	shearwater_predator_parser_t *parser = (shearwater_predator_parser_t *) abstract;
 
@@ -929,6 +936,7 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 	unsigned int length = size - parser->footersize;
 	while (offset + parser->samplesize <= length) {
 		dc_sample_value_t sample = {0};
+		dc_sample_fixed_t fixed = {0};
 
 		// Ignore empty samples.
 		if (array_isequal (data + offset, parser->samplesize, 0x00)) {
@@ -943,16 +951,23 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 			type == LOG_RECORD_AVELO_SAMPLE) {
 			// Time (seconds).
 			time += interval;
-			sample.time = time;
-			if (callback) callback (DC_SAMPLE_TIME, &sample, userdata);
+			sample.time = fixed.time = time;
+			dc_sample_sink_emit (sink, DC_SAMPLE_TIME, &sample, &fixed);
 
 			// Depth (1/10 m or ft).
 			unsigned int depth = array_uint16_be (data + pnf + offset);
-			if (parser->units == IMPERIAL)
-				sample.depth = depth * FEET / 10.0;
-			else
-				sample.depth = depth / 10.0;
-			if (callback) callback (DC_SAMPLE_DEPTH, &sample, userdata);
+			if (sink->fixed) {
+				if (parser->units == IMPERIAL)
+					fixed.depth = (depth * 3048 + 50) / 100;
+				else
+					fixed.depth = depth * 100;
+			} else {
+				if (parser->units == IMPERIAL)
+					sample.depth = depth * FEET / 10.0;
+				else
+					sample.depth = depth / 10.0;
+			}
+			dc_sample_sink_emit (sink, DC_SAMPLE_DEPTH, &sample, &fixed);
 
 			// Temperature (°C or °F).
 			int temperature = (signed char) data[offset + pnf + 13];
@@ -963,11 +978,18 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 					temperature = 0;
 				}
 			}
-			if (parser->units == IMPERIAL)
-				sample.temperature = (temperature - 32.0) * (5.0 / 9.0);
-			else
-				sample.temperature = temperature;
-			if (callback) callback (DC_SAMPLE_TEMPERATURE, &sample, userdata);
+			if (sink->fixed) {
+				if (parser->units == IMPERIAL)
+					fixed.temperature = ((temperature - 32) * 5000 + 273150 * 9 + 4) / 9;
+				else
+					fixed.temperature = temperature * 1000 + 273150;
+			} else {
+				if (parser->units == IMPERIAL)
+					sample.temperature = (temperature - 32.0) * (5.0 / 9.0);
+				else
+					sample.temperature = temperature;
+			}
+			dc_sample_sink_emit (sink, DC_SAMPLE_TEMPERATURE, &sample, &fixed);
 
 			// Status flags.
 			unsigned int status = 0;
@@ -980,41 +1002,61 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 			if (ccr) {
 				// PPO2
 				if ((status & PPO2_EXTERNAL) == 0) {
-					sample.ppo2.sensor = DC_SENSOR_NONE;
-					sample.ppo2.value = data[offset + pnf + 6] / 100.0;
-					if (callback) callback (DC_SAMPLE_PPO2, &sample, userdata);
-
-					sample.ppo2.sensor = 0;
-					sample.ppo2.value = data[offset + pnf + 12] * parser->calibration[0];
-					if (callback && (parser->calibrated & 0x01)) callback (DC_SAMPLE_PPO2, &sample, userdata);
-
-					sample.ppo2.sensor = 1;
-					sample.ppo2.value = data[offset + pnf + 14] * parser->calibration[1];
-					if (callback && (parser->calibrated & 0x02)) callback (DC_SAMPLE_PPO2, &sample, userdata);
-
-					sample.ppo2.sensor = 2;
-					sample.ppo2.value = data[offset + pnf + 15] * parser->calibration[2];
-					if (callback && (parser->calibrated & 0x04)) callback (DC_SAMPLE_PPO2, &sample, userdata);
+					sample.ppo2.sensor = fixed.ppo2.sensor = DC_SENSOR_NONE;
+					if (sink->fixed)
+						fixed.ppo2.value = data[offset + pnf + 6] * 10;
+					else
+						sample.ppo2.value = data[offset + pnf + 6] / 100.0;
+					dc_sample_sink_emit (sink, DC_SAMPLE_PPO2, &sample, &fixed);
+
+					sample.ppo2.sensor = fixed.ppo2.sensor = 0;
+					if (sink->fixed)
+						fixed.ppo2.value = (data[offset + pnf + 12] * parser->calibration_fixed[0] + 500) / 1000;
+					else
+						sample.ppo2.value = data[offset + pnf + 12] * parser->calibration[0];
+					if (parser->calibrated & 0x01) dc_sample_sink_emit (sink, DC_SAMPLE_PPO2, &sample, &fixed);
+
+					sample.ppo2.sensor = fixed.ppo2.sensor = 1;
+					if (sink->fixed)
+						fixed.ppo2.value = (data[offset + pnf + 14] * parser->calibration_fixed[1] + 500) / 1000;
+					else
+						sample.ppo2.value = data[offset + pnf + 14] * parser->calibration[1];
+					if (parser->calibrated & 0x02) dc_sample_sink_emit (sink, DC_SAMPLE_PPO2, &sample, &fixed);
+
+					sample.ppo2.sensor = fixed.ppo2.sensor = 2;
+					if (sink->fixed)
+						fixed.ppo2.value = (data[offset + pnf + 15] * parser->calibration_fixed[2] + 500) / 1000;
+					else
+						sample.ppo2.value = data[offset + pnf + 15] * parser->calibration[2];
+					if (parser->calibrated & 0x04) dc_sample_sink_emit (sink, DC_SAMPLE_PPO2, &sample, &fixed);
 				}
 
 				// Setpoint
+				unsigned int setpoint = 0;
 				if (parser->petrel) {
-					sample.setpoint = data[offset + pnf + 18] / 100.0;
+					setpoint = data[offset + pnf + 18];
 				} else {
 					// this will only ever be called for the actual Predator, so no adjustment needed for PNF
 					if (status & SETPOINT_HIGH) {
-						sample.setpoint = data[18] / 100.0;
+						setpoint = data[18];
 					} else {
-						sample.setpoint = data[17] / 100.0;
+						setpoint = data[17];
 					}
 				}
-				if (callback) callback (DC_SAMPLE_SETPOINT, &sample, userdata);
+				if (sink->fixed)
+					fixed.setpoint = setpoint * 10;
+				else
+					sample.setpoint = setpoint / 100.0;
+				dc_sample_sink_emit (sink, DC_SAMPLE_SETPOINT, &sample, &fixed);
 			}
 
 			// CNS
 			if (parser->petrel) {
-				sample.cns = data[offset + pnf + 22] / 100.0;
-				if (callback) callback (DC_SAMPLE_CNS, &sample, userdata);
+				if (sink->fixed)
+					fixed.cns = data[offset + pnf + 22] * 10;
+				else
+					sample.cns = data[offset + pnf + 22] / 100.0;
+				dc_sample_sink_emit (sink, DC_SAMPLE_CNS, &sample, &fixed);
 			}
 
 			// Gaschange.
@@ -1028,8 +1070,8 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 					return DC_STATUS_DATAFORMAT;
 				}
 
-				sample.gasmix = idx;
-				if (callback) callback (DC_SAMPLE_GASMIX, &sample, userdata);
+				sample.gasmix = fixed.gasmix = idx;
+				dc_sample_sink_emit (sink, DC_SAMPLE_GASMIX, &sample, &fixed);
 				o2_previous = o2;
 				he_previous = he;
 				dil_previous = ccr;
@@ -1038,18 +1080,26 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 			// Deco stop / NDL.
 			unsigned int decostop = array_uint16_be (data + offset + pnf + 2);
 			if (decostop) {
-				sample.deco.type = DC_DECO_DECOSTOP;
-				if (parser->units == IMPERIAL)
-					sample.deco.depth = decostop * FEET;
-				else
-					sample.deco.depth = decostop;
+				sample.deco.type = fixed.deco.type = DC_DECO_DECOSTOP;
+				if (sink->fixed) {
+					if (parser->units == IMPERIAL)
+						fixed.deco.depth = (decostop * 3048 + 5) / 10;
+					else
+						fixed.deco.depth = decostop * 1000;
+				} else {
+					if (parser->units == IMPERIAL)
+						sample.deco.depth = decostop * FEET;
+					else
+						sample.deco.depth = decostop;
+				}
 			} else {
-				sample.deco.type = DC_DECO_NDL;
+				sample.deco.type = fixed.deco.type = DC_DECO_NDL;
 				sample.deco.depth = 0.0;
+				fixed.deco.depth = 0;
 			}
-			sample.deco.time = data[offset + pnf + 9] * 60;
-			sample.deco.tts = array_uint16_be (data + offset + pnf + 4) * 60;
-			if (callback) callback (DC_SAMPLE_DECO, &sample, userdata);
+			sample.deco.time = fixed.deco.time = data[offset + pnf + 9] * 60;
+			sample.deco.tts = fixed.deco.tts = array_uint16_be (data + offset + pnf + 4) * 60;
+			dc_sample_sink_emit (sink, DC_SAMPLE_DECO, &sample, &fixed);
 
 			// for logversion 7 and newer (introduced for Perdix AI)
 			// detect tank pressure
@@ -1071,9 +1121,12 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 					if (pressure < 0xFFF0) {
 						pressure &= 0x0FFF;
 						if (pressure) {
-							sample.pressure.tank = parser->tankidx[id];
-							sample.pressure.value = pressure * 2 * PSI / BAR;
-							if (callback) callback (DC_SAMPLE_PRESSURE, &sample, userdata);
+							sample.pressure.tank = fixed.pressure.tank = parser->tankidx[id];
+							if (sink->fixed)
+								fixed.pressure.value = (pressure * 13789514586ULL + 50000000) / 100000000;
+							else
+								sample.pressure.value = pressure * 2 * PSI / BAR;
+							dc_sample_sink_emit (sink, DC_SAMPLE_PRESSURE, &sample, &fixed);
 						}
 					}
 				}
@@ -1086,8 +1139,8 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 				//    0xFC Not available because of DECO
 				//    0xFB Tank size or max pressure haven’t been set up
 				if (data[offset + pnf + 21] < 0xF0) {
-					sample.rbt = data[offset + pnf + 21];
-					if (callback) callback (DC_SAMPLE_RBT, &sample, userdata);
+					sample.rbt = fixed.rbt = data[offset + pnf + 21];
+					dc_sample_sink_emit (sink, DC_SAMPLE_RBT, &sample, &fixed);
 				}
 			}
 		} else if (type == LOG_RECORD_DIVE_SAMPLE_EXT) {
@@ -1099,9 +1152,12 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 					if (pressure < 0xFFF0) {
 						pressure &= 0x0FFF;
 						if (pressure) {
-							sample.pressure.tank = parser->tankidx[id];
-							sample.pressure.value = pressure * 2 * PSI / BAR;
-							if (callback) callback (DC_SAMPLE_PRESSURE, &sample, userdata);
+							sample.pressure.tank = fixed.pressure.tank = parser->tankidx[id];
+							if (sink->fixed)
+								fixed.pressure.value = (pressure * 13789514586ULL + 50000000) / 100000000;
+							else
+								sample.pressure.value = pressure * 2 * PSI / BAR;
+							dc_sample_sink_emit (sink, DC_SAMPLE_PRESSURE, &sample, &fixed);
 						}
 					}
 				}
@@ -1112,9 +1168,12 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 					unsigned int pressure = array_uint16_be (data + offset + pnf + 4 + i * 2);
 					unsigned int id = 4 + i;
 					if (pressure) {
-						sample.pressure.tank = parser->tankidx[id];
-						sample.pressure.value = pressure * 2 * PSI / BAR;
-						if (callback) callback (DC_SAMPLE_PRESSURE, &sample, userdata);
+						sample.pressure.tank = fixed.pressure.tank = parser->tankidx[id];
+						if (sink->fixed)
+							fixed.pressure.value = (pressure * 13789514586ULL + 50000000) / 100000000;
+						else
+							sample.pressure.value = pressure * 2 * PSI / BAR;
+						dc_sample_sink_emit (sink, DC_SAMPLE_PRESSURE, &sample, &fixed);
 					}
 				}
 			}
@@ -1132,18 +1191,28 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 
 				// Time (seconds).
 				time += interval;
-				sample.time = time;
-				if (callback) callback (DC_SAMPLE_TIME, &sample, userdata);
+				sample.time = fixed.time = time;
+				dc_sample_sink_emit (sink, DC_SAMPLE_TIME, &sample, &fixed);
 
 				// Depth (absolute pressure in millibar)
 				unsigned int depth = array_uint16_be (data + idx + 1);
-				sample.depth = (signed int)(depth - parser->atmospheric) * (BAR / 1000.0) / (parser->density * GRAVITY);
-				if (callback) callback (DC_SAMPLE_DEPTH, &sample, userdata);
+				if (sink->fixed) {
+					long long pressure = (signed int)(depth - parser->atmospheric) * 100000000LL;
+					long long scale = parser->density * 980665LL;
+					if (scale)
+						fixed.depth = (pressure + (pressure < 0 ? -scale : scale) / 2) / scale;
+				} else {
+					sample.depth = (signed int)(depth - parser->atmospheric) * (BAR / 1000.0) / (parser->density * GRAVITY);
+				}
+				dc_sample_sink_emit (sink, DC_SAMPLE_DEPTH, &sample, &fixed);
 
 				// Temperature (1/10 °C).
 				int temperature = (signed short) array_uint16_be (data + idx + 3);
-				sample.temperature = temperature / 10.0;
-				if (callback) callback (DC_SAMPLE_TEMPERATURE, &sample, userdata);
+				if (sink->fixed)
+					fixed.temperature = temperature * 100 + 273150;
+				else
+					sample.temperature = temperature / 10.0;
+				dc_sample_sink_emit (sink, DC_SAMPLE_TEMPERATURE, &sample, &fixed);
 			}
 		} else if (type == LOG_RECORD_INFO_EVENT) {
 			unsigned int event = data[offset + 1];
@@ -1154,16 +1223,16 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 			if (event == INFO_EVENT_TAG_LOG) {
 				// Compass heading
 				if (w1 != 0xFFFFFFFF) {
-					sample.bearing = w1;
-					if (callback) callback (DC_SAMPLE_BEARING, &sample, userdata);
+					sample.bearing = fixed.bearing = w1;
+					dc_sample_sink_emit (sink, DC_SAMPLE_BEARING, &sample, &fixed);
 				}
 
 				// Tag
-				sample.event.type = SAMPLE_EVENT_BOOKMARK;
-				sample.event.time = 0;
-				sample.event.flags = 0;
-				sample.event.value = w2;
-				if (callback) callback (DC_SAMPLE_EVENT, &sample, userdata);
+				sample.event.type = fixed.event.type = SAMPLE_EVENT_BOOKMARK;
+				sample.event.time = fixed.event.time = 0;
+				sample.event.flags = fixed.event.flags = 0;
+				sample.event.value = fixed.event.value = w2;
+				dc_sample_sink_emit (sink, DC_SAMPLE_EVENT, &sample, &fixed);
 			}
 		}
 
@@ -1172,3 +1241,19 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 
 	return DC_STATUS_SUCCESS;
 }
+
+static dc_status_t
+shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+{
+	dc_sample_sink_t sink = {callback, NULL, userdata};
+
+	return shearwater_predator_parser_samples (abstract, &sink);
+}
+
+static dc_status_t
+shearwater_predator_parser_samples_foreach_fixed (dc_parser_t *abstract, dc_sample_fixed_callback_t callback, void *userdata)
+{
+	dc_sample_sink_t sink = {NULL, callback, userdata};
+
+	return shearwater_predator_parser_samples (abstract, &sink);
+}
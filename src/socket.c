@@ -241,6 +241,30 @@ dc_socket_poll (dc_iostream_t *abstract, int timeout)
 	}
 }
 
+dc_status_t
+dc_socket_get_pollfd (dc_iostream_t *abstract, dc_pollfd_t pollfd[], size_t size, size_t *actual)
+{
+#ifdef _WIN32
+	// A winsock handle is not a file descriptor.
+	return DC_STATUS_UNSUPPORTED;
+#else
+	dc_socket_t *socket = (dc_socket_t *) abstract;
+
+	if (actual)
+		*actual = 1;
+
+	if (size < 1)
+		return DC_STATUS_NOMEMORY;
+
+	pollfd[0].fd = socket->fd;
+	pollfd[0].events = DC_POLL_IN;
+	if (abstract->blocked)
+		pollfd[0].events |= DC_POLL_OUT;
+
+	return DC_STATUS_SUCCESS;
+#endif
+}
+
 dc_status_t
 dc_socket_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual)
 {
@@ -306,12 +330,22 @@ dc_socket_write (dc_iostream_t *abstract, const void *data, size_t size, size_t
 	dc_socket_t *socket = (dc_socket_t *) abstract;
 	size_t nbytes = 0;
 
+	// In non-blocking mode, only the data that fits in the send buffer
+	// is written.
+	struct timeval tv = {0, 0};
+	struct timeval *timeout = abstract->nonblocking ? &tv : NULL;
+	int flags = MSG_NOSIGNAL;
+#ifdef MSG_DONTWAIT
+	if (abstract->nonblocking)
+		flags |= MSG_DONTWAIT;
+#endif
+
 	while (nbytes < size) {
 		fd_set fds;
 		FD_ZERO (&fds);
 		FD_SET (socket->fd, &fds);
 
-		int rc = select (socket->fd + 1, NULL, &fds, NULL, NULL);
+		int rc = select (socket->fd + 1, NULL, &fds, NULL, timeout);
 		if (rc < 0) {
 			s_errcode_t errcode = S_ERRNO;
 			if (errcode == S_EINTR)
@@ -323,11 +357,16 @@ dc_socket_write (dc_iostream_t *abstract, const void *data, size_t size, size_t
 			break; // Timeout.
 		}
 
-		s_ssize_t n = send (socket->fd, (const char *) data + nbytes, size - nbytes, MSG_NOSIGNAL);
+		s_ssize_t n = send (socket->fd, (const char *) data + nbytes, size - nbytes, flags);
 		if (n < 0) {
 			s_errcode_t errcode = S_ERRNO;
-			if (errcode == S_EINTR || errcode == S_EAGAIN)
+			if (errcode == S_EINTR)
 				continue; // Retry.
+			if (errcode == S_EAGAIN) {
+				if (abstract->nonblocking)
+					break; // Output buffer full.
+				continue; // Retry.
+			}
 			SYSERROR (abstract->context, errcode);
 			status = dc_socket_syserror(errcode);
 			goto out;
@@ -338,7 +377,10 @@ dc_socket_write (dc_iostream_t *abstract, const void *data, size_t size, size_t
 		nbytes += n;
 	}
 
-	if (nbytes != size) {
+	if (abstract->nonblocking) {
+		if (nbytes == 0)
+			status = DC_STATUS_WOULDBLOCK;
+	} else if (nbytes != size) {
 		status = DC_STATUS_TIMEOUT;
 	}
 
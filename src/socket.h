@@ -112,6 +112,9 @@ dc_socket_get_available (dc_iostream_t *iostream, size_t *value);
 dc_status_t
 dc_socket_poll (dc_iostream_t *iostream, int timeout);
 
+dc_status_t
+dc_socket_get_pollfd (dc_iostream_t *iostream, dc_pollfd_t pollfd[], size_t size, size_t *actual);
+
 dc_status_t
 dc_socket_read (dc_iostream_t *iostream, void *data, size_t size, size_t *actual);
 
@@ -74,6 +74,7 @@ static const dc_device_vtable_t sporasub_sp2_device_vtable = {
 	NULL, /* write */
 	sporasub_sp2_device_dump, /* dump */
 	sporasub_sp2_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	sporasub_sp2_device_timesync, /* timesync */
 	NULL /* close */
 };
@@ -366,7 +367,7 @@ sporasub_sp2_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 	device_event_emit (abstract, DC_EVENT_VENDOR, &vendor);
 
 	return device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), SZ_READ);
+		dc_buffer_get_size (buffer), SZ_READ / 8, SZ_READ);
 }
 
 static dc_status_t
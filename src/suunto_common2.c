@@ -49,12 +49,34 @@ suunto_common2_device_init (suunto_common2_device_t *device)
 	device->layout = NULL;
 	memset (device->version, 0, sizeof (device->version));
 	memset (device->fingerprint, 0, sizeof (device->fingerprint));
+
+	// Retry failed transfers immediately.
+	dc_transaction_init (&device->transaction, (dc_device_t *) device, NULL, MAXRETRIES, 0, 0);
 }
 
 
+typedef struct suunto_common2_transfer_t {
+	const unsigned char *command;
+	unsigned int csize;
+	unsigned char *answer;
+	unsigned int asize;
+	unsigned int size;
+} suunto_common2_transfer_t;
+
+static dc_status_t
+suunto_common2_transfer_attempt (dc_transaction_t *transaction, unsigned int attempt, void *userdata)
+{
+	suunto_common2_transfer_t *transfer = (suunto_common2_transfer_t *) userdata;
+	dc_device_t *abstract = transaction->device;
+
+	return VTABLE (abstract)->packet (abstract, transfer->command, transfer->csize, transfer->answer, transfer->asize, transfer->size);
+}
+
 static dc_status_t
 suunto_common2_transfer (dc_device_t *abstract, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize, unsigned int size)
 {
+	suunto_common2_device_t *device = (suunto_common2_device_t *) abstract;
+
 	assert (asize >= size + 4);
 
 	if (VTABLE (abstract)->packet == NULL)
@@ -65,20 +87,9 @@ suunto_common2_transfer (dc_device_t *abstract, const unsigned char command[], u
 	// returning an error. Usually the dive computer will respond
 	// again during one of the retries.
 
-	unsigned int nretries = 0;
-	dc_status_t rc = DC_STATUS_SUCCESS;
-	while ((rc = VTABLE (abstract)->packet (abstract, command, csize, answer, asize, size)) != DC_STATUS_SUCCESS) {
-		// Automatically discard a corrupted packet,
-		// and request a new one.
-		if (rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL)
-			return rc;
-
-		// Abort if the maximum number of retries is reached.
-		if (nretries++ >= MAXRETRIES)
-			return rc;
-	}
+	suunto_common2_transfer_t transfer = {command, csize, answer, asize, size};
 
-	return rc;
+	return dc_transaction_run (&device->transaction, suunto_common2_transfer_attempt, &transfer);
 }
 
 
@@ -219,7 +230,7 @@ suunto_common2_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 	device_event_emit (abstract, DC_EVENT_VENDOR, &vendor);
 
 	return device_dump_read (abstract, 0, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), SZ_PACKET);
+		dc_buffer_get_size (buffer), SZ_PACKET / 8, SZ_PACKET);
 }
 
 
@@ -23,6 +23,7 @@
 #define SUUNTO_COMMON2_H
 
 #include "device-private.h"
+#include "transaction.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,6 +46,7 @@ typedef struct suunto_common2_device_t {
 	const suunto_common2_layout_t *layout;
 	unsigned char version[4];
 	unsigned char fingerprint[7];
+	dc_transaction_t transaction;
 } suunto_common2_device_t;
 
 typedef struct suunto_common2_device_vtable_t {
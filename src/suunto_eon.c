@@ -49,6 +49,7 @@ static const dc_device_vtable_t suunto_eon_device_vtable = {
 	NULL, /* write */
 	suunto_eon_device_dump, /* dump */
 	suunto_eon_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	NULL, /* timesync */
 	NULL /* close */
 };
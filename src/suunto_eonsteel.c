@@ -34,6 +34,28 @@
 #define EONSTEEL 0
 #define EONCORE  1
 
+// Maximum number of outstanding requests
+#define MAXPENDING   8
+#define PIPELINE_USB 1
+#define PIPELINE_BLE 6
+
+typedef struct suunto_eonsteel_request_t {
+	unsigned short cmd;
+	unsigned short seq;
+	unsigned int size;
+} suunto_eonsteel_request_t;
+
+struct directory_entry;
+
+typedef struct suunto_eonsteel_download_t {
+	unsigned int active;
+	struct directory_entry *de;
+	dc_buffer_t *file;
+	dc_event_progress_t progress;
+	dc_status_t status;
+	int skip;
+} suunto_eonsteel_download_t;
+
 typedef struct suunto_eonsteel_device_t {
 	dc_device_t base;
 	dc_iostream_t *iostream;
@@ -42,6 +64,15 @@ typedef struct suunto_eonsteel_device_t {
 	unsigned short seq;
 	unsigned char version[0x30];
 	unsigned char fingerprint[4];
+	// Outstanding requests, in the order they were sent.
+	suunto_eonsteel_request_t pending[MAXPENDING];
+	unsigned int head;
+	unsigned int npending;
+	unsigned int pipeline;
+	// File opened ahead of time by the previous read.
+	char prefetch[64];
+	// State of the resumable download.
+	suunto_eonsteel_download_t download;
 } suunto_eonsteel_device_t;
 
 // The EON Steel implements a small filesystem
@@ -81,11 +112,17 @@ struct directory_entry {
 #define MAXDATA_SIZE 2048
 #define CRC_SIZE    4
 
+#define READ_SIZE   1024
+#define READ_MAGIC  1234
+
 static dc_status_t suunto_eonsteel_device_set_fingerprint (dc_device_t *abstract, const unsigned char data[], unsigned int size);
 static dc_status_t suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
+static dc_status_t suunto_eonsteel_device_foreach_step(dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
 static dc_status_t suunto_eonsteel_device_timesync(dc_device_t *abstract, const dc_datetime_t *datetime);
 static dc_status_t suunto_eonsteel_device_close (dc_device_t *abstract);
 
+static void suunto_eonsteel_download_abort(suunto_eonsteel_device_t *eon);
+
 static const dc_device_vtable_t suunto_eonsteel_device_vtable = {
 	sizeof(suunto_eonsteel_device_t),
 	DC_FAMILY_SUUNTO_EONSTEEL,
@@ -94,6 +131,7 @@ static const dc_device_vtable_t suunto_eonsteel_device_vtable = {
 	NULL, /* write */
 	NULL, /* dump */
 	suunto_eonsteel_device_foreach, /* foreach */
+	suunto_eonsteel_device_foreach_step, /* foreach_step */
 	suunto_eonsteel_device_timesync, /* timesync */
 	suunto_eonsteel_device_close /* close */
 };
@@ -277,10 +315,46 @@ suunto_eonsteel_send(suunto_eonsteel_device_t *device,
 }
 
 /*
- * Send a command, receive a reply
+ * Send a command, without waiting for the reply.
+ *
+ * The request is added to the queue of outstanding requests, such
+ * that the reply can be matched against it later. The size is an
+ * arbitrary value, which is returned along with the reply.
+ */
+static dc_status_t
+suunto_eonsteel_submit(suunto_eonsteel_device_t *device,
+	unsigned short cmd,
+	const unsigned char data[], unsigned int size,
+	unsigned int value)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	if (device->npending >= MAXPENDING) {
+		ERROR(device->base.context, "Too many outstanding requests.");
+		return DC_STATUS_PROTOCOL;
+	}
+
+	rc = suunto_eonsteel_send(device, cmd, data, size);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	suunto_eonsteel_request_t *request = device->pending + (device->head + device->npending) % MAXPENDING;
+	request->cmd = cmd;
+	request->seq = device->seq;
+	request->size = value;
+	device->npending++;
+
+	// Increment the sequence number.
+	device->seq++;
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Receive the reply to the oldest outstanding request.
  *
  * This carefully checks the data fields in the reply for a match
- * against the command, and then only returns the actual reply
+ * against the request, and then only returns the actual reply
  * data itself.
  *
  * Also note that receive() function itself will have removed the
@@ -290,9 +364,8 @@ suunto_eonsteel_send(suunto_eonsteel_device_t *device,
  * send() side. The offsets are the same in the actual raw packet.
  */
 static dc_status_t
-suunto_eonsteel_transfer(suunto_eonsteel_device_t *device,
-	unsigned short cmd,
-	const unsigned char data[], unsigned int size,
+suunto_eonsteel_receive(suunto_eonsteel_device_t *device,
+	suunto_eonsteel_request_t *request,
 	unsigned char answer[], unsigned int asize,
 	unsigned int *actual)
 {
@@ -300,10 +373,18 @@ suunto_eonsteel_transfer(suunto_eonsteel_device_t *device,
 	unsigned char header[HEADER_SIZE + MAXDATA_SIZE];
 	unsigned int len = 0;
 
-	// Send the command.
-	rc = suunto_eonsteel_send(device, cmd, data, size);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	if (device->npending == 0) {
+		ERROR(device->base.context, "No outstanding request.");
+		return DC_STATUS_PROTOCOL;
+	}
+
+	// Remove the oldest request from the queue.
+	suunto_eonsteel_request_t *pending = device->pending + device->head;
+	unsigned short cmd = pending->cmd;
+	if (request)
+		*request = *pending;
+	device->head = (device->head + 1) % MAXPENDING;
+	device->npending--;
 
 	if (dc_iostream_get_transport(device->iostream) == DC_TRANSPORT_BLE) {
 		// Receive the entire data packet.
@@ -342,8 +423,8 @@ suunto_eonsteel_transfer(suunto_eonsteel_device_t *device,
 	}
 
 	// Verify the sequence number.
-	if (seq != device->seq) {
-		ERROR(device->base.context, "Unexpected sequence number (received %04x, expected %04x).", seq, device->seq);
+	if (seq != pending->seq) {
+		ERROR(device->base.context, "Unexpected sequence number (received %04x, expected %04x).", seq, pending->seq);
 		return DC_STATUS_PROTOCOL;
 	}
 
@@ -388,23 +469,61 @@ suunto_eonsteel_transfer(suunto_eonsteel_device_t *device,
 		device->magic = (magic & 0xffff0000) | 0x0005;
 	}
 
-	// Increment the sequence number.
-	device->seq++;
-
 	if (actual)
 		*actual = nbytes;
 
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * Discard all outstanding requests after an error.
+ *
+ * The replies of the remaining requests can't be matched reliably
+ * anymore, so any data still in transit is thrown away.
+ */
+static void
+suunto_eonsteel_reset(suunto_eonsteel_device_t *device)
+{
+	if (device->npending == 0 && device->prefetch[0] == 0)
+		return;
+
+	device->head = 0;
+	device->npending = 0;
+	device->prefetch[0] = 0;
+
+	dc_iostream_purge(device->iostream, DC_DIRECTION_INPUT);
+}
+
+/*
+ * Send a command, receive a reply
+ */
 static dc_status_t
-read_file(suunto_eonsteel_device_t *eon, const char *filename, dc_buffer_t *buf)
+suunto_eonsteel_transfer(suunto_eonsteel_device_t *device,
+	unsigned short cmd,
+	const unsigned char data[], unsigned int size,
+	unsigned char answer[], unsigned int asize,
+	unsigned int *actual)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	if (device->npending) {
+		ERROR(device->base.context, "Unexpected outstanding requests.");
+		return DC_STATUS_PROTOCOL;
+	}
+
+	rc = suunto_eonsteel_submit(device, cmd, data, size, 0);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	return suunto_eonsteel_receive(device, NULL, answer, asize, actual);
+}
+
+static dc_status_t
+submit_file_open(suunto_eonsteel_device_t *eon, const char *filename)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
-	unsigned char result[2560];
 	unsigned char cmdbuf[64];
-	unsigned int size, offset, len;
-	unsigned int n = 0;
+	unsigned int len;
 
 	memset(cmdbuf, 0, sizeof(cmdbuf));
 	len = strlen(filename) + 1;
@@ -413,77 +532,264 @@ read_file(suunto_eonsteel_device_t *eon, const char *filename, dc_buffer_t *buf)
 		return DC_STATUS_PROTOCOL;
 	}
 	memcpy(cmdbuf+4, filename, len);
-	rc = suunto_eonsteel_transfer(eon, CMD_FILE_OPEN,
-		cmdbuf, len + 4, result, sizeof(result), &n);
+
+	rc = suunto_eonsteel_submit(eon, CMD_FILE_OPEN, cmdbuf, len + 4, 0);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR(eon->base.context, "unable to look up %s", filename);
 		return rc;
 	}
-	HEXDUMP (eon->base.context, DC_LOGLEVEL_DEBUG, "lookup", result, n);
 
-	rc = suunto_eonsteel_transfer(eon, CMD_FILE_STAT,
-		NULL, 0, result, sizeof(result), &n);
+	// Without pipelining, wait for the reply first.
+	if (eon->npending >= eon->pipeline) {
+		unsigned char result[2560];
+		unsigned int n = 0;
+
+		rc = suunto_eonsteel_receive(eon, NULL, result, sizeof(result), &n);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR(eon->base.context, "unable to look up %s", filename);
+			return rc;
+		}
+		HEXDUMP (eon->base.context, DC_LOGLEVEL_DEBUG, "lookup", result, n);
+	}
+
+	rc = suunto_eonsteel_submit(eon, CMD_FILE_STAT, NULL, 0, 0);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR(eon->base.context, "unable to stat %s", filename);
 		return rc;
 	}
-	HEXDUMP (eon->base.context, DC_LOGLEVEL_DEBUG, "stat", result, n);
 
-	size = array_uint32_le(result+4);
-	offset = 0;
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Close the file that was opened ahead of time, but never read.
+ */
+static dc_status_t
+read_file_cancel(suunto_eonsteel_device_t *eon)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	unsigned char result[2560];
+	unsigned int n = 0;
 
-	while (size > 0) {
-		unsigned int ask, got, at;
+	if (eon->prefetch[0] == 0)
+		return DC_STATUS_SUCCESS;
 
-		ask = size;
-		if (ask > 1024)
-			ask = 1024;
-		array_uint32_le_set(cmdbuf + 0, 1234);	// Not file offset, after all
-		array_uint32_le_set(cmdbuf + 4, ask);	// Size of read
-		rc = suunto_eonsteel_transfer(eon, CMD_FILE_READ,
-			cmdbuf, 8, result, sizeof(result), &n);
+	while (eon->npending) {
+		rc = suunto_eonsteel_receive(eon, NULL, result, sizeof(result), &n);
 		if (rc != DC_STATUS_SUCCESS) {
-			ERROR(eon->base.context, "unable to read %s", filename);
+			suunto_eonsteel_reset(eon);
 			return rc;
 		}
-		if (n < 8) {
-			ERROR(eon->base.context, "got short read reply for %s", filename);
-			return DC_STATUS_PROTOCOL;
-		}
+	}
 
-		// Not file offset, just stays unmodified.
-		at = array_uint32_le(result);
-		if (at != 1234) {
-			ERROR(eon->base.context, "read of %s returned different offset than asked for (%d vs %d)", filename, at, offset);
-			return DC_STATUS_PROTOCOL;
+	eon->prefetch[0] = 0;
+
+	rc = suunto_eonsteel_transfer(eon, CMD_FILE_CLOSE,
+		NULL, 0, result, sizeof(result), &n);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR(eon->base.context, "cmd CMD_FILE_CLOSE failed");
+		return rc;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Receive the reply to a read request, and append the data to the
+ * buffer. Data beyond the end of the file is ignored.
+ */
+static dc_status_t
+read_file_reply(suunto_eonsteel_device_t *eon, const char *filename, dc_buffer_t *buf, unsigned int size, unsigned int *offset, unsigned int *requested, int *eof)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	suunto_eonsteel_request_t request;
+	unsigned char result[2560];
+	unsigned int got, at;
+	unsigned int n = 0;
+
+	if (eon->pending[eon->head].cmd != CMD_FILE_READ) {
+		ERROR(eon->base.context, "Unexpected command reply (%04x).", eon->pending[eon->head].cmd);
+		return DC_STATUS_PROTOCOL;
+	}
+
+	rc = suunto_eonsteel_receive(eon, &request, result, sizeof(result), &n);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR(eon->base.context, "unable to read %s", filename);
+		return rc;
+	}
+	*requested -= request.size;
+
+	if (n < 8) {
+		ERROR(eon->base.context, "got short read reply for %s", filename);
+		return DC_STATUS_PROTOCOL;
+	}
+
+	// Not file offset, just stays unmodified.
+	at = array_uint32_le(result);
+	if (at != READ_MAGIC) {
+		ERROR(eon->base.context, "read of %s returned different offset than asked for (%d vs %d)", filename, at, *offset);
+		return DC_STATUS_PROTOCOL;
+	}
+
+	// Number of bytes actually read
+	got = array_uint32_le(result+4);
+	if (!got) {
+		*eof = 1;
+		return DC_STATUS_SUCCESS;
+	}
+	if (n < 8 + got) {
+		ERROR(eon->base.context, "odd read size reply for offset %d of file %s", *offset, filename);
+		return DC_STATUS_PROTOCOL;
+	}
+
+	if (*eof)
+		return DC_STATUS_SUCCESS;
+	if (got > size - *offset)
+		got = size - *offset;
+	if (!dc_buffer_append (buf, result + 8, got)) {
+		ERROR (eon->base.context, "Insufficient buffer space available.");
+		return DC_STATUS_NOMEMORY;
+	}
+	*offset += got;
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Read a file.
+ *
+ * Up to eon->pipeline requests are kept outstanding at the same time.
+ * The device keeps track of the file position itself, and processes
+ * the requests in order, so the read replies arrive in file order,
+ * even when a reply is shorter than requested.
+ *
+ * Once all data has arrived, the close of the file is sent together
+ * with the open and stat of the next file (if any), and the first
+ * reads of that file. Reads beyond the end of a file simply return
+ * no data.
+ */
+static dc_status_t
+read_file(suunto_eonsteel_device_t *eon, const char *filename, const char *nextname, dc_buffer_t *buf)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	suunto_eonsteel_request_t request;
+	unsigned char result[2560];
+	unsigned char cmdbuf[8];
+	unsigned int size = 0, offset = 0, requested = 0;
+	unsigned int n = 0;
+	int eof = 0;
+
+	// Open the file, unless that was already done by the previous read.
+	if (strcmp(eon->prefetch, filename) != 0) {
+		rc = read_file_cancel(eon);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+
+		rc = submit_file_open(eon, filename);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+	}
+	eon->prefetch[0] = 0;
+
+	// Collect the replies of the previous close and the open and stat.
+	do {
+		rc = suunto_eonsteel_receive(eon, &request, result, sizeof(result), &n);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR(eon->base.context, "unable to open %s", filename);
+			return rc;
 		}
 
-		// Number of bytes actually read
-		got = array_uint32_le(result+4);
-		if (!got)
+		switch (request.cmd) {
+		case CMD_FILE_CLOSE:
+			HEXDUMP(eon->base.context, DC_LOGLEVEL_DEBUG, "close", result, n);
 			break;
-		if (n < 8 + got) {
-			ERROR(eon->base.context, "odd read size reply for offset %d of file %s", offset, filename);
+		case CMD_FILE_OPEN:
+			HEXDUMP(eon->base.context, DC_LOGLEVEL_DEBUG, "lookup", result, n);
+			break;
+		case CMD_FILE_STAT:
+			HEXDUMP(eon->base.context, DC_LOGLEVEL_DEBUG, "stat", result, n);
+			if (n < 8) {
+				ERROR(eon->base.context, "got short stat reply for %s", filename);
+				return DC_STATUS_PROTOCOL;
+			}
+			size = array_uint32_le(result+4);
+			break;
+		default:
+			ERROR(eon->base.context, "Unexpected command reply (%04x).", request.cmd);
 			return DC_STATUS_PROTOCOL;
 		}
+	} while (request.cmd != CMD_FILE_STAT);
 
-		if (got > size)
-			got = size;
-		if (!dc_buffer_append (buf, result + 8, got)) {
-			ERROR (eon->base.context, "Insufficient buffer space available.");
-			return DC_STATUS_NOMEMORY;
+	// The remaining requests are reads sent along with the open.
+	for (unsigned int i = 0; i < eon->npending; ++i) {
+		requested += eon->pending[(eon->head + i) % MAXPENDING].size;
+	}
+
+	for (;;) {
+		// Keep the pipeline filled with read requests.
+		while (!eof && offset + requested < size && eon->npending < eon->pipeline) {
+			unsigned int ask = size - offset - requested;
+			if (ask > READ_SIZE)
+				ask = READ_SIZE;
+			array_uint32_le_set(cmdbuf + 0, READ_MAGIC);	// Not file offset, after all
+			array_uint32_le_set(cmdbuf + 4, ask);	// Size of read
+			rc = suunto_eonsteel_submit(eon, CMD_FILE_READ, cmdbuf, 8, ask);
+			if (rc != DC_STATUS_SUCCESS) {
+				ERROR(eon->base.context, "unable to read %s", filename);
+				return rc;
+			}
+			requested += ask;
 		}
-		offset += got;
-		size -= got;
+
+		if ((eof || offset >= size) && eon->npending < eon->pipeline)
+			break;
+
+		rc = read_file_reply(eon, filename, buf, size, &offset, &requested, &eof);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
 	}
 
-	rc = suunto_eonsteel_transfer(eon, CMD_FILE_CLOSE,
-		NULL, 0, result, sizeof(result), &n);
+	rc = suunto_eonsteel_submit(eon, CMD_FILE_CLOSE, NULL, 0, 0);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR(eon->base.context, "cmd CMD_FILE_CLOSE failed");
 		return rc;
 	}
-	HEXDUMP(eon->base.context, DC_LOGLEVEL_DEBUG, "close", result, n);
+
+	// Open the next file, and start reading it.
+	if (nextname && strlen(nextname) < sizeof(eon->prefetch) &&
+		eon->npending + 2 <= eon->pipeline) {
+		rc = submit_file_open(eon, nextname);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+		strcpy(eon->prefetch, nextname);
+
+		while (eon->npending < eon->pipeline) {
+			array_uint32_le_set(cmdbuf + 0, READ_MAGIC);
+			array_uint32_le_set(cmdbuf + 4, READ_SIZE);
+			rc = suunto_eonsteel_submit(eon, CMD_FILE_READ, cmdbuf, 8, READ_SIZE);
+			if (rc != DC_STATUS_SUCCESS) {
+				ERROR(eon->base.context, "unable to read %s", nextname);
+				return rc;
+			}
+		}
+	}
+
+	// Collect the replies of any reads beyond the end of the file.
+	while (eon->pending[eon->head].cmd == CMD_FILE_READ) {
+		rc = read_file_reply(eon, filename, buf, size, &offset, &requested, &eof);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+	}
+
+	// Without a next file, wait for the close to complete.
+	if (eon->prefetch[0] == 0) {
+		rc = suunto_eonsteel_receive(eon, NULL, result, sizeof(result), &n);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR(eon->base.context, "cmd CMD_FILE_CLOSE failed");
+			return rc;
+		}
+		HEXDUMP(eon->base.context, DC_LOGLEVEL_DEBUG, "close", result, n);
+	}
 
 	return DC_STATUS_SUCCESS;
 }
@@ -555,19 +861,41 @@ get_file_list(suunto_eonsteel_device_t *eon, struct directory_entry **res)
 	array_uint32_le_set(cmd, 0);
 	memcpy(cmd + 4, dive_directory, sizeof(dive_directory));
 	cmdlen = 4 + sizeof(dive_directory);
-	rc = suunto_eonsteel_transfer(eon, CMD_DIR_OPEN,
-		cmd, cmdlen, result, sizeof(result), &n);
+	rc = suunto_eonsteel_submit(eon, CMD_DIR_OPEN,
+		cmd, cmdlen, 0);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR(eon->base.context, "cmd DIR_LOOKUP failed");
 		return rc;
 	}
+
+	// Send the first readdir along with the open.
+	if (eon->pipeline > 1) {
+		rc = suunto_eonsteel_submit(eon, CMD_DIR_READDIR,
+			NULL, 0, 0);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR(eon->base.context, "readdir failed");
+			suunto_eonsteel_reset(eon);
+			return rc;
+		}
+	}
+
+	rc = suunto_eonsteel_receive(eon, NULL, result, sizeof(result), &n);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR(eon->base.context, "cmd DIR_LOOKUP failed");
+		suunto_eonsteel_reset(eon);
+		return rc;
+	}
 	HEXDUMP(eon->base.context, DC_LOGLEVEL_DEBUG, "DIR_LOOKUP", result, n);
 
 	for (;;) {
 		unsigned int nr, last;
 
-		rc = suunto_eonsteel_transfer(eon, CMD_DIR_READDIR,
-			NULL, 0, result, sizeof(result), &n);
+		if (eon->npending) {
+			rc = suunto_eonsteel_receive(eon, NULL, result, sizeof(result), &n);
+		} else {
+			rc = suunto_eonsteel_transfer(eon, CMD_DIR_READDIR,
+				NULL, 0, result, sizeof(result), &n);
+		}
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR(eon->base.context, "readdir failed");
 			file_list_free(de);
@@ -631,8 +959,13 @@ suunto_eonsteel_device_open(dc_device_t **out, dc_context_t *context, dc_iostrea
 	eon->model = model;
 	eon->magic = INIT_MAGIC;
 	eon->seq = INIT_SEQ;
+	eon->head = 0;
+	eon->npending = 0;
+	eon->pipeline = (transport == DC_TRANSPORT_BLE) ? PIPELINE_BLE : PIPELINE_USB;
+	memset (eon->prefetch, 0, sizeof (eon->prefetch));
 	memset (eon->version, 0, sizeof (eon->version));
 	memset (eon->fingerprint, 0, sizeof (eon->fingerprint));
+	memset (&eon->download, 0, sizeof (eon->download));
 
 	if (transport == DC_TRANSPORT_BLE) {
 		status = dc_hdlc_open (&eon->iostream, context, iostream, 20, 20);
@@ -676,6 +1009,8 @@ suunto_eonsteel_device_close (dc_device_t *abstract)
 {
 	suunto_eonsteel_device_t *device = (suunto_eonsteel_device_t *) abstract;
 
+	suunto_eonsteel_download_abort(device);
+
 	if (dc_iostream_get_transport (device->iostream) == DC_TRANSPORT_BLE) {
 		return dc_iostream_close (device->iostream);
 	}
@@ -699,18 +1034,72 @@ suunto_eonsteel_device_set_fingerprint (dc_device_t *abstract, const unsigned ch
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * Find the pathname of the next dive that will be downloaded, such
+ * that it can be opened ahead of time.
+ */
+static const char *
+next_file(suunto_eonsteel_device_t *eon, struct directory_entry *de, char pathname[], unsigned int size)
+{
+	unsigned char buf[4];
+	unsigned int time;
+	int len;
+
+	if (eon->pipeline <= 1)
+		return NULL;
+
+	while (de && de->type != DIRTYPE_FILE)
+		de = de->next;
+	if (de == NULL)
+		return NULL;
+
+	if (sscanf(de->name, "%x.LOG", &time) != 1)
+		return NULL;
+
+	array_uint32_le_set(buf, time);
+	if (memcmp (buf, eon->fingerprint, sizeof (eon->fingerprint)) == 0)
+		return NULL;
+
+	len = dc_platform_snprintf(pathname, size, "%s/%s", dive_directory, de->name);
+	if (len < 0 || (unsigned int) len >= size)
+		return NULL;
+
+	return pathname;
+}
+
+static void
+suunto_eonsteel_download_reset(suunto_eonsteel_download_t *download)
+{
+	file_list_free(download->de);
+	dc_buffer_free(download->file);
+
+	download->active = 0;
+	download->de = NULL;
+	download->file = NULL;
+	download->status = DC_STATUS_SUCCESS;
+	download->skip = 0;
+}
+
+/*
+ * Discard an unfinished resumable download, including the file reads
+ * that are still in flight.
+ */
+static void
+suunto_eonsteel_download_abort(suunto_eonsteel_device_t *eon)
+{
+	if (!eon->download.active)
+		return;
+
+	read_file_cancel(eon);
+	suunto_eonsteel_download_reset(&eon->download);
+}
+
 static dc_status_t
-suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+suunto_eonsteel_download_start(suunto_eonsteel_device_t *eon)
 {
-	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_device_t *abstract = (dc_device_t *) eon;
+	suunto_eonsteel_download_t *download = &eon->download;
 	dc_status_t rc = DC_STATUS_SUCCESS;
-	int skip = 0;
-	struct directory_entry *de;
-	suunto_eonsteel_device_t *eon = (suunto_eonsteel_device_t *) abstract;
-	dc_buffer_t *file;
-	char pathname[64];
-	unsigned int time;
-	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
 
 	// Emit a device info event.
 	dc_event_devinfo_t devinfo;
@@ -719,35 +1108,54 @@ suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callbac
 	devinfo.serial = array_convert_str2num(eon->version + 0x10, 16);
 	device_event_emit (abstract, DC_EVENT_DEVINFO, &devinfo);
 
-	rc = get_file_list(eon, &de);
+	rc = get_file_list(eon, &download->de);
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 
-	if (de == NULL) {
+	if (download->de == NULL) {
 		return DC_STATUS_SUCCESS;
 	}
 
-	file = dc_buffer_new (16384);
-	if (file == NULL) {
+	download->file = dc_buffer_new (16384);
+	if (download->file == NULL) {
 		ERROR (abstract->context, "Insufficient buffer space available.");
-		file_list_free(de);
 		return DC_STATUS_NOMEMORY;
 	}
 
-	progress.maximum = count_file_list(de);
-	progress.current = 0;
-	device_event_emit(abstract, DC_EVENT_PROGRESS, &progress);
+	download->progress.maximum = count_file_list(download->de);
+	download->progress.current = 0;
+	device_event_emit(abstract, DC_EVENT_PROGRESS, &download->progress);
 
-	while (de) {
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Process the directory entries until a single dive has been passed to
+ * the callback, or the end of the list has been reached.
+ */
+static void
+suunto_eonsteel_download_dive(suunto_eonsteel_device_t *eon, dc_dive_callback_t callback, void *userdata)
+{
+	dc_device_t *abstract = (dc_device_t *) eon;
+	suunto_eonsteel_download_t *download = &eon->download;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_buffer_t *file = download->file;
+	char pathname[64];
+	unsigned int time;
+	int delivered = 0;
+
+	while (download->de && !delivered) {
 		int len;
+		struct directory_entry *de = download->de;
 		struct directory_entry *next = de->next;
 		unsigned char buf[4];
 		const unsigned char *data = NULL;
 		unsigned int size = 0;
+		char nextname[64];
 
 		if (device_is_cancelled(abstract)) {
-			dc_status_set_error(&status, DC_STATUS_CANCELLED);
-			skip = 1;
+			dc_status_set_error(&download->status, DC_STATUS_CANCELLED);
+			download->skip = 1;
 		}
 
 		switch (de->type) {
@@ -755,24 +1163,24 @@ suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callbac
 			/* Ignore subdirectories in the dive directory */
 			break;
 		case DIRTYPE_FILE:
-			if (skip)
+			if (download->skip)
 				break;
 
 			if (sscanf(de->name, "%x.LOG", &time) != 1) {
-				dc_status_set_error(&status, DC_STATUS_PROTOCOL);
+				dc_status_set_error(&download->status, DC_STATUS_PROTOCOL);
 				break;
 			}
 
 			array_uint32_le_set(buf, time);
 
 			if (memcmp (buf, eon->fingerprint, sizeof (eon->fingerprint)) == 0) {
-				skip = 1;
+				download->skip = 1;
 				break;
 			}
 
 			len = dc_platform_snprintf(pathname, sizeof(pathname), "%s/%s", dive_directory, de->name);
 			if (len < 0 || (unsigned int) len >= sizeof(pathname)) {
-				dc_status_set_error(&status, DC_STATUS_PROTOCOL);
+				dc_status_set_error(&download->status, DC_STATUS_PROTOCOL);
 				break;
 			}
 
@@ -781,9 +1189,11 @@ suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callbac
 			dc_buffer_append(file, buf, 4);
 
 			// Then read the filename into the rest of the buffer
-			rc = read_file(eon, pathname, file);
+			rc = read_file(eon, pathname,
+				next_file(eon, next, nextname, sizeof(nextname)), file);
 			if (rc != DC_STATUS_SUCCESS) {
-				dc_status_set_error(&status, rc);
+				suunto_eonsteel_reset(eon);
+				dc_status_set_error(&download->status, rc);
 				break;
 			}
 
@@ -791,19 +1201,70 @@ suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callbac
 			size = dc_buffer_get_size(file);
 
 			if (callback && !callback(data, size, data, sizeof(eon->fingerprint), userdata))
-				skip = 1;
+				download->skip = 1;
+
+			delivered = 1;
 		}
-		progress.current++;
-		device_event_emit(abstract, DC_EVENT_PROGRESS, &progress);
+		download->progress.current++;
+		device_event_emit(abstract, DC_EVENT_PROGRESS, &download->progress);
 
 		free(de);
-		de = next;
+		download->de = next;
+	}
+}
+
+/*
+ * Resumable download. The first step reads the dive directory, and every
+ * next step downloads a single dive. DC_STATUS_WOULDBLOCK is returned as
+ * long as there are more directory entries to process.
+ */
+static dc_status_t
+suunto_eonsteel_device_foreach_step(dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	suunto_eonsteel_device_t *eon = (suunto_eonsteel_device_t *) abstract;
+	suunto_eonsteel_download_t *download = &eon->download;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	if (!download->active) {
+		download->active = 1;
+		rc = suunto_eonsteel_download_start(eon);
+		if (rc != DC_STATUS_SUCCESS || download->de == NULL) {
+			suunto_eonsteel_download_reset(download);
+			return rc;
+		}
+	} else {
+		suunto_eonsteel_download_dive(eon, callback, userdata);
 	}
-	dc_buffer_free(file);
+
+	if (download->de)
+		return DC_STATUS_WOULDBLOCK;
+
+	status = download->status;
+	suunto_eonsteel_download_reset(download);
+
+	rc = read_file_cancel(eon);
+	if (rc != DC_STATUS_SUCCESS)
+		dc_status_set_error(&status, rc);
 
 	return status;
 }
 
+static dc_status_t
+suunto_eonsteel_device_foreach(dc_device_t *abstract, dc_dive_callback_t callback, void *userdata)
+{
+	suunto_eonsteel_device_t *eon = (suunto_eonsteel_device_t *) abstract;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	suunto_eonsteel_download_abort(eon);
+
+	do {
+		rc = suunto_eonsteel_device_foreach_step(abstract, callback, userdata);
+	} while (rc == DC_STATUS_WOULDBLOCK);
+
+	return rc;
+}
+
 static dc_status_t suunto_eonsteel_device_timesync(dc_device_t *abstract, const dc_datetime_t *datetime)
 {
 	suunto_eonsteel_device_t *eon = (suunto_eonsteel_device_t *) abstract;
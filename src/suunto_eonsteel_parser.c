@@ -61,14 +61,47 @@ enum eon_sample {
 
 #define EON_MAX_GROUP 16
 
+/*
+ * An interned type descriptor.
+ *
+ * Every dive file contains the full set of type descriptors, and they are
+ * nearly always the same. The parsed form of each unique descriptor text is
+ * therefore kept in a process wide table, and shared between all parser
+ * instances. Interned entries are immutable and never freed. To bound the
+ * memory usage, long descriptors are never interned, and once the table
+ * reaches its maximum size, new entries are owned by the parser instead.
+ */
+typedef struct eon_intern_t {
+	struct eon_intern_t *next;
+	unsigned int hash;
+	unsigned int length;
+	unsigned int shared;
+	const char *text;
+	const char *desc, *format, *mod;
+	unsigned int size;
+	enum eon_sample type;
+	unsigned int nenums;
+	const char **enums;
+} eon_intern_t;
+
 struct type_desc {
-	char *desc, *format, *mod;
+	const char *desc, *format, *mod;
+	eon_intern_t *intern;
 	unsigned int size;
 	enum eon_sample type[EON_MAX_GROUP];
 };
 
 #define MAXTYPE 512
 #define MAXGASES 16
+#define MAXENUM  100
+
+#define INTERN_BUCKETS 256
+#define INTERN_MAXENTRIES 4096
+#define INTERN_MAXLENGTH  256
+#define INTERN_MAXSIZE    (256 * 1024)
+
+#define FNV_OFFSET 0x811c9dc5
+#define FNV_PRIME  0x01000193
 
 typedef struct suunto_eonsteel_parser_t {
 	dc_parser_t base;
@@ -135,9 +168,45 @@ static const struct {
 	{ "Events.DiveTimer.Time",		ES_none },
 };
 
-static enum eon_sample lookup_descriptor_type(suunto_eonsteel_parser_t *eon, struct type_desc *desc)
+/*
+ * Perfect hash over the sample type strings above. The slot is the top six
+ * bits of the FNV-1a hash, with a seed chosen such that all names map to a
+ * unique slot. Each slot holds the index into the type_translation table,
+ * plus one (zero marks an empty slot). When adding new names, the seed and
+ * the slots need to be recalculated.
+ */
+#define TYPE_HASH_SEED 0x811c9e97
+#define TYPE_HASH_SLOT(h) ((h) >> 26)
+
+static const unsigned char type_hash[64] = {
+	[45] =  1, [61] =  2, [49] =  3, [ 6] =  4, [60] =  5, [35] =  6,
+	[23] =  7, [27] =  8, [51] =  9, [17] = 10, [58] = 11, [46] = 12,
+	[30] = 13, [54] = 14, [44] = 15, [52] = 16, [ 1] = 17, [36] = 18,
+	[14] = 19, [62] = 20, [24] = 21, [ 7] = 22, [13] = 23, [59] = 24,
+	[31] = 25, [10] = 26, [ 2] = 27,
+};
+
+static dc_mutex_t g_intern_mutex = DC_MUTEX_INIT;
+static eon_intern_t *g_intern_table[INTERN_BUCKETS];
+static unsigned int g_intern_count = 0;
+static size_t g_intern_size = 0;
+
+static unsigned int
+eon_hash (unsigned int seed, const char *data, size_t size)
 {
-	const char *name = desc->desc;
+	unsigned int hash = seed;
+
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= (unsigned char) data[i];
+		hash *= FNV_PRIME;
+	}
+
+	return hash & 0xFFFFFFFF;
+}
+
+static enum eon_sample lookup_descriptor_type(const char *name)
+{
+	unsigned int idx;
 
 	// Not a sample type? Skip it
 	if (strncmp(name, "sml.DeviceLog.Samples", 21))
@@ -159,10 +228,10 @@ static enum eon_sample lookup_descriptor_type(suunto_eonsteel_parser_t *eon, str
 	name += 8;
 
 	// .. and look it up in the table of sample type strings
-	for (size_t i = 0; i < C_ARRAY_SIZE(type_translation); i++) {
-		if (!strcmp(name, type_translation[i].name))
-			return type_translation[i].type;
-	}
+	idx = type_hash[TYPE_HASH_SLOT(eon_hash(TYPE_HASH_SEED, name, strlen(name)))];
+	if (idx && !strcmp(name, type_translation[idx - 1].name))
+		return type_translation[idx - 1].type;
+
 	return ES_none;
 }
 
@@ -185,9 +254,8 @@ static const char *desc_type_name(enum eon_sample type)
 	return "Unknown";
 }
 
-static int lookup_descriptor_size(suunto_eonsteel_parser_t *eon, struct type_desc *desc)
+static int lookup_descriptor_size(const char *format)
 {
-	const char *format = desc->format;
 	unsigned char c;
 
 	if (!format)
@@ -279,84 +347,293 @@ static int fill_in_desc_details(suunto_eonsteel_parser_t *eon, struct type_desc
 	if (isdigit(desc->desc[0]))
 		return fill_in_group_details(eon, desc);
 
-	desc->size = lookup_descriptor_size(eon, desc);
-	desc->type[0] = lookup_descriptor_type(eon, desc);
+	desc->size = desc->intern->size;
+	desc->type[0] = desc->intern->type;
 	return 0;
 }
 
+static void
+intern_free (eon_intern_t *intern)
+{
+	if (intern == NULL)
+		return;
+
+	free(intern->enums);
+	free(intern);
+}
+
+static size_t
+intern_size (const eon_intern_t *intern)
+{
+	size_t size = sizeof(eon_intern_t) + 2 * (intern->length + 1);
+
+	if (intern->enums) {
+		for (unsigned int i = 0; i < intern->nenums; ++i) {
+			size += sizeof(char *);
+			if (intern->enums[i])
+				size += strlen(intern->enums[i]) + 1;
+		}
+	}
+
+	return size;
+}
+
 static void
 desc_free (struct type_desc desc[], unsigned int count)
 {
 	for (unsigned int i = 0; i < count; ++i) {
-		free(desc[i].desc);
-		free(desc[i].format);
-		free(desc[i].mod);
+		if (desc[i].intern && !desc[i].intern->shared)
+			intern_free(desc[i].intern);
 	}
 }
 
-static int record_type(suunto_eonsteel_parser_t *eon, unsigned short type, const char *name, int namelen)
+/*
+ * Build the enumeration table of an interned descriptor.
+ *
+ * Enumerations have the enum values in the "format" string,
+ * and all start with "enum:" followed by a comma-separated list
+ * of enumeration values and strings. Example:
+ *
+ * "enum:0=NoFly Time,1=Depth,2=Surface Time,3=..."
+ *
+ * The strings are copied once, and indexed by their value, such
+ * that a lookup doesn't require any parsing or allocations.
+ */
+static int intern_enums(eon_intern_t *intern)
 {
-	struct type_desc desc;
-	const char *next;
+	const char *str = intern->format;
+	const char *strings[MAXENUM] = {0};
+	unsigned int lengths[MAXENUM] = {0};
+	unsigned int nenums = 0, total = 0;
+	unsigned char c;
+	char *p;
+
+	if (!str)
+		return 0;
+	if (strncmp(str, "enum:", 5))
+		return 0;
+	str += 5;
+
+	while ((c = *str) != 0) {
+		unsigned char n;
+		const char *begin, *end;
+
+		str++;
+		if (!isdigit(c))
+			continue;
+		n = c - '0';
+
+		// We only handle one or two digits
+		if (isdigit(*str)) {
+			n = n*10 + *str - '0';
+			str++;
+		}
+
+		begin = end = str;
+		while ((c = *str) != 0) {
+			str++;
+			if (c == ',')
+				break;
+			end = str;
+		}
+
+		// Verify that it has the 'n=string' format and skip the equals sign
+		if (*begin != '=')
+			continue;
+		begin++;
+
+		// The first match for a value wins
+		if (strings[n])
+			continue;
+
+		strings[n] = begin;
+		lengths[n] = end - begin;
+		total += lengths[n] + 1;
+		if (nenums < n + 1U)
+			nenums = n + 1;
+	}
+
+	if (nenums == 0)
+		return 0;
+
+	intern->enums = (const char **) malloc(nenums * sizeof(char *) + total);
+	if (intern->enums == NULL)
+		return -1;
+
+	p = (char *) (intern->enums + nenums);
+	for (unsigned int i = 0; i < nenums; ++i) {
+		if (strings[i] == NULL) {
+			intern->enums[i] = NULL;
+			continue;
+		}
+
+		memcpy(p, strings[i], lengths[i]);
+		p[lengths[i]] = 0;
+		intern->enums[i] = p;
+		p += lengths[i] + 1;
+	}
+	intern->nenums = nenums;
+
+	return 0;
+}
+
+/*
+ * Parse the raw descriptor text into a new (not yet shared) entry.
+ *
+ * The text consists of newline separated "<PTH>", "<GRP>", "<FRM>" and
+ * "<MOD>" lines. A single copy of the text is made, and the individual
+ * fields point into that copy.
+ */
+static eon_intern_t *intern_create(suunto_eonsteel_parser_t *eon, unsigned int hash, const char *text, unsigned int length)
+{
+	eon_intern_t *intern = NULL;
+	char *buffer = NULL, *name = NULL, *next = NULL;
+
+	intern = (eon_intern_t *) malloc(sizeof(eon_intern_t) + 2 * (length + 1));
+	if (intern == NULL) {
+		ERROR(eon->base.context, "out of memory");
+		return NULL;
+	}
+
+	memset(intern, 0, sizeof(eon_intern_t));
+	intern->hash = hash;
+	intern->length = length;
+
+	buffer = (char *) (intern + 1);
+	memcpy(buffer, text, length);
+	buffer[length] = 0;
+	intern->text = buffer;
+
+	name = buffer + length + 1;
+	memcpy(name, text, length);
+	name[length] = 0;
 
-	memset(&desc, 0, sizeof(desc));
 	do {
 		int len;
-		char *p;
 
 		next = strchr(name, '\n');
 		if (next) {
-			len = next - name;
-			next++;
-		} else {
-			len = strlen(name);
-			if (!len)
-				break;
+			*next++ = 0;
 		}
 
+		len = strlen(name);
+		if (!next && !len)
+			break;
+
 		if (len < 5 || name[0] != '<' || name[4] != '>') {
 			ERROR(eon->base.context, "Unexpected type description: %.*s", len, name);
-			return -1;
+			goto error;
 		}
-		p = (char *) malloc(len-4);
-		if (!p) {
-			ERROR(eon->base.context, "out of memory");
-			desc_free(&desc, 1);
-			return -1;
-		}
-		memcpy(p, name+5, len-5);
-		p[len-5] = 0;
 
 		// PTH, GRP, FRM, MOD
 		switch (name[1]) {
 		case 'P':
 		case 'G':
-			desc.desc = p;
+			intern->desc = name + 5;
 			break;
 		case 'F':
-			desc.format = p;
+			intern->format = name + 5;
 			break;
 		case 'M':
-			desc.mod = p;
+			intern->mod = name + 5;
 			break;
 		default:
 			ERROR(eon->base.context, "Unknown type descriptor: %.*s", len, name);
-			desc_free(&desc, 1);
-			free(p);
-			return -1;
+			goto error;
 		}
 	} while ((name = next) != NULL);
 
+	// Group descriptors refer to the other descriptors of the
+	// same dive by index, and are resolved per parser instance.
+	if (intern->desc && !isdigit(intern->desc[0])) {
+		intern->size = lookup_descriptor_size(intern->format);
+		intern->type = lookup_descriptor_type(intern->desc);
+	}
+
+	if (intern_enums(intern) != 0) {
+		ERROR(eon->base.context, "out of memory");
+		goto error;
+	}
+
+	return intern;
+
+error:
+	intern_free(intern);
+	return NULL;
+}
+
+/*
+ * Look up the descriptor text in the intern table, and add it
+ * when it isn't present yet. Long descriptors, and new entries
+ * once the table is full, are owned by the parser instead.
+ */
+static eon_intern_t *intern_lookup(suunto_eonsteel_parser_t *eon, const char *text, unsigned int length)
+{
+	unsigned int hash = eon_hash(FNV_OFFSET, text, length);
+	eon_intern_t **bucket = g_intern_table + (hash % INTERN_BUCKETS);
+	eon_intern_t *intern = NULL;
+
+	dc_mutex_lock(&g_intern_mutex);
+
+	for (intern = *bucket; intern; intern = intern->next) {
+		if (intern->hash == hash && intern->length == length &&
+			memcmp(intern->text, text, length) == 0)
+			break;
+	}
+
+	if (intern == NULL) {
+		intern = intern_create(eon, hash, text, length);
+		if (intern && length <= INTERN_MAXLENGTH &&
+			g_intern_count < INTERN_MAXENTRIES &&
+			g_intern_size + intern_size(intern) <= INTERN_MAXSIZE) {
+			intern->shared = 1;
+			intern->next = *bucket;
+			*bucket = intern;
+			g_intern_count++;
+			g_intern_size += intern_size(intern);
+		}
+	}
+
+	dc_mutex_unlock(&g_intern_mutex);
+
+	return intern;
+}
+
+static int record_type(suunto_eonsteel_parser_t *eon, unsigned short type, const char *name, int namelen)
+{
+	struct type_desc desc;
+	eon_intern_t *intern;
+	const char *end;
+
+	if (namelen < 0)
+		return -1;
+
+	// The descriptor text is NUL terminated
+	end = (const char *) memchr(name, 0, namelen);
+	if (end)
+		namelen = end - name;
+
+	intern = intern_lookup(eon, name, namelen);
+	if (intern == NULL)
+		return -1;
+
 	if (type >= MAXTYPE) {
 		ERROR(eon->base.context, "Type out of range (%04x: '%s' '%s' '%s')",
 			type,
-			desc.desc ? desc.desc : "",
-			desc.format ? desc.format : "",
-			desc.mod ? desc.mod : "");
-		desc_free(&desc, 1);
+			intern->desc ? intern->desc : "",
+			intern->format ? intern->format : "",
+			intern->mod ? intern->mod : "");
+		if (!intern->shared)
+			intern_free(intern);
 		return -1;
 	}
 
+	memset(&desc, 0, sizeof(desc));
+	desc.desc = intern->desc;
+	desc.format = intern->format;
+	desc.mod = intern->mod;
+	desc.intern = intern;
+
 	fill_in_desc_details(eon, &desc);
 
 	desc_free(eon->type_desc + type, 1);
@@ -461,8 +738,8 @@ struct sample_data {
 	dc_sample_callback_t callback;
 	void *userdata;
 	unsigned int time;
-	char *state_type, *notify_type;
-	char *warning_type, *alarm_type;
+	const char *state_type, *notify_type;
+	const char *warning_type, *alarm_type;
 
 	/* We gather up deco and cylinder pressure information */
 	int gasnr;
@@ -606,65 +883,17 @@ static void sample_gas_switch_event(struct sample_data *info, unsigned short idx
 /*
  * Look up the string from an enumeration.
  *
- * Enumerations have the enum values in the "format" string,
- * and all start with "enum:" followed by a comma-separated list
- * of enumeration values and strings. Example:
- *
- * "enum:0=NoFly Time,1=Depth,2=Surface Time,3=..."
+ * The returned string is owned by the interned descriptor,
+ * and must not be freed.
  */
-static char *lookup_enum(const struct type_desc *desc, unsigned char value)
+static const char *lookup_enum(const struct type_desc *desc, unsigned char value)
 {
-	const char *str = desc->format;
-	unsigned char c;
+	const eon_intern_t *intern = desc->intern;
 
-	if (!str)
+	if (!intern || value >= intern->nenums)
 		return NULL;
-	if (strncmp(str, "enum:", 5))
-		return NULL;
-	str += 5;
 
-	while ((c = *str) != 0) {
-		unsigned char n;
-		const char *begin, *end;
-		char *ret;
-
-		str++;
-		if (!isdigit(c))
-			continue;
-		n = c - '0';
-
-		// We only handle one or two digits
-		if (isdigit(*str)) {
-			n = n*10 + *str - '0';
-			str++;
-		}
-
-		begin = end = str;
-		while ((c = *str) != 0) {
-			str++;
-			if (c == ',')
-				break;
-			end = str;
-		}
-
-		// Verify that it has the 'n=string' format and skip the equals sign
-		if (*begin != '=')
-			continue;
-		begin++;
-
-		// Is it the value we're looking for?
-		if (n != value)
-			continue;
-
-		ret = (char *)malloc(end - begin + 1);
-		if (!ret)
-			break;
-
-		memcpy(ret, begin, end-begin);
-		ret[end-begin] = 0;
-		return ret;
-	}
-	return NULL;
+	return intern->enums[value];
 }
 
 /*
@@ -673,7 +902,6 @@ static char *lookup_enum(const struct type_desc *desc, unsigned char value)
  */
 static void sample_event_state_type(const struct type_desc *desc, struct sample_data *info, unsigned char type)
 {
-	free(info->state_type);
 	info->state_type = lookup_enum(desc, type);
 }
 
@@ -705,7 +933,6 @@ static void sample_event_state_value(const struct type_desc *desc, struct sample
 
 static void sample_event_notify_type(const struct type_desc *desc, struct sample_data *info, unsigned char type)
 {
-	free(info->notify_type);
 	info->notify_type = lookup_enum(desc, type);
 }
 
@@ -748,7 +975,6 @@ static void sample_event_notify_value(const struct type_desc *desc, struct sampl
 
 static void sample_event_warning_type(const struct type_desc *desc, struct sample_data *info, unsigned char type)
 {
-	free(info->warning_type);
 	info->warning_type = lookup_enum(desc, type);
 }
 
@@ -787,7 +1013,6 @@ static void sample_event_warning_value(const struct type_desc *desc, struct samp
 
 static void sample_event_alarm_type(const struct type_desc *desc, struct sample_data *info, unsigned char type)
 {
-	free(info->alarm_type);
 	info->alarm_type = lookup_enum(desc, type);
 }
 
@@ -822,7 +1047,7 @@ static void sample_event_alarm_value(const struct type_desc *desc, struct sample
 static void sample_setpoint_type(const struct type_desc *desc, struct sample_data *info, unsigned char value)
 {
 	dc_sample_value_t sample = {0};
-	char *type = lookup_enum(desc, value);
+	const char *type = lookup_enum(desc, value);
 
 	if (!type) {
 		DEBUG(info->eon->base.context, "sample_setpoint_type(%u) did not match anything in %s", value, desc->format);
@@ -837,12 +1062,10 @@ static void sample_setpoint_type(const struct type_desc *desc, struct sample_dat
 		sample.setpoint = info->eon->cache.customsetpoint;
 	else {
 		DEBUG(info->eon->base.context, "sample_setpoint_type(%u) unknown type '%s'", value, type);
-		free(type);
 		return;
 	}
 
 	if (info->callback) info->callback(DC_SAMPLE_SETPOINT, &sample, info->userdata);
-	free(type);
 }
 
 // uint32
@@ -1017,11 +1240,6 @@ suunto_eonsteel_parser_samples_foreach(dc_parser_t *abstract, dc_sample_callback
 
 	traverse_data(eon, traverse_samples, &data);
 
-	free(data.state_type);
-	free(data.notify_type);
-	free(data.warning_type);
-	free(data.alarm_type);
-
 	return DC_STATUS_SUCCESS;
 }
 
@@ -1162,7 +1380,7 @@ static int add_gas_type(suunto_eonsteel_parser_t *eon, const struct type_desc *d
 	int idx = eon->cache.ngases;
 	dc_tankvolume_t tankinfo = DC_TANKVOLUME_METRIC;
 	dc_usage_t usage = DC_USAGE_NONE;
-	char *name;
+	const char *name;
 
 	if (idx >= MAXGASES)
 		return 0;
@@ -1186,7 +1404,6 @@ static int add_gas_type(suunto_eonsteel_parser_t *eon, const struct type_desc *d
 
 	eon->cache.initialized |= 1 << DC_FIELD_GASMIX_COUNT;
 	eon->cache.initialized |= 1 << DC_FIELD_TANK_COUNT;
-	free(name);
 	return 0;
 }
 
@@ -1527,6 +1744,7 @@ static const dc_parser_vtable_t suunto_eonsteel_parser_vtable = {
 	suunto_eonsteel_parser_get_datetime, /* datetime */
 	suunto_eonsteel_parser_get_field, /* fields */
 	suunto_eonsteel_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_foreach_fixed */
 	suunto_eonsteel_parser_destroy /* destroy */
 };
 
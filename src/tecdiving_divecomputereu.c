@@ -73,6 +73,7 @@ static const dc_device_vtable_t tecdiving_divecomputereu_device_vtable = {
 	NULL, /* write */
 	NULL, /* dump */
 	tecdiving_divecomputereu_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	NULL, /* timesync */
 	tecdiving_divecomputereu_device_close, /* close */
 };
@@ -49,6 +49,7 @@ static const dc_parser_vtable_t tecdiving_divecomputereu_parser_vtable = {
 	tecdiving_divecomputereu_parser_get_datetime, /* datetime */
 	tecdiving_divecomputereu_parser_get_field, /* fields */
 	tecdiving_divecomputereu_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_foreach_fixed */
 	NULL /* destroy */
 };
 
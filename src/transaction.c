@@ -0,0 +1,280 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+
+#include "transaction.h"
+#include "context-private.h"
+#include "device-private.h"
+#include "iostream-private.h"
+
+// Number of round trip time samples before the timeout is adapted.
+#define NSAMPLES 8
+
+void
+dc_transaction_init (dc_transaction_t *transaction, dc_device_t *device, dc_iostream_t *iostream, unsigned int maxretries, unsigned int delay, unsigned int purge)
+{
+	transaction->device = device;
+	transaction->iostream = iostream;
+	transaction->maxretries = maxretries;
+	transaction->delay = delay;
+	transaction->maxdelay = delay * 4;
+	transaction->purge = purge;
+	transaction->abort = 0;
+	transaction->seed = 0x9E3779B9;
+	if (iostream) {
+		transaction->seed ^= (unsigned int) dc_iostream_now (iostream);
+	}
+	transaction->timeout = 0;
+	transaction->mintimeout = 0;
+	transaction->current = 0;
+	transaction->nsamples = 0;
+	transaction->srtt = 0;
+	transaction->rttvar = 0;
+	transaction->ssize = 0;
+	transaction->ntransactions = 0;
+	transaction->nretries = 0;
+	transaction->nfailures = 0;
+}
+
+void
+dc_transaction_set_maxdelay (dc_transaction_t *transaction, unsigned int maxdelay)
+{
+	transaction->maxdelay = maxdelay < transaction->delay ? transaction->delay : maxdelay;
+}
+
+void
+dc_transaction_set_adaptive (dc_transaction_t *transaction, int timeout, int mintimeout)
+{
+	if (transaction->iostream == NULL ||
+		timeout <= 0 || mintimeout <= 0 || mintimeout > timeout) {
+		transaction->timeout = 0;
+		transaction->mintimeout = 0;
+	} else {
+		transaction->timeout = timeout;
+		transaction->mintimeout = mintimeout;
+	}
+
+	transaction->current = transaction->timeout;
+	transaction->nsamples = 0;
+	transaction->srtt = 0;
+	transaction->rttvar = 0;
+	transaction->ssize = 0;
+}
+
+void
+dc_transaction_abort (dc_transaction_t *transaction)
+{
+	transaction->abort = 1;
+}
+
+static unsigned int
+dc_transaction_random (dc_transaction_t *transaction)
+{
+	// Xorshift pseudo random number generator.
+	unsigned int x = transaction->seed ? transaction->seed : 1;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	transaction->seed = x;
+
+	return x;
+}
+
+static void
+dc_transaction_sample (dc_transaction_t *transaction, long long rtt, size_t size)
+{
+	// Jacobson/Karels estimator, with gains of 1/8 and 1/4.
+	if (transaction->nsamples == 0) {
+		transaction->srtt = rtt;
+		transaction->rttvar = rtt / 2;
+	} else {
+		long long delta = rtt - transaction->srtt;
+		transaction->srtt += delta / 8;
+		transaction->rttvar += ((delta < 0 ? -delta : delta) - transaction->rttvar) / 4;
+	}
+
+	// The expected size is averaged with the same gain as the round trip
+	// time, but only for the transactions with an expected size.
+	if (size) {
+		if (transaction->ssize == 0)
+			transaction->ssize = size;
+		else
+			transaction->ssize += ((long long) size - transaction->ssize) / 8;
+	}
+
+	if (transaction->nsamples < NSAMPLES)
+		transaction->nsamples++;
+}
+
+static int
+dc_transaction_timeout (dc_transaction_t *transaction, unsigned int attempt, size_t size)
+{
+	// Use the base timeout until enough samples are available, and always
+	// for the final attempt.
+	if (transaction->mintimeout == 0 ||
+		transaction->nsamples < NSAMPLES ||
+		attempt >= transaction->maxretries)
+		return transaction->timeout;
+
+	// Retransmission timeout, rounded up to milliseconds, and doubled for
+	// every failed attempt.
+	long long rto = (transaction->srtt + 4 * transaction->rttvar + 999) / 1000;
+
+	// Scale the timeout for a transaction which is larger than average.
+	// The fixed latency is scaled as well, which errs on the safe side.
+	if (transaction->ssize > 0 && (long long) size > transaction->ssize) {
+		rto = rto * (long long) size / transaction->ssize;
+	}
+
+	for (unsigned int i = 0; i < attempt && rto < transaction->timeout; ++i) {
+		rto *= 2;
+	}
+
+	if (rto < transaction->mintimeout)
+		rto = transaction->mintimeout;
+	if (rto > transaction->timeout)
+		rto = transaction->timeout;
+
+	return (int) rto;
+}
+
+static unsigned int
+dc_transaction_backoff (dc_transaction_t *transaction, unsigned int attempt)
+{
+	if (transaction->delay == 0)
+		return 0;
+
+	unsigned int delay = transaction->delay;
+	for (unsigned int i = 0; i < attempt && delay < transaction->maxdelay; ++i) {
+		delay *= 2;
+	}
+
+	if (delay > transaction->maxdelay)
+		delay = transaction->maxdelay;
+
+	// Add a random jitter of up to 25%.
+	return delay + dc_transaction_random (transaction) % (delay / 4 + 1);
+}
+
+static void
+dc_transaction_set_timeout (dc_transaction_t *transaction, int timeout)
+{
+	// Changing the timeout can be expensive (e.g. a callback into the
+	// application for a custom I/O stream), and the estimate changes
+	// slightly with every sample. A longer timeout is always applied, but
+	// a shorter one only if it's at least 25% shorter. A slightly longer
+	// timeout than necessary is harmless.
+	if (timeout <= transaction->current &&
+		timeout >= transaction->current - transaction->current / 4)
+		return;
+
+	if (dc_iostream_set_timeout (transaction->iostream, timeout) == DC_STATUS_SUCCESS)
+		transaction->current = timeout;
+}
+
+dc_status_t
+dc_transaction_run (dc_transaction_t *transaction, dc_transaction_func_t func, void *userdata)
+{
+	return dc_transaction_run_sized (transaction, 0, func, userdata);
+}
+
+dc_status_t
+dc_transaction_run_sized (dc_transaction_t *transaction, size_t size, dc_transaction_func_t func, void *userdata)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_device_t *device = transaction->device;
+
+	transaction->abort = 0;
+	transaction->ntransactions++;
+
+	unsigned int attempt = 0;
+	while (1) {
+		if (transaction->mintimeout) {
+			dc_transaction_set_timeout (transaction, dc_transaction_timeout (transaction, attempt, size));
+		}
+
+		if (transaction->mintimeout == 0) {
+			status = func (transaction, attempt, userdata);
+		} else {
+			dc_usecs_t begin = dc_iostream_now (transaction->iostream);
+			status = func (transaction, attempt, userdata);
+			dc_usecs_t end = dc_iostream_now (transaction->iostream);
+
+			// Only the first attempt is sampled, because the answer to a
+			// retried command can't be matched to a specific attempt.
+			if (status == DC_STATUS_SUCCESS && attempt == 0 && end != 0) {
+				dc_transaction_sample (transaction, (long long) (end - begin), size);
+			}
+		}
+
+		if (status == DC_STATUS_SUCCESS)
+			break;
+
+		// Automatically discard a corrupted packet,
+		// and request a new one.
+		if (status != DC_STATUS_TIMEOUT && status != DC_STATUS_PROTOCOL)
+			break;
+
+		// Abort if the callback reported a fatal error.
+		if (transaction->abort)
+			break;
+
+		// Abort if the maximum number of retries is reached.
+		if (attempt >= transaction->maxretries)
+			break;
+
+		// Abort if the download is cancelled.
+		if (device && device_is_cancelled (device)) {
+			status = DC_STATUS_CANCELLED;
+			break;
+		}
+
+		unsigned int delay = dc_transaction_backoff (transaction, attempt);
+		if (device) {
+			INFO (device->context, "Retrying transaction (attempt=%u, status=%i, delay=%u, timeout=%i).",
+				attempt + 1, status, delay, transaction->current);
+		}
+
+		// Delay the next attempt.
+		if (delay && transaction->iostream) {
+			dc_iostream_sleep (transaction->iostream, delay);
+		}
+
+		// Discard any garbage bytes.
+		if (transaction->purge && transaction->iostream) {
+			dc_iostream_purge (transaction->iostream, (dc_direction_t) transaction->purge);
+		}
+
+		transaction->nretries++;
+		attempt++;
+	}
+
+	if (status != DC_STATUS_SUCCESS) {
+		transaction->nfailures++;
+		if (device && attempt) {
+			WARNING (device->context, "Transaction failed after %u attempts (transactions=%u, retries=%u, failures=%u).",
+				attempt + 1, transaction->ntransactions, transaction->nretries, transaction->nfailures);
+		}
+	}
+
+	return status;
+}
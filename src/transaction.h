@@ -0,0 +1,180 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2026 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_TRANSACTION_H
+#define DC_TRANSACTION_H
+
+#include <libdivecomputer/common.h>
+#include <libdivecomputer/device.h>
+#include <libdivecomputer/iostream.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct dc_transaction_t dc_transaction_t;
+
+/**
+ * Transaction callback.
+ *
+ * The callback performs a single attempt of the transaction, typically
+ * sending a command and receiving the answer. On a retry, the callback is
+ * responsible for resuming any partial state (e.g. restoring the progress
+ * events or the output buffer), which it can keep in the user data.
+ *
+ * @param[in]  transaction  A valid transaction object.
+ * @param[in]  attempt      The attempt number, starting from zero.
+ * @param[in]  userdata     The user data.
+ * @returns #DC_STATUS_SUCCESS on success, #DC_STATUS_TIMEOUT or
+ * #DC_STATUS_PROTOCOL to retry, or another #dc_status_t code on failure.
+ */
+typedef dc_status_t (*dc_transaction_func_t) (dc_transaction_t *transaction, unsigned int attempt, void *userdata);
+
+/**
+ * Transaction engine.
+ *
+ * Failed attempts are retried with an exponential backoff and a random
+ * jitter, to avoid retrying in lockstep with a device that is still busy.
+ * Optionally, the I/O timeout is adapted to the measured round trip time.
+ */
+struct dc_transaction_t {
+	dc_device_t *device;
+	dc_iostream_t *iostream;
+	/* Retry policy. */
+	unsigned int maxretries;
+	unsigned int delay;
+	unsigned int maxdelay;
+	unsigned int purge;
+	unsigned int abort;
+	unsigned int seed;
+	/* Adaptive timeout. */
+	int timeout;
+	int mintimeout;
+	int current;
+	unsigned int nsamples;
+	long long srtt;
+	long long rttvar;
+	long long ssize;
+	/* Statistics. */
+	unsigned int ntransactions;
+	unsigned int nretries;
+	unsigned int nfailures;
+};
+
+/**
+ * Initialize the transaction engine.
+ *
+ * The delay before the first retry is doubled on every subsequent retry,
+ * up to four times the initial delay, and a random jitter of up to 25% is
+ * added. A zero delay retries immediately.
+ *
+ * @param[out] transaction  The transaction object to initialize.
+ * @param[in]  device       A valid device object.
+ * @param[in]  iostream     An (optional) I/O stream, used for the delay,
+ *                          the purge and the adaptive timeout.
+ * @param[in]  maxretries   The maximum number of retries.
+ * @param[in]  delay        The initial retry delay (in milliseconds).
+ * @param[in]  purge        The direction(s) to purge before a retry, or
+ *                          zero to leave the buffers untouched.
+ */
+void
+dc_transaction_init (dc_transaction_t *transaction, dc_device_t *device, dc_iostream_t *iostream, unsigned int maxretries, unsigned int delay, unsigned int purge);
+
+/**
+ * Set the maximum retry delay.
+ *
+ * By default, the retry delay is capped at four times the initial delay.
+ * A maximum equal to the initial delay disables the exponential backoff,
+ * but keeps the random jitter.
+ *
+ * @param[in]  transaction  A valid transaction object.
+ * @param[in]  maxdelay     The maximum retry delay (in milliseconds).
+ */
+void
+dc_transaction_set_maxdelay (dc_transaction_t *transaction, unsigned int maxdelay);
+
+/**
+ * Enable the adaptive timeout.
+ *
+ * Once enough round trip times are measured, the I/O timeout is derived
+ * from the smoothed round trip time and its variance, and doubled after
+ * every failed attempt. The timeout is never shorter than the minimum,
+ * never longer than the base timeout, and the final attempt always uses
+ * the base timeout. For transactions with an expected size, the timeout
+ * is scaled by the ratio of that size to the average size of the measured
+ * transactions, so a large answer is not cut off by an estimate based on
+ * small ones. The timeout remains in effect between transactions, and the
+ * I/O stream is only reconfigured when it changes significantly.
+ * Therefore, the timeout of the I/O stream should not be changed directly
+ * while the adaptive timeout is enabled.
+ *
+ * @param[in]  transaction  A valid transaction object.
+ * @param[in]  timeout      The base timeout (in milliseconds).
+ * @param[in]  mintimeout   The minimum timeout (in milliseconds).
+ */
+void
+dc_transaction_set_adaptive (dc_transaction_t *transaction, int timeout, int mintimeout);
+
+/**
+ * Abort the transaction after the current attempt.
+ *
+ * This is intended for a callback that detects a fatal error, which
+ * should not be retried even though the status code would allow it.
+ *
+ * @param[in]  transaction  A valid transaction object.
+ */
+void
+dc_transaction_abort (dc_transaction_t *transaction);
+
+/**
+ * Run a transaction.
+ *
+ * @param[in]  transaction  A valid transaction object.
+ * @param[in]  func         The transaction callback.
+ * @param[in]  userdata     The user data passed to the callback.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_transaction_run (dc_transaction_t *transaction, dc_transaction_func_t func, void *userdata);
+
+/**
+ * Run a transaction with an expected size.
+ *
+ * The expected size is only used to scale the adaptive timeout. It
+ * should be proportional to the amount of data transferred, for example
+ * the size of the answer. A zero size is equivalent to
+ * #dc_transaction_run.
+ *
+ * @param[in]  transaction  A valid transaction object.
+ * @param[in]  size         The expected size (in bytes).
+ * @param[in]  func         The transaction callback.
+ * @param[in]  userdata     The user data passed to the callback.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_transaction_run_sized (dc_transaction_t *transaction, size_t size, dc_transaction_func_t func, void *userdata);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_TRANSACTION_H */
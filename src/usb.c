@@ -42,9 +42,12 @@
 #include "iterator-private.h"
 #include "platform.h"
 #include "array.h"
+#include "timer.h"
 
 #define ISINSTANCE(device) dc_iostream_isinstance((device), &dc_usb_vtable)
 
+#define CANCEL_TIMEOUT 2000
+
 typedef struct dc_usb_params_t {
 	unsigned int interface;
 	unsigned char endpoint_in;
@@ -79,7 +82,9 @@ static dc_status_t dc_usb_iterator_next (dc_iterator_t *iterator, void *item);
 static dc_status_t dc_usb_iterator_free (dc_iterator_t *iterator);
 
 static dc_status_t dc_usb_set_timeout (dc_iostream_t *iostream, int timeout);
+static dc_status_t dc_usb_get_available (dc_iostream_t *iostream, size_t *value);
 static dc_status_t dc_usb_poll (dc_iostream_t *iostream, int timeout);
+static dc_status_t dc_usb_get_pollfd (dc_iostream_t *iostream, dc_pollfd_t pollfd[], size_t size, size_t *actual);
 static dc_status_t dc_usb_read (dc_iostream_t *iostream, void *data, size_t size, size_t *actual);
 static dc_status_t dc_usb_write (dc_iostream_t *iostream, const void *data, size_t size, size_t *actual);
 static dc_status_t dc_usb_ioctl (dc_iostream_t *iostream, unsigned int request, void *data, size_t size);
@@ -94,6 +99,13 @@ typedef struct dc_usb_iterator_t {
 	size_t current;
 } dc_usb_iterator_t;
 
+typedef struct dc_usb_transfer_t {
+	struct dc_usb_t *usb;
+	struct libusb_transfer *transfer;
+	unsigned int pending;
+	unsigned int offset;
+} dc_usb_transfer_t;
+
 typedef struct dc_usb_t {
 	/* Base class. */
 	dc_iostream_t base;
@@ -104,6 +116,17 @@ typedef struct dc_usb_t {
 	unsigned char endpoint_in;
 	unsigned char endpoint_out;
 	unsigned int timeout;
+	dc_timer_t *timer;
+	/* Protects the pending state of the transfers below, which is updated
+	 * from the libusb callbacks. Those run on whichever thread handles
+	 * the events of the (shared) libusb session. */
+	dc_mutex_t mutex;
+	/* Queue of bulk-IN transfers. */
+	dc_usb_transfer_t *transfers;
+	unsigned int ntransfers;
+	unsigned int npending;
+	unsigned int head;
+	dc_status_t status;
 } dc_usb_t;
 
 static const dc_iterator_vtable_t dc_usb_iterator_vtable = {
@@ -119,9 +142,10 @@ static const dc_iostream_vtable_t dc_usb_vtable = {
 	NULL, /* set_dtr */
 	NULL, /* set_rts */
 	NULL, /* get_lines */
-	NULL, /* get_available */
+	dc_usb_get_available, /* get_available */
 	NULL, /* configure */
 	dc_usb_poll, /* poll */
+	dc_usb_get_pollfd, /* get_pollfd */
 	dc_usb_read, /* read */
 	dc_usb_write, /* write */
 	dc_usb_ioctl, /* ioctl */
@@ -172,6 +196,265 @@ syserror(int errcode)
 	}
 }
 
+/*
+ * With the transfer queue enabled, a number of bulk-IN transfers are
+ * kept submitted at all times. They complete in the order they were
+ * submitted, so the oldest one (the head) is always the next one to be
+ * read. The reader copies the data directly from the buffer of the
+ * completed transfer, and the transfer is resubmitted (at the tail of
+ * the queue) as soon as all its data has been consumed.
+ *
+ * The libusb session is shared by all devices, and the transfer callbacks
+ * are invoked by whichever thread happens to handle the events. The
+ * pending state is therefore protected by the per-device mutex, and the
+ * dc_usb_submit function must be called with the mutex locked.
+ *
+ * A transfer can't be freed, nor the device handle closed, while it is
+ * still pending. Freeing the queue therefore cancels all transfers, and
+ * waits until every callback has run.
+ */
+
+static void LIBUSB_CALL
+dc_usb_callback (struct libusb_transfer *transfer)
+{
+	dc_usb_transfer_t *current = (dc_usb_transfer_t *) transfer->user_data;
+
+	dc_usb_t *usb = current->usb;
+
+	dc_mutex_lock (&usb->mutex);
+
+	current->pending = 0;
+	current->offset = 0;
+	usb->npending--;
+
+	switch (transfer->status) {
+	case LIBUSB_TRANSFER_COMPLETED:
+	case LIBUSB_TRANSFER_CANCELLED:
+		break;
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		ERROR (usb->base.context, "Usb read bulk transfer failed (no device).");
+		usb->status = DC_STATUS_NODEVICE;
+		break;
+	default:
+		ERROR (usb->base.context, "Usb read bulk transfer failed (status %i).",
+			transfer->status);
+		usb->status = DC_STATUS_IO;
+		break;
+	}
+
+	dc_mutex_unlock (&usb->mutex);
+}
+
+static dc_status_t
+dc_usb_submit (dc_usb_t *usb, dc_usb_transfer_t *current)
+{
+	int rc = libusb_submit_transfer (current->transfer);
+	if (rc != LIBUSB_SUCCESS) {
+		ERROR (usb->base.context, "Failed to submit the usb transfer (%s).",
+			libusb_error_name (rc));
+		usb->status = syserror (rc);
+		return usb->status;
+	}
+
+	current->pending = 1;
+	usb->npending++;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_usb_wait (dc_usb_t *usb, int timeout)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_usb_transfer_t *current = &usb->transfers[usb->head];
+
+	// The absolute target time.
+	dc_usecs_t target = 0;
+	if (timeout > 0) {
+		dc_usecs_t now = 0;
+		status = dc_timer_now (usb->timer, &now);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		target = now + (dc_usecs_t) timeout * 1000;
+	}
+
+	// After an error, the transfers are no longer resubmitted, and the
+	// order of the queue can't be trusted anymore.
+	int init = 1;
+	while (1) {
+		dc_mutex_lock (&usb->mutex);
+		unsigned int pending = current->pending;
+		dc_status_t error = usb->status;
+		dc_mutex_unlock (&usb->mutex);
+
+		if (error != DC_STATUS_SUCCESS)
+			return error;
+
+		if (!pending)
+			break;
+
+		struct timeval tv;
+		if (timeout > 0) {
+			dc_usecs_t now = 0;
+			status = dc_timer_now (usb->timer, &now);
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+
+			dc_usecs_t remaining = now < target ? target - now : 0;
+			if (remaining == 0 && !init)
+				return DC_STATUS_TIMEOUT;
+
+			tv.tv_sec  = remaining / 1000000;
+			tv.tv_usec = remaining % 1000000;
+		} else if (timeout == 0) {
+			if (!init)
+				return DC_STATUS_TIMEOUT;
+
+			tv.tv_sec  = 0;
+			tv.tv_usec = 0;
+		} else {
+			tv.tv_sec  = 1;
+			tv.tv_usec = 0;
+		}
+
+		int rc = libusb_handle_events_timeout_completed (usb->session->handle, &tv, NULL);
+		if (rc != LIBUSB_SUCCESS && rc != LIBUSB_ERROR_INTERRUPTED) {
+			ERROR (usb->base.context, "Failed to handle the usb events (%s).",
+				libusb_error_name (rc));
+			return syserror (rc);
+		}
+
+		init = 0;
+	}
+
+	// A cancelled or failed transfer contains no valid data.
+	if (current->transfer->status != LIBUSB_TRANSFER_COMPLETED)
+		return DC_STATUS_IO;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static void
+dc_usb_queue_free (dc_usb_t *usb)
+{
+	if (usb->transfers == NULL)
+		return;
+
+	dc_mutex_lock (&usb->mutex);
+	for (unsigned int i = 0; i < usb->ntransfers; ++i) {
+		if (usb->transfers[i].pending) {
+			libusb_cancel_transfer (usb->transfers[i].transfer);
+		}
+	}
+	dc_mutex_unlock (&usb->mutex);
+
+	// Wait for the cancelled transfers to complete. libusb guarantees
+	// the callback of a cancelled transfer is always invoked, so the
+	// wait can't be aborted early. The events can also be handled by
+	// another thread, hence the short timeout.
+	int warned = 0;
+	dc_usecs_t now = 0, deadline = 0;
+	if (dc_timer_now (usb->timer, &now) == DC_STATUS_SUCCESS) {
+		deadline = now + (dc_usecs_t) CANCEL_TIMEOUT * 1000;
+	}
+
+	while (1) {
+		dc_mutex_lock (&usb->mutex);
+		unsigned int npending = usb->npending;
+		dc_mutex_unlock (&usb->mutex);
+
+		if (npending == 0)
+			break;
+
+		if (!warned && dc_timer_now (usb->timer, &now) == DC_STATUS_SUCCESS && now >= deadline) {
+			WARNING (usb->base.context, "Waiting for %u usb transfers to be cancelled.", npending);
+			warned = 1;
+		}
+
+		struct timeval tv = {0, 100000};
+		libusb_handle_events_timeout_completed (usb->session->handle, &tv, NULL);
+	}
+
+	for (unsigned int i = 0; i < usb->ntransfers; ++i) {
+		struct libusb_transfer *transfer = usb->transfers[i].transfer;
+		if (transfer) {
+			free (transfer->buffer);
+			libusb_free_transfer (transfer);
+		}
+	}
+	free (usb->transfers);
+
+	usb->transfers = NULL;
+	usb->ntransfers = 0;
+	usb->npending = 0;
+	usb->head = 0;
+	usb->status = DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_usb_queue_new (dc_usb_t *usb, unsigned int count, unsigned int size)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	dc_usb_queue_free (usb);
+
+	if (count == 0)
+		return DC_STATUS_SUCCESS;
+
+	if (size == 0 || size > 0x7FFFFFFF)
+		return DC_STATUS_INVALIDARGS;
+
+	usb->transfers = (dc_usb_transfer_t *) malloc (count * sizeof (dc_usb_transfer_t));
+	if (usb->transfers == NULL) {
+		ERROR (usb->base.context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	for (unsigned int i = 0; i < count; ++i) {
+		usb->transfers[i].usb = usb;
+		usb->transfers[i].transfer = NULL;
+		usb->transfers[i].pending = 0;
+		usb->transfers[i].offset = 0;
+	}
+
+	usb->ntransfers = count;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		struct libusb_transfer *transfer = libusb_alloc_transfer (0);
+		unsigned char *buffer = (unsigned char *) malloc (size);
+		if (transfer == NULL || buffer == NULL) {
+			ERROR (usb->base.context, "Failed to allocate memory.");
+			libusb_free_transfer (transfer);
+			free (buffer);
+			status = DC_STATUS_NOMEMORY;
+			goto error;
+		}
+
+		libusb_fill_bulk_transfer (transfer, usb->handle, usb->endpoint_in,
+			buffer, size, dc_usb_callback, &usb->transfers[i], 0);
+
+		usb->transfers[i].transfer = transfer;
+
+		dc_mutex_lock (&usb->mutex);
+		status = dc_usb_submit (usb, &usb->transfers[i]);
+		dc_mutex_unlock (&usb->mutex);
+		if (status != DC_STATUS_SUCCESS) {
+			goto error;
+		}
+	}
+
+	return DC_STATUS_SUCCESS;
+
+error:
+	dc_usb_queue_free (usb);
+	return status;
+}
+
+// The session reference count is shared by the iterator, the device
+// handles and the open streams, which can live on different threads.
+static dc_mutex_t g_usb_mutex = DC_MUTEX_INIT;
+
 static dc_status_t
 dc_usb_session_new (dc_usb_session_t **out, dc_context_t *context)
 {
@@ -218,8 +501,12 @@ dc_usb_session_ref (dc_usb_session_t *session)
 	if (session == NULL)
 		return NULL;
 
+	dc_mutex_lock (&g_usb_mutex);
+
 	session->refcount++;
 
+	dc_mutex_unlock (&g_usb_mutex);
+
 	return session;
 }
 
@@ -229,7 +516,13 @@ dc_usb_session_unref (dc_usb_session_t *session)
 	if (session == NULL)
 		return DC_STATUS_SUCCESS;
 
-	if (--session->refcount == 0) {
+	dc_mutex_lock (&g_usb_mutex);
+
+	unsigned int last = (--session->refcount == 0);
+
+	dc_mutex_unlock (&g_usb_mutex);
+
+	if (last) {
 		libusb_exit (session->handle);
 		free (session);
 	}
@@ -491,11 +784,26 @@ dc_usb_open (dc_iostream_t **out, dc_context_t *context, dc_usb_device_t *device
 	usb->endpoint_in = device->endpoint_in;
 	usb->endpoint_out = device->endpoint_out;
 	usb->timeout = 0;
+	usb->transfers = NULL;
+	usb->ntransfers = 0;
+	usb->npending = 0;
+	usb->head = 0;
+	usb->status = DC_STATUS_SUCCESS;
+
+	status = dc_timer_new (&usb->timer);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create a high resolution timer.");
+		goto error_usb_release;
+	}
+
+	dc_mutex_init (&usb->mutex);
 
 	*out = (dc_iostream_t *) usb;
 
 	return DC_STATUS_SUCCESS;
 
+error_usb_release:
+	libusb_release_interface (usb->handle, usb->interface);
 error_usb_close:
 	libusb_close (usb->handle);
 error_session_unref:
@@ -515,6 +823,9 @@ dc_usb_close (dc_iostream_t *abstract)
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_usb_t *usb = (dc_usb_t *) abstract;
 
+	dc_usb_queue_free (usb);
+	dc_timer_free (usb->timer);
+	dc_mutex_destroy (&usb->mutex);
 	libusb_release_interface (usb->handle, usb->interface);
 	libusb_close (usb->handle);
 	dc_usb_session_unref (usb->session);
@@ -538,10 +849,86 @@ dc_usb_set_timeout (dc_iostream_t *abstract, int timeout)
 	return DC_STATUS_SUCCESS;
 }
 
+static dc_status_t
+dc_usb_get_available (dc_iostream_t *abstract, size_t *value)
+{
+	dc_usb_t *usb = (dc_usb_t *) abstract;
+
+	if (usb->transfers == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	// Process the completed transfers, without blocking.
+	dc_status_t status = dc_usb_wait (usb, 0);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_TIMEOUT)
+		return status;
+
+	// Count the data in the completed transfers, up to the first one
+	// that is still pending.
+	size_t available = 0;
+	dc_mutex_lock (&usb->mutex);
+	for (unsigned int i = 0; i < usb->ntransfers; ++i) {
+		dc_usb_transfer_t *current = &usb->transfers[(usb->head + i) % usb->ntransfers];
+		if (current->pending)
+			break;
+		available += current->transfer->actual_length - current->offset;
+	}
+	dc_mutex_unlock (&usb->mutex);
+
+	if (value)
+		*value = available;
+
+	return DC_STATUS_SUCCESS;
+}
+
 static dc_status_t
 dc_usb_poll (dc_iostream_t *abstract, int timeout)
 {
-	return DC_STATUS_UNSUPPORTED;
+	dc_usb_t *usb = (dc_usb_t *) abstract;
+
+	if (usb->transfers == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	return dc_usb_wait (usb, timeout);
+}
+
+static dc_status_t
+dc_usb_get_pollfd (dc_iostream_t *abstract, dc_pollfd_t pollfd[], size_t size, size_t *actual)
+{
+	dc_usb_t *usb = (dc_usb_t *) abstract;
+
+	// Without a queue of asynchronous transfers, there is no activity on
+	// the file descriptors to wait for.
+	if (usb->transfers == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	// The file descriptors are owned by the libusb context, and can change
+	// whenever a device is added or removed.
+	const struct libusb_pollfd **fds = libusb_get_pollfds (usb->session->handle);
+	if (fds == NULL) {
+		ERROR (abstract->context, "Failed to get the usb file descriptors.");
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	size_t count = 0;
+	while (fds[count])
+		count++;
+
+	if (actual)
+		*actual = count;
+
+	if (count > size) {
+		libusb_free_pollfds (fds);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		pollfd[i].fd = fds[i]->fd;
+		pollfd[i].events = fds[i]->events;
+	}
+
+	libusb_free_pollfds (fds);
+
+	return DC_STATUS_SUCCESS;
 }
 
 static dc_status_t
@@ -551,6 +938,35 @@ dc_usb_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual)
 	dc_usb_t *usb = (dc_usb_t *) abstract;
 	int nbytes = 0;
 
+	if (usb->transfers) {
+		status = dc_usb_wait (usb, usb->timeout ? (int) usb->timeout : -1);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Usb read bulk transfer failed.");
+			goto out;
+		}
+
+		dc_usb_transfer_t *current = &usb->transfers[usb->head];
+		struct libusb_transfer *transfer = current->transfer;
+
+		size_t length = transfer->actual_length - current->offset;
+		if (length > size)
+			length = size;
+
+		memcpy (data, transfer->buffer + current->offset, length);
+		current->offset += length;
+		nbytes = length;
+
+		// Resubmit the transfer once it has been consumed completely.
+		if (current->offset == (unsigned int) transfer->actual_length) {
+			usb->head = (usb->head + 1) % usb->ntransfers;
+			dc_mutex_lock (&usb->mutex);
+			status = dc_usb_submit (usb, current);
+			dc_mutex_unlock (&usb->mutex);
+		}
+
+		goto out;
+	}
+
 	int rc = libusb_bulk_transfer (usb->handle, usb->endpoint_in, data, size, &nbytes, usb->timeout);
 	if (rc != LIBUSB_SUCCESS || nbytes < 0) {
 		ERROR (abstract->context, "Usb read bulk transfer failed (%s).",
@@ -614,6 +1030,15 @@ dc_usb_ioctl_control (dc_iostream_t *abstract, void *data, size_t size)
 	return DC_STATUS_SUCCESS;
 }
 
+static dc_status_t
+dc_usb_ioctl_queue (dc_iostream_t *abstract, void *data, size_t size)
+{
+	dc_usb_t *usb = (dc_usb_t *) abstract;
+	const dc_usb_queue_t *queue = (const dc_usb_queue_t *) data;
+
+	return dc_usb_queue_new (usb, queue->count, queue->size);
+}
+
 static dc_status_t
 dc_usb_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t size)
 {
@@ -621,6 +1046,8 @@ dc_usb_ioctl (dc_iostream_t *abstract, unsigned int request, void *data, size_t
 	case DC_IOCTL_USB_CONTROL_READ:
 	case DC_IOCTL_USB_CONTROL_WRITE:
 		return dc_usb_ioctl_control (abstract, data, size);
+	case DC_IOCTL_USB_SET_QUEUE:
+		return dc_usb_ioctl_queue (abstract, data, size);
 	default:
 		return DC_STATUS_UNSUPPORTED;
 	}
@@ -25,9 +25,6 @@
 
 #include <stdlib.h>
 #include <string.h>
-#ifdef HAVE_PTHREAD_H
-#include <pthread.h>
-#endif
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #define NOGDI
@@ -59,17 +56,15 @@
 #include "iostream-private.h"
 #include "iterator-private.h"
 #include "platform.h"
-
-#ifdef _WIN32
-typedef LONG dc_mutex_t;
-#define DC_MUTEX_INIT 0
-#else
-typedef pthread_mutex_t dc_mutex_t;
-#define DC_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
-#endif
+#include "timer.h"
 
 #define ISINSTANCE(device) dc_iostream_isinstance((device), &dc_usbhid_vtable)
 
+#define NTRANSFERS 4
+#define NREPORTS   32
+
+#define CANCEL_TIMEOUT 2000
+
 typedef struct dc_usbhid_session_t {
 	size_t refcount;
 #if defined(USE_LIBUSB)
@@ -96,7 +91,14 @@ static dc_status_t dc_usbhid_iterator_next (dc_iterator_t *iterator, void *item)
 static dc_status_t dc_usbhid_iterator_free (dc_iterator_t *iterator);
 
 static dc_status_t dc_usbhid_set_timeout (dc_iostream_t *iostream, int timeout);
+#if defined(USE_LIBUSB)
+static dc_status_t dc_usbhid_get_available (dc_iostream_t *iostream, size_t *value);
+static dc_status_t dc_usbhid_purge (dc_iostream_t *iostream, dc_direction_t direction);
+#endif
 static dc_status_t dc_usbhid_poll (dc_iostream_t *iostream, int timeout);
+#if defined(USE_LIBUSB)
+static dc_status_t dc_usbhid_get_pollfd (dc_iostream_t *iostream, dc_pollfd_t pollfd[], size_t size, size_t *actual);
+#endif
 static dc_status_t dc_usbhid_read (dc_iostream_t *iostream, void *data, size_t size, size_t *actual);
 static dc_status_t dc_usbhid_write (dc_iostream_t *iostream, const void *data, size_t size, size_t *actual);
 static dc_status_t dc_usbhid_ioctl (dc_iostream_t *iostream, unsigned int request, void *data, size_t size);
@@ -115,6 +117,14 @@ typedef struct dc_usbhid_iterator_t {
 #endif
 } dc_usbhid_iterator_t;
 
+#if defined(USE_LIBUSB)
+typedef struct dc_usbhid_transfer_t {
+	struct dc_usbhid_t *usbhid;
+	struct libusb_transfer *transfer;
+	unsigned int pending;
+} dc_usbhid_transfer_t;
+#endif
+
 typedef struct dc_usbhid_t {
 	/* Base class. */
 	dc_iostream_t base;
@@ -126,7 +136,21 @@ typedef struct dc_usbhid_t {
 	unsigned char endpoint_in;
 	unsigned char endpoint_out;
 	unsigned short packetsize;
-	unsigned int timeout;
+	int timeout;
+	dc_timer_t *timer;
+	/* Protects the transfer and receive state below, which is updated
+	 * from the libusb callbacks. Those run on whichever thread handles
+	 * the events of the (shared) libusb session. */
+	dc_mutex_t mutex;
+	/* Interrupt-IN transfers. */
+	dc_usbhid_transfer_t transfers[NTRANSFERS];
+	unsigned int npending;
+	dc_status_t status;
+	/* Receive ring of input reports. */
+	unsigned char *reports;
+	unsigned int lengths[NREPORTS];
+	unsigned int head;
+	unsigned int count;
 #elif defined(USE_HIDAPI)
 	hid_device *handle;
 	int timeout;
@@ -146,20 +170,35 @@ static const dc_iostream_vtable_t dc_usbhid_vtable = {
 	NULL, /* set_dtr */
 	NULL, /* set_rts */
 	NULL, /* get_lines */
+#if defined(USE_LIBUSB)
+	dc_usbhid_get_available, /* get_available */
+#else
 	NULL, /* get_available */
+#endif
 	NULL, /* configure */
 	dc_usbhid_poll, /* poll */
+#if defined(USE_LIBUSB)
+	dc_usbhid_get_pollfd, /* get_pollfd */
+#else
+	NULL, /* get_pollfd */
+#endif
 	dc_usbhid_read, /* read */
 	dc_usbhid_write, /* write */
 	dc_usbhid_ioctl, /* ioctl */
 	NULL, /* flush */
+#if defined(USE_LIBUSB)
+	dc_usbhid_purge, /* purge */
+#else
 	NULL, /* purge */
+#endif
 	NULL, /* sleep */
 	dc_usbhid_close, /* close */
 };
 
-#ifdef USE_HIDAPI
+// The session reference count is shared by the iterator, the device
+// handles and the open streams, which can live on different threads.
 static dc_mutex_t g_usbhid_mutex = DC_MUTEX_INIT;
+#ifdef USE_HIDAPI
 static dc_usbhid_session_t *g_usbhid_session = NULL;
 #endif
 
@@ -184,29 +223,207 @@ syserror(int errcode)
 		return DC_STATUS_IO;
 	}
 }
-#endif
 
-#ifdef USE_HIDAPI
-static void
-dc_mutex_lock (dc_mutex_t *mutex)
+/*
+ * The input reports are received asynchronously. A number of
+ * interrupt-IN transfers are kept submitted at all times, and each
+ * completed report is appended to a receive ring, from which the read
+ * function takes them. Because there is always a transfer pending, the
+ * device can send its data at the full rate, also while the
+ * application is busy processing the previous reports.
+ *
+ * A transfer is only resubmitted when there is room in the ring for
+ * its report. Otherwise it stays idle until the ring is drained.
+ *
+ * The libusb session is shared by all devices, and the transfer callbacks
+ * are invoked by whichever thread happens to handle the events. All state
+ * touched by the callbacks is therefore protected by the per-device mutex.
+ * The dc_usbhid_submit function must be called with the mutex locked.
+ *
+ * A transfer can't be freed, nor the device handle closed, while it is
+ * still pending. Closing the device therefore cancels all transfers,
+ * and waits until every callback has run.
+ */
+
+static void LIBUSB_CALL dc_usbhid_callback (struct libusb_transfer *transfer);
+
+static dc_status_t
+dc_usbhid_submit (dc_usbhid_t *usbhid)
 {
-#ifdef _WIN32
-	while (InterlockedCompareExchange (mutex, 1, 0) == 1) {
-		SleepEx (0, TRUE);
+	for (unsigned int i = 0; i < NTRANSFERS; ++i) {
+		dc_usbhid_transfer_t *current = &usbhid->transfers[i];
+
+		if (usbhid->status != DC_STATUS_SUCCESS)
+			return usbhid->status;
+
+		if (current->pending || usbhid->count + usbhid->npending >= NREPORTS)
+			continue;
+
+		int rc = libusb_submit_transfer (current->transfer);
+		if (rc != LIBUSB_SUCCESS) {
+			ERROR (usbhid->base.context, "Failed to submit the usb transfer (%s).",
+				libusb_error_name (rc));
+			usbhid->status = syserror (rc);
+			return usbhid->status;
+		}
+
+		current->pending = 1;
+		usbhid->npending++;
 	}
-#else
-	pthread_mutex_lock (mutex);
-#endif
+
+	return DC_STATUS_SUCCESS;
+}
+
+static void LIBUSB_CALL
+dc_usbhid_callback (struct libusb_transfer *transfer)
+{
+	dc_usbhid_transfer_t *current = (dc_usbhid_transfer_t *) transfer->user_data;
+
+	dc_usbhid_t *usbhid = current->usbhid;
+
+	dc_mutex_lock (&usbhid->mutex);
+
+	current->pending = 0;
+	usbhid->npending--;
+
+	switch (transfer->status) {
+	case LIBUSB_TRANSFER_COMPLETED:
+		if (usbhid->count < NREPORTS) {
+			unsigned int tail = (usbhid->head + usbhid->count) % NREPORTS;
+			memcpy (usbhid->reports + tail * usbhid->packetsize, transfer->buffer, transfer->actual_length);
+			usbhid->lengths[tail] = transfer->actual_length;
+			usbhid->count++;
+		}
+		dc_usbhid_submit (usbhid);
+		break;
+	case LIBUSB_TRANSFER_CANCELLED:
+		break;
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		ERROR (usbhid->base.context, "Usb read interrupt transfer failed (no device).");
+		usbhid->status = DC_STATUS_NODEVICE;
+		break;
+	default:
+		ERROR (usbhid->base.context, "Usb read interrupt transfer failed (status %i).",
+			transfer->status);
+		usbhid->status = DC_STATUS_IO;
+		break;
+	}
+
+	dc_mutex_unlock (&usbhid->mutex);
+}
+
+static dc_status_t
+dc_usbhid_wait (dc_usbhid_t *usbhid, int timeout)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	// The absolute target time.
+	dc_usecs_t target = 0;
+	if (timeout > 0) {
+		dc_usecs_t now = 0;
+		status = dc_timer_now (usbhid->timer, &now);
+		if (status != DC_STATUS_SUCCESS)
+			return status;
+
+		target = now + (dc_usecs_t) timeout * 1000;
+	}
+
+	int init = 1;
+	while (1) {
+		dc_mutex_lock (&usbhid->mutex);
+		unsigned int count = usbhid->count;
+		dc_status_t error = usbhid->status;
+		dc_mutex_unlock (&usbhid->mutex);
+
+		if (count)
+			break;
+
+		if (error != DC_STATUS_SUCCESS)
+			return error;
+
+		struct timeval tv;
+		if (timeout > 0) {
+			dc_usecs_t now = 0;
+			status = dc_timer_now (usbhid->timer, &now);
+			if (status != DC_STATUS_SUCCESS)
+				return status;
+
+			dc_usecs_t remaining = now < target ? target - now : 0;
+			if (remaining == 0 && !init)
+				return DC_STATUS_TIMEOUT;
+
+			tv.tv_sec  = remaining / 1000000;
+			tv.tv_usec = remaining % 1000000;
+		} else if (timeout == 0) {
+			if (!init)
+				return DC_STATUS_TIMEOUT;
+
+			tv.tv_sec  = 0;
+			tv.tv_usec = 0;
+		} else {
+			tv.tv_sec  = 1;
+			tv.tv_usec = 0;
+		}
+
+		int rc = libusb_handle_events_timeout_completed (usbhid->session->handle, &tv, NULL);
+		if (rc != LIBUSB_SUCCESS && rc != LIBUSB_ERROR_INTERRUPTED) {
+			ERROR (usbhid->base.context, "Failed to handle the usb events (%s).",
+				libusb_error_name (rc));
+			return syserror (rc);
+		}
+
+		init = 0;
+	}
+
+	return DC_STATUS_SUCCESS;
 }
 
 static void
-dc_mutex_unlock (dc_mutex_t *mutex)
+dc_usbhid_cancel (dc_usbhid_t *usbhid)
 {
-#ifdef _WIN32
-	InterlockedExchange (mutex, 0);
-#else
-	pthread_mutex_unlock (mutex);
-#endif
+	dc_mutex_lock (&usbhid->mutex);
+	for (unsigned int i = 0; i < NTRANSFERS; ++i) {
+		if (usbhid->transfers[i].pending) {
+			libusb_cancel_transfer (usbhid->transfers[i].transfer);
+		}
+	}
+	dc_mutex_unlock (&usbhid->mutex);
+
+	// Wait for the cancelled transfers to complete. libusb guarantees
+	// the callback of a cancelled transfer is always invoked, so the
+	// wait can't be aborted early. The events can also be handled by
+	// another thread, hence the short timeout.
+	int warned = 0;
+	dc_usecs_t now = 0, deadline = 0;
+	if (dc_timer_now (usbhid->timer, &now) == DC_STATUS_SUCCESS) {
+		deadline = now + (dc_usecs_t) CANCEL_TIMEOUT * 1000;
+	}
+
+	while (1) {
+		dc_mutex_lock (&usbhid->mutex);
+		unsigned int npending = usbhid->npending;
+		dc_mutex_unlock (&usbhid->mutex);
+
+		if (npending == 0)
+			break;
+
+		if (!warned && dc_timer_now (usbhid->timer, &now) == DC_STATUS_SUCCESS && now >= deadline) {
+			WARNING (usbhid->base.context, "Waiting for %u usb transfers to be cancelled.", npending);
+			warned = 1;
+		}
+
+		struct timeval tv = {0, 100000};
+		libusb_handle_events_timeout_completed (usbhid->session->handle, &tv, NULL);
+	}
+
+	for (unsigned int i = 0; i < NTRANSFERS; ++i) {
+		struct libusb_transfer *transfer = usbhid->transfers[i].transfer;
+		if (transfer) {
+			free (transfer->buffer);
+			libusb_free_transfer (transfer);
+		}
+		usbhid->transfers[i].transfer = NULL;
+	}
 }
 #endif
 
@@ -283,15 +500,11 @@ dc_usbhid_session_ref (dc_usbhid_session_t *session)
 	if (session == NULL)
 		return NULL;
 
-#ifdef USE_HIDAPI
 	dc_mutex_lock (&g_usbhid_mutex);
-#endif
 
 	session->refcount++;
 
-#ifdef USE_HIDAPI
 	dc_mutex_unlock (&g_usbhid_mutex);
-#endif
 
 	return session;
 }
@@ -302,9 +515,7 @@ dc_usbhid_session_unref (dc_usbhid_session_t *session)
 	if (session == NULL)
 		return DC_STATUS_SUCCESS;
 
-#ifdef USE_HIDAPI
 	dc_mutex_lock (&g_usbhid_mutex);
-#endif
 
 	if (--session->refcount == 0) {
 #if defined(USE_LIBUSB)
@@ -316,9 +527,7 @@ dc_usbhid_session_unref (dc_usbhid_session_t *session)
 		free (session);
 	}
 
-#ifdef USE_HIDAPI
 	dc_mutex_unlock (&g_usbhid_mutex);
-#endif
 
 	return DC_STATUS_SUCCESS;
 }
@@ -621,7 +830,60 @@ dc_usbhid_open (dc_iostream_t **out, dc_context_t *context, dc_usbhid_device_t *
 	usbhid->endpoint_in = device->endpoint_in;
 	usbhid->endpoint_out = device->endpoint_out;
 	usbhid->packetsize = device->packetsize;
-	usbhid->timeout = 0;
+	usbhid->timeout = -1;
+	usbhid->timer = NULL;
+	usbhid->npending = 0;
+	usbhid->status = DC_STATUS_SUCCESS;
+	usbhid->reports = NULL;
+	usbhid->head = 0;
+	usbhid->count = 0;
+	for (unsigned int i = 0; i < NTRANSFERS; ++i) {
+		usbhid->transfers[i].usbhid = usbhid;
+		usbhid->transfers[i].transfer = NULL;
+		usbhid->transfers[i].pending = 0;
+	}
+
+	status = dc_timer_new (&usbhid->timer);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (context, "Failed to create a high resolution timer.");
+		goto error_usb_release;
+	}
+
+	dc_mutex_init (&usbhid->mutex);
+
+	// Allocate the receive ring.
+	usbhid->reports = (unsigned char *) malloc (NREPORTS * usbhid->packetsize);
+	if (usbhid->reports == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto error_timer_free;
+	}
+
+	// Allocate the interrupt-IN transfers.
+	for (unsigned int i = 0; i < NTRANSFERS; ++i) {
+		struct libusb_transfer *transfer = libusb_alloc_transfer (0);
+		unsigned char *buffer = (unsigned char *) malloc (usbhid->packetsize);
+		if (transfer == NULL || buffer == NULL) {
+			ERROR (context, "Failed to allocate memory.");
+			libusb_free_transfer (transfer);
+			free (buffer);
+			status = DC_STATUS_NOMEMORY;
+			goto error_transfers_free;
+		}
+
+		libusb_fill_interrupt_transfer (transfer, usbhid->handle, usbhid->endpoint_in,
+			buffer, usbhid->packetsize, dc_usbhid_callback, &usbhid->transfers[i], 0);
+
+		usbhid->transfers[i].transfer = transfer;
+	}
+
+	// Start receiving the input reports.
+	dc_mutex_lock (&usbhid->mutex);
+	status = dc_usbhid_submit (usbhid);
+	dc_mutex_unlock (&usbhid->mutex);
+	if (status != DC_STATUS_SUCCESS) {
+		goto error_transfers_free;
+	}
 
 #elif defined(USE_HIDAPI)
 	INFO (context, "Open: path=%s", device->path);
@@ -642,6 +904,14 @@ dc_usbhid_open (dc_iostream_t **out, dc_context_t *context, dc_usbhid_device_t *
 	return DC_STATUS_SUCCESS;
 
 #if defined(USE_LIBUSB)
+error_transfers_free:
+	dc_usbhid_cancel (usbhid);
+	free (usbhid->reports);
+error_timer_free:
+	dc_timer_free (usbhid->timer);
+	dc_mutex_destroy (&usbhid->mutex);
+error_usb_release:
+	libusb_release_interface (usbhid->handle, usbhid->interface);
 error_usb_close:
 	libusb_close (usbhid->handle);
 #endif
@@ -663,6 +933,10 @@ dc_usbhid_close (dc_iostream_t *abstract)
 	dc_usbhid_t *usbhid = (dc_usbhid_t *) abstract;
 
 #if defined(USE_LIBUSB)
+	dc_usbhid_cancel (usbhid);
+	free (usbhid->reports);
+	dc_timer_free (usbhid->timer);
+	dc_mutex_destroy (&usbhid->mutex);
 	libusb_release_interface (usbhid->handle, usbhid->interface);
 	libusb_close (usbhid->handle);
 #elif defined(USE_HIDAPI)
@@ -678,29 +952,109 @@ dc_usbhid_set_timeout (dc_iostream_t *abstract, int timeout)
 {
 	dc_usbhid_t *usbhid = (dc_usbhid_t *) abstract;
 
-#if defined(USE_LIBUSB)
-	if (timeout < 0) {
-		usbhid->timeout = 0;
-	} else if (timeout == 0) {
-		return DC_STATUS_UNSUPPORTED;
-	} else {
-		usbhid->timeout = timeout;
-	}
-#elif defined(USE_HIDAPI)
 	if (timeout < 0) {
 		usbhid->timeout = -1;
 	} else {
 		usbhid->timeout = timeout;
 	}
-#endif
+
+	return DC_STATUS_SUCCESS;
+}
+
+#if defined(USE_LIBUSB)
+static dc_status_t
+dc_usbhid_get_available (dc_iostream_t *abstract, size_t *value)
+{
+	dc_usbhid_t *usbhid = (dc_usbhid_t *) abstract;
+
+	// Process the completed transfers, without blocking.
+	dc_status_t status = dc_usbhid_wait (usbhid, 0);
+	if (status != DC_STATUS_SUCCESS && status != DC_STATUS_TIMEOUT)
+		return status;
+
+	size_t available = 0;
+	dc_mutex_lock (&usbhid->mutex);
+	for (unsigned int i = 0; i < usbhid->count; ++i) {
+		available += usbhid->lengths[(usbhid->head + i) % NREPORTS];
+	}
+	dc_mutex_unlock (&usbhid->mutex);
+
+	if (value)
+		*value = available;
 
 	return DC_STATUS_SUCCESS;
 }
 
+static dc_status_t
+dc_usbhid_get_pollfd (dc_iostream_t *abstract, dc_pollfd_t pollfd[], size_t size, size_t *actual)
+{
+	dc_usbhid_t *usbhid = (dc_usbhid_t *) abstract;
+
+	// The file descriptors are owned by the libusb context, and can change
+	// whenever a device is added or removed.
+	const struct libusb_pollfd **fds = libusb_get_pollfds (usbhid->session->handle);
+	if (fds == NULL) {
+		ERROR (abstract->context, "Failed to get the usb file descriptors.");
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	size_t count = 0;
+	while (fds[count])
+		count++;
+
+	if (actual)
+		*actual = count;
+
+	if (count > size) {
+		libusb_free_pollfds (fds);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		pollfd[i].fd = fds[i]->fd;
+		pollfd[i].events = fds[i]->events;
+	}
+
+	libusb_free_pollfds (fds);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dc_usbhid_purge (dc_iostream_t *abstract, dc_direction_t direction)
+{
+	dc_usbhid_t *usbhid = (dc_usbhid_t *) abstract;
+
+	if (direction & DC_DIRECTION_INPUT) {
+		// Process the completed transfers, without blocking.
+		dc_status_t status = dc_usbhid_wait (usbhid, 0);
+		if (status != DC_STATUS_SUCCESS && status != DC_STATUS_TIMEOUT)
+			return status;
+
+		// Discard all queued input reports.
+		dc_mutex_lock (&usbhid->mutex);
+		usbhid->head = 0;
+		usbhid->count = 0;
+		status = dc_usbhid_submit (usbhid);
+		dc_mutex_unlock (&usbhid->mutex);
+
+		return status;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+#endif
+
 static dc_status_t
 dc_usbhid_poll (dc_iostream_t *abstract, int timeout)
 {
+#if defined(USE_LIBUSB)
+	dc_usbhid_t *usbhid = (dc_usbhid_t *) abstract;
+
+	return dc_usbhid_wait (usbhid, timeout);
+#else
 	return DC_STATUS_UNSUPPORTED;
+#endif
 }
 
 static dc_status_t
@@ -711,19 +1065,34 @@ dc_usbhid_read (dc_iostream_t *abstract, void *data, size_t size, size_t *actual
 	int nbytes = 0;
 
 #if defined(USE_LIBUSB)
-	if (size > usbhid->packetsize) {
-		size = usbhid->packetsize;
-	}
+	unsigned char *buffer = (unsigned char *) data;
 
-	int rc = libusb_interrupt_transfer (usbhid->handle, usbhid->endpoint_in, data, size, &nbytes, usbhid->timeout);
-	if (rc != LIBUSB_SUCCESS || nbytes < 0) {
-		ERROR (abstract->context, "Usb read interrupt transfer failed (%s).",
-			libusb_error_name (rc));
-		status = syserror (rc);
-		if (nbytes < 0)
-			nbytes = 0;
+	status = dc_usbhid_wait (usbhid, usbhid->timeout);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Usb read interrupt transfer failed.");
 		goto out;
 	}
+
+	// Take the oldest report from the receive ring. Every read returns
+	// exactly one report, just like the synchronous implementation.
+	// Backends rely on that to parse the report framing.
+	dc_mutex_lock (&usbhid->mutex);
+	unsigned int length = usbhid->lengths[usbhid->head];
+	if (length > size) {
+		WARNING (abstract->context, "Input report truncated (%u " DC_PRINTF_SIZE ").", length, size);
+		length = size;
+	}
+
+	memcpy (buffer, usbhid->reports + usbhid->head * usbhid->packetsize, length);
+	nbytes = length;
+
+	usbhid->head = (usbhid->head + 1) % NREPORTS;
+	usbhid->count--;
+
+	// Resubmit the idle transfers. A failure is reported by the next
+	// read, once all queued reports have been consumed.
+	dc_usbhid_submit (usbhid);
+	dc_mutex_unlock (&usbhid->mutex);
 #elif defined(USE_HIDAPI)
 	nbytes = hid_read_timeout(usbhid->handle, data, size, usbhid->timeout);
 	if (nbytes < 0) {
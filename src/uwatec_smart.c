@@ -77,6 +77,7 @@ static const dc_device_vtable_t uwatec_smart_device_vtable = {
 	NULL, /* write */
 	uwatec_smart_device_dump, /* dump */
 	uwatec_smart_device_foreach, /* foreach */
+	NULL, /* foreach_step */
 	NULL, /* timesync */
 	NULL /* close */
 };
@@ -120,6 +121,9 @@ uwatec_smart_irda_receive (uwatec_smart_device_t *device, dc_event_progress_t *p
 
 	size_t nbytes = 0;
 	while (nbytes < size) {
+		if (device_is_cancelled (abstract))
+			return DC_STATUS_CANCELLED;
+
 		// Set the minimum packet size.
 		size_t len = 32;
 
@@ -213,6 +217,9 @@ uwatec_smart_serial_receive (uwatec_smart_device_t *device, dc_event_progress_t
 
 	size_t nbytes = 0;
 	while (nbytes < size) {
+		if (device_is_cancelled (abstract))
+			return DC_STATUS_CANCELLED;
+
 		// Read the header.
 		unsigned char header[5];
 		status = dc_iostream_read (device->iostream, header, sizeof (header), NULL);
@@ -323,6 +330,9 @@ uwatec_smart_usbhid_receive (uwatec_smart_device_t *device, dc_event_progress_t
 
 	size_t nbytes = 0;
 	while (nbytes < size) {
+		if (device_is_cancelled (abstract))
+			return DC_STATUS_CANCELLED;
+
 		size_t transferred = 0;
 		rc = dc_iostream_read (device->iostream, buf, packetsize, &transferred);
 		if (rc != DC_STATUS_SUCCESS) {
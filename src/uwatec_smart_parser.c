@@ -58,6 +58,9 @@
 
 #define UNSUPPORTED 0xFFFFFFFF
 
+#define LUT_ESCAPE  0xFE
+#define LUT_INVALID 0xFF
+
 #define NEVENTS   3
 #define NGASMIXES 10
 
@@ -119,6 +122,12 @@ typedef struct uwatec_smart_sample_info_t {
 	unsigned int extrabytes;
 } uwatec_smart_sample_info_t;
 
+typedef struct uwatec_smart_lut_t {
+	unsigned char id;
+	unsigned char length;
+	unsigned char nbits;
+} uwatec_smart_lut_t;
+
 typedef struct uwatec_smart_event_info_t {
 	uwatec_smart_event_t type;
 	unsigned int mask;
@@ -150,6 +159,10 @@ struct uwatec_smart_parser_t {
 	const uwatec_smart_event_info_t *events[NEVENTS];
 	unsigned int nevents[NEVENTS];
 	unsigned int trimix;
+	unsigned int galileo;
+	// Sample lookup tables.
+	uwatec_smart_lut_t lut[256];
+	uwatec_smart_lut_t lut_ext[256];
 	// Cached fields.
 	unsigned int cached;
 	unsigned int ngasmixes;
@@ -175,6 +188,7 @@ static const dc_parser_vtable_t uwatec_smart_parser_vtable = {
 	uwatec_smart_parser_get_datetime, /* datetime */
 	uwatec_smart_parser_get_field, /* fields */
 	uwatec_smart_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_foreach_fixed */
 	NULL /* destroy */
 };
 
@@ -574,6 +588,112 @@ uwatec_smart_parser_cache (uwatec_smart_parser_t *parser)
 }
 
 
+static unsigned int
+uwatec_smart_identify (const unsigned char data[], unsigned int size)
+{
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < size; ++i) {
+		unsigned char value = data[i];
+		for (unsigned int j = 0; j < NBITS; ++j) {
+			unsigned char mask = 1 << (NBITS - 1 - j);
+			if ((value & mask) == 0)
+				return count;
+			count++;
+		}
+	}
+
+	return (unsigned int) -1;
+}
+
+
+static unsigned int
+uwatec_galileo_identify (unsigned char value)
+{
+	// Bits: 0ddd dddd
+	if ((value & 0x80) == 0)
+		return 0;
+
+	// Bits: 100d dddd
+	if ((value & 0xE0) == 0x80)
+		return 1;
+
+	// Bits: 1XXX dddd
+	if ((value & 0xF0) != 0xF0)
+		return (value & 0x70) >> 4;
+
+	// Bits: 1111 XXXX
+	return (value & 0x0F) + 7;
+}
+
+
+
+static void
+uwatec_smart_lut_entry (uwatec_smart_parser_t *parser, uwatec_smart_lut_t *entry, unsigned int id)
+{
+	if (id >= parser->nsamples) {
+		entry->id = LUT_INVALID;
+		entry->length = 0;
+		entry->nbits = 0;
+		return;
+	}
+
+	const uwatec_smart_sample_info_t *info = parser->samples + id;
+
+	// The type bits are followed by the remaining data bits of the
+	// last type byte (if any), and the extra data bytes.
+	unsigned int n = info->ntypebits % NBITS;
+	unsigned int nbits = info->extrabytes * NBITS;
+	if (n > 0 && !info->ignoretype) {
+		nbits += NBITS - n;
+	}
+
+	entry->id = id;
+	entry->length = info->ntypebits / NBITS + (n > 0) + info->extrabytes;
+	entry->nbits = nbits;
+}
+
+/*
+ * Build the lookup tables to identify the samples.
+ *
+ * The first table is indexed with the first byte of the sample. For the
+ * Smart models, the type bits of the longest samples continue into the
+ * second byte, and those are found in the second table, indexed with the
+ * second byte.
+ */
+static void
+uwatec_smart_lut_init (uwatec_smart_parser_t *parser)
+{
+	for (unsigned int i = 0; i < 256; ++i) {
+		unsigned char value = i;
+		unsigned int id = 0;
+
+		if (parser->galileo) {
+			id = uwatec_galileo_identify (value);
+		} else {
+			id = uwatec_smart_identify (&value, 1);
+		}
+
+		if (id == (unsigned int) -1) {
+			parser->lut[i].id = LUT_ESCAPE;
+			parser->lut[i].length = 0;
+			parser->lut[i].nbits = 0;
+		} else {
+			uwatec_smart_lut_entry (parser, parser->lut + i, id);
+		}
+
+		if (parser->galileo) {
+			id = UNSUPPORTED;
+		} else {
+			id = uwatec_smart_identify (&value, 1);
+			if (id != (unsigned int) -1)
+				id += NBITS;
+		}
+
+		uwatec_smart_lut_entry (parser, parser->lut_ext + i, id);
+	}
+}
+
+
 dc_status_t
 uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, const unsigned char data[], size_t size, unsigned int model)
 {
@@ -593,6 +713,7 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 	// Set the default values.
 	parser->model = model;
 	parser->trimix = 0;
+	parser->galileo = 0;
 	for (unsigned int i = 0; i < NEVENTS; ++i) {
 		parser->events[i] = NULL;
 		parser->nevents[i] = 0;
@@ -623,6 +744,7 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 		parser->nevents[0] = C_ARRAY_SIZE (uwatec_smart_galileo_events_0);
 		parser->nevents[1] = C_ARRAY_SIZE (uwatec_smart_galileo_events_1);
 		parser->nevents[2] = C_ARRAY_SIZE (uwatec_smart_galileo_events_2);
+		parser->galileo = 1;
 		break;
 	case G2:
 	case G2HUD:
@@ -644,6 +766,7 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 		parser->nevents[1] = C_ARRAY_SIZE (uwatec_smart_galileo_events_1);
 		parser->nevents[2] = C_ARRAY_SIZE (uwatec_smart_trimix_events_2);
 		parser->trimix = 1;
+		parser->galileo = 1;
 		break;
 	case ALADINTEC:
 		parser->headersize = 108;
@@ -702,6 +825,8 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, const unsi
 	parser->watertype = DC_WATER_FRESH;
 	parser->divemode = DC_DIVEMODE_OC;
 
+	uwatec_smart_lut_init (parser);
+
 	*out = (dc_parser_t*) parser;
 
 	return DC_STATUS_SUCCESS;
@@ -837,44 +962,6 @@ uwatec_smart_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsi
 }
 
 
-static unsigned int
-uwatec_smart_identify (const unsigned char data[], unsigned int size)
-{
-	unsigned int count = 0;
-	for (unsigned int i = 0; i < size; ++i) {
-		unsigned char value = data[i];
-		for (unsigned int j = 0; j < NBITS; ++j) {
-			unsigned char mask = 1 << (NBITS - 1 - j);
-			if ((value & mask) == 0)
-				return count;
-			count++;
-		}
-	}
-
-	return (unsigned int) -1;
-}
-
-
-static unsigned int
-uwatec_galileo_identify (unsigned char value)
-{
-	// Bits: 0ddd dddd
-	if ((value & 0x80) == 0)
-		return 0;
-
-	// Bits: 100d dddd
-	if ((value & 0xE0) == 0x80)
-		return 1;
-
-	// Bits: 1XXX dddd
-	if ((value & 0xF0) != 0xF0)
-		return (value & 0x70) >> 4;
-
-	// Bits: 1111 XXXX
-	return (value & 0x0F) + 7;
-}
-
-
 static dc_status_t
 uwatec_smart_parse (uwatec_smart_parser_t *parser, dc_sample_callback_t callback, void *userdata)
 {
@@ -927,59 +1014,38 @@ uwatec_smart_parse (uwatec_smart_parser_t *parser, dc_sample_callback_t callback
 	while (offset < size) {
 		dc_sample_value_t sample = {0};
 
-		// Process the type bits in the bitstream.
-		unsigned int id = 0;
-		if (parser->model == GALILEO || parser->model == GALILEOTRIMIX ||
-			parser->model == ALADIN2G || parser->model == MERIDIAN ||
-			parser->model == CHROMIS || parser->model == MANTIS2 ||
-			parser->model == G2 || parser->model == ALADINSPORTMATRIX ||
-			parser->model == ALADINSQUARE || parser->model == G2HUD ||
-			parser->model == ALADINA1 || parser->model == ALADINA2 ||
-			parser->model == G2TEK || parser->model == G3 ||
-			parser->model == LUNA2AI || parser->model == LUNA2) {
-			// Uwatec Galileo
-			id = uwatec_galileo_identify (data[offset]);
-		} else {
-			// Uwatec Smart
-			id = uwatec_smart_identify (data + offset, size - offset);
+		// Identify the sample type with the lookup table.
+		const uwatec_smart_lut_t *entry = parser->lut + data[offset];
+		if (entry->id == LUT_ESCAPE && offset + 1 < size) {
+			entry = parser->lut_ext + data[offset + 1];
 		}
-		if (id >= entries) {
+		if (entry->id >= entries) {
 			ERROR (abstract->context, "Invalid type bits.");
 			return DC_STATUS_DATAFORMAT;
 		}
 
-		// Skip the processed type bytes.
-		offset += table[id].ntypebits / NBITS;
-
-		// Process the remaining data bits.
-		unsigned int nbits = 0;
-		unsigned int value = 0;
-		unsigned int n = table[id].ntypebits % NBITS;
-		if (n > 0) {
-			nbits = NBITS - n;
-			value = data[offset] & (0xFF >> n);
-			if (table[id].ignoretype) {
-				// Ignore any data bits that are stored in
-				// the last type byte for certain samples.
-				nbits = 0;
-				value = 0;
-			}
-			offset++;
-		}
+		unsigned int id = entry->id;
+		unsigned int length = entry->length;
+		unsigned int nbits = entry->nbits;
 
 		// Check for buffer overflows.
-		if (offset + table[id].extrabytes > size) {
+		if (offset + length > size) {
 			ERROR (abstract->context, "Incomplete sample data.");
 			return DC_STATUS_DATAFORMAT;
 		}
 
-		// Process the extra data bytes.
-		for (unsigned int i = 0; i < table[id].extrabytes; ++i) {
-			nbits += NBITS;
-			value <<= NBITS;
-			value += data[offset];
-			offset++;
+		// Extract the data bits, which are always the least
+		// significant bits of the (at most four) sample bytes.
+		unsigned int value = 0;
+		if (offset + 4 <= size) {
+			value = array_uint32_be (data + offset) >> (32 - length * NBITS);
+		} else {
+			for (unsigned int i = 0; i < length; ++i) {
+				value = (value << NBITS) | data[offset + i];
+			}
 		}
+		value &= (1U << nbits) - 1;
+		offset += length;
 
 		// Fix the sign bit.
 		signed int svalue = signextend (value, nbits);